@@ -0,0 +1,354 @@
+
+// Qt
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+// GDAL
+#include <gdal_priv.h>
+
+// Project
+#include "BatchProcessor.h"
+#include "Core/ImageDataProvider.h"
+#include "Core/IntegralImage.h"
+#include "Core/LayerUtils.h"
+#include "Filters/FiltersManager.h"
+#include "Filters/TiledFilterEngine.h"
+
+// STD
+#include <iostream>
+
+namespace Batch
+{
+
+//******************************************************************************
+/*!
+  \class BatchProcessor
+  \brief runs overview builds, statistics, a filter chain and exports over a list of image files
+  without user interaction.
+
+  Files are processed in a pool of nbOfJobs threads, filters are applied tile by tile with
+  nbOfThreadsPerFile threads per file. Each file is filtered with its own pipeline of filter copies. Each step of each file is reported on the standard output
+  as a tab-separated line : file, step, status, duration in ms and step info.
+
+  Files with several subsets are opened at subsetIndex.
+*/
+
+//******************************************************************************
+
+class ProcessFileTask : public QRunnable
+{
+public:
+    ProcessFileTask(BatchProcessor * processor, const QString & file) :
+        _processor(processor),
+        _file(file)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        _processor->processFile(_file);
+    }
+
+protected:
+    BatchProcessor * _processor;
+    QString _file;
+};
+
+//******************************************************************************
+/*!
+  Filter of the filters manager with the name or the class name
+*/
+const Filters::AbstractFilter * findFilter(const QString & name)
+{
+    foreach (Filters::AbstractFilter * f, Filters::FiltersManager::get()->getFilters())
+    {
+        if (f->getName() == name || name == f->metaObject()->className())
+            return f;
+    }
+    return 0;
+}
+
+//******************************************************************************
+
+BatchProcessor::BatchProcessor(QObject *parent) :
+    QObject(parent),
+    _nbOfJobs(QThread::idealThreadCount()),
+    _nbOfThreadsPerFile(1),
+    _buildOverviews(false),
+    _computeStats(false),
+    _subsetIndex(0),
+    _nbOfFailures(0)
+{
+}
+
+//******************************************************************************
+
+BatchProcessor::~BatchProcessor()
+{
+    qDeleteAll(_filters);
+}
+
+//******************************************************************************
+/*!
+  Method to append a copy of a filter to the chain, the same filter can be appended several times
+  \param specification is 'filter name[:property=value[,property=value]]', e.g. 'Blur filter:size=7',
+  filter name is the name of the filter or its class name
+*/
+bool BatchProcessor::addFilter(const QString &specification, QString * errorMessage)
+{
+    QString name = specification.section(':', 0, 0).trimmed();
+    QString properties = specification.section(':', 1);
+
+    const Filters::AbstractFilter * prototype = findFilter(name);
+    Filters::AbstractFilter * filter = prototype ? prototype->clone() : 0;
+    QString message;
+    if (!prototype)
+    {
+        message = tr("Filter \'%1\' is not found").arg(name);
+    }
+    else if (!filter)
+    {
+        message = tr("Filter \'%1\' can not be copied").arg(name);
+    }
+    else
+    {
+        foreach (QString property, properties.split(',', QString::SkipEmptyParts))
+        {
+            QString key = property.section('=', 0, 0).trimmed();
+            QString value = property.section('=', 1).trimmed();
+            if (!filter->setProperty(key.toLatin1().constData(), value))
+            {
+                message = tr("Failed to set property \'%1\' of filter \'%2\'").arg(key).arg(name);
+                break;
+            }
+        }
+    }
+
+    if (!message.isEmpty())
+    {
+        if (errorMessage)
+            *errorMessage = message;
+        delete filter;
+        return false;
+    }
+    filter->setNoDataValue(Core::ImageDataProvider::NoDataValue);
+    filter->setVerbose(false);
+    _filters << filter;
+    return true;
+}
+
+//******************************************************************************
+/*!
+  Method to process the files. Method is blocking.
+  \return number of files failed to process
+*/
+int BatchProcessor::run(const QStringList &files)
+{
+    _nbOfFailures = 0;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, _nbOfJobs));
+    foreach (QString file, files)
+    {
+        pool.start(new ProcessFileTask(this, file));
+    }
+    pool.waitForDone();
+
+    return _nbOfFailures;
+}
+
+//******************************************************************************
+
+void BatchProcessor::processFile(const QString &file)
+{
+    QElapsedTimer total, timer;
+    total.start();
+    timer.start();
+
+    QString info;
+    Core::GDALDataProvider * provider = open(file, info);
+    bool ok = provider != 0;
+    report(file, "open", ok, timer.restart(), info);
+
+    if (ok && _buildOverviews)
+    {
+        ok = Core::createOverviews(provider->getDataset());
+        report(file, "overviews", ok, timer.restart());
+    }
+
+    if (ok && _computeStats)
+    {
+        info.clear();
+        ok = computeStatistics(provider, info);
+        report(file, "stats", ok, timer.restart(), info);
+    }
+
+    Core::ImageDataProvider * result = 0;
+    if (ok && !_filters.isEmpty())
+    {
+        // Pipeline and filters of the job, they are deleted with the pipeline
+        Filters::FilterPipeline pipeline;
+        pipeline.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+        foreach (const Filters::AbstractFilter * f, _filters)
+        {
+            Filters::AbstractFilter * copy = f->clone();
+            if (!copy)
+                break;
+            copy->setParent(&pipeline);
+            pipeline.append(copy);
+        }
+
+        Filters::TiledFilterEngine engine;
+        engine.setMaxNbOfThreads(qMax(1, _nbOfThreadsPerFile));
+        if (pipeline.getFilters().size() == _filters.size())
+        {
+            result = engine.apply(&pipeline, provider);
+            info = result ? pipeline.getName() : engine.getErrorMessage();
+        }
+        else
+        {
+            info = tr("Failed to copy the filters");
+        }
+        ok = result != 0;
+        report(file, "filters", ok, timer.restart(), info);
+    }
+
+    if (ok && !_outputPath.isEmpty())
+    {
+        info.clear();
+        ok = exportImage(result ? result : provider, file, info);
+        report(file, "export", ok, timer.restart(), info);
+    }
+
+    delete result;
+    delete provider;
+
+    if (!ok)
+    {
+        QMutexLocker locker(&_mutex);
+        _nbOfFailures++;
+    }
+    report(file, "total", ok, total.elapsed());
+}
+
+//******************************************************************************
+
+Core::GDALDataProvider * BatchProcessor::open(const QString &file, QString &info)
+{
+    if (!QFileInfo(file).exists())
+    {
+        info = tr("File is not found");
+        return 0;
+    }
+
+    QString fileToOpen = file;
+    QStringList subsetNames, subsetDescriptions;
+    if (Core::isSubsetFile(file, subsetNames, subsetDescriptions))
+    {
+        if (_subsetIndex < 0 || _subsetIndex >= subsetNames.size())
+        {
+            info = tr("Subset %1 is not found, file has %2 subsets").arg(_subsetIndex).arg(subsetNames.size());
+            return 0;
+        }
+        fileToOpen = subsetNames[_subsetIndex];
+        info = subsetDescriptions.value(_subsetIndex);
+    }
+
+    Core::GDALDataProvider * provider = new Core::GDALDataProvider();
+    provider->setImageName(QFileInfo(file).baseName());
+    if (!provider->setup(fileToOpen))
+    {
+        info = tr("Failed to open the file");
+        delete provider;
+        return 0;
+    }
+    return provider;
+}
+
+//******************************************************************************
+/*!
+  Method to compute the stats of the provider (as in ImageOpener) and to write min, max, mean and std of bands in info
+*/
+bool BatchProcessor::computeStatistics(Core::GDALDataProvider *provider, QString &info)
+{
+    cv::Mat data = provider->getImageData(QRect(), 1024);
+    if (data.empty())
+        return false;
+
+    cv::Mat mask = Core::ImageDataProvider::computeMask(data);
+    QVector<double> minValues, maxValues;
+    QVector<QVector<double> > bandHistograms;
+    int histSize = provider->getInputDepthInBytes() > 1 ? 1000 : 256;
+    if (!Core::computeNormalizedHistogram(data, mask, minValues, maxValues, bandHistograms, histSize))
+        return false;
+    provider->setMinValues(minValues);
+    provider->setMaxValues(maxValues);
+    provider->setBandHistograms(bandHistograms);
+
+    // Mean and std are computed at the overview level of the data used for the histograms
+    QSize size = provider->getPixelExtent().size();
+    int level = 0;
+    while ((qMax(size.width(), size.height()) >> level) > 1024)
+    {
+        level++;
+    }
+    QVector<double> means, stds;
+    Core::WindowStatistics stats(provider);
+    if (!stats.meanStdDev(QRect(), level, means, stds))
+        return false;
+
+    QStringList bands;
+    for (int i=0; i<minValues.size() && i<means.size(); i++)
+    {
+        bands << QString("b%1: min=%2 max=%3 mean=%4 std=%5")
+                 .arg(i + 1).arg(minValues[i]).arg(maxValues[i]).arg(means[i]).arg(stds[i]);
+    }
+    info = bands.join("; ");
+    return true;
+}
+
+//******************************************************************************
+/*!
+  Method to write provider data (or its subset pixelExtent) as tiled GeoTiff into the output directory
+*/
+bool BatchProcessor::exportImage(const Core::ImageDataProvider *provider, const QString &file, QString &info)
+{
+    QDir dir(_outputPath);
+    if (!dir.exists() && !dir.mkpath("."))
+    {
+        info = tr("Failed to create the output directory");
+        return false;
+    }
+    QString suffix = _filters.isEmpty() ? QString() : QString("_filtered");
+    QString path = dir.absoluteFilePath(QFileInfo(file).baseName() + suffix + ".tif");
+    info = path;
+
+    // Data is streamed by windows, the subset is read directly from the source
+    Core::GeoTiffOptions options = _exportOptions;
+    options.NbOfThreads = qMax(1, _nbOfThreadsPerFile);
+    return Core::writeToFile(path, provider, _pixelExtent,
+                             provider->fetchProjectionRef(), provider->fetchGeoTransform(),
+                             Core::ImageDataProvider::NoDataValue,
+                             QList< QPair<QString,QString> >(), options);
+}
+
+//******************************************************************************
+
+void BatchProcessor::report(const QString &file, const QString &step, bool ok, qint64 ms, const QString &info)
+{
+    QString line = QString("%1\t%2\t%3\t%4 ms").arg(file).arg(step).arg(ok ? "ok" : "failed").arg(ms);
+    if (!info.isEmpty())
+        line += "\t" + info;
+    QMutexLocker locker(&_mutex);
+    std::cout << line.toStdString() << std::endl;
+}
+
+//******************************************************************************
+
+}
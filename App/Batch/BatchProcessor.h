@@ -0,0 +1,69 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+// Qt
+#include <QObject>
+#include <QStringList>
+#include <QMutex>
+#include <QRect>
+
+// Project
+#include "Core/Global.h"
+#include "Core/LayerUtils.h"
+#include "Filters/FilterPipeline.h"
+
+namespace Core
+{
+class GDALDataProvider;
+class ImageDataProvider;
+}
+
+namespace Batch
+{
+
+//******************************************************************************
+
+class BatchProcessor : public QObject
+{
+    Q_OBJECT
+
+    PROPERTY_ACCESSORS(int, nbOfJobs, getNbOfJobs, setNbOfJobs)
+    PROPERTY_ACCESSORS(int, nbOfThreadsPerFile, getNbOfThreadsPerFile, setNbOfThreadsPerFile)
+    PROPERTY_ACCESSORS(bool, buildOverviews, getBuildOverviews, setBuildOverviews)
+    PROPERTY_ACCESSORS(bool, computeStats, getComputeStats, setComputeStats)
+    //! Output directory of exported images, images are not exported if empty
+    PROPERTY_ACCESSORS(QString, outputPath, getOutputPath, setOutputPath)
+    //! Subset opened for files with several subsets
+    PROPERTY_ACCESSORS(int, subsetIndex, getSubsetIndex, setSubsetIndex)
+    //! Pixel extent of exported images, whole images are exported if empty
+    PROPERTY_ACCESSORS(QRect, pixelExtent, getPixelExtent, setPixelExtent)
+    //! Codec, predictor and layout of exported images
+    PROPERTY_ACCESSORS(Core::GeoTiffOptions, exportOptions, getExportOptions, setExportOptions)
+
+public:
+    explicit BatchProcessor(QObject * parent = 0);
+    virtual ~BatchProcessor();
+
+    bool addFilter(const QString & specification, QString * errorMessage = 0);
+    int run(const QStringList & files);
+
+    void processFile(const QString & file);
+
+protected:
+    Core::GDALDataProvider * open(const QString & file, QString & info);
+    bool computeStatistics(Core::GDALDataProvider * provider, QString & info);
+    bool exportImage(const Core::ImageDataProvider * provider, const QString & file, QString & info);
+    void report(const QString & file, const QString & step, bool ok, qint64 ms, const QString & info = QString());
+
+    //! Configured filters of the chain, each job runs a pipeline of their clones
+    QList<Filters::AbstractFilter*> _filters;
+    QMutex _mutex;
+    int _nbOfFailures;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,210 @@
+/*!
+*
+* Geo Image Viewer project
+*
+* Command-line batch processing : overviews, statistics, filter chains and exports over lists of files.
+*
+* Usage : giv-batch [options] files...
+*
+*/
+
+
+// Qt
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QRect>
+
+// GDAL
+#include <gdal_priv.h>
+
+// Project
+#include "BatchProcessor.h"
+#include "Filters/FiltersManager.h"
+#include "Core/LayerUtils.h"
+
+// STD
+#include <iostream>
+
+//******************************************************************************
+
+void printUsage()
+{
+    std::cout << "Usage : giv-batch [options] files..." << std::endl
+              << "Options :" << std::endl
+              << "  --list <file>       text file with an input file per line" << std::endl
+              << "  --jobs <n>          number of files processed in parallel (default : nb of cores)" << std::endl
+              << "  --threads <n>       number of threads to filter a file (default : 1)" << std::endl
+              << "  --overviews         build overviews" << std::endl
+              << "  --stats             compute band statistics" << std::endl
+              << "  --plugins <path>    load filter plugins from the path" << std::endl
+              << "  --filter <spec>     append a filter to the chain, spec is 'name[:property=value[,property=value]]'" << std::endl
+              << "  --output <dir>      export (filtered) images as GeoTiff into the directory" << std::endl
+              << "  --subset <index>    subset to open for files with several subsets (default : 0)" << std::endl
+              << "  --extent <x,y,w,h>  export only the pixel extent of images" << std::endl
+              << "  --compress <codec>  codec of exported images : LZW (default), DEFLATE, ZSTD or JPEG (8 bits RGB)" << std::endl
+              << "  --predictor <n>     TIFF predictor of exported images : 2 - horizontal, 3 - floating point" << std::endl
+              << "  --level <n>         compression level (or JPEG quality) of exported images" << std::endl
+              << "  --cog               export cloud optimized GeoTiffs with internal overviews" << std::endl
+              << "  --help              print this message" << std::endl
+              << "Each step is reported as : file, step, status, duration and info separated by tabs" << std::endl;
+}
+
+//******************************************************************************
+
+int main(int argc, char *argv[])
+{
+
+    QCoreApplication a(argc, argv);
+    QStringList arguments = a.arguments();
+
+    GDALAllRegister();
+
+    Batch::BatchProcessor processor;
+    Core::GeoTiffOptions exportOptions;
+    QStringList files, filterSpecifications;
+    QString pluginsPath;
+    for (int i=1; i<arguments.size(); i++)
+    {
+        const QString & arg = arguments[i];
+        bool hasValue = i + 1 < arguments.size();
+        if (arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--overviews")
+        {
+            processor.setBuildOverviews(true);
+        }
+        else if (arg == "--stats")
+        {
+            processor.setComputeStats(true);
+        }
+        else if (arg == "--cog")
+        {
+            exportOptions.CloudOptimized = true;
+        }
+        else if (arg.startsWith("--") && !hasValue)
+        {
+            std::cerr << "Option " << arg.toStdString() << " needs a value" << std::endl;
+            return 2;
+        }
+        else if (arg == "--list")
+        {
+            QFile list(arguments[++i]);
+            if (!list.open(QIODevice::ReadOnly | QIODevice::Text))
+            {
+                std::cerr << "Failed to read the file list " << list.fileName().toStdString() << std::endl;
+                return 2;
+            }
+            QTextStream stream(&list);
+            while (!stream.atEnd())
+            {
+                QString line = stream.readLine().trimmed();
+                if (!line.isEmpty() && !line.startsWith('#'))
+                    files << line;
+            }
+        }
+        else if (arg == "--jobs")
+        {
+            processor.setNbOfJobs(arguments[++i].toInt());
+        }
+        else if (arg == "--threads")
+        {
+            processor.setNbOfThreadsPerFile(arguments[++i].toInt());
+        }
+        else if (arg == "--plugins")
+        {
+            pluginsPath = arguments[++i];
+        }
+        else if (arg == "--filter")
+        {
+            filterSpecifications << arguments[++i];
+        }
+        else if (arg == "--output")
+        {
+            processor.setOutputPath(arguments[++i]);
+        }
+        else if (arg == "--subset")
+        {
+            processor.setSubsetIndex(arguments[++i].toInt());
+        }
+        else if (arg == "--extent")
+        {
+            QStringList values = arguments[++i].split(',');
+            QRect extent;
+            if (values.size() == 4)
+                extent = QRect(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
+            if (extent.isEmpty())
+            {
+                std::cerr << "Extent should be 'x,y,w,h' with positive sizes" << std::endl;
+                return 2;
+            }
+            processor.setPixelExtent(extent);
+        }
+        else if (arg == "--compress")
+        {
+            exportOptions.Compression = arguments[++i].toUpper();
+            QStringList codecs;
+            codecs << "LZW" << "DEFLATE" << "ZSTD" << "JPEG";
+            if (!codecs.contains(exportOptions.Compression))
+            {
+                std::cerr << "Unknown codec " << exportOptions.Compression.toStdString() << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "--predictor")
+        {
+            exportOptions.Predictor = arguments[++i].toInt();
+        }
+        else if (arg == "--level")
+        {
+            exportOptions.Level = arguments[++i].toInt();
+        }
+        else if (arg.startsWith("--"))
+        {
+            std::cerr << "Unknown option " << arg.toStdString() << std::endl;
+            printUsage();
+            return 2;
+        }
+        else
+        {
+            files << arg;
+        }
+    }
+
+    if (files.isEmpty())
+    {
+        printUsage();
+        return 2;
+    }
+    processor.setExportOptions(exportOptions);
+
+    if (!pluginsPath.isEmpty())
+        Filters::FiltersManager::get()->loadPlugins(pluginsPath);
+
+    foreach (QString specification, filterSpecifications)
+    {
+        QString message;
+        if (!processor.addFilter(specification, &message))
+        {
+            std::cerr << message.toStdString() << std::endl;
+            return 2;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int nbOfFailures = processor.run(files);
+    std::cout << QString("Processed %1 files, %2 failed, in %3 s")
+                 .arg(files.size()).arg(nbOfFailures).arg(timer.elapsed() / 1000.0, 0, 'f', 1).toStdString()
+              << std::endl;
+
+    Filters::FiltersManager::destroy();
+    GDALDestroyDriverManager();
+    return nbOfFailures > 0 ? 1 : 0;
+
+}
@@ -0,0 +1,24 @@
+/*!
+*
+* Geo Image Viewer project
+*
+* Filter worker process : runs filters on image tiles for the application (see Filters::ProcessFilter).
+* A crash of the filter code stops only the worker, the application restarts it.
+*
+*/
+
+
+// Qt
+#include <QCoreApplication>
+#include <QStringList>
+
+// Project
+#include "Filters/ProcessFilter.h"
+
+int main(int argc, char *argv[])
+{
+
+    QCoreApplication a(argc, argv);
+    return Filters::ProcessFilter::runWorker(a.arguments());
+
+}
@@ -56,6 +56,10 @@ MainWindow::MainWindow(QWidget *parent) :
         QAction * a = ui->menuFilters->addAction(f->getName(), &_viewer, SLOT(onFilterTriggered()));
         a->setData( QVariant::fromValue( static_cast<QObject*>(f) ) );
     }
+    ui->menuFilters->addSeparator();
+    QAction * outOfProcess = ui->menuFilters->addAction(tr("Run filters in worker processes"));
+    outOfProcess->setCheckable(true);
+    connect(outOfProcess, SIGNAL(toggled(bool)), this, SLOT(onOutOfProcessActionToggled(bool)));
 
     // connect actions:
     connect(ui->actionExit, SIGNAL(triggered()), this, SLOT(onExitActionTriggered()));
@@ -72,6 +76,7 @@ MainWindow::MainWindow(QWidget *parent) :
     {
         showMaximized();
     }
+    outOfProcess->setChecked(settings.value("Filters/outOfProcess", false).toBool());
 
 }
 
@@ -119,6 +124,15 @@ void MainWindow::onSettingsActionTriggered()
 
 //******************************************************************************
 
+void MainWindow::onOutOfProcessActionToggled(bool checked)
+{
+    Filters::FiltersManager::get()->setOutOfProcess(checked);
+    QSettings settings("GeoImageViewer_dot_com", "GIV");
+    settings.setValue("Filters/outOfProcess", checked);
+}
+
+//******************************************************************************
+
 void MainWindow::closeEvent(QCloseEvent * event)
 {
     QSettings settings("GeoImageViewer_dot_com", "GIV");
@@ -35,6 +35,7 @@ protected slots:
     void onOpenImageActionTriggered();
     void onExitActionTriggered();
     void onSettingsActionTriggered();
+    void onOutOfProcessActionToggled(bool checked);
 
 protected:
     void closeEvent(QCloseEvent * event);
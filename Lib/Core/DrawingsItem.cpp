@@ -1,11 +1,15 @@
 
 // Qt
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 
 // Project
 #include "Global.h"
 #include "DrawingsItem.h"
 
+// STD
+#include <cstring>
+
 
 namespace Core
 {
@@ -14,45 +18,413 @@ namespace Core
 
 /*!
   \class DrawingsItem
-  \brief inherits from QGraphicsItem and serves as a canvas (contains a QImage) for drawing shapes using QPainter.
+  \brief inherits from QGraphicsItem and serves as a canvas for drawing shapes using QPainter.
+  Canvas is sparse : it is divided in tiles of TileSize pixels and only tiles where something is painted
+  are allocated, other tiles are the background. Thus the memory is proportional to the painted area
+  and not to the canvas size.
   For example :
     DrawingsItem d(200, 300, QColor(Qt::white));
-    QPainter p(&d.getImage());
-    p.drawLine(...)
-    etc
+    {
+        DrawingsPainter p(&d, QRect(10, 10, 50, 50));
+        p.drawLine(...)
+        etc
+    }
     d.update()
 
-  DrawingsItem::boundingRect() return a rectangle of the QImage size
+  DrawingsItem::boundingRect() return a rectangle of the canvas size.
+  getImage() returns a composed image of a part of the canvas.
+
+  Tiles are stored in QImage::Format_ARGB32_Premultiplied format that QPainter draws without conversion,
+  and only the tiles in the exposed rect are drawn on repaint.
+
+  Modifications between beginEdit() and endEdit() (e.g. a stroke) can be undone. Tiles are implicitly shared
+  images, thus an edit keeps only the previous versions of the tiles it has modified and the history memory
+  is proportional to the modified area. The oldest edits are forgotten when the history memory is larger
+  than the limit (see setUndoMemoryLimit()).
 
  */
 
 //******************************************************************************
 
+namespace
+{
+
+/*!
+  Method to copy a rectangle of pixels between two images of 32-bit formats
+*/
+void copyPixels(const QImage & src, const QRect & srcRect, QImage & dst, const QPoint & dstPos)
+{
+    int n = srcRect.width() * 4;
+    for (int y=0; y<srcRect.height(); y++)
+    {
+        const uchar * s = src.constScanLine(srcRect.y() + y) + srcRect.x() * 4;
+        uchar * d = dst.scanLine(dstPos.y() + y) + dstPos.x() * 4;
+        std::memcpy(d, s, n);
+    }
+}
+
+//******************************************************************************
+
+bool isUniform(const QImage & src, const QRect & srcRect, quint32 value)
+{
+    for (int y=0; y<srcRect.height(); y++)
+    {
+        const quint32 * s = reinterpret_cast<const quint32*>(src.constScanLine(srcRect.y() + y)) + srcRect.x();
+        for (int x=0; x<srcRect.width(); x++)
+        {
+            if (s[x] != value)
+                return false;
+        }
+    }
+    return true;
+}
+
+}
+
+//******************************************************************************
+
 DrawingsItem::DrawingsItem(int width, int height, QColor bg, QGraphicsItem * parent) :
     QGraphicsItem(parent),
-    _background(bg)
+    _background(bg),
+    _size(width, height),
+    _editing(false),
+    _undoMemoryLimit(64*1024*1024),
+    _undoMemorySize(0)
 {
-//    _image = QImage(width, height, QImage::Format_ARGB32);
-    _image = QImage(width, height, QImage::Format_RGBA8888);
-    _image.fill(_background);
+    _currentEdit.memorySize = 0;
+    // Provide the exposed rect to paint()
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 }
 
 //******************************************************************************
 
 QRectF DrawingsItem::boundingRect() const
 {
-    return QRectF(QPointF(0.0, 0.0), _image.size());
+    return QRectF(QPointF(0.0, 0.0), _size);
+}
+
+//******************************************************************************
+
+QRect DrawingsItem::tileRect(int tx, int ty) const
+{
+    return QRect(tx*TileSize, ty*TileSize, TileSize, TileSize).intersected(QRect(QPoint(0, 0), _size));
 }
 
 //******************************************************************************
 
 void DrawingsItem::paint(QPainter * p, const QStyleOptionGraphicsItem *o, QWidget * w)
 {
-    Q_UNUSED(o);
     Q_UNUSED(w);
     //    SD_TRACE(" > DrawingsItem::paint");
-    QRectF r = boundingRect();
-    p->drawImage(r, _image, r);
+    QRect exposed = o->exposedRect.toAlignedRect().intersected(QRect(QPoint(0, 0), _size));
+    if (exposed.isEmpty())
+        return;
+
+    for (int ty=exposed.top()/TileSize; ty<=exposed.bottom()/TileSize; ty++)
+    {
+        for (int tx=exposed.left()/TileSize; tx<=exposed.right()/TileSize; tx++)
+        {
+            QRect tr = tileRect(tx, ty);
+            QRect r = tr.intersected(exposed);
+            QHash<quint64, QImage>::const_iterator it = _tiles.constFind(tileKey(tx, ty));
+            if (it != _tiles.constEnd())
+                p->drawImage(r, it.value(), r.translated(-tr.topLeft()));
+            else if (_background.alpha() > 0)
+                p->fillRect(r, _background);
+        }
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to get the image of the whole canvas. Image format is QImage::Format_RGBA8888
+*/
+QImage DrawingsItem::getImage() const
+{
+    return getImage(QRect(QPoint(0, 0), _size));
+}
+
+//******************************************************************************
+/*!
+  Method to get the image of the canvas in the rect (in item coordinates).
+  Parts outside of the canvas are filled with the background. Image format is QImage::Format_RGBA8888
+  \return null image if the rect is empty
+*/
+QImage DrawingsItem::getImage(const QRect &rect) const
+{
+    return composeImage(rect).convertToFormat(QImage::Format_RGBA8888);
+}
+
+//******************************************************************************
+/*!
+  Method to compose the image of the canvas in the rect from the tiles, in QImage::Format_ARGB32_Premultiplied format
+*/
+QImage DrawingsItem::composeImage(const QRect &rect) const
+{
+    if (rect.isEmpty())
+        return QImage();
+
+    QRect r = rect;
+    QImage out(r.size(), QImage::Format_ARGB32_Premultiplied);
+    out.fill(_background);
+
+    QRect rr = r.intersected(QRect(QPoint(0, 0), _size));
+    if (rr.isEmpty())
+        return out;
+
+    for (int ty=rr.top()/TileSize; ty<=rr.bottom()/TileSize; ty++)
+    {
+        for (int tx=rr.left()/TileSize; tx<=rr.right()/TileSize; tx++)
+        {
+            QHash<quint64, QImage>::const_iterator it = _tiles.constFind(tileKey(tx, ty));
+            if (it == _tiles.constEnd())
+                continue;
+            QRect tr = tileRect(tx, ty);
+            QRect common = tr.intersected(rr);
+            copyPixels(it.value(), common.translated(-tr.topLeft()), out, common.topLeft() - r.topLeft());
+        }
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to replace the canvas pixels by the image at position pos (in item coordinates).
+  Tiles are allocated only if the image is different from the background on them.
+*/
+void DrawingsItem::setImage(const QImage &image, const QPoint &pos)
+{
+    QImage src = image.format() == QImage::Format_ARGB32_Premultiplied ?
+                image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QRect r = QRect(pos, src.size()).intersected(QRect(QPoint(0, 0), _size));
+    if (r.isEmpty())
+        return;
+
+    QImage bgPixel(1, 1, QImage::Format_ARGB32_Premultiplied);
+    bgPixel.fill(_background);
+    quint32 bgValue = *reinterpret_cast<const quint32*>(bgPixel.constScanLine(0));
+
+    for (int ty=r.top()/TileSize; ty<=r.bottom()/TileSize; ty++)
+    {
+        for (int tx=r.left()/TileSize; tx<=r.right()/TileSize; tx++)
+        {
+            QRect tr = tileRect(tx, ty);
+            QRect common = tr.intersected(r);
+            QRect srcRect = common.translated(-pos);
+            quint64 key = tileKey(tx, ty);
+            QHash<quint64, QImage>::iterator it = _tiles.find(key);
+            if (it == _tiles.end())
+            {
+                if (isUniform(src, srcRect, bgValue))
+                    continue;
+                saveTile(key);
+                QImage tile(tr.size(), QImage::Format_ARGB32_Premultiplied);
+                tile.fill(_background);
+                it = _tiles.insert(key, tile);
+            }
+            else
+            {
+                // tile is detached from the saved copy when pixels are written
+                saveTile(key);
+            }
+            copyPixels(src, srcRect, it.value(), common.topLeft() - tr.topLeft());
+        }
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to start an edit : modified tiles are saved until endEdit()
+*/
+void DrawingsItem::beginEdit()
+{
+    if (_editing)
+        endEdit();
+    _editing = true;
+    _currentEdit.tiles.clear();
+    _currentEdit.memorySize = 0;
+}
+
+//******************************************************************************
+/*!
+  Method to finish the edit and put it into undo history. Redo history is cleared
+*/
+void DrawingsItem::endEdit()
+{
+    if (!_editing)
+        return;
+    _editing = false;
+    if (_currentEdit.tiles.isEmpty())
+        return;
+
+    _undoStack.append(_currentEdit);
+    _undoMemorySize += _currentEdit.memorySize;
+    _currentEdit.tiles.clear();
+    _currentEdit.memorySize = 0;
+
+    foreach (const Edit & e, _redoStack)
+    {
+        _undoMemorySize -= e.memorySize;
+    }
+    _redoStack.clear();
+    limitUndoMemory();
+}
+
+//******************************************************************************
+
+void DrawingsItem::saveTile(quint64 key)
+{
+    if (!_editing || _currentEdit.tiles.contains(key))
+        return;
+    QImage tile = _tiles.value(key);
+    _currentEdit.tiles.insert(key, tile);
+    _currentEdit.memorySize += tile.bytesPerLine() * tile.height();
+}
+
+//******************************************************************************
+/*!
+  Method to put back the tiles of the edit, returns the replaced tiles
+*/
+DrawingsItem::Edit DrawingsItem::restore(const Edit &edit)
+{
+    Edit out;
+    out.memorySize = 0;
+    QHash<quint64, QImage>::const_iterator it = edit.tiles.constBegin();
+    for (; it != edit.tiles.constEnd(); ++it)
+    {
+        QImage current = _tiles.value(it.key());
+        out.tiles.insert(it.key(), current);
+        out.memorySize += current.bytesPerLine() * current.height();
+
+        if (it.value().isNull())
+            _tiles.remove(it.key());
+        else
+            _tiles.insert(it.key(), it.value());
+        update(tileRect((int) (it.key() & 0xFFFFFFFF), (int) (it.key() >> 32)));
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to undo the last edit
+  \return false if there is nothing to undo
+*/
+bool DrawingsItem::undo()
+{
+    endEdit();
+    if (_undoStack.isEmpty())
+        return false;
+
+    Edit e = _undoStack.takeLast();
+    Edit r = restore(e);
+    _redoStack.append(r);
+    _undoMemorySize += r.memorySize - e.memorySize;
+    limitUndoMemory();
+    return true;
+}
+
+//******************************************************************************
+/*!
+  Method to redo the last undone edit
+  \return false if there is nothing to redo
+*/
+bool DrawingsItem::redo()
+{
+    endEdit();
+    if (_redoStack.isEmpty())
+        return false;
+
+    Edit e = _redoStack.takeLast();
+    Edit u = restore(e);
+    _undoStack.append(u);
+    _undoMemorySize += u.memorySize - e.memorySize;
+    limitUndoMemory();
+    return true;
+}
+
+//******************************************************************************
+
+void DrawingsItem::setUndoMemoryLimit(int megaBytes)
+{
+    _undoMemoryLimit = (qint64) qMax(0, megaBytes) * 1024 * 1024;
+    limitUndoMemory();
+}
+
+//******************************************************************************
+/*!
+  Method to forget the oldest edits while the history is larger than the limit
+*/
+void DrawingsItem::limitUndoMemory()
+{
+    while (_undoMemorySize > _undoMemoryLimit && !_undoStack.isEmpty())
+    {
+        _undoMemorySize -= _undoStack.takeFirst().memorySize;
+    }
+    while (_undoMemorySize > _undoMemoryLimit && !_redoStack.isEmpty())
+    {
+        _undoMemorySize -= _redoStack.takeFirst().memorySize;
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to get the rectangle (in item coordinates) of allocated tiles. Outside of this rectangle
+  the canvas is the background
+*/
+QRect DrawingsItem::getPaintedRect() const
+{
+    QRect out;
+    QHash<quint64, QImage>::const_iterator it = _tiles.constBegin();
+    for (; it != _tiles.constEnd(); ++it)
+    {
+        int tx = (int) (it.key() & 0xFFFFFFFF);
+        int ty = (int) (it.key() >> 32);
+        out = out.united(tileRect(tx, ty));
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  \class DrawingsPainter
+  \brief QPainter on a part of DrawingsItem canvas. Coordinates are item coordinates,
+  painting outside of the rect is clipped. Painted pixels are written into the canvas tiles
+  and the rect is updated (unless updateItem is false) when the painter is destroyed. For example :
+    {
+        DrawingsPainter p(item, QRect(10, 10, 50, 50));
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.drawEllipse(QRectF(10.0, 10.0, 50.0, 50.0));
+    }
+ */
+
+//******************************************************************************
+
+DrawingsPainter::DrawingsPainter(DrawingsItem *item, const QRect &rect, bool updateItem) :
+    QPainter(),
+    _item(item),
+    _updateItem(updateItem)
+{
+    _rect = rect.intersected(QRect(QPoint(0, 0), _item->getSize()));
+    if (_rect.isEmpty())
+        return;
+
+    _buffer = _item->composeImage(_rect);
+    begin(&_buffer);
+    translate(-_rect.x(), -_rect.y());
+}
+
+//******************************************************************************
+
+DrawingsPainter::~DrawingsPainter()
+{
+    if (!isActive())
+        return;
+    end();
+    _item->setImage(_buffer, _rect.topLeft());
+    // Only the painted rect is repainted
+    if (_updateItem)
+        _item->update(_rect);
 }
 
 //******************************************************************************
@@ -4,8 +4,12 @@
 // Qt
 #include <QGraphicsItem>
 #include <QImage>
+#include <QPainter>
+#include <QHash>
+#include <QList>
 
 // Project
+#include "LibExport.h"
 #include "Global.h"
 
 
@@ -14,10 +18,12 @@ namespace Core
 
 //******************************************************************************
 
-class DrawingsItem : public QGraphicsItem
+class GIV_DLL_EXPORT DrawingsItem : public QGraphicsItem
 {
+    friend class DrawingsPainter;
 
     PROPERTY_GETACCESSOR(QColor, background, getBackground)
+    PROPERTY_GETACCESSOR(QSize, size, getSize)
 
 public:
     DrawingsItem(int width, int height, QColor bg = QColor(127,127,127,50), QGraphicsItem * parent = 0);
@@ -25,18 +31,74 @@ public:
     enum { Type = UserType + 3 };
     int type() const { return Type; }
 
+    enum { TileSize = 256 };
+
     virtual QRectF boundingRect() const;
     virtual void paint(QPainter * p, const QStyleOptionGraphicsItem *o, QWidget * w);
 
-    QImage & getImage()
-    { return _image; }
+    QImage getImage() const;
+    QImage getImage(const QRect & rect) const;
+    void setImage(const QImage & image, const QPoint & pos = QPoint());
+
+    QRect getPaintedRect() const;
+    int getNbTiles() const
+    { return _tiles.size(); }
+
+    void beginEdit();
+    void endEdit();
+    bool undo();
+    bool redo();
+    bool canUndo() const
+    { return !_undoStack.isEmpty(); }
+    bool canRedo() const
+    { return !_redoStack.isEmpty(); }
 
-    const QImage & getImage() const
-    { return _image; }
+    void setUndoMemoryLimit(int megaBytes);
+    //! Memory size in bytes of the undo/redo history
+    qint64 getUndoMemorySize() const
+    { return _undoMemorySize; }
 
+protected:
+
+    //! Tiles of the canvas before an edit (or after the edit for redo), null image for a not allocated tile
+    struct Edit
+    {
+        QHash<quint64, QImage> tiles;
+        qint64 memorySize;
+    };
+
+    static quint64 tileKey(int tx, int ty)
+    { return ((quint64) ty << 32) | (quint64) tx; }
+    QRect tileRect(int tx, int ty) const;
+    QImage composeImage(const QRect & rect) const;
+    void saveTile(quint64 key);
+    Edit restore(const Edit & edit);
+    void limitUndoMemory();
+
+    //! Allocated tiles of the canvas, other tiles are filled with the background
+    QHash<quint64, QImage> _tiles;
+
+    bool _editing;
+    Edit _currentEdit;
+    QList<Edit> _undoStack;
+    QList<Edit> _redoStack;
+    qint64 _undoMemoryLimit;
+    qint64 _undoMemorySize;
+};
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT DrawingsPainter : public QPainter
+{
+public:
+    DrawingsPainter(DrawingsItem * item, const QRect & rect, bool updateItem = true);
+    ~DrawingsPainter();
 
 protected:
-    QImage _image;
+    DrawingsItem * _item;
+    QRect _rect;
+    QImage _buffer;
+    bool _updateItem;
 };
 
 //******************************************************************************
@@ -106,6 +106,22 @@ cv::Mat FloatingDataProvider::getImageData(const QRect & srcPixelExtent, int dst
 
 }
 
+//******************************************************************************
+/*!
+  Method to create a provider that shares the data matrix : data is not copied and it is
+  released with the last provider
+*/
+ImageDataProvider * FloatingDataProvider::clone() const
+{
+    FloatingDataProvider * out = new FloatingDataProvider();
+    copyDataInfo(this, out);
+    out->_data = _data;
+    out->_projectionRef = _projectionRef;
+    out->_geoTransform = _geoTransform;
+    out->_geoExtent = _geoExtent;
+    return out;
+}
+
 //******************************************************************************
 
 void FloatingDataProvider::setImageData(const QPoint &offset, const cv::Mat &data)
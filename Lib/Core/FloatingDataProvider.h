@@ -48,6 +48,8 @@ public:
     virtual bool isValid() const
     { return !_data.empty(); }
 
+    virtual ImageDataProvider * clone() const;
+
 signals:
     void dataChanged(const QRect & pixelExtent);
 
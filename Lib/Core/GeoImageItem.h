@@ -57,6 +57,8 @@ public:
     const ImageDataProvider * getConstDataProvider() const
     { return _dataProvider; }
     const ImageRendererConfiguration * getRendererConfiguration() const;
+    ImageRenderer * getRenderer() const
+    { return _renderer; }
 
 public slots:
     void updateItem(int zoomLevel, const QRectF & visiblePixelExtent);
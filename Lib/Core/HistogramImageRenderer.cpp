@@ -49,6 +49,14 @@ void HistogramRendererConfiguration::copy(ImageRendererConfiguration *output)
 
 //******************************************************************************
 
+ImageRendererConfiguration * HistogramRendererConfiguration::clone() const
+{
+    // transfer functions are shared static instances
+    return new HistogramRendererConfiguration(*this);
+}
+
+//******************************************************************************
+
 inline double clamp(double value, double vmin=0.0, double vmax=1.0)
 {
     return (value >= vmax) ? vmax : (value < vmin) ? vmin : value;
@@ -35,6 +35,7 @@ struct GIV_DLL_EXPORT HistogramRendererConfiguration : public ImageRendererConfi
     {}
 
     virtual void copy(ImageRendererConfiguration * output);
+    virtual ImageRendererConfiguration * clone() const;
 
     static QStringList getAvailableTransferFunctionNames();
     static TransferFunction* getTransferFunctionByName(const QString & name);
@@ -52,6 +53,9 @@ public:
     HistogramImageRenderer(QObject * parent = 0);
     virtual cv::Mat render(const cv::Mat & rawData, const ImageRendererConfiguration * conf, bool isBGRA=false);
 
+    virtual ImageRenderer * clone() const
+    { return new HistogramImageRenderer(); }
+
     static bool setupConfiguration(const ImageDataProvider *dataProvider, HistogramRendererConfiguration * conf, HistogramRendererConfiguration::Mode mode);
 
     static HistogramRendererConfiguration::Mode getDefaultMode(const ImageDataProvider *dataProvider);
@@ -83,6 +83,31 @@ void ImageDataProvider::setupDataInfo(const cv::Mat & src, ImageDataProvider * d
 
 //******************************************************************************
 
+void ImageDataProvider::copyDataInfo(const ImageDataProvider * src, ImageDataProvider * dst)
+{
+    dst->_imageName = src->_imageName;
+    dst->_location = src->_location;
+    dst->_inputNbBands = src->_inputNbBands;
+    dst->_inputIsComplex = src->_inputIsComplex;
+    dst->_inputWidth = src->_inputWidth;
+    dst->_inputHeight = src->_inputHeight;
+    dst->_inputDepth = src->_inputDepth;
+    dst->_nbBands = src->_nbBands;
+    dst->_isComplex = src->_isComplex;
+    dst->_width = src->_width;
+    dst->_height = src->_height;
+    dst->_depth = src->_depth;
+    dst->_pixelExtent = src->_pixelExtent;
+    dst->_minValues = src->_minValues;
+    dst->_maxValues = src->_maxValues;
+    dst->_bandHistograms = src->_bandHistograms;
+    dst->_bandNames = src->_bandNames;
+    dst->_cutNoDataBRBoundary = src->_cutNoDataBRBoundary;
+    dst->_editable = src->_editable;
+}
+
+//******************************************************************************
+
 cv::Mat ImageDataProvider::computeMask(const cv::Mat &data, float noDataValue)
 {
     cv::Mat out;
@@ -135,6 +160,7 @@ QVector<double> ImageDataProvider::getPixelValue(const QPoint &pixelCoords, bool
 GDALDataProvider::GDALDataProvider(QObject *parent) :
     ImageDataProvider(parent),
     _dataset(0),
+    _temporary(false),
     _mutex(new QMutex())
 {
 }
@@ -144,11 +170,36 @@ GDALDataProvider::GDALDataProvider(QObject *parent) :
 GDALDataProvider::~GDALDataProvider()
 {
     if (_dataset)
+    {
+        GDALDriver * driver = _dataset->GetDriver();
         GDALClose(_dataset);
+        if (_temporary && driver)
+        {
+            // remove dataset file and associated files (e.g. overviews)
+            driver->Delete(_filePath.toStdString().c_str());
+        }
+    }
 
     delete _mutex;
 }
 
+//******************************************************************************
+/*!
+  Method to create a provider that opens the file of this one with its own dataset.
+  Copy is not temporary : the file is removed by this provider
+*/
+ImageDataProvider * GDALDataProvider::clone() const
+{
+    GDALDataProvider * out = new GDALDataProvider();
+    if (!out->setup(_filePath))
+    {
+        delete out;
+        return 0;
+    }
+    copyDataInfo(this, out);
+    return out;
+}
+
 //******************************************************************************
 
 bool GDALDataProvider::setup(const QString &filepath)
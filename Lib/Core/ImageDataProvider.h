@@ -87,8 +87,14 @@ public:
     virtual bool isValid() const
     { return false; }
 
+    //! Method to create a provider of the same data that does not depend on this one (e.g. to read the data in background).
+    //! Returns null if the provider can not be copied
+    virtual ImageDataProvider * clone() const
+    { return 0; }
+
 protected:
     static void setupDataInfo(const cv::Mat & src, ImageDataProvider * dst);
+    static void copyDataInfo(const ImageDataProvider * src, ImageDataProvider * dst);
 
 
 };
@@ -100,6 +106,8 @@ class GIV_DLL_EXPORT GDALDataProvider : public ImageDataProvider
     Q_OBJECT
     PROPERTY_GETACCESSOR(QString, filePath, getFilePath)
     PTR_PROPERTY_GETACCESSOR(GDALDataset, dataset, getDataset)
+    //! Option to remove dataset files when provider is destroyed (e.g. temporary filtering results)
+    PROPERTY_ACCESSORS(bool, temporary, isTemporary, setTemporary)
 
 public:
     explicit GDALDataProvider(QObject *parent = 0);
@@ -116,6 +124,8 @@ public:
     virtual bool isValid() const
     { return _dataset != 0; }
 
+    virtual ImageDataProvider * clone() const;
+
 
 protected:
     QMutex * _mutex;
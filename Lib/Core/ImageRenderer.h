@@ -31,6 +31,10 @@ struct GIV_DLL_EXPORT ImageRendererConfiguration {
         *output = *this;
     }
 
+    //! Method to create a copy of the same type, e.g. for a rendering in background
+    virtual ImageRendererConfiguration * clone() const
+    { return new ImageRendererConfiguration(*this); }
+
 };
 
 class GIV_DLL_EXPORT ImageRenderer : public QObject
@@ -42,6 +46,10 @@ public:
     ImageRenderer(QObject * parent = 0);
     virtual cv::Mat render(const cv::Mat & rawData, const ImageRendererConfiguration * conf, bool isBGRA=false);
 
+    //! Method to create a renderer of the same type, e.g. for a rendering in background
+    virtual ImageRenderer * clone() const
+    { return new ImageRenderer(); }
+
     static bool setupConfiguration(const ImageDataProvider *dataProvider, ImageRendererConfiguration * conf);
 
 protected:
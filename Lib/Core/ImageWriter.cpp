@@ -8,6 +8,8 @@
 #include "ImageWriter.h"
 #include "ImageDataProvider.h"
 #include "GeoImageLayer.h"
+#include "TilePyramidWriter.h"
+#include "ImageRenderer.h"
 
 namespace Core
 {
@@ -22,9 +24,12 @@ namespace Core
 ImageWriter::ImageWriter(QObject *parent) :
     QObject(parent),
     _isWorking(false),
-    _isAsyncTask(true),
+    _pool(new QThreadPool(this)),
     _task(0)
 {
+    // Only one thread is possible due to GDAL reader (e.g. TIFF)
+    _pool->setMaxThreadCount(1);
+
     int count = GetGDALDriverManager()->GetDriverCount();
     if (count == 0)
         GDALAllRegister();
@@ -34,6 +39,10 @@ ImageWriter::ImageWriter(QObject *parent) :
 
 ImageWriter::~ImageWriter()
 {
+    // tasks use the writer until their end
+    cancel();
+    _pool->waitForDone();
+
     int count = GetGDALDriverManager()->GetDriverCount();
     if (count > 0)
         GDALDestroyDriverManager();
@@ -41,7 +50,8 @@ ImageWriter::~ImageWriter()
 
 //******************************************************************************
 
-bool ImageWriter::write(const QString &outputfilename, const ImageDataProvider *data, const GeoImageLayer * dataInfo)
+bool ImageWriter::write(const QString &outputfilename, const ImageDataProvider *data, const GeoImageLayer * dataInfo,
+                        const QRect &pixelExtent)
 {
     if (QFileInfo(outputfilename).exists())
     {
@@ -52,21 +62,19 @@ bool ImageWriter::write(const QString &outputfilename, const ImageDataProvider *
         }
     }
 
-    if (!_task)
-        _task = new WriteImageTask(this);
-
-
-    _task->setOutputFile(outputfilename);
-    _task->setDataProvider(data);
-    _task->setDataInfo(dataInfo);
-    _isAsyncTask = false;
-    _task->run();
+    // task is not the current task of the writer : imageWriteFinished() is not sent
+    WriteImageTask task(this);
+    task.setOutputFile(outputfilename);
+    task.setDataProvider(data, pixelExtent);
+    task.setDataInfo(dataInfo);
+    task.run();
     return QFileInfo(outputfilename).exists();
 }
 
 //******************************************************************************
 
-bool ImageWriter::writeInBackground(const QString &outputfilename, const ImageDataProvider *data, const GeoImageLayer *dataInfo)
+bool ImageWriter::writeInBackground(const QString &outputfilename, const ImageDataProvider *data, const GeoImageLayer *dataInfo,
+                                    const QRect &pixelExtent)
 {
     if (!removeFile(outputfilename))
     {
@@ -74,28 +82,22 @@ bool ImageWriter::writeInBackground(const QString &outputfilename, const ImageDa
         return false;
     }
 
-    if (!_task)
-        _task = new WriteImageTask(this);
-
-    _task->setOutputFile(outputfilename);
-    _task->setDataProvider(data);
-    _task->setDataInfo(dataInfo);
-    _isAsyncTask = true;
-
-    QThreadPool * pool = QThreadPool::globalInstance();
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-    pool->clear();
-#endif
-    pool->waitForDone();
-    // Only one thread is possible due to GDAL reader (e.g. TIFF)
-    _isWorking=true;
-    pool->start(_task);
+    WriteImageTask * task = new WriteImageTask(this);
+    task->setOutputFile(outputfilename);
+    task->setDataProvider(data, pixelExtent);
+    task->setDataInfo(dataInfo);
+    startTask(task);
     return true;
 }
 
 //******************************************************************************
 
-bool ImageWriter::writeInBackground(const QString &outputfilename, const QImage * data, const GeoImageLayer *dataInfo)
+/*!
+  Method to write the image in background. Image is a part of the layer placed at pixelPos in the layer pixels,
+  output geo transform is shifted accordingly
+*/
+bool ImageWriter::writeInBackground(const QString &outputfilename, const QImage * data, const GeoImageLayer *dataInfo,
+                                    const QPoint &pixelPos)
 {
     if (!removeFile(outputfilename))
     {
@@ -103,36 +105,66 @@ bool ImageWriter::writeInBackground(const QString &outputfilename, const QImage
         return false;
     }
 
-    if (!_task)
-        _task = new WriteImageTask(this);
+    WriteImageTask * task = new WriteImageTask(this);
+    task->setOutputFile(outputfilename);
+    task->setDataProvider(data, pixelPos);
+    task->setDataInfo(dataInfo);
+    startTask(task);
+    return true;
+}
 
-    _task->setOutputFile(outputfilename);
-    _task->setDataProvider(data);
-    _task->setDataInfo(dataInfo);
-    _isAsyncTask = true;
+//******************************************************************************
+/*!
+  Method to render the data provider into map tiles 'outputPath/z/x/y.<tileFormat>', rows are numbered
+  from the bottom if tms is true. Data provider, renderer and configuration are copied and the copies
+  are owned by the task : the layer can be changed or removed while tiles are written
+*/
+bool ImageWriter::writeTilesInBackground(const QString &outputPath, const ImageDataProvider *data,
+                                         const ImageRenderer *renderer, const ImageRendererConfiguration *conf,
+                                         const QString &tileFormat, bool tms)
+{
+    ImageDataProvider * provider = data ? data->clone() : 0;
+    if (!provider || !renderer)
+    {
+        SD_ERR(tr("Layer data can not be written as map tiles"));
+        delete provider;
+        return false;
+    }
 
-    QThreadPool * pool = QThreadPool::globalInstance();
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-    pool->clear();
-#endif
-    pool->waitForDone();
-    // Only one thread is possible due to GDAL reader (e.g. TIFF)
-    _isWorking=true;
-    pool->start(_task);
+    // Tiles are written by the thread pool of TilePyramidWriter
+    WriteImageTask * task = new WriteImageTask(this);
+    task->setOutputFile(outputPath);
+    task->setTileSources(provider, renderer->clone(), conf, tileFormat, tms);
+    startTask(task);
     return true;
 }
 
 //******************************************************************************
+/*!
+  Method to start a task in background. Task is deleted by the pool at the end of the run.
+  Previous task is canceled, it finishes before the new one starts and its result is not sent
+*/
+void ImageWriter::startTask(WriteImageTask *task)
+{
+    cancel();
+    {
+        QMutexLocker locker(&_taskMutex);
+        _task = task;
+        _isWorking = true;
+    }
+    _pool->start(task);
+}
 
+//******************************************************************************
+/*!
+  Method to cancel the current task. Method does not wait for the end of the task :
+  imageWriteFinished() is sent with false when the task stops
+*/
 void ImageWriter::cancel()
 {
-    _task->setOutputFile(QString());
-    QThreadPool * pool = QThreadPool::globalInstance();
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-    pool->clear();
-#endif
-    pool->waitForDone();
-    _isWorking=false;
+    QMutexLocker locker(&_taskMutex);
+    if (_task)
+        _task->cancel();
 }
 
 //******************************************************************************
@@ -151,33 +183,88 @@ bool ImageWriter::removeFile(const QString &filename)
 
 //******************************************************************************
 
-void ImageWriter::taskFinished(bool ok)
+void ImageWriter::taskFinished(WriteImageTask * task, bool ok)
 {
+    // method is called from the task thread at the end of the run
+    QMutexLocker locker(&_taskMutex);
+    if (task != _task)
+        return;
+    _task = 0;
     _isWorking=false;
-    if (_isAsyncTask)
-        emit imageWriteFinished(ok);
+    emit imageWriteFinished(ok);
+}
+
+//******************************************************************************
+
+WriteImageTask::~WriteImageTask()
+{
+    clearTileSources();
+}
+
+//******************************************************************************
+
+void WriteImageTask::setTileSources(ImageDataProvider *provider, ImageRenderer *renderer, const ImageRendererConfiguration *conf,
+                                    const QString &tileFormat, bool tms)
+{
+    clearTileSources();
+    _tileProvider = provider;
+    _renderer = renderer;
+    // configuration is copied : it can be changed in the GUI thread while tiles are rendered
+    _rendererConf = conf ? conf->clone() : 0;
+    _tileFormat = tileFormat;
+    _tms = tms;
+}
+
+//******************************************************************************
+
+void WriteImageTask::clearTileSources()
+{
+    delete _tileProvider;
+    _tileProvider = 0;
+    delete _renderer;
+    _renderer = 0;
+    delete _rendererConf;
+    _rendererConf = 0;
 }
 
 //******************************************************************************
 //******************************************************************************
 
 #define Cancel() \
-    if (_canceled) { \
-        _imageWriter->taskFinished(false); \
+    if (isCanceled()) { \
+        _imageWriter->taskFinished(this, false); \
         return; \
     }
 
 void WriteImageTask::run()
 {
-
-    _canceled=false;
+    if (_renderer)
+    {
+        bool res = false;
+        if (!_filename.isEmpty() && _tileProvider && _rendererConf)
+        {
+            _tileWriter.setFormat(_tileFormat);
+            _tileWriter.setTms(_tms);
+            _reporter->startValue = 0;
+            _reporter->endValue = 99;
+            res = _tileWriter.write(_filename, _tileProvider, _renderer, _rendererConf, _reporter);
+        }
+        else
+        {
+            SD_TRACE("WriteImageTask::run : output path is empty or no data provider or no renderer configuration");
+        }
+        clearTileSources();
+        _imageWriter->writeProgressValueChanged(100);
+        _imageWriter->taskFinished(this, res);
+        return;
+    }
 
     if (_filename.isEmpty() ||
-            (_dataProvider == 0 && _sourceImage == 0) ||
+            (_dataProvider == 0 && _sourceImage.isNull()) ||
             _dataInfo == 0)
     {
         SD_TRACE("WriteImageTask::run : filename is empty or no data providers or no data info");
-        _imageWriter->taskFinished(false);
+        _imageWriter->taskFinished(this, false);
         return;
     }
 
@@ -195,34 +282,40 @@ void WriteImageTask::run()
     _imageWriter->writeProgressValueChanged(10);
 
 
-    cv::Mat data;
-    QImage im;
     if (_dataProvider)
     {
-        // get data to write :
-        data = _dataProvider->getImageData();
+        // data is read and written by windows, progress is reported for each window
+        _reporter->startValue = 10;
+        _reporter->endValue = 99;
+        res = Core::writeToFile(_filename, _dataProvider, _pixelExtent,
+                                projStr, geoTransform,
+                                nodatavalue, metadata,
+                                _imageWriter->getGeoTiffOptions(), _reporter);
     }
-    else if (_sourceImage)
+    else if (!_sourceImage.isNull())
     {
-        im = _sourceImage->copy();
-        data = Core::fromQImage(im);
+        QImage im = _sourceImage.copy();
+        cv::Mat data = Core::fromQImage(im);
 //        Core::printMat(data, "data");
-    }
 
-    Cancel();
-    _imageWriter->writeProgressValueChanged(50);
-    res = Core::writeToFile(_filename, data,
-                                 projStr, geoTransform,
-                                 nodatavalue, metadata);
-
-    _imageWriter->writeProgressValueChanged(100);
-    _imageWriter->taskFinished(res);
+        // geo transform of the image : geoTransform is relative to the layer pixels origin
+        if (geoTransform.size() == 6)
+        {
+            double dx = _pixelExtent.x();
+            double dy = _pixelExtent.y();
+            geoTransform[0] += dx * geoTransform[1] + dy * geoTransform[2];
+            geoTransform[3] += dx * geoTransform[4] + dy * geoTransform[5];
+        }
 
-    // reset conf:
-    _dataProvider = 0;
-    _sourceImage = 0;
-    _dataInfo = 0;
+        Cancel();
+        _imageWriter->writeProgressValueChanged(50);
+        res = Core::writeToFile(_filename, data,
+                                projStr, geoTransform,
+                                nodatavalue, metadata);
+    }
 
+    _imageWriter->writeProgressValueChanged(100);
+    _imageWriter->taskFinished(this, res);
 }
 
 //******************************************************************************
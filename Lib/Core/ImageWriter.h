@@ -3,6 +3,7 @@
 
 
 // Qt
+#include <QMutex>
 #include <QObject>
 #include <QRunnable>
 #include <QImage>
@@ -10,12 +11,17 @@
 // Project
 #include "LibExport.h"
 #include "LayerUtils.h"
+#include "TilePyramidWriter.h"
+
+class QThreadPool;
 
 namespace Core
 {
 
 class GeoImageLayer;
 class ImageDataProvider;
+class ImageRenderer;
+struct ImageRendererConfiguration;
 class WriteImageTask;
 
 //******************************************************************************
@@ -24,13 +30,23 @@ class GIV_DLL_EXPORT ImageWriter : public QObject
 {
     Q_OBJECT
     friend class WriteImageTask;
+
+    //! Options of GeoTiff files written from data providers
+    PROPERTY_ACCESSORS(GeoTiffOptions, geoTiffOptions, getGeoTiffOptions, setGeoTiffOptions)
+
 public:
     explicit ImageWriter(QObject *parent = 0);
     virtual ~ImageWriter();
 
-    bool write(const QString & outputfilename, const Core::ImageDataProvider * data, const GeoImageLayer * dataInfo);
-    bool writeInBackground(const QString & outputfilename, const Core::ImageDataProvider * data, const GeoImageLayer * dataInfo);
-    bool writeInBackground(const QString & outputfilename, const QImage *data, const GeoImageLayer * dataInfo);
+    bool write(const QString & outputfilename, const Core::ImageDataProvider * data, const GeoImageLayer * dataInfo,
+               const QRect & pixelExtent = QRect());
+    bool writeInBackground(const QString & outputfilename, const Core::ImageDataProvider * data, const GeoImageLayer * dataInfo,
+                           const QRect & pixelExtent = QRect());
+    bool writeInBackground(const QString & outputfilename, const QImage *data, const GeoImageLayer * dataInfo,
+                           const QPoint & pixelPos = QPoint());
+    bool writeTilesInBackground(const QString & outputPath, const Core::ImageDataProvider * data,
+                                const ImageRenderer * renderer, const ImageRendererConfiguration * conf,
+                                const QString & tileFormat = "png", bool tms = false);
     void cancel();
     bool isWorking()
     { return _isWorking; }
@@ -42,9 +58,14 @@ signals:
 private:
 
     bool removeFile(const QString & filename);
-    void taskFinished(bool);
+    void startTask(WriteImageTask * task);
+    void taskFinished(WriteImageTask * task, bool ok);
+
+    //! Pool of the background tasks : one thread due to GDAL reader (e.g. TIFF)
+    QThreadPool * _pool;
+    //! Current task, previous canceled tasks finish in the pool without sending their results
     WriteImageTask * _task;
-    bool _isAsyncTask;
+    QMutex _taskMutex;
     bool _isWorking;
 };
 
@@ -55,44 +76,80 @@ class WriteImageTask : public QObject, public QRunnable
     Q_OBJECT
 public:
 
-    WriteImageTask(ImageWriter * parent) :
-        QObject(parent),
-        _imageWriter(parent),
-        _canceled(false),
+    //! Task is deleted by the pool at the end of the run in background, thus it has no parent
+    WriteImageTask(ImageWriter * writer) :
+        QObject(),
+        _imageWriter(writer),
+        _canceled(0),
         _dataProvider(0),
-        _sourceImage(0),
-        _dataInfo(0)
+        _dataInfo(0),
+        _tileProvider(0),
+        _renderer(0),
+        _rendererConf(0),
+        _tms(false),
+        _reporter(new ProgressReporter(this))
     {
-        setAutoDelete(false);
+        connect(_reporter, SIGNAL(progressValueChanged(int)),
+                _imageWriter, SIGNAL(writeProgressValueChanged(int)));
     }
+    virtual ~WriteImageTask();
 
     void setOutputFile(const QString & filename)
+    { _filename = filename; }
+    virtual void run();
+
+    //! Method to cancel the run from another thread : provider data stops to be written at the next window
+    //! and tiles at the next tile
+    void cancel()
     {
-        _canceled = true;
-        _filename = filename;
+        _canceled.store(1);
+        _reporter->cancel();
+        _tileWriter.cancel();
     }
-    virtual void run();
+    bool isCanceled() const
+    { return _canceled.load() != 0; }
 
-    void setDataProvider(const ImageDataProvider * p)
-    { _dataProvider = p; _sourceImage = 0; }
+    void setDataProvider(const ImageDataProvider * p, const QRect & pixelExtent = QRect())
+    { clearTileSources(); _dataProvider = p; _pixelExtent = pixelExtent; _sourceImage = QImage(); }
 
-    void setDataProvider(const QImage * image)
-    { _dataProvider = 0; _sourceImage = image; }
+    //! Image is implicitly shared, thus the source can be a temporary image. Image is placed at pixelPos in the data info pixels
+    void setDataProvider(const QImage * image, const QPoint & pixelPos = QPoint())
+    {
+        clearTileSources(); _dataProvider = 0; _sourceImage = image ? *image : QImage();
+        _pixelExtent = QRect(pixelPos, _sourceImage.size());
+    }
 
     void setDataInfo(const GeoImageLayer * info)
     { _dataInfo = info; }
 
+    //! Data provider is rendered into a directory of map tiles. Task takes the ownership of the provider and the renderer
+    void setTileSources(ImageDataProvider * provider, ImageRenderer * renderer, const ImageRendererConfiguration * conf,
+                        const QString & tileFormat, bool tms);
+
 protected:
 
-    bool _canceled;
+    QAtomicInt _canceled;
     QString _filename;
     ImageWriter * _imageWriter;
 
     // two possible data providers :
     const ImageDataProvider * _dataProvider;
-    const QImage * _sourceImage;
+    //! Subset of the data provider to write or position of the source image
+    QRect _pixelExtent;
+    QImage _sourceImage;
 
     const GeoImageLayer * _dataInfo;
+
+    // tile pyramid export : provider, renderer and configuration are copies owned by the task
+    void clearTileSources();
+    ImageDataProvider * _tileProvider;
+    ImageRenderer * _renderer;
+    ImageRendererConfiguration * _rendererConf;
+    QString _tileFormat;
+    bool _tms;
+    TilePyramidWriter _tileWriter;
+
+    ProgressReporter * _reporter;
 };
 
 //******************************************************************************
@@ -0,0 +1,352 @@
+
+// Qt
+#include <qmath.h>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "IntegralImage.h"
+#include "ImageDataProvider.h"
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class IntegralImage
+  \brief Summed-area tables of values, squared values and valid pixels of an image.
+
+  Sum, mean and standard deviation of valid pixels over any rectangle are computed in constant time,
+  e.g. a local mean map for an adaptive threshold costs the same for any window size.
+  Rectangles are clipped to the image : unlike cv::adaptiveThreshold (replicated border), local means near
+  the border are computed from the pixels inside the image only, and no-data pixels are not counted.
+*/
+
+//******************************************************************************
+
+namespace
+{
+
+template<typename T>
+double boxSum(const cv::Mat & table, const cv::Rect & r, int band)
+{
+    int cn = table.channels();
+    const T * p0 = table.ptr<T>(r.y);
+    const T * p1 = table.ptr<T>(r.y + r.height);
+    int x0 = r.x*cn + band;
+    int x1 = (r.x + r.width)*cn + band;
+    return (double) p1[x1] - (double) p1[x0] - (double) p0[x1] + (double) p0[x0];
+}
+
+//******************************************************************************
+/*!
+  Box sums of the table band over the windows centered on each pixel and clipped to the image :
+  the table is padded with replicated values, i.e. window corners are clamped to the image
+*/
+cv::Mat windowSums(const cv::Mat & table, cv::Size window, int band)
+{
+    cv::Mat t, padded;
+    cv::extractChannel(table, t, band);
+    t.convertTo(t, CV_64F);
+    int w = table.cols - 1, h = table.rows - 1;
+    int rx = window.width/2, ry = window.height/2;
+    cv::copyMakeBorder(t, padded, ry, window.height, rx, window.width, cv::BORDER_REPLICATE);
+    return padded(cv::Rect(window.width, window.height, w, h))
+            - padded(cv::Rect(window.width, 0, w, h))
+            - padded(cv::Rect(0, window.height, w, h))
+            + padded(cv::Rect(0, 0, w, h));
+}
+
+//******************************************************************************
+/*!
+  Number of pixels in the window clipped to the image along one axis
+*/
+cv::Mat clippedLengths(int size, int window, bool column)
+{
+    cv::Mat out(column ? size : 1, column ? 1 : size, CV_64F);
+    double * o = out.ptr<double>(0);
+    int r = window/2;
+    for (int i=0; i<size; i++)
+    {
+        o[i] = qMin(size, i - r + window) - qMax(0, i - r);
+    }
+    return out;
+}
+
+}
+
+//******************************************************************************
+
+IntegralImage::IntegralImage()
+{
+}
+
+//******************************************************************************
+
+IntegralImage::IntegralImage(const cv::Mat &data, const cv::Mat &noDataMask)
+{
+    compute(data, noDataMask);
+}
+
+//******************************************************************************
+/*!
+  Method to compute the tables
+  \param noDataMask is an optional 8-bit matrix with channels of data, non-zero where data is not valid
+*/
+void IntegralImage::compute(const cv::Mat &data, const cv::Mat &noDataMask)
+{
+    cv::Mat values;
+    if (data.depth() == CV_8U || data.depth() == CV_32F || data.depth() == CV_64F)
+        values = data;
+    else
+        data.convertTo(values, CV_32F);
+
+    _count.release();
+    if (!noDataMask.empty())
+    {
+        values = values.clone();
+        values.reshape(1).setTo(0, noDataMask.reshape(1));
+        cv::Mat valid;
+        cv::compare(noDataMask, 0, valid, cv::CMP_EQ);
+        valid.convertTo(valid, CV_8U, 1.0/255.0);
+        cv::integral(valid, _count, CV_32S);
+    }
+    cv::integral(values, _sum, _sqSum, CV_64F);
+}
+
+//******************************************************************************
+
+qint64 IntegralImage::getMemorySize() const
+{
+    return (qint64) _sum.total()*_sum.elemSize() +
+            _sqSum.total()*_sqSum.elemSize() +
+            _count.total()*_count.elemSize();
+}
+
+//******************************************************************************
+
+double IntegralImage::sum(const cv::Rect &r, int band) const
+{
+    cv::Rect rr = r & cv::Rect(0, 0, getWidth(), getHeight());
+    if (rr.area() == 0)
+        return 0.0;
+    return boxSum<double>(_sum, rr, band);
+}
+
+//******************************************************************************
+
+double IntegralImage::squareSum(const cv::Rect &r, int band) const
+{
+    cv::Rect rr = r & cv::Rect(0, 0, getWidth(), getHeight());
+    if (rr.area() == 0)
+        return 0.0;
+    return boxSum<double>(_sqSum, rr, band);
+}
+
+//******************************************************************************
+/*!
+  Method to get the number of valid pixels in the rectangle
+*/
+double IntegralImage::count(const cv::Rect &r, int band) const
+{
+    cv::Rect rr = r & cv::Rect(0, 0, getWidth(), getHeight());
+    if (rr.area() == 0)
+        return 0.0;
+    return _count.empty() ? rr.area() : boxSum<int>(_count, rr, band);
+}
+
+//******************************************************************************
+/*!
+  Method to compute mean and standard deviation of valid pixels in the rectangle
+  \return false if there are no valid pixels
+*/
+bool IntegralImage::meanStdDev(const cv::Rect &r, double &mean, double &std, int band) const
+{
+    double n = count(r, band);
+    if (n <= 0.0)
+        return false;
+    mean = sum(r, band)/n;
+    std = qSqrt(qMax(0.0, squareSum(r, band)/n - mean*mean));
+    return true;
+}
+
+//******************************************************************************
+/*!
+  Method to compute the mean of valid pixels in the window centered on each pixel.
+  The window is clipped to the image. Sums are computed with matrix operations on the tables.
+  \return CV_32F matrix, zero where window has no valid pixels
+*/
+cv::Mat IntegralImage::localMean(cv::Size window, int band) const
+{
+    cv::Mat out;
+    if (isEmpty())
+        return out;
+    cv::Mat sums = windowSums(_sum, window, band);
+    cv::Mat counts;
+    if (_count.empty())
+        counts = clippedLengths(getHeight(), window.height, true) * clippedLengths(getWidth(), window.width, false);
+    else
+        counts = windowSums(_count, window, band);
+    cv::divide(sums, cv::max(counts, 1.0), out, 1.0, CV_32F);
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to threshold src as cv::adaptiveThreshold with ADAPTIVE_THRESH_MEAN_C and THRESH_BINARY :
+  output is maxValue where src > (local mean - c) and 0 otherwise.
+  Local mean is computed from valid pixels of the window clipped to the image, use cv::adaptiveThreshold
+  (replicated border) when data has no no-data pixels.
+  \param src is the single-channel image the integral image was computed on
+  \return CV_8U matrix
+*/
+cv::Mat IntegralImage::adaptiveThreshold(const cv::Mat &src, double maxValue, int blockSize, double c, int band) const
+{
+    cv::Mat values, out;
+    if (src.rows != getHeight() || src.cols != getWidth() || src.channels() != 1)
+        return out;
+    src.convertTo(values, CV_32F);
+    cv::Mat threshold = localMean(cv::Size(blockSize, blockSize), band) - c;
+    cv::compare(values, threshold, out, cv::CMP_GT);
+    if (maxValue != 255.0)
+        out.convertTo(out, CV_8U, maxValue/255.0);
+    return out;
+}
+
+//******************************************************************************
+/*!
+  \class WindowStatistics
+  \brief Service computing statistics of provider data over any rectangle.
+
+  Integral images of provider tiles are built on demand at overview level 'level'
+  (data is read at 1/2^level resolution) and kept in a cache. Statistics of a rectangle are
+  accumulated from the tiles it intersects in constant time per tile.
+  The object is owned by the caller and the provider is not owned : the provider should
+  outlive it. Methods can be called from several threads.
+*/
+
+//******************************************************************************
+
+WindowStatistics::WindowStatistics(const ImageDataProvider *provider, int tileSize) :
+    _tileSize(qMax(16, tileSize)),
+    _provider(provider)
+{
+    setCacheSize(256);
+}
+
+//******************************************************************************
+
+void WindowStatistics::setCacheSize(int megaBytes)
+{
+    QMutexLocker locker(&_mutex);
+    _tiles.setMaxCost(qMax(1, megaBytes)*1024);
+}
+
+//******************************************************************************
+
+void WindowStatistics::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _tiles.clear();
+}
+
+//******************************************************************************
+
+const IntegralImage * WindowStatistics::getTile(int level, int tx, int ty)
+{
+    quint64 key = ((quint64) level << 48) | ((quint64) ty << 24) | (quint64) tx;
+    IntegralImage * tile = _tiles.object(key);
+    if (tile)
+        return tile;
+
+    int scale = 1 << level;
+    int size = _tileSize*scale;
+    QRect pixelExtent = _provider->getPixelExtent();
+    QRect extent = QRect(pixelExtent.x() + tx*size, pixelExtent.y() + ty*size, size, size).intersected(pixelExtent);
+    if (extent.isEmpty())
+        return 0;
+
+    int w = qMax(1, (extent.width() + scale - 1)/scale);
+    int h = qMax(1, (extent.height() + scale - 1)/scale);
+    cv::Mat data = _provider->getImageData(extent, w, h);
+    if (data.empty())
+        return 0;
+
+    cv::Mat noDataMask = data == ImageDataProvider::NoDataValue;
+    if (cv::countNonZero(noDataMask.reshape(1)) == 0)
+        noDataMask.release();
+
+    tile = new IntegralImage(data, noDataMask);
+    if (!_tiles.insert(key, tile, (int) qMax((qint64) 1, tile->getMemorySize()/1024)))
+        return 0;
+    return tile;
+}
+
+//******************************************************************************
+/*!
+  Method to compute mean and standard deviation per band of valid pixels in the pixel extent
+  \param level is the overview level : data is read at 1/2^level resolution
+  \param count is an optional output number of valid pixels (at the overview level)
+  \return false if provider data can not be read
+*/
+bool WindowStatistics::meanStdDev(const QRect &pixelExtent, int level, QVector<double> &mean, QVector<double> &std, QVector<double> *count)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_provider || level < 0 || level > 16)
+        return false;
+
+    QRect fullExtent = _provider->getPixelExtent();
+    QRect extent = pixelExtent.isEmpty() ? fullExtent : pixelExtent.intersected(fullExtent);
+    if (extent.isEmpty())
+        return false;
+
+    // Extent in pixels of the overview level :
+    int scale = 1 << level;
+    int x0 = (extent.x() - fullExtent.x())/scale;
+    int y0 = (extent.y() - fullExtent.y())/scale;
+    int x1 = (extent.x() + extent.width() - fullExtent.x() + scale - 1)/scale;
+    int y1 = (extent.y() + extent.height() - fullExtent.y() + scale - 1)/scale;
+
+    QVector<double> s, sq, n;
+    for (int ty=y0/_tileSize; ty<=(y1 - 1)/_tileSize; ty++)
+    {
+        for (int tx=x0/_tileSize; tx<=(x1 - 1)/_tileSize; tx++)
+        {
+            const IntegralImage * tile = getTile(level, tx, ty);
+            if (!tile)
+                return false;
+            if (s.isEmpty())
+            {
+                s.fill(0.0, tile->getNbBands());
+                sq.fill(0.0, tile->getNbBands());
+                n.fill(0.0, tile->getNbBands());
+            }
+            cv::Rect r(x0 - tx*_tileSize, y0 - ty*_tileSize, x1 - x0, y1 - y0);
+            for (int b=0; b<s.size(); b++)
+            {
+                s[b] += tile->sum(r, b);
+                sq[b] += tile->squareSum(r, b);
+                n[b] += tile->count(r, b);
+            }
+        }
+    }
+
+    mean.fill(0.0, s.size());
+    std.fill(0.0, s.size());
+    for (int b=0; b<s.size(); b++)
+    {
+        if (n[b] > 0.0)
+        {
+            mean[b] = s[b]/n[b];
+            std[b] = qSqrt(qMax(0.0, sq[b]/n[b] - mean[b]*mean[b]));
+        }
+    }
+    if (count)
+        *count = n;
+    return true;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,90 @@
+#ifndef INTEGRALIMAGE_H
+#define INTEGRALIMAGE_H
+
+// Qt
+#include <QRect>
+#include <QVector>
+#include <QCache>
+#include <QMutex>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "LibExport.h"
+#include "Global.h"
+
+namespace Core
+{
+
+class ImageDataProvider;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT IntegralImage
+{
+public:
+    IntegralImage();
+    explicit IntegralImage(const cv::Mat & data, const cv::Mat & noDataMask = cv::Mat());
+
+    void compute(const cv::Mat & data, const cv::Mat & noDataMask = cv::Mat());
+
+    bool isEmpty() const
+    { return _sum.empty(); }
+    int getWidth() const
+    { return _sum.empty() ? 0 : _sum.cols - 1; }
+    int getHeight() const
+    { return _sum.empty() ? 0 : _sum.rows - 1; }
+    int getNbBands() const
+    { return _sum.channels(); }
+    //! Memory size in bytes
+    qint64 getMemorySize() const;
+
+    double sum(const cv::Rect & r, int band = 0) const;
+    double squareSum(const cv::Rect & r, int band = 0) const;
+    double count(const cv::Rect & r, int band = 0) const;
+    bool meanStdDev(const cv::Rect & r, double & mean, double & std, int band = 0) const;
+
+    cv::Mat localMean(cv::Size window, int band = 0) const;
+    cv::Mat adaptiveThreshold(const cv::Mat & src, double maxValue, int blockSize, double c, int band = 0) const;
+
+protected:
+    //! Summed-area tables of values, squared values and valid pixels of size (height+1)x(width+1)
+    cv::Mat _sum;
+    cv::Mat _sqSum;
+    cv::Mat _count;
+
+};
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT WindowStatistics
+{
+    Q_DISABLE_COPY(WindowStatistics)
+
+    PROPERTY_GETACCESSOR(int, tileSize, getTileSize)
+
+public:
+    explicit WindowStatistics(const ImageDataProvider * provider, int tileSize = 512);
+
+    bool meanStdDev(const QRect & pixelExtent, int level,
+                    QVector<double> & mean, QVector<double> & std,
+                    QVector<double> * count = 0);
+
+    void setCacheSize(int megaBytes);
+    void clear();
+
+protected:
+    const IntegralImage * getTile(int level, int tx, int ty);
+
+    const ImageDataProvider * _provider;
+    QMutex _mutex;
+    //! Integral images of tiles at overview levels, cost is in kilobytes
+    QCache<quint64, IntegralImage> _tiles;
+};
+
+//******************************************************************************
+
+}
+
+#endif // INTEGRALIMAGE_H
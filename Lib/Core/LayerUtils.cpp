@@ -6,6 +6,8 @@
 #include <qmath.h>
 #include <QString>
 #include <QFileInfo>
+#include <QHash>
+#include <QPainterPath>
 
 // OpenCV
 #include <opencv2/imgproc/imgproc.hpp>
@@ -13,6 +15,10 @@
 
 // Project
 #include "LayerUtils.h"
+#include "ImageDataProvider.h"
+
+// STD
+#include <cstring>
 
 namespace Core
 {
@@ -911,41 +917,503 @@ bool writeToFile(const QString &outputFilename0, const cv::Mat &image,
 
 //******************************************************************************
 
-int joinOvrlContours(QVector<QPolygon> &contours)
+namespace
 {
-    int count = contours.size();
-    QVector< QPolygon >::iterator it1 = contours.begin();
-    QVector< QPolygon >::iterator it2;
-    bool erase = false;
-    for (;it1 != contours.end();)
+
+//******************************************************************************
+/*!
+  Method to get creation options of a tiled GeoTiff. Predictor and compression level are set only if specified
+*/
+char ** createGeoTiffOptions(const GeoTiffOptions & options, int blockSize)
+{
+    char **papszCreateOptions = 0;
+    papszCreateOptions=CSLAddString(papszCreateOptions, "TILED=YES");
+    papszCreateOptions=CSLAddString(papszCreateOptions, QString("BLOCKXSIZE=%1").arg(blockSize).toStdString().c_str());
+    papszCreateOptions=CSLAddString(papszCreateOptions, QString("BLOCKYSIZE=%1").arg(blockSize).toStdString().c_str());
+    papszCreateOptions=CSLAddString(papszCreateOptions, QString("COMPRESS=%1").arg(options.Compression.toUpper()).toStdString().c_str());
+    papszCreateOptions=CSLAddString(papszCreateOptions, options.NbOfThreads > 0 ?
+                                        QString("NUM_THREADS=%1").arg(options.NbOfThreads).toStdString().c_str() :
+                                        "NUM_THREADS=ALL_CPUS");
+    papszCreateOptions=CSLAddString(papszCreateOptions, "BIGTIFF=IF_SAFER");
+
+    QString compression = options.Compression.toUpper();
+    if (options.Predictor > 1 && compression != "JPEG")
+    {
+        papszCreateOptions=CSLAddString(papszCreateOptions, QString("PREDICTOR=%1").arg(options.Predictor).toStdString().c_str());
+    }
+    if (options.Level > 0)
+    {
+        QString levelOption = compression == "DEFLATE" ? "ZLEVEL" :
+                              compression == "ZSTD" ? "ZSTD_LEVEL" :
+                              compression == "JPEG" ? "JPEG_QUALITY" : QString();
+        if (!levelOption.isEmpty())
+        {
+            papszCreateOptions=CSLAddString(papszCreateOptions, QString("%1=%2").arg(levelOption).arg(options.Level).toStdString().c_str());
+        }
+    }
+    if (compression == "JPEG")
+    {
+        papszCreateOptions=CSLAddString(papszCreateOptions, "PHOTOMETRIC=YCBCR");
+    }
+    return papszCreateOptions;
+}
+
+//******************************************************************************
+/*!
+  Method to get the range [i0, i1) of the overview pixels sampled in the image pixels [first, last].
+  Overview pixel i samples the centre of its block i*f + f/2, the last partial block samples the last image pixel
+*/
+void sampledRange(int first, int last, int size, int f, int & i0, int & i1)
+{
+    int h = f / 2;
+    i0 = (first - h + f - 1) / f;
+    i1 = last >= h ? (last - h) / f + 1 : 0;
+    if (last == size - 1)
+        i1 = (size + f - 1) / f;
+}
+
+//******************************************************************************
+/*!
+  Method to decimate window data for the overview of factor f with the nearest neighbour (as GDAL NEAREST
+  resampling) : pixel (X, Y) of the overview is the pixel (X*f + f/2, Y*f + f/2) of the image,
+  clamped to the image for the last partial block
+  \param window is the window of data in the image pixels
+  \param imageSize is the size of the image
+  \param levelWindow is the output window in the overview pixels
+*/
+cv::Mat decimate(const cv::Mat & data, const QRect & window, const QSize & imageSize, int f, QRect & levelWindow)
+{
+    int x0, x1, y0, y1;
+    sampledRange(window.left(), window.right(), imageSize.width(), f, x0, x1);
+    sampledRange(window.top(), window.bottom(), imageSize.height(), f, y0, y1);
+    levelWindow = QRect(x0, y0, x1 - x0, y1 - y0);
+    if (levelWindow.isEmpty())
+        return cv::Mat();
+
+    cv::Mat out(levelWindow.height(), levelWindow.width(), data.type());
+    size_t elemSize = data.elemSize();
+    int h = f / 2;
+    for (int y=y0; y<y1; y++)
+    {
+        const uchar * src = data.ptr<uchar>(qMin(y*f + h, imageSize.height() - 1) - window.y());
+        uchar * dst = out.ptr<uchar>(y - y0);
+        for (int x=x0; x<x1; x++)
+        {
+            int sx = qMin(x*f + h, imageSize.width() - 1);
+            std::memcpy(dst + (x - x0)*elemSize, src + (sx - window.x())*elemSize, elemSize);
+        }
+    }
+    return out;
+}
+
+}
+
+//******************************************************************************
+
+bool writeToFile(const QString &outputFilename0, const ImageDataProvider *provider,
+                 const QRect &pixelExtent,
+                 const QString &projectionStr, const QVector<double> &geoTransform,
+                 double nodatavalue,
+                 const QList<QPair<QString, QString> > &metadata,
+                 const GeoTiffOptions &options,
+                 ProgressReporter *reporter)
+{
+    if (!provider)
+    {
+        SD_TRACE("writeToFile : Error : data provider is null");
+        return false;
+    }
+    QRect extent = pixelExtent.isEmpty() ? provider->getPixelExtent() : pixelExtent.intersected(provider->getPixelExtent());
+    if (extent.isEmpty())
+    {
+        SD_TRACE("writeToFile : Error : pixel extent is empty");
+        return false;
+    }
+
+    int count = GetGDALDriverManager()->GetDriverCount();
+    if (count == 0)
+    {
+        SD_TRACE("writeToFile : Error : GDAL drivers are not registered");
+        return false;
+    }
+
+    GDALDriver * driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    if (!driver)
+    {
+        SD_TRACE( "GDAL failed to get geotiff driver to write output image " );
+        return false;
+    }
+
+    int nbBands = provider->getNbBands();
+    int blockSize = qMax(16, options.BlockSize / 16 * 16);
+
+    // Provider data is always 32F. JPEG is possible only for 8 bits RGB images which are written as bytes
+    bool isJpeg = options.Compression.toUpper() == "JPEG";
+    if (isJpeg && (nbBands != 3 || provider->getInputDepthInBytes() != 1 || provider->inputIsComplex()))
     {
-        QPolygon & p1 = *it1;
-        it2 = it1+1;
-        for (;it2 != contours.end();)
+        SD_TRACE("writeToFile : Error : JPEG compression is possible only for 8 bits RGB images");
+        return false;
+    }
+    GDALDataType dataType = isJpeg ? GDT_Byte : GDT_Float32;
+    int depth = isJpeg ? CV_8U : CV_32F;
+
+    QString outputFilename = outputFilename0;
+    QFileInfo fi(outputFilename);
+    if (fi.suffix().compare("tif", Qt::CaseInsensitive))
+    {
+        outputFilename.append(".tif");
+    }
+
+    // Cloud optimized layout (overviews are stored before the full resolution data) is obtained by the copy
+    // of a tiled file with internal overviews. This file is written without loss, overviews are computed
+    // while the data is streamed into it
+    QString datasetFilename = outputFilename;
+    GeoTiffOptions datasetOptions = options;
+    if (options.CloudOptimized)
+    {
+        datasetFilename = outputFilename + ".tmp.tif";
+        datasetOptions.Compression = "LZW";
+        datasetOptions.Predictor = 0;
+        datasetOptions.Level = -1;
+    }
+
+    char **papszCreateOptions = createGeoTiffOptions(datasetOptions, blockSize);
+    GDALDataset * outputDataset = driver->Create(datasetFilename.toStdString().c_str(),
+                                                 extent.width(), extent.height(), nbBands, dataType, papszCreateOptions);
+    CSLDestroy(papszCreateOptions);
+    if (!outputDataset)
+    {
+        SD_TRACE( QString( "GDAL failed to create output image : %1" ).arg( datasetFilename ) )
+        return false;
+    }
+
+    if (!projectionStr.isEmpty())
+    {
+        outputDataset->SetProjection( projectionStr.toStdString().c_str() );
+    }
+    // geo transform of the subset : geoTransform is relative to the provider pixel extent origin
+    if (geoTransform.size() == 6)
+    {
+        QVector<double> gt = geoTransform;
+        double dx = extent.x() - provider->getPixelExtent().x();
+        double dy = extent.y() - provider->getPixelExtent().y();
+        gt[0] += dx * geoTransform[1] + dy * geoTransform[2];
+        gt[3] += dx * geoTransform[4] + dy * geoTransform[5];
+        outputDataset->SetGeoTransform( gt.data() );
+    }
+
+    typedef QPair<QString,QString> Mdi;
+    foreach(Mdi item, metadata)
+    {
+        outputDataset->SetMetadataItem(item.first.toStdString().c_str(),
+                                       item.second.toStdString().c_str());
+    }
+
+    // no-data value can not be represented in bytes
+    if (nodatavalue != -123456789.0 && !isJpeg)
+    {
+        for (int i=0; i<nbBands; i++)
         {
-            QPolygon & p2 = *it2;
+            outputDataset->GetRasterBand(i+1)->SetNoDataValue(nodatavalue);
+        }
+    }
+
+    // Overviews down to a single block. Levels are only created here and filled by the windows
+    QVector<int> factors;
+    if (options.CloudOptimized)
+    {
+        int maxDim = qMax(extent.width(), extent.height());
+        for (int f=2; qCeil(maxDim * 2.0 / f) > blockSize; f*=2)
+        {
+            factors << f;
+        }
+    }
+    bool ok = true;
+    if (!factors.isEmpty() &&
+            outputDataset->BuildOverviews("NONE", factors.size(), factors.data(), 0, 0, 0, 0) != CE_None)
+    {
+        SD_TRACE("writeToFile : GDAL failed to create overviews");
+        ok = false;
+    }
 
-            QPolygon ints = p1.intersected(p2);
-            if (ints.isEmpty())
+    int startValue = reporter ? reporter->startValue : 0;
+    int endValue = reporter ? reporter->endValue : 100;
+    int writeEndValue = options.CloudOptimized ? startValue + 0.7*(endValue - startValue) : endValue;
+
+    // Windows are a row of blocks, at most 16 blocks wide. Interleaved provider data is written
+    // in one call for all bands, thus bands are not split
+    int windowWidth = qMin(extent.width(), 16*blockSize);
+    int nbXWindows = qCeil(extent.width() * 1.0 / windowWidth);
+    int nbYWindows = qCeil(extent.height() * 1.0 / blockSize);
+    for (int wy=0; wy<nbYWindows && ok; wy++)
+    {
+        for (int wx=0; wx<nbXWindows && ok; wx++)
+        {
+            if (reporter && reporter->isCanceled())
             {
-                ++it2;
-                continue;
+                SD_TRACE( "writeToFile : Write is canceled" );
+                ok = false;
+                break;
+            }
+
+            QRect window = QRect(wx*windowWidth, wy*blockSize, windowWidth, blockSize)
+                    .intersected(QRect(QPoint(0, 0), extent.size()));
+            cv::Mat data = provider->getImageData(window.translated(extent.topLeft()));
+            if (data.cols != window.width() || data.rows != window.height() || data.channels() != nbBands)
+            {
+                SD_TRACE( "writeToFile : Failed to read data" );
+                ok = false;
+                break;
+            }
+            if (data.depth() != depth)
+            {
+                data.convertTo(data, depth);
+            }
+
+            CPLErr err = outputDataset->RasterIO(GF_Write, window.x(), window.y(), window.width(), window.height(),
+                                                 data.data, data.cols, data.rows, dataType,
+                                                 nbBands, 0,
+                                                 data.elemSize(), data.step[0], data.elemSize1());
+
+            // overview bands are written band by band
+            for (int k=0; k<factors.size() && err == CE_None; k++)
+            {
+                QRect levelWindow;
+                cv::Mat levelData = decimate(data, window, extent.size(), factors[k], levelWindow);
+                if (levelData.empty())
+                    continue;
+                for (int i=0; i<nbBands && err == CE_None; i++)
+                {
+                    GDALRasterBand * overview = outputDataset->GetRasterBand(i+1)->GetOverview(k);
+                    err = overview ? overview->RasterIO(GF_Write, levelWindow.x(), levelWindow.y(), levelWindow.width(), levelWindow.height(),
+                                                        levelData.data + i*levelData.elemSize1(), levelData.cols, levelData.rows, dataType,
+                                                        levelData.elemSize(), levelData.step[0]) : CE_Failure;
+                }
+            }
+
+            if (err != CE_None)
+            {
+                SD_TRACE( "Failed to write data" );
+                ok = false;
+                break;
+            }
+
+            if (reporter)
+            {
+                double r = (wy*nbXWindows + wx + 1) * 1.0 / (nbXWindows*nbYWindows);
+                reporter->progressValueChanged(r*(writeEndValue - startValue) + startValue);
             }
-            p1 = p1.united(p2);
-            contours.erase(it2);
-            erase = true;
-            break;
         }
+    }
 
-        if (erase)
+    if (ok && options.CloudOptimized)
+    {
+        // Copy with the final compression, source overviews are copied and placed before the data
+        papszCreateOptions = createGeoTiffOptions(options, blockSize);
+        papszCreateOptions = CSLAddString(papszCreateOptions, "COPY_SRC_OVERVIEWS=YES");
+        if (reporter)
         {
-            erase = false;
+            reporter->startValue = writeEndValue;
+        }
+        GDALDataset * cogDataset = driver->CreateCopy(outputFilename.toStdString().c_str(), outputDataset, FALSE,
+                                                      papszCreateOptions, reporter ? progressCallback : 0, reporter);
+        CSLDestroy(papszCreateOptions);
+        if (reporter)
+        {
+            reporter->startValue = startValue;
+        }
+        if (!cogDataset)
+        {
+            SD_TRACE( QString( "GDAL failed to create output image : %1" ).arg( outputFilename ) )
+            ok = false;
         }
         else
         {
-            ++it1;
+            GDALClose(cogDataset);
         }
     }
+
+    GDALClose(outputDataset);
+    if (options.CloudOptimized)
+    {
+        driver->Delete(datasetFilename.toStdString().c_str());
+    }
+    // incomplete output is removed (e.g. canceled write)
+    if (!ok && QFileInfo(outputFilename).exists())
+    {
+        QFile(outputFilename).remove();
+    }
+    return ok;
+}
+
+//******************************************************************************
+
+namespace
+{
+
+int findRoot(QVector<int> & parents, int i)
+{
+    while (parents[i] != i)
+    {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+//******************************************************************************
+
+inline int orientation(const QPoint & a, const QPoint & b, const QPoint & c)
+{
+    qint64 v = (qint64) (b.x() - a.x()) * (c.y() - a.y()) - (qint64) (b.y() - a.y()) * (c.x() - a.x());
+    return v > 0 ? 1 : (v < 0 ? -1 : 0);
+}
+
+//******************************************************************************
+/*!
+  Method to check if polygons overlap : a vertex of one polygon is inside the other or their edges cross.
+  Polygons touching each other are checked with QPolygon::intersected
+  \param common is the intersection of the bounding rects
+*/
+bool polygonsOverlap(const QPolygon & a, const QPolygon & b, const QRect & common)
+{
+    bool touching = false;
+    for (int i=0; i<a.size(); i++)
+    {
+        const QPoint & a1 = a[i];
+        const QPoint & a2 = a[(i + 1) % a.size()];
+        QRect ra = QRect(a1, a2).normalized();
+        if (a1 == a2 || !ra.intersects(common))
+            continue;
+        for (int j=0; j<b.size(); j++)
+        {
+            const QPoint & b1 = b[j];
+            const QPoint & b2 = b[(j + 1) % b.size()];
+            if (b1 == b2 || !ra.intersects(QRect(b1, b2).normalized()))
+                continue;
+            int o1 = orientation(a1, a2, b1), o2 = orientation(a1, a2, b2);
+            int o3 = orientation(b1, b2, a1), o4 = orientation(b1, b2, a2);
+            if (o1*o2 < 0 && o3*o4 < 0)
+                return true;
+            if (o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0)
+                touching = true;
+        }
+    }
+    if (touching)
+        return !a.intersected(b).isEmpty();
+
+    // No edges cross : one polygon is inside the other or they are disjoint
+    if (common.contains(a.first()) && b.containsPoint(a.first(), Qt::OddEvenFill))
+        return true;
+    if (common.contains(b.first()) && a.containsPoint(b.first(), Qt::OddEvenFill))
+        return true;
+    return false;
+}
+
+}
+
+//******************************************************************************
+/*!
+  Candidate pairs are polygons with intersecting bounding rects found with a uniform grid,
+  the cell size is the mean size of the bounding rects. Overlapping polygons are grouped and
+  polygons of a group are united by pairs.
+*/
+int joinOvrlContours(QVector<QPolygon> &contours)
+{
+    int count = contours.size();
+    if (count < 2)
+        return 0;
+
+    QVector<QRect> rects(count);
+    QRect extent;
+    double size = 0.0;
+    for (int i=0; i<count; i++)
+    {
+        rects[i] = contours[i].boundingRect();
+        extent = extent.united(rects[i]);
+        size += qMax(rects[i].width(), rects[i].height());
+    }
+    // Grid has at most 1024x1024 cells
+    int cellSize = qMax(qRound(size / count), qMax(extent.width(), extent.height()) / 1024);
+    cellSize = qMax(1, cellSize);
+
+    QVector<int> parents(count);
+    for (int i=0; i<count; i++)
+    {
+        parents[i] = i;
+    }
+
+    // A pair is tested in the cell of the top-left corner of the bounding rects intersection only
+    QHash<quint64, QVector<int> > cells;
+    for (int i=0; i<count; i++)
+    {
+        const QRect & r = rects[i];
+        int cx0 = (r.left() - extent.left()) / cellSize;
+        int cx1 = (r.right() - extent.left()) / cellSize;
+        int cy0 = (r.top() - extent.top()) / cellSize;
+        int cy1 = (r.bottom() - extent.top()) / cellSize;
+        for (int cy=cy0; cy<=cy1; cy++)
+        {
+            for (int cx=cx0; cx<=cx1; cx++)
+            {
+                QVector<int> & cell = cells[((quint64) cy << 32) | (quint64) cx];
+                for (int k=0; k<cell.size(); k++)
+                {
+                    int j = cell[k];
+                    QRect common = r.intersected(rects[j]);
+                    if (common.isEmpty() ||
+                            (common.left() - extent.left()) / cellSize != cx ||
+                            (common.top() - extent.top()) / cellSize != cy)
+                        continue;
+                    int ri = findRoot(parents, i);
+                    int rj = findRoot(parents, j);
+                    if (ri == rj || !polygonsOverlap(contours[i], contours[j], common))
+                        continue;
+                    parents[qMax(ri, rj)] = qMin(ri, rj);
+                }
+                cell << i;
+            }
+        }
+    }
+
+    // Group root is the first polygon of the group : order of polygons is kept
+    QVector<QList<int> > groups(count);
+    for (int i=0; i<count; i++)
+    {
+        groups[findRoot(parents, i)] << i;
+    }
+
+    QVector<QPolygon> output;
+    for (int i=0; i<count; i++)
+    {
+        const QList<int> & group = groups[i];
+        if (group.isEmpty())
+            continue;
+        if (group.size() == 1)
+        {
+            output << contours[i];
+            continue;
+        }
+        QList<QPainterPath> paths;
+        foreach (int j, group)
+        {
+            QPainterPath path;
+            path.addPolygon(contours[j]);
+            path.closeSubpath();
+            paths << path;
+        }
+        while (paths.size() > 1)
+        {
+            QList<QPainterPath> united;
+            for (int k=0; k<paths.size(); k+=2)
+            {
+                united << (k + 1 < paths.size() ? paths[k].united(paths[k + 1]) : paths[k]);
+            }
+            paths = united;
+        }
+        output << paths.first().toFillPolygon().toPolygon();
+    }
+    contours = output;
     return count - contours.size();
 }
 
@@ -967,6 +1435,7 @@ int progressCallback( double dfComplete, const char * pszMessage, void * pProgre
 
     int value = dfComplete * (reporter->endValue - reporter->startValue) + reporter->startValue;
     reporter->progressValueChanged(value);
-    return true;
+    // GDAL stops the operation if the work is canceled
+    return !reporter->isCanceled();
 }
 
@@ -2,7 +2,9 @@
 #define LAYERUTILS_H
 
 // Qt
+#include <QAtomicInt>
 #include <QPolygonF>
+#include <QRect>
 #include <QVariant>
 #include <QPair>
 #include <QList>
@@ -23,6 +25,8 @@
 namespace Core
 {
 
+class ImageDataProvider;
+
 class ProgressReporter : public QObject
 {
     Q_OBJECT
@@ -30,15 +34,26 @@ public:
     ProgressReporter(QObject * parent = 0):
         QObject(parent),
         startValue(0),
-        endValue(100)
+        endValue(100),
+        _canceled(0)
     { }
 
     int startValue;
     int endValue;
 
+    //! Method to request the cancellation of the work reporting its progress, it can be called from any thread
+    void cancel()
+    { _canceled.store(1); }
+    void reset()
+    { _canceled.store(0); }
+    bool isCanceled() const
+    { return _canceled.load() != 0; }
+
 signals:
     void progressValueChanged(int value);
 
+protected:
+    QAtomicInt _canceled;
 
 };
 
@@ -260,6 +275,50 @@ bool GIV_DLL_EXPORT writeToFile(const QString & outputFilename, const cv::Mat &
                                 double nodatavalue = -123456789.0,
                                 const QList< QPair<QString,QString> > & metadata = QList< QPair<QString,QString> >());
 
+/*!
+ * \brief GeoTiffOptions defines the layout and the compression of GeoTiff files written by windows
+ */
+struct GeoTiffOptions
+{
+    int BlockSize;
+    //! Codec : LZW, DEFLATE, ZSTD or JPEG (only for 8 bits RGB images)
+    QString Compression;
+    //! TIFF predictor : 2 - horizontal differencing, 3 - floating point. No predictor if Predictor <= 1
+    int Predictor;
+    //! Compression level (ZLEVEL, ZSTD_LEVEL or JPEG_QUALITY), codec default if Level <= 0
+    int Level;
+    //! Number of threads to compress blocks, all cores are used if NbOfThreads <= 0
+    int NbOfThreads;
+    //! Cloud optimized layout with internal overviews
+    bool CloudOptimized;
+    GeoTiffOptions() :
+        BlockSize(256),
+        Compression("LZW"),
+        Predictor(0),
+        Level(-1),
+        NbOfThreads(0),
+        CloudOptimized(false)
+    {}
+};
+
+/*!
+ * \brief writeToFile method to write provider data into a tiled GeoTiff. Data is read from the provider and written
+ * by block aligned windows, thus the memory does not depend on the image size.
+ * \param pixelExtent is the subset of the provider to write, whole image is written if empty
+ * \param geoTransform is the geo transform of the provider, it is shifted to the subset origin
+ * \param options defines the codec and the layout. Cloud optimized files have internal overviews which are
+ * computed during the write, they are opened without overviews computation
+ * \param reporter receives the progress, the write stops at the next window if it is canceled
+ * \return true if successful. Output files are removed if the write fails or is canceled
+ */
+bool GIV_DLL_EXPORT writeToFile(const QString & outputFilename, const ImageDataProvider * provider,
+                                const QRect & pixelExtent = QRect(),
+                                const QString & projectionStr = QString(), const QVector<double> & geoTransform = QVector<double>(),
+                                double nodatavalue = -123456789.0,
+                                const QList< QPair<QString,QString> > & metadata = QList< QPair<QString,QString> >(),
+                                const GeoTiffOptions & options = GeoTiffOptions(),
+                                ProgressReporter * reporter = 0);
+
 //******************************************************************************
 // Type conversion methods
 //******************************************************************************
@@ -0,0 +1,180 @@
+
+// Qt
+#include <QVector>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "RegionGrowing.h"
+#include "ImageDataProvider.h"
+
+// STD
+#include <cfloat>
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class RegionGrowing
+  \brief Scanline flood fill of a band of a provider at full resolution.
+
+  Pixels connected to the seed with values in [seed - loDiff, seed + upDiff] are filled
+  (as cv::floodFill with cv::FLOODFILL_FIXED_RANGE), no-data pixels are never filled.
+  Provider data is read by tiles when the fill reaches them and the result is a SparseMask,
+  thus memory and time depend on the region size and not on the image size.
+  Coordinates are in pixels of the provider pixel extent.
+  Fill can be limited in pixels and in loaded tiles (see isLimitReached()) and canceled from another thread.
+*/
+
+//******************************************************************************
+
+RegionGrowing::RegionGrowing(const ImageDataProvider *provider, int band, int tileSize) :
+    _tileSize(qMax(16, tileSize)),
+    _nbOfPixels(0),
+    _maxNbOfPixels(0),
+    _maxNbOfTiles(0),
+    _limitReached(false),
+    _provider(provider),
+    _band(band),
+    _lastTx(-1),
+    _lastTy(-1),
+    _readError(false),
+    _lowValue(0.0f),
+    _highValue(0.0f)
+{
+    if (_provider)
+        _extent = _provider->getPixelExtent();
+}
+
+//******************************************************************************
+/*!
+  Method to fill the region from the seed
+  \return false if seed is not a valid pixel, provider data can not be read, a limit is reached
+  or the fill is canceled. Mask is partial in the last cases
+*/
+bool RegionGrowing::grow(const QPoint &seed, double loDiff, double upDiff, bool eightConnectivity)
+{
+    _mask = SparseMask(_extent, _tileSize);
+    _nbOfPixels = 0;
+    _readError = false;
+    _limitReached = false;
+    _canceled.store(0);
+    if (!_provider || _band < 0 || _band >= _provider->getNbBands() || !_extent.contains(seed))
+        return false;
+
+    // Range is defined by the seed value :
+    _lowValue = -FLT_MAX;
+    _highValue = FLT_MAX;
+    if (!inRange(seed.x(), seed.y()))
+        return false;
+    float v = _lastTile.at<float>(seed.y() - _extent.y() - _lastTy*_tileSize, seed.x() - _extent.x() - _lastTx*_tileSize);
+    _lowValue = v - loDiff;
+    _highValue = v + upDiff;
+
+    QVector<QPoint> stack;
+    stack << seed;
+    int n = eightConnectivity ? 1 : 0;
+    while (!stack.isEmpty())
+    {
+        if (_readError || _limitReached || isCanceled())
+            return false;
+        QPoint p = stack.last();
+        stack.pop_back();
+        int y = p.y();
+        if (_mask.at(p.x(), y) || !inRange(p.x(), y))
+            continue;
+
+        // Fill the run of the row :
+        int xl = p.x(), xr = p.x();
+        while (xl > _extent.left() && !_mask.at(xl - 1, y) && inRange(xl - 1, y))
+            xl--;
+        while (xr < _extent.right() && !_mask.at(xr + 1, y) && inRange(xr + 1, y))
+            xr++;
+        _mask.setRow(y, xl, xr);
+        _nbOfPixels += xr - xl + 1;
+        if (_maxNbOfPixels > 0 && _nbOfPixels > _maxNbOfPixels)
+        {
+            _limitReached = true;
+            return false;
+        }
+
+        // Seeds of the runs in the rows above and below :
+        for (int ny=y-1; ny<=y+1; ny+=2)
+        {
+            if (ny < _extent.top() || ny > _extent.bottom())
+                continue;
+            int x0 = qMax(_extent.left(), xl - n);
+            int x1 = qMin(_extent.right(), xr + n);
+            bool inRun = false;
+            for (int x=x0; x<=x1; x++)
+            {
+                bool ok = !_mask.at(x, ny) && inRange(x, ny);
+                if (ok && !inRun)
+                    stack << QPoint(x, ny);
+                inRun = ok;
+            }
+        }
+    }
+    return !_readError && !_limitReached;
+}
+
+//******************************************************************************
+
+bool RegionGrowing::inRange(int x, int y)
+{
+    int px = x - _extent.x(), py = y - _extent.y();
+    int tx = px / _tileSize, ty = py / _tileSize;
+    if (tx != _lastTx || ty != _lastTy)
+    {
+        _lastTile = loadTile(tx, ty);
+        _lastTx = tx;
+        _lastTy = ty;
+    }
+    float v = _lastTile.at<float>(py - ty*_tileSize, px - tx*_tileSize);
+    return v != ImageDataProvider::NoDataValue && v >= _lowValue && v <= _highValue;
+}
+
+//******************************************************************************
+/*!
+  Method to get the band data of the tile, tile is read from the provider on the first call
+*/
+cv::Mat RegionGrowing::loadTile(int tx, int ty)
+{
+    quint64 key = ((quint64) ty << 32) | (quint64) tx;
+    QHash<quint64, cv::Mat>::const_iterator it = _tiles.constFind(key);
+    if (it != _tiles.constEnd())
+        return it.value();
+
+    QRect r = QRect(_extent.x() + tx*_tileSize, _extent.y() + ty*_tileSize, _tileSize, _tileSize).intersected(_extent);
+    if (_maxNbOfTiles > 0 && _tiles.size() >= _maxNbOfTiles)
+    {
+        // tile is not kept : fill is stopped
+        _limitReached = true;
+        return cv::Mat(r.height(), r.width(), CV_32F, cv::Scalar(ImageDataProvider::NoDataValue));
+    }
+    cv::Mat data = _provider->getImageData(r);
+    cv::Mat out;
+    if (data.empty())
+    {
+        SD_TRACE("RegionGrowing : failed to read data");
+        _readError = true;
+        out = cv::Mat(r.height(), r.width(), CV_32F, cv::Scalar(ImageDataProvider::NoDataValue));
+    }
+    else
+    {
+        if (data.channels() > 1)
+            cv::extractChannel(data, out, _band);
+        else
+            out = data;
+        if (out.depth() != CV_32F)
+            out.convertTo(out, CV_32F);
+    }
+    _tiles.insert(key, out);
+    return out;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,76 @@
+#ifndef REGIONGROWING_H
+#define REGIONGROWING_H
+
+// Qt
+#include <QRect>
+#include <QHash>
+#include <QPoint>
+#include <QAtomicInt>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "LibExport.h"
+#include "Global.h"
+#include "SparseMask.h"
+
+namespace Core
+{
+
+class ImageDataProvider;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT RegionGrowing
+{
+    PROPERTY_GETACCESSOR(int, tileSize, getTileSize)
+    PROPERTY_GETACCESSOR(qint64, nbOfPixels, getNbOfPixels)
+    //! Fill is stopped when the region has more pixels, no limit if not positive
+    PROPERTY_ACCESSORS(qint64, maxNbOfPixels, getMaxNbOfPixels, setMaxNbOfPixels)
+    //! Fill is stopped when it needs more data tiles (memory limit), no limit if not positive
+    PROPERTY_ACCESSORS(int, maxNbOfTiles, getMaxNbOfTiles, setMaxNbOfTiles)
+    PROPERTY_GETACCESSOR(bool, limitReached, isLimitReached)
+
+public:
+    explicit RegionGrowing(const ImageDataProvider * provider, int band = 0, int tileSize = 256);
+
+    bool grow(const QPoint & seed, double loDiff, double upDiff, bool eightConnectivity = true);
+
+    const SparseMask & getMask() const
+    { return _mask; }
+    int getNbOfLoadedTiles() const
+    { return _tiles.size(); }
+
+    //! Method to stop the fill, it can be called from another thread
+    void cancel()
+    { _canceled.store(1); }
+    bool isCanceled() const
+    { return _canceled.load() != 0; }
+
+protected:
+    bool inRange(int x, int y);
+    cv::Mat loadTile(int tx, int ty);
+
+    const ImageDataProvider * _provider;
+    int _band;
+    QRect _extent;
+
+    //! Loaded CV_32F tiles of the band
+    QHash<quint64, cv::Mat> _tiles;
+    cv::Mat _lastTile;
+    int _lastTx;
+    int _lastTy;
+    bool _readError;
+    QAtomicInt _canceled;
+
+    float _lowValue;
+    float _highValue;
+    SparseMask _mask;
+};
+
+//******************************************************************************
+
+}
+
+#endif // REGIONGROWING_H
@@ -0,0 +1,120 @@
+
+// Project
+#include "SparseMask.h"
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class SparseMask
+  \brief Binary mask over a large extent where only the tiles containing mask pixels are allocated.
+  Coordinates are pixels of the extent (e.g. provider pixel extent), pixels outside of the extent are
+  not in the mask.
+*/
+
+//******************************************************************************
+
+SparseMask::SparseMask(const QRect &extent, int tileSize) :
+    _extent(extent),
+    _tileSize(qMax(16, tileSize))
+{
+}
+
+//******************************************************************************
+
+bool SparseMask::at(int x, int y) const
+{
+    if (!_extent.contains(x, y))
+        return false;
+    int px = x - _extent.x(), py = y - _extent.y();
+    int tx = px / _tileSize, ty = py / _tileSize;
+    QHash<quint64, cv::Mat>::const_iterator it = _tiles.constFind(tileKey(tx, ty));
+    if (it == _tiles.constEnd())
+        return false;
+    return it.value().at<uchar>(py - ty*_tileSize, px - tx*_tileSize) != 0;
+}
+
+//******************************************************************************
+/*!
+  Method to add pixels [x0, x1] of the row y to the mask
+*/
+void SparseMask::setRow(int y, int x0, int x1)
+{
+    if (y < _extent.top() || y > _extent.bottom())
+        return;
+    x0 = qMax(x0, _extent.left());
+    x1 = qMin(x1, _extent.right());
+
+    int py = y - _extent.y();
+    int ty = py / _tileSize;
+    for (int x=x0; x<=x1;)
+    {
+        int px = x - _extent.x();
+        int tx = px / _tileSize;
+        int end = qMin(x1, _extent.x() + (tx + 1)*_tileSize - 1);
+
+        quint64 key = tileKey(tx, ty);
+        QHash<quint64, cv::Mat>::iterator it = _tiles.find(key);
+        if (it == _tiles.end())
+        {
+            QRect r = QRect(_extent.x() + tx*_tileSize, _extent.y() + ty*_tileSize, _tileSize, _tileSize).intersected(_extent);
+            it = _tiles.insert(key, cv::Mat(r.height(), r.width(), CV_8U, cv::Scalar(0)));
+        }
+        uchar * row = it.value().ptr<uchar>(py - ty*_tileSize);
+        for (int i=px - tx*_tileSize; i<=end - _extent.x() - tx*_tileSize; i++)
+        {
+            row[i] = 255;
+        }
+        x = end + 1;
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to get the mask in the rect (in pixels of the extent)
+  \return CV_8U matrix, 255 for mask pixels
+*/
+cv::Mat SparseMask::getData(const QRect &rect) const
+{
+    cv::Mat out(rect.height(), rect.width(), CV_8U, cv::Scalar(0));
+    QRect r = rect.intersected(_extent);
+    if (r.isEmpty() || _tiles.isEmpty())
+        return out;
+
+    int tx0 = (r.left() - _extent.x()) / _tileSize, tx1 = (r.right() - _extent.x()) / _tileSize;
+    int ty0 = (r.top() - _extent.y()) / _tileSize, ty1 = (r.bottom() - _extent.y()) / _tileSize;
+    for (int ty=ty0; ty<=ty1; ty++)
+    {
+        for (int tx=tx0; tx<=tx1; tx++)
+        {
+            QHash<quint64, cv::Mat>::const_iterator it = _tiles.constFind(tileKey(tx, ty));
+            if (it == _tiles.constEnd())
+                continue;
+            QRect tr(_extent.x() + tx*_tileSize, _extent.y() + ty*_tileSize, it.value().cols, it.value().rows);
+            QRect common = tr.intersected(r);
+            it.value()(cv::Rect(common.x() - tr.x(), common.y() - tr.y(), common.width(), common.height()))
+                    .copyTo(out(cv::Rect(common.x() - rect.x(), common.y() - rect.y(), common.width(), common.height())));
+        }
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to get the indices of the allocated tiles
+*/
+QList<QPoint> SparseMask::getTiles() const
+{
+    QList<QPoint> out;
+    QHash<quint64, cv::Mat>::const_iterator it = _tiles.constBegin();
+    for (; it != _tiles.constEnd(); ++it)
+    {
+        out << QPoint((int) (it.key() & 0xFFFFFFFF), (int) (it.key() >> 32));
+    }
+    return out;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,55 @@
+#ifndef SPARSEMASK_H
+#define SPARSEMASK_H
+
+// Qt
+#include <QRect>
+#include <QHash>
+#include <QList>
+#include <QPoint>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "LibExport.h"
+#include "Global.h"
+
+namespace Core
+{
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT SparseMask
+{
+    PROPERTY_GETACCESSOR(QRect, extent, getExtent)
+    PROPERTY_GETACCESSOR(int, tileSize, getTileSize)
+
+public:
+    explicit SparseMask(const QRect & extent = QRect(), int tileSize = 256);
+
+    bool at(int x, int y) const;
+    void setRow(int y, int x0, int x1);
+    cv::Mat getData(const QRect & rect) const;
+
+    QList<QPoint> getTiles() const;
+    int getNbTiles() const
+    { return _tiles.size(); }
+    bool isEmpty() const
+    { return _tiles.isEmpty(); }
+
+    void clear()
+    { _tiles.clear(); }
+
+protected:
+    static quint64 tileKey(int tx, int ty)
+    { return ((quint64) ty << 32) | (quint64) tx; }
+
+    //! Allocated CV_8U tiles, 255 for mask pixels
+    QHash<quint64, cv::Mat> _tiles;
+};
+
+//******************************************************************************
+
+}
+
+#endif // SPARSEMASK_H
@@ -0,0 +1,249 @@
+
+// Qt
+#include <QDir>
+#include <QImage>
+#include <QPainter>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <qmath.h>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "TilePyramidWriter.h"
+#include "ImageDataProvider.h"
+#include "ImageRenderer.h"
+#include "LayerUtils.h"
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class TilePyramidWriter
+  \brief Writes the rendered image as a pyramid of static map tiles 'z/x/y.png' (or .jpg).
+
+  Tiles are in the pixel grid of the image (no reprojection) : the whole image fits in the single tile
+  of zoom 0 and the max zoom is the full resolution. Tile data is read at the resolution of the zoom,
+  GDAL providers read it from the matching overview. Tiles without data are not written.
+  Tile columns are rendered and encoded in parallel, the provider is expected to be thread-safe.
+  A canceled writer stops before the next tile of each column and does not write anymore.
+*/
+
+//******************************************************************************
+
+class TilePyramidTask : public QRunnable
+{
+public:
+    TilePyramidTask(TilePyramidWriter * writer, int z, int x) :
+        _writer(writer),
+        _z(z),
+        _x(x)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        _writer->writeColumn(_z, _x);
+    }
+
+protected:
+    TilePyramidWriter * _writer;
+    int _z;
+    int _x;
+};
+
+//******************************************************************************
+
+TilePyramidWriter::TilePyramidWriter() :
+    _tileSize(256),
+    _format("png"),
+    _tms(false),
+    _nbOfThreads(0),
+    _nbOfWrittenTiles(0),
+    _nbOfSkippedTiles(0),
+    _provider(0),
+    _renderer(0),
+    _conf(0),
+    _reporter(0),
+    _maxZoom(0),
+    _nbOfTiles(0),
+    _canceled(0)
+{
+}
+
+//******************************************************************************
+/*!
+  Method to get the zoom of the full resolution : the smallest zoom where the tile size multiplied by 2^zoom covers the image
+*/
+int TilePyramidWriter::getMaxZoom(const QSize &imageSize) const
+{
+    int maxDim = qMax(imageSize.width(), imageSize.height());
+    int zoom = 0;
+    while (((qint64) _tileSize << zoom) < maxDim)
+    {
+        zoom++;
+    }
+    return zoom;
+}
+
+//******************************************************************************
+/*!
+  Method to write the tiles of all zooms into the output directory. Method is blocking.
+  \return true if all tiles with data are written, false if the write is canceled
+*/
+bool TilePyramidWriter::write(const QString &outputPath, const ImageDataProvider *provider,
+                              ImageRenderer *renderer, const ImageRendererConfiguration *conf,
+                              ProgressReporter *reporter)
+{
+    _nbOfWrittenTiles = 0;
+    _nbOfSkippedTiles = 0;
+    if (isCanceled())
+    {
+        SD_TRACE("TilePyramidWriter::write : write is canceled");
+        return false;
+    }
+    if (!provider || !renderer || !conf || _tileSize < 1)
+    {
+        SD_TRACE("TilePyramidWriter::write : provider, renderer or configuration is null");
+        return false;
+    }
+
+    QDir dir(outputPath);
+    if (!dir.exists() && !dir.mkpath("."))
+    {
+        SD_TRACE("TilePyramidWriter::write : failed to create the output directory");
+        return false;
+    }
+
+    _outputPath = dir.absolutePath();
+    _provider = provider;
+    _renderer = renderer;
+    _conf = conf;
+    _reporter = reporter;
+    _maxZoom = getMaxZoom(provider->getPixelExtent().size());
+    _done.store(0);
+    _written.store(0);
+    _skipped.store(0);
+    _failed.store(0);
+    _progress.store(reporter ? reporter->startValue : 0);
+
+    QSize size = provider->getPixelExtent().size();
+    _nbOfTiles = 0;
+    for (int z=0; z<=_maxZoom; z++)
+    {
+        qint64 tileExtent = (qint64) _tileSize << (_maxZoom - z);
+        _nbOfTiles += qCeil(size.width() * 1.0 / tileExtent) * qCeil(size.height() * 1.0 / tileExtent);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(_nbOfThreads > 0 ? _nbOfThreads : QThread::idealThreadCount());
+    for (int z=0; z<=_maxZoom; z++)
+    {
+        qint64 tileExtent = (qint64) _tileSize << (_maxZoom - z);
+        int nx = qCeil(size.width() * 1.0 / tileExtent);
+        for (int x=0; x<nx; x++)
+        {
+            pool.start(new TilePyramidTask(this, z, x));
+        }
+    }
+    pool.waitForDone();
+
+    _nbOfWrittenTiles = _written.load();
+    _nbOfSkippedTiles = _skipped.load();
+    _provider = 0;
+    _renderer = 0;
+    _conf = 0;
+    _reporter = 0;
+    return _failed.load() == 0 && !isCanceled();
+}
+
+//******************************************************************************
+/*!
+  Method to write the tiles of the column x at zoom z. Method is called in the worker threads
+*/
+void TilePyramidWriter::writeColumn(int z, int x)
+{
+    QRect extent = _provider->getPixelExtent();
+    int scale = 1 << (_maxZoom - z);
+    int tileExtent = _tileSize * scale;
+    int ny = qCeil(extent.height() * 1.0 / tileExtent);
+    bool isJpeg = !_format.compare("jpg", Qt::CaseInsensitive) || !_format.compare("jpeg", Qt::CaseInsensitive);
+    QString columnPath = QString("%1/%2/%3").arg(_outputPath).arg(z).arg(x);
+
+    for (int y=0; y<ny; y++)
+    {
+        if (isCanceled())
+            return;
+
+        QRect srcRect(extent.x() + x*tileExtent, extent.y() + y*tileExtent, tileExtent, tileExtent);
+        // data at the zoom resolution, matrix is smaller than the tile at the image boundary
+        cv::Mat data = _provider->getImageData(srcRect, _tileSize, _tileSize);
+        if (data.empty())
+        {
+            _failed.fetchAndAddOrdered(1);
+            reportProgress();
+            continue;
+        }
+
+        cv::Mat valid = data.reshape(1) > ImageDataProvider::NoDataValue;
+        if (cv::countNonZero(valid) == 0)
+        {
+            _skipped.fetchAndAddOrdered(1);
+            reportProgress();
+            continue;
+        }
+
+        cv::Mat rgba = _renderer->render(data, _conf);
+        if (rgba.empty() || !QDir().mkpath(columnPath))
+        {
+            _failed.fetchAndAddOrdered(1);
+            reportProgress();
+            continue;
+        }
+
+        QImage tile(_tileSize, _tileSize, isJpeg ? QImage::Format_RGB32 : QImage::Format_ARGB32);
+        tile.fill(isJpeg ? Qt::black : Qt::transparent);
+        {
+            QPainter p(&tile);
+            p.drawImage(0, 0, Core::fromMat(rgba));
+        }
+
+        // TMS rows are numbered from the bottom of the 2^z rows of the zoom
+        int row = _tms ? (1 << z) - 1 - y : y;
+        QString path = QString("%1/%2.%3").arg(columnPath).arg(row).arg(isJpeg ? "jpg" : "png");
+        if (tile.save(path, isJpeg ? "JPG" : "PNG"))
+        {
+            _written.fetchAndAddOrdered(1);
+        }
+        else
+        {
+            SD_TRACE("TilePyramidWriter : failed to write " + path);
+            _failed.fetchAndAddOrdered(1);
+        }
+        reportProgress();
+    }
+}
+
+//******************************************************************************
+
+void TilePyramidWriter::reportProgress()
+{
+    int done = _done.fetchAndAddOrdered(1) + 1;
+    if (!_reporter || _nbOfTiles < 1)
+        return;
+    int value = _reporter->startValue + (_reporter->endValue - _reporter->startValue) * (qint64) done / _nbOfTiles;
+    int previous = _progress.load();
+    // progress is reported only when the value changes
+    if (value > previous && _progress.testAndSetOrdered(previous, value))
+    {
+        _reporter->progressValueChanged(value);
+    }
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,80 @@
+#ifndef TILEPYRAMIDWRITER_H
+#define TILEPYRAMIDWRITER_H
+
+// Qt
+#include <QString>
+#include <QSize>
+#include <QAtomicInt>
+
+// Project
+#include "LibExport.h"
+#include "Global.h"
+
+namespace Core
+{
+
+class ImageDataProvider;
+class ImageRenderer;
+struct ImageRendererConfiguration;
+class ProgressReporter;
+
+//******************************************************************************
+
+class TilePyramidTask;
+
+class GIV_DLL_EXPORT TilePyramidWriter
+{
+    friend class TilePyramidTask;
+
+    PROPERTY_ACCESSORS(int, tileSize, getTileSize, setTileSize)
+    //! Image format of tiles : "png" or "jpg". JPEG tiles have a black background
+    PROPERTY_ACCESSORS(QString, format, getFormat, setFormat)
+    //! Tile rows are numbered from the bottom (TMS) instead of the top (XYZ)
+    PROPERTY_ACCESSORS(bool, tms, isTms, setTms)
+    //! Number of threads, all cores are used if nbOfThreads <= 0
+    PROPERTY_ACCESSORS(int, nbOfThreads, getNbOfThreads, setNbOfThreads)
+
+    PROPERTY_GETACCESSOR(int, nbOfWrittenTiles, getNbOfWrittenTiles)
+    PROPERTY_GETACCESSOR(int, nbOfSkippedTiles, getNbOfSkippedTiles)
+
+public:
+    TilePyramidWriter();
+
+    bool write(const QString & outputPath, const ImageDataProvider * provider,
+               ImageRenderer * renderer, const ImageRendererConfiguration * conf,
+               ProgressReporter * reporter = 0);
+
+    int getMaxZoom(const QSize & imageSize) const;
+
+    //! Method to cancel the write from another thread, tiles that are not written yet are skipped
+    void cancel()
+    { _canceled.store(1); }
+    bool isCanceled() const
+    { return _canceled.load() != 0; }
+
+protected:
+    void writeColumn(int z, int x);
+    void reportProgress();
+
+    QString _outputPath;
+    const ImageDataProvider * _provider;
+    ImageRenderer * _renderer;
+    const ImageRendererConfiguration * _conf;
+    ProgressReporter * _reporter;
+    int _maxZoom;
+    int _nbOfTiles;
+
+    // Counters updated by the worker threads
+    QAtomicInt _done;
+    QAtomicInt _written;
+    QAtomicInt _skipped;
+    QAtomicInt _failed;
+    QAtomicInt _progress;
+    QAtomicInt _canceled;
+};
+
+//******************************************************************************
+
+}
+
+#endif // TILEPYRAMIDWRITER_H
@@ -0,0 +1,532 @@
+
+// Qt
+#include <QSet>
+#include <QThread>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "TiledVectorizer.h"
+#include "ImageDataProvider.h"
+#include "SparseMask.h"
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class TiledVectorizer
+  \brief vectorizes a mask as polygons tile by tile.
+
+  Mask is an image (non-zero pixels of a channel), a data provider (positive values of a band) or a sparse mask.
+  Tiles are read with a 1 pixel halo and processed in a thread pool. Polygons follow the pixel boundaries :
+  vertices are pixel corners, diagonal pixels are connected (8-connectivity as cv::findContours).
+  Parts of boundaries crossing tile borders are stitched when the neighbour tiles are processed
+  and polygons are emitted as soon as they are complete, thus only the open parts are kept in memory.
+
+  Outer boundaries are clockwise on the screen (positive area), inner boundaries are counter-clockwise.
+  Output polygons are closed (last point is the first point), coordinates are in pixels of the mask or
+  of the provider pixel extent.
+*/
+
+//******************************************************************************
+
+namespace
+{
+
+enum Direction
+{
+    East = 0,
+    South,
+    West,
+    North
+};
+
+const int DX[] = {1, 0, -1, 0};
+const int DY[] = {0, 1, 0, -1};
+
+//! Boundary edge between two pixels from its start vertex, foreground pixel is on the right
+struct Edge
+{
+    Edge(int ix=0, int iy=0, int idir=East) :
+        x(ix), y(iy), dir(idir)
+    {}
+    int x;
+    int y;
+    int dir;
+};
+
+inline quint64 edgeKey(int x, int y, int dir)
+{
+    return ((quint64)(quint32) y << 34) | ((quint64)(quint32) x << 2) | (quint64) dir;
+}
+
+//! Mask values of a tile with its halo
+struct TileMask
+{
+    cv::Mat data;
+    int x0;
+    int y0;
+
+    inline bool at(int x, int y) const
+    { return data.at<uchar>(y - y0, x - x0) != 0; }
+};
+
+//******************************************************************************
+/*!
+  Method to get the direction of the boundary leaving the vertex (vx, vy) entered with direction 'dir'.
+  Vertex (vx, vy) is the top-left corner of pixel (vx, vy)
+*/
+int nextDirection(const TileMask & mask, int vx, int vy, int dir)
+{
+    bool a = mask.at(vx - 1, vy - 1);
+    bool b = mask.at(vx, vy - 1);
+    bool c = mask.at(vx - 1, vy);
+    bool d = mask.at(vx, vy);
+
+    // Saddle points : boundary goes around both diagonal pixels
+    if (a && d && !b && !c)
+        return dir == South ? East : West;
+    if (b && c && !a && !d)
+        return dir == East ? North : South;
+
+    if (d && !b)
+        return East;
+    if (c && !d)
+        return South;
+    if (a && !c)
+        return West;
+    return North;
+}
+
+}
+
+//******************************************************************************
+
+class VectorizeTileTask : public QRunnable
+{
+public:
+    VectorizeTileTask(TiledVectorizer * vectorizer, const QRect & tile) :
+        _vectorizer(vectorizer),
+        _tile(tile)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        _vectorizer->processTile(_tile);
+    }
+
+protected:
+    TiledVectorizer * _vectorizer;
+    QRect _tile;
+};
+
+//******************************************************************************
+
+TiledVectorizer::TiledVectorizer(QObject *parent) :
+    QObject(parent),
+    _tileSize(512),
+    _maxNbOfThreads(QThread::idealThreadCount()),
+    _externalOnly(true),
+    _collectPolygons(true),
+    _channel(0),
+    _provider(0),
+    _sparseMask(0),
+    _nbOfTiles(0),
+    _nbOfProcessedTiles(0)
+{
+}
+
+//******************************************************************************
+/*!
+  Method to vectorize non-zero pixels of the channel of the mask.
+  Method is blocking.
+  \return polygons if collectPolygons is true, empty vector if canceled
+*/
+QVector<QPolygonF> TiledVectorizer::vectorize(const cv::Mat &mask, int channel)
+{
+    if (mask.empty() || channel < 0 || channel >= mask.channels())
+        return QVector<QPolygonF>();
+
+    _mask = mask;
+    _channel = channel;
+    _provider = 0;
+    _sparseMask = 0;
+    QVector<QPolygonF> output = run(QRect(0, 0, mask.cols, mask.rows), QList<QRect>());
+    _mask.release();
+    return output;
+}
+
+//******************************************************************************
+/*!
+  Method to vectorize positive values of the band of the provider.
+  Method is blocking and should be called from a worker thread.
+  \return polygons if collectPolygons is true, empty vector if canceled or data can not be read
+*/
+QVector<QPolygonF> TiledVectorizer::vectorize(const ImageDataProvider *provider, int band)
+{
+    if (!provider || band < 0 || band >= provider->getNbBands())
+        return QVector<QPolygonF>();
+
+    _mask.release();
+    _channel = band;
+    _provider = provider;
+    _sparseMask = 0;
+    QVector<QPolygonF> output = run(provider->getPixelExtent(), QList<QRect>());
+    _provider = 0;
+    return output;
+}
+
+//******************************************************************************
+/*!
+  Method to vectorize a sparse mask. Tiles are the tiles of the mask and only the allocated tiles
+  with their right and bottom neighbours (that own the edges on the tile borders) are processed.
+  Method is blocking.
+  \return polygons if collectPolygons is true, empty vector if canceled
+*/
+QVector<QPolygonF> TiledVectorizer::vectorize(const SparseMask &mask)
+{
+    if (mask.isEmpty())
+        return QVector<QPolygonF>();
+
+    QRect extent = mask.getExtent();
+    int size = mask.getTileSize();
+    QSet<quint64> keys;
+    QList<QRect> tiles;
+    foreach (QPoint t, mask.getTiles())
+    {
+        for (int i=0; i<4; i++)
+        {
+            int tx = t.x() + (i & 1), ty = t.y() + (i >> 1);
+            QRect r = QRect(tx*size, ty*size, size, size).intersected(QRect(0, 0, extent.width(), extent.height()));
+            quint64 key = ((quint64) ty << 32) | (quint64) tx;
+            if (!r.isEmpty() && !keys.contains(key))
+            {
+                keys.insert(key);
+                tiles << r;
+            }
+        }
+    }
+
+    _mask.release();
+    _channel = 0;
+    _provider = 0;
+    _sparseMask = &mask;
+    QVector<QPolygonF> output = run(extent, tiles);
+    _sparseMask = 0;
+    return output;
+}
+
+//******************************************************************************
+
+void TiledVectorizer::cancel()
+{
+    _canceled.storeRelease(1);
+}
+
+//******************************************************************************
+
+bool TiledVectorizer::isCanceled() const
+{
+    return _canceled.loadAcquire() != 0;
+}
+
+//******************************************************************************
+
+/*!
+  Method to process the tiles (in pixels of the extent), all tiles of the extent if the list is empty
+*/
+QVector<QPolygonF> TiledVectorizer::run(const QRect &extent, const QList<QRect> & tileList)
+{
+    _canceled.storeRelease(0);
+    _extent = extent;
+    _polygons.clear();
+
+    QList<QRect> tiles = tileList;
+    int tileSize = qMax(16, _tileSize);
+    for (int y=0; tileList.isEmpty() && y<extent.height(); y+=tileSize)
+    {
+        for (int x=0; x<extent.width(); x+=tileSize)
+        {
+            tiles << QRect(x, y, qMin(tileSize, extent.width() - x), qMin(tileSize, extent.height() - y));
+        }
+    }
+    _nbOfTiles = tiles.size();
+    _nbOfProcessedTiles = 0;
+
+    // Own pool : global pool can be used by the task calling this method
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, _maxNbOfThreads));
+    foreach (QRect tile, tiles)
+    {
+        pool.start(new VectorizeTileTask(this, tile));
+    }
+    pool.waitForDone();
+
+    // Open fragments remain only if canceled
+    qDeleteAll(_byStart);
+    _byStart.clear();
+    _byEnd.clear();
+
+    QVector<QPolygonF> output;
+    if (!isCanceled())
+        output = _polygons;
+    _polygons.clear();
+    return output;
+}
+
+//******************************************************************************
+/*!
+  Method to read mask values of the rectangle r (in pixels of the extent)
+  \return CV_8U matrix, non-zero for foreground pixels
+*/
+cv::Mat TiledVectorizer::readTile(const cv::Rect &r) const
+{
+    cv::Mat data, out;
+    if (_provider)
+    {
+        data = _provider->getImageData(QRect(_extent.x() + r.x, _extent.y() + r.y, r.width, r.height));
+        if (data.empty())
+            return out;
+    }
+    else if (_sparseMask)
+    {
+        data = _sparseMask->getData(QRect(_extent.x() + r.x, _extent.y() + r.y, r.width, r.height));
+    }
+    else
+    {
+        data = _mask(r);
+    }
+
+    if (data.channels() > 1)
+    {
+        cv::Mat c;
+        cv::extractChannel(data, c, _channel);
+        data = c;
+    }
+    // no-data value of providers is negative
+    cv::compare(data, 0, out, _provider ? cv::CMP_GT : cv::CMP_NE);
+    return out;
+}
+
+//******************************************************************************
+
+void TiledVectorizer::processTile(const QRect &tile)
+{
+    if (isCanceled())
+        return;
+
+    int w = _extent.width(), h = _extent.height();
+
+    // Tile owns the edges whose top-left vertex is in [vx0, vx1)x[vy0, vy1),
+    // last tiles own the edges on the right and bottom image borders
+    int vx0 = tile.x(), vy0 = tile.y();
+    int vx1 = tile.x() + tile.width() == w ? w + 1 : tile.x() + tile.width();
+    int vy1 = tile.y() + tile.height() == h ? h + 1 : tile.y() + tile.height();
+    int nx = vx1 - vx0, ny = vy1 - vy0;
+
+    TileMask mask;
+    mask.x0 = vx0 - 1;
+    mask.y0 = vy0 - 1;
+    mask.data = cv::Mat(ny + 2, nx + 2, CV_8U, cv::Scalar(0));
+    cv::Rect r = cv::Rect(mask.x0, mask.y0, nx + 2, ny + 2) & cv::Rect(0, 0, w, h);
+    cv::Mat data = readTile(r);
+    if (data.empty())
+    {
+        SD_TRACE("TiledVectorizer : failed to read mask data");
+        cancel();
+        return;
+    }
+    data.copyTo(mask.data(cv::Rect(r.x - mask.x0, r.y - mask.y0, r.width, r.height)));
+
+    // Boundary edges of the tile and their indices by position :
+    QVector<Edge> edges;
+    cv::Mat hIndices(ny, nx, CV_32S, cv::Scalar(-1));
+    cv::Mat vIndices(ny, nx, CV_32S, cv::Scalar(-1));
+    for (int y=vy0; y<vy1; y++)
+    {
+        for (int x=vx0; x<vx1; x++)
+        {
+            bool p = mask.at(x, y);
+            if (p != mask.at(x, y - 1))
+            {
+                hIndices.at<int>(y - vy0, x - vx0) = edges.size();
+                edges << (p ? Edge(x, y, East) : Edge(x + 1, y, West));
+            }
+            if (p != mask.at(x - 1, y))
+            {
+                vIndices.at<int>(y - vy0, x - vx0) = edges.size();
+                edges << (p ? Edge(x, y + 1, North) : Edge(x, y, South));
+            }
+        }
+    }
+
+    // Links between edges, edges leaving the tile keep the key of the next edge :
+    int nbEdges = edges.size();
+    QVector<int> next(nbEdges, -1);
+    QVector<bool> hasPrevious(nbEdges, false);
+    QVector<quint64> nextKeys(nbEdges, 0);
+    for (int i=0; i<nbEdges; i++)
+    {
+        const Edge & e = edges[i];
+        int ex = e.x + DX[e.dir], ey = e.y + DY[e.dir];
+        int dir = nextDirection(mask, ex, ey, e.dir);
+        int ox = dir == West ? ex - 1 : ex;
+        int oy = dir == North ? ey - 1 : ey;
+        if (ox >= vx0 && ox < vx1 && oy >= vy0 && oy < vy1)
+        {
+            const cv::Mat & indices = (dir == East || dir == West) ? hIndices : vIndices;
+            next[i] = indices.at<int>(oy - vy0, ox - vx0);
+            hasPrevious[next[i]] = true;
+        }
+        else
+        {
+            nextKeys[i] = edgeKey(ex, ey, dir);
+        }
+    }
+
+    // Chains entering the tile are fragments, others are closed boundaries :
+    QVector<bool> visited(nbEdges, false);
+    QList<Fragment*> fragments;
+    QVector<QPolygonF> closed;
+    for (int i=0; i<nbEdges; i++)
+    {
+        if (hasPrevious[i])
+            continue;
+        Fragment * f = new Fragment;
+        f->startKey = edgeKey(edges[i].x, edges[i].y, edges[i].dir);
+        int k = i, last = i;
+        for (; k >= 0; k = next[k])
+        {
+            visited[k] = true;
+            if (k == i || edges[k].dir != edges[last].dir)
+                f->points << QPoint(edges[k].x, edges[k].y);
+            last = k;
+        }
+        f->points << QPoint(edges[last].x + DX[edges[last].dir], edges[last].y + DY[edges[last].dir]);
+        f->endKey = nextKeys[last];
+        fragments << f;
+    }
+    for (int i=0; i<nbEdges; i++)
+    {
+        if (visited[i])
+            continue;
+        QPolygon ring;
+        int k = i, last = i;
+        do
+        {
+            visited[k] = true;
+            if (k == i || edges[k].dir != edges[last].dir)
+                ring << QPoint(edges[k].x, edges[k].y);
+            last = k;
+            k = next[k];
+        }
+        while (k != i);
+        ring << ring.first();
+        appendRing(ring, closed);
+    }
+    if (isCanceled())
+    {
+        qDeleteAll(fragments);
+        return;
+    }
+
+    int progress;
+    {
+        QMutexLocker locker(&_mutex);
+        foreach (Fragment * f, fragments)
+        {
+            addFragment(f, closed);
+        }
+        if (_collectPolygons)
+            _polygons += closed;
+        _nbOfProcessedTiles++;
+        progress = (100 * _nbOfProcessedTiles) / _nbOfTiles;
+    }
+    if (!closed.isEmpty())
+        emit polygonsReady(closed);
+    emit progressValueChanged(progress);
+}
+
+//******************************************************************************
+/*!
+  Method to stitch the fragment with open fragments of processed tiles. Method takes the ownership of
+  the fragment and should be called with the mutex locked.
+*/
+void TiledVectorizer::addFragment(Fragment *f, QVector<QPolygonF> &closed)
+{
+    Fragment * g = _byStart.value(f->endKey, 0);
+    if (g)
+    {
+        _byStart.remove(g->startKey);
+        _byEnd.remove(g->endKey);
+        f->points += g->points.mid(1);
+        f->endKey = g->endKey;
+        delete g;
+    }
+    if (f->endKey != f->startKey)
+    {
+        Fragment * h = _byEnd.value(f->startKey, 0);
+        if (h)
+        {
+            _byStart.remove(h->startKey);
+            _byEnd.remove(h->endKey);
+            h->points += f->points.mid(1);
+            h->endKey = f->endKey;
+            delete f;
+            f = h;
+        }
+    }
+
+    if (f->endKey == f->startKey)
+    {
+        appendRing(f->points, closed);
+        delete f;
+        return;
+    }
+    _byStart.insert(f->startKey, f);
+    _byEnd.insert(f->endKey, f);
+}
+
+//******************************************************************************
+/*!
+  Method to append the closed ring to output without collinear vertices
+  \return false if the ring is skipped
+*/
+bool TiledVectorizer::appendRing(const QPolygon &ring, QVector<QPolygonF> &output) const
+{
+    int n = ring.size() - 1;
+    if (n < 4)
+        return false;
+
+    qint64 area = 0;
+    for (int i=0; i<n; i++)
+    {
+        area += (qint64) ring[i].x() * ring[i + 1].y() - (qint64) ring[i + 1].x() * ring[i].y();
+    }
+    if (_externalOnly && area < 0)
+        return false;
+
+    QPolygonF polygon;
+    for (int i=0; i<n; i++)
+    {
+        const QPoint & p = ring[(i + n - 1) % n];
+        const QPoint & c = ring[i];
+        const QPoint & q = ring[i + 1];
+        if ((c.x() - p.x()) * (q.y() - c.y()) != (c.y() - p.y()) * (q.x() - c.x()))
+            polygon << QPointF(c + _extent.topLeft());
+    }
+    polygon << polygon.first();
+    output << polygon;
+    return true;
+}
+
+//******************************************************************************
+
+}
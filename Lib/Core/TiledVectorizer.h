@@ -0,0 +1,95 @@
+#ifndef TILEDVECTORIZER_H
+#define TILEDVECTORIZER_H
+
+// Qt
+#include <QObject>
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QPolygon>
+#include <QPolygonF>
+#include <QVector>
+#include <QRect>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "LibExport.h"
+#include "Global.h"
+
+namespace Core
+{
+
+class ImageDataProvider;
+class SparseMask;
+class VectorizeTileTask;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT TiledVectorizer : public QObject
+{
+    Q_OBJECT
+    friend class VectorizeTileTask;
+
+    PROPERTY_ACCESSORS(int, tileSize, getTileSize, setTileSize)
+    PROPERTY_ACCESSORS(int, maxNbOfThreads, getMaxNbOfThreads, setMaxNbOfThreads)
+    //! Inner contours (holes) are not vectorized
+    PROPERTY_ACCESSORS(bool, externalOnly, getExternalOnly, setExternalOnly)
+    //! Polygons are returned by vectorize(), otherwise they are only emitted with polygonsReady()
+    PROPERTY_ACCESSORS(bool, collectPolygons, getCollectPolygons, setCollectPolygons)
+
+public:
+    explicit TiledVectorizer(QObject * parent = 0);
+
+    QVector<QPolygonF> vectorize(const cv::Mat & mask, int channel = 0);
+    QVector<QPolygonF> vectorize(const ImageDataProvider * provider, int band = 0);
+    QVector<QPolygonF> vectorize(const SparseMask & mask);
+
+    void cancel();
+    bool isCanceled() const;
+
+signals:
+    //! Signal is emitted from the worker threads when polygons are complete
+    void polygonsReady(const QVector<QPolygonF> & polygons);
+    void progressValueChanged(int);
+
+protected:
+
+    //! Boundary part crossing tile borders
+    struct Fragment
+    {
+        quint64 startKey;
+        quint64 endKey;
+        QPolygon points;
+    };
+
+    QVector<QPolygonF> run(const QRect & extent, const QList<QRect> & tiles);
+    cv::Mat readTile(const cv::Rect & r) const;
+    void processTile(const QRect & tile);
+    void addFragment(Fragment * fragment, QVector<QPolygonF> & closed);
+    bool appendRing(const QPolygon & ring, QVector<QPolygonF> & output) const;
+
+    // Source is a mask, a provider or a sparse mask
+    cv::Mat _mask;
+    int _channel;
+    const ImageDataProvider * _provider;
+    const SparseMask * _sparseMask;
+    QRect _extent;
+
+    QAtomicInt _canceled;
+    QMutex _mutex;
+    //! Open fragments by their first and by their next edge
+    QHash<quint64, Fragment*> _byStart;
+    QHash<quint64, Fragment*> _byEnd;
+    QVector<QPolygonF> _polygons;
+    int _nbOfTiles;
+    int _nbOfProcessedTiles;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // TILEDVECTORIZER_H
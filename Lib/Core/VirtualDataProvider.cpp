@@ -0,0 +1,656 @@
+
+// STD
+#include <cmath>
+#include <cfloat>
+
+// Qt
+#include <QRegExp>
+#include <QStringList>
+
+// OpenCV
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "VirtualDataProvider.h"
+#include "LayerUtils.h"
+
+namespace Core
+{
+
+//******************************************************************************
+/*!
+  \class VirtualDataProvider
+  \brief provides image data computed on demand from one or more co-registered input providers
+  with a band-math expression (e.g. NDVI, band ratios, differences between two layers).
+
+  Nothing is precomputed : getImageData() requests the same extent and output size from
+  the inputs (thus GDAL inputs read from the matching overview) and evaluates the compiled
+  expression with full-matrix OpenCV operations on the returned tile.
+
+  Expression syntax :
+  - band references : b<k> is the band k of the first input, i<n>b<k> is the band k of the input n (1-based)
+  - numbers, operators +, -, *, /, ^ (power), unary minus and parentheses
+  - functions : abs(x), sqrt(x), log(x), exp(x), min(x,y), max(x,y)
+  - several expressions separated by ';' produce a multi-band output
+
+  For example, NDVI of a 4-band image : (b4 - b3)/(b4 + b3), difference of two layers : i1b1 - i2b1
+
+  Output pixel is set to NoDataValue if any referenced input band is NoDataValue or if the
+  result is undefined (division by zero, log of a negative value, etc).
+
+  Inputs are not owned by the provider and should be of the same size.
+*/
+
+//******************************************************************************
+
+namespace
+{
+
+struct CompileItem
+{
+    enum Kind {Operator, Function, LeftParen};
+    Kind kind;
+    BandMathOp::Type type;
+    int precedence;
+    bool rightAssoc;
+
+    CompileItem(Kind k=LeftParen, BandMathOp::Type t=BandMathOp::Constant, int p=0, bool r=false) :
+        kind(k),
+        type(t),
+        precedence(p),
+        rightAssoc(r)
+    {}
+};
+
+struct Operand
+{
+    cv::Mat m;
+    double v;
+    bool isScalar;
+
+    Operand(double value=0.0) :
+        v(value),
+        isScalar(true)
+    {}
+    Operand(const cv::Mat & mat) :
+        m(mat),
+        v(0.0),
+        isScalar(false)
+    {}
+};
+
+inline int arity(BandMathOp::Type type)
+{
+    switch (type)
+    {
+    case BandMathOp::Constant:
+    case BandMathOp::Band:
+        return 0;
+    case BandMathOp::Neg:
+    case BandMathOp::Abs:
+    case BandMathOp::Sqrt:
+    case BandMathOp::Log:
+    case BandMathOp::Exp:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+inline void restrictMask(cv::Mat & mask, const cv::Mat & condition)
+{
+    cv::bitwise_and(mask, condition, mask);
+}
+
+}
+
+//******************************************************************************
+
+VirtualDataProvider::VirtualDataProvider(QObject *parent) :
+    ImageDataProvider(parent)
+{
+}
+
+//******************************************************************************
+
+VirtualDataProvider* VirtualDataProvider::createDataProvider(const QString &name, const QList<const ImageDataProvider *> &inputs, const QString &expression)
+{
+    VirtualDataProvider * dst = new VirtualDataProvider();
+    dst->setImageName(name);
+    if (!dst->setup(inputs, expression))
+    {
+        SD_TRACE("VirtualDataProvider::createDataProvider : " + dst->getErrorMessage());
+        delete dst;
+        return 0;
+    }
+    return dst;
+}
+
+//******************************************************************************
+/*!
+ * \brief VirtualDataProvider::setup method to setup the provider on inputs and expression.
+ * Data stats (min/max values, histograms) are computed on a reduced resolution image
+ * \return true if expression is compiled and inputs are compatible
+ */
+bool VirtualDataProvider::setup(const QList<const ImageDataProvider *> &inputs, const QString &expression)
+{
+    _errorMessage.clear();
+    if (inputs.isEmpty())
+    {
+        _errorMessage = tr("No input data providers");
+        return false;
+    }
+
+    for (int i=0; i<inputs.size(); i++)
+    {
+        if (!inputs[i] || !inputs[i]->isValid())
+        {
+            _errorMessage = tr("Input %1 is not valid").arg(i+1);
+            return false;
+        }
+        if (inputs[i]->getPixelExtent() != inputs[0]->getPixelExtent())
+        {
+            _errorMessage = tr("Input %1 has a size different from the first input").arg(i+1);
+            return false;
+        }
+    }
+
+    QVector<BandMathProgram> programs;
+    if (!compile(expression, inputs, programs, &_errorMessage))
+    {
+        return false;
+    }
+
+    foreach (const ImageDataProvider * input, _inputs)
+    {
+        disconnect(input, SIGNAL(destroyed()), this, SLOT(onInputDestroyed()));
+    }
+
+    _inputs = inputs;
+    _programs = programs;
+    _expression = expression;
+
+    foreach (const ImageDataProvider * input, _inputs)
+    {
+        connect(input, SIGNAL(destroyed()), this, SLOT(onInputDestroyed()));
+    }
+
+    const ImageDataProvider * first = _inputs.first();
+    _inputWidth     = first->getWidth();
+    _inputHeight    = first->getHeight();
+    _inputDepth     = sizeof(float);
+    _inputNbBands   = _programs.size();
+    _inputIsComplex = false;
+
+    _nbBands   = _programs.size();
+    _width     = first->getWidth();
+    _height    = first->getHeight();
+    _depth     = sizeof(float);
+    _isComplex = false;
+    _pixelExtent = first->getPixelExtent();
+
+    _bandNames = expression.split(';', QString::SkipEmptyParts);
+    for (int i=0; i<_bandNames.size(); i++)
+    {
+        _bandNames[i] = _bandNames[i].trimmed();
+    }
+
+    // compute data stats on a reduced resolution image :
+    cv::Mat data = getImageData(QRect(), 1024);
+    if (data.empty())
+    {
+        _errorMessage = tr("Failed to evaluate expression on input data");
+        return false;
+    }
+    cv::Mat mask = ImageDataProvider::computeMask(data);
+    if (!computeNormalizedHistogram(data, mask,
+                                    _minValues,
+                                    _maxValues,
+                                    _bandHistograms,
+                                    1000))
+    {
+        _errorMessage = tr("Failed to compute image stats");
+        return false;
+    }
+    return true;
+}
+
+//******************************************************************************
+
+void VirtualDataProvider::onInputDestroyed()
+{
+    SD_TRACE("VirtualDataProvider : input data provider is destroyed -> provider is invalidated");
+    _inputs.clear();
+    _programs.clear();
+}
+
+//******************************************************************************
+/*!
+ * \brief VirtualDataProvider::compile method to transform expression into a list of programs in postfix notation (one per output band)
+ * \return true if successful, otherwise errorMessage is set
+ */
+bool VirtualDataProvider::compile(const QString &expression, const QList<const ImageDataProvider *> &inputs,
+                                  QVector<BandMathProgram> &programs, QString *errorMessage)
+{
+    programs.clear();
+    QStringList expressions = expression.split(';', QString::SkipEmptyParts);
+    QRegExp bandRef("^(?:i(\\d+))?b(\\d+)$", Qt::CaseInsensitive);
+    QRegExp token("\\s*(\\d+\\.?\\d*(?:[eE][-+]?\\d+)?|\\.\\d+(?:[eE][-+]?\\d+)?|[A-Za-z_][A-Za-z0-9_]*|[-+*/^(),])");
+
+    foreach (QString expr, expressions)
+    {
+        if (expr.trimmed().isEmpty())
+            continue;
+
+        BandMathProgram program;
+        QVector<CompileItem> stack;
+        // true when the next token should be an operand (start, after operator, '(' or ',')
+        bool expectOperand = true;
+        int pos = 0;
+        expr = expr.trimmed();
+        while (pos < expr.size())
+        {
+            if (token.indexIn(expr, pos) != pos)
+            {
+                if (errorMessage) *errorMessage = QObject::tr("Unexpected symbol at position %1 in '%2'").arg(pos).arg(expr);
+                return false;
+            }
+            pos += token.matchedLength();
+            QString t = token.cap(1);
+            QChar c = t[0];
+
+            if (c.isDigit() || c == '.')
+            {
+                program << BandMathOp(BandMathOp::Constant, t.toDouble());
+                expectOperand = false;
+            }
+            else if (c.isLetter() || c == '_')
+            {
+                QString name = t.toLower();
+                if (bandRef.indexIn(name) == 0)
+                {
+                    int input = bandRef.cap(1).isEmpty() ? 0 : bandRef.cap(1).toInt() - 1;
+                    int band = bandRef.cap(2).toInt() - 1;
+                    if (input < 0 || input >= inputs.size() ||
+                            band < 0 || band >= inputs[input]->getNbBands())
+                    {
+                        if (errorMessage) *errorMessage = QObject::tr("Band reference '%1' is out of range").arg(t);
+                        return false;
+                    }
+                    program << BandMathOp(BandMathOp::Band, 0.0, input, band);
+                    expectOperand = false;
+                }
+                else
+                {
+                    BandMathOp::Type type;
+                    if (name == "abs") type = BandMathOp::Abs;
+                    else if (name == "sqrt") type = BandMathOp::Sqrt;
+                    else if (name == "log") type = BandMathOp::Log;
+                    else if (name == "exp") type = BandMathOp::Exp;
+                    else if (name == "min") type = BandMathOp::Min;
+                    else if (name == "max") type = BandMathOp::Max;
+                    else
+                    {
+                        if (errorMessage) *errorMessage = QObject::tr("Unknown identifier '%1'").arg(t);
+                        return false;
+                    }
+                    stack << CompileItem(CompileItem::Function, type);
+                    expectOperand = true;
+                }
+            }
+            else if (c == '(')
+            {
+                stack << CompileItem(CompileItem::LeftParen);
+                expectOperand = true;
+            }
+            else if (c == ')' || c == ',')
+            {
+                while (!stack.isEmpty() && stack.last().kind != CompileItem::LeftParen)
+                {
+                    program << BandMathOp(stack.last().type);
+                    stack.pop_back();
+                }
+                if (stack.isEmpty())
+                {
+                    if (errorMessage) *errorMessage = QObject::tr("Mismatched parentheses in '%1'").arg(expr);
+                    return false;
+                }
+                if (c == ')')
+                {
+                    stack.pop_back();
+                    if (!stack.isEmpty() && stack.last().kind == CompileItem::Function)
+                    {
+                        program << BandMathOp(stack.last().type);
+                        stack.pop_back();
+                    }
+                    expectOperand = false;
+                }
+                else
+                {
+                    expectOperand = true;
+                }
+            }
+            else
+            {
+                CompileItem op(CompileItem::Operator);
+                if (expectOperand)
+                {
+                    if (c == '+')
+                        continue;
+                    if (c != '-')
+                    {
+                        if (errorMessage) *errorMessage = QObject::tr("Operand is missing before '%1' in '%2'").arg(t).arg(expr);
+                        return false;
+                    }
+                    op.type = BandMathOp::Neg; op.precedence = 3; op.rightAssoc = true;
+                }
+                else if (c == '+') { op.type = BandMathOp::Add; op.precedence = 1; }
+                else if (c == '-') { op.type = BandMathOp::Sub; op.precedence = 1; }
+                else if (c == '*') { op.type = BandMathOp::Mul; op.precedence = 2; }
+                else if (c == '/') { op.type = BandMathOp::Div; op.precedence = 2; }
+                else { op.type = BandMathOp::Pow; op.precedence = 4; op.rightAssoc = true; }
+
+                // Unary operator has no left operand to pop
+                if (op.type != BandMathOp::Neg)
+                {
+                    while (!stack.isEmpty() && stack.last().kind == CompileItem::Operator &&
+                           (stack.last().precedence > op.precedence ||
+                            (stack.last().precedence == op.precedence && !op.rightAssoc)))
+                    {
+                        program << BandMathOp(stack.last().type);
+                        stack.pop_back();
+                    }
+                }
+                stack << op;
+                expectOperand = true;
+            }
+        }
+
+        while (!stack.isEmpty())
+        {
+            if (stack.last().kind == CompileItem::LeftParen)
+            {
+                if (errorMessage) *errorMessage = QObject::tr("Mismatched parentheses in '%1'").arg(expr);
+                return false;
+            }
+            program << BandMathOp(stack.last().type);
+            stack.pop_back();
+        }
+
+        // Check operand count :
+        int depth = 0;
+        foreach (const BandMathOp & op, program)
+        {
+            int n = arity(op.type);
+            if (depth < n)
+            {
+                depth = -1;
+                break;
+            }
+            depth += 1 - n;
+        }
+        if (depth != 1)
+        {
+            if (errorMessage) *errorMessage = QObject::tr("Malformed expression '%1'").arg(expr);
+            return false;
+        }
+        programs << program;
+    }
+
+    if (programs.isEmpty())
+    {
+        if (errorMessage) *errorMessage = QObject::tr("Expression is empty");
+        return false;
+    }
+    return true;
+}
+
+//******************************************************************************
+
+cv::Mat VirtualDataProvider::getImageData(const QRect &srcPixelExtent, int dstPixelWidth, int dstPixelHeight) const
+{
+    cv::Mat out;
+    if (!isValid())
+        return out;
+
+    // Fetch only referenced bands of referenced inputs :
+    QVector<QVector<cv::Mat> > planes(_inputs.size());
+    cv::Size size;
+    for (int k=0; k<_programs.size(); k++)
+    {
+        foreach (const BandMathOp & op, _programs[k])
+        {
+            if (op.type != BandMathOp::Band)
+                continue;
+            QVector<cv::Mat> & inputPlanes = planes[op.input];
+            if (inputPlanes.isEmpty())
+            {
+                cv::Mat data = _inputs[op.input]->getImageData(srcPixelExtent, dstPixelWidth, dstPixelHeight);
+                if (data.empty())
+                    return out;
+                if (size.area() == 0)
+                {
+                    size = data.size();
+                }
+                else if (data.size() != size)
+                {
+                    SD_TRACE("VirtualDataProvider::getImageData : inputs returned data of different sizes");
+                    return out;
+                }
+                inputPlanes.resize(data.channels());
+                cv::split(data, &inputPlanes[0]);
+            }
+        }
+    }
+
+    // Pixel is valid if all referenced bands are valid :
+    cv::Mat mask(size, CV_8U, cv::Scalar::all(255));
+    for (int i=0; i<planes.size(); i++)
+    {
+        QVector<bool> used(planes[i].size(), false);
+        for (int k=0; k<_programs.size(); k++)
+        {
+            foreach (const BandMathOp & op, _programs[k])
+            {
+                if (op.type == BandMathOp::Band && op.input == i)
+                    used[op.band] = true;
+            }
+        }
+        for (int j=0; j<used.size(); j++)
+        {
+            if (used[j])
+                restrictMask(mask, planes[i][j] != NoDataValue);
+        }
+    }
+
+    std::vector<cv::Mat> oChannels(_programs.size());
+    for (int k=0; k<_programs.size(); k++)
+    {
+        cv::Mat bandMask = mask.clone();
+        oChannels[k] = evaluate(_programs[k], planes, bandMask);
+        // Exclude infinite values and NaNs
+        cv::Mat finite;
+        cv::compare(cv::abs(oChannels[k]), FLT_MAX, finite, cv::CMP_LE);
+        restrictMask(bandMask, finite);
+        oChannels[k].setTo(NoDataValue, bandMask == 0);
+    }
+
+    cv::merge(oChannels, out);
+    return out;
+}
+
+//******************************************************************************
+/*!
+ * \brief VirtualDataProvider::evaluate method to evaluate a compiled program on the data planes.
+ * Pixels with undefined results are removed from the mask
+ * \return single band CV_32F matrix
+ */
+cv::Mat VirtualDataProvider::evaluate(const BandMathProgram &program, const QVector<QVector<cv::Mat> > &planes, cv::Mat &mask) const
+{
+    QVector<Operand> stack;
+    foreach (const BandMathOp & op, program)
+    {
+        if (op.type == BandMathOp::Constant)
+        {
+            stack << Operand(op.value);
+            continue;
+        }
+        else if (op.type == BandMathOp::Band)
+        {
+            stack << Operand(planes[op.input][op.band]);
+            continue;
+        }
+
+        Operand b = stack.last();
+        stack.pop_back();
+        Operand res;
+
+        if (arity(op.type) == 1)
+        {
+            if (b.isScalar)
+            {
+                switch (op.type)
+                {
+                case BandMathOp::Neg: res.v = -b.v; break;
+                case BandMathOp::Abs: res.v = std::fabs(b.v); break;
+                case BandMathOp::Sqrt: res.v = std::sqrt(b.v); break;
+                case BandMathOp::Log: res.v = std::log(b.v); break;
+                default: res.v = std::exp(b.v); break;
+                }
+            }
+            else
+            {
+                res.isScalar = false;
+                switch (op.type)
+                {
+                case BandMathOp::Neg:
+                    cv::subtract(cv::Scalar::all(0), b.m, res.m);
+                    break;
+                case BandMathOp::Abs:
+                    res.m = cv::abs(b.m);
+                    break;
+                case BandMathOp::Sqrt:
+                    restrictMask(mask, b.m >= 0);
+                    cv::sqrt(cv::abs(b.m), res.m);
+                    break;
+                case BandMathOp::Log:
+                    restrictMask(mask, b.m > 0);
+                    cv::log(cv::abs(b.m), res.m);
+                    break;
+                default:
+                    cv::exp(b.m, res.m);
+                    break;
+                }
+            }
+            stack << res;
+            continue;
+        }
+
+        Operand a = stack.last();
+        stack.pop_back();
+
+        if (a.isScalar && b.isScalar)
+        {
+            switch (op.type)
+            {
+            case BandMathOp::Add: res.v = a.v + b.v; break;
+            case BandMathOp::Sub: res.v = a.v - b.v; break;
+            case BandMathOp::Mul: res.v = a.v * b.v; break;
+            case BandMathOp::Div: res.v = a.v / b.v; break;
+            case BandMathOp::Pow: res.v = std::pow(a.v, b.v); break;
+            case BandMathOp::Min: res.v = qMin(a.v, b.v); break;
+            default: res.v = qMax(a.v, b.v); break;
+            }
+            stack << res;
+            continue;
+        }
+
+        res.isScalar = false;
+        switch (op.type)
+        {
+        case BandMathOp::Add:
+            if (a.isScalar) cv::add(b.m, cv::Scalar::all(a.v), res.m);
+            else if (b.isScalar) cv::add(a.m, cv::Scalar::all(b.v), res.m);
+            else cv::add(a.m, b.m, res.m);
+            break;
+        case BandMathOp::Sub:
+            if (a.isScalar) cv::subtract(cv::Scalar::all(a.v), b.m, res.m);
+            else if (b.isScalar) cv::subtract(a.m, cv::Scalar::all(b.v), res.m);
+            else cv::subtract(a.m, b.m, res.m);
+            break;
+        case BandMathOp::Mul:
+            if (a.isScalar) cv::multiply(b.m, cv::Scalar::all(a.v), res.m);
+            else if (b.isScalar) cv::multiply(a.m, cv::Scalar::all(b.v), res.m);
+            else cv::multiply(a.m, b.m, res.m);
+            break;
+        case BandMathOp::Div:
+            if (b.isScalar)
+            {
+                if (b.v == 0.0)
+                    mask.setTo(0);
+                cv::multiply(a.m, cv::Scalar::all(b.v != 0.0 ? 1.0/b.v : 0.0), res.m);
+            }
+            else
+            {
+                restrictMask(mask, b.m != 0);
+                if (a.isScalar) cv::divide(a.v, b.m, res.m);
+                else cv::divide(a.m, b.m, res.m);
+            }
+            break;
+        case BandMathOp::Pow:
+            if (b.isScalar)
+            {
+                // cv::pow uses absolute values for non-integer powers
+                if (b.v != std::floor(b.v))
+                    restrictMask(mask, a.m >= 0);
+                cv::pow(a.m, b.v, res.m);
+            }
+            else
+            {
+                // a^b = exp(b*log(a)), defined for a > 0
+                cv::Mat logA;
+                if (a.isScalar)
+                {
+                    if (a.v <= 0.0)
+                        mask.setTo(0);
+                    cv::multiply(b.m, cv::Scalar::all(a.v > 0.0 ? std::log(a.v) : 0.0), logA);
+                }
+                else
+                {
+                    restrictMask(mask, a.m > 0);
+                    cv::log(cv::abs(a.m), logA);
+                    cv::multiply(logA, b.m, logA);
+                }
+                cv::exp(logA, res.m);
+            }
+            break;
+        case BandMathOp::Min:
+            if (a.isScalar) res.m = cv::min(b.m, a.v);
+            else if (b.isScalar) res.m = cv::min(a.m, b.v);
+            else res.m = cv::min(a.m, b.m);
+            break;
+        default:
+            if (a.isScalar) res.m = cv::max(b.m, a.v);
+            else if (b.isScalar) res.m = cv::max(a.m, b.v);
+            else res.m = cv::max(a.m, b.m);
+            break;
+        }
+        stack << res;
+    }
+
+    Operand & r = stack.last();
+    if (r.isScalar)
+    {
+        return cv::Mat(mask.size(), CV_32F, cv::Scalar::all(r.v));
+    }
+    // Band operands are shared with input planes -> copy before modification
+    if (program.size() == 1)
+    {
+        return r.m.clone();
+    }
+    return r.m;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,89 @@
+#ifndef VIRTUALDATAPROVIDER_H
+#define VIRTUALDATAPROVIDER_H
+
+
+// Qt
+#include <QList>
+#include <QVector>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "Global.h"
+#include "LibExport.h"
+#include "ImageDataProvider.h"
+
+namespace Core
+{
+
+//******************************************************************************
+
+struct BandMathOp
+{
+    enum Type {Constant, Band, Add, Sub, Mul, Div, Pow, Neg, Abs, Sqrt, Log, Exp, Min, Max};
+
+    Type type;
+    int input;
+    int band;
+    double value;
+
+    BandMathOp(Type t=Constant, double v=0.0, int i=-1, int b=-1) :
+        type(t),
+        input(i),
+        band(b),
+        value(v)
+    {}
+};
+
+typedef QVector<BandMathOp> BandMathProgram;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT VirtualDataProvider : public ImageDataProvider
+{
+    Q_OBJECT
+    PROPERTY_GETACCESSOR(QString, expression, getExpression)
+    PROPERTY_GETACCESSOR(QString, errorMessage, getErrorMessage)
+
+public:
+    explicit VirtualDataProvider(QObject *parent = 0);
+
+    virtual cv::Mat getImageData(const QRect & srcPixelExtent=QRect(), int dstPixelWidth=0, int dstPixelHeight=0) const;
+    bool setup(const QList<const ImageDataProvider*> & inputs, const QString & expression);
+
+    static VirtualDataProvider* createDataProvider(const QString & name, const QList<const ImageDataProvider*> & inputs, const QString & expression);
+
+    static bool compile(const QString & expression, const QList<const ImageDataProvider*> & inputs,
+                        QVector<BandMathProgram> & programs, QString * errorMessage=0);
+
+    virtual QString fetchProjectionRef() const
+    { return !_inputs.isEmpty() ? _inputs.first()->fetchProjectionRef() : ImageDataProvider::fetchProjectionRef(); }
+    virtual QPolygonF fetchGeoExtent(const QVector<QPoint> & points=QVector<QPoint>()) const
+    { return !_inputs.isEmpty() ? _inputs.first()->fetchGeoExtent(points) : ImageDataProvider::fetchGeoExtent(points); }
+    virtual QVector<double> fetchGeoTransform() const
+    { return !_inputs.isEmpty() ? _inputs.first()->fetchGeoTransform() : ImageDataProvider::fetchGeoTransform(); }
+
+    virtual bool isValid() const
+    { return !_inputs.isEmpty() && !_programs.isEmpty(); }
+
+    const QList<const ImageDataProvider*> & getInputs() const
+    { return _inputs; }
+
+protected slots:
+    void onInputDestroyed();
+
+protected:
+
+    cv::Mat evaluate(const BandMathProgram & program, const QVector<QVector<cv::Mat> > & planes, cv::Mat & mask) const;
+
+    QList<const ImageDataProvider*> _inputs;
+    QVector<BandMathProgram> _programs;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // VIRTUALDATAPROVIDER_H
@@ -1,7 +1,9 @@
 
+// Qt
+#include <QMetaProperty>
+
 // Project
 #include "AbstractFilter.h"
-#include "Core/LayerUtils.h"
 
 namespace Filters
 {
@@ -11,8 +13,80 @@ namespace Filters
   \class AbstractFilter
   \brief Abstract class represent application filters
 
+  Filter declares the neighbourhood radius (halo) needed to compute an output pixel with getHaloSize().
+  It allows to apply the filter on overlapping tiles of a large image (see TiledFilterEngine).
+  Default value -1 means that the filter needs the whole image (e.g. global statistics).
+
+  No-data values are handled with a compact 8-bit mask (non-zero where a channel value equals noDataValue)
+  computed once in apply() and passed to filterWithMask(). Default implementation writes zeros instead of
+  no-data values (only if there are any), calls filter() and writes noDataValue back into the result.
+  Filters that do not need zeros in the input (e.g. pixel-wise operations) can reimplement filterWithMask()
+  to work directly on the source data.
+
+  Filter run is controlled with a FilterMonitor passed to filter() : long filters should report progress
+  between processing stages with FilterMonitor::setProgress() and stop when it returns false (run is canceled).
+  Neighbourhood filters can implement filterStrip() and call filterByStrips() : data is filtered by strips
+  of rows with the halo and the run is stopped between strips.
+  Errors are reported with FilterMonitor::setError() : the same filter can run on several tiles in parallel,
+  thus the filter keeps the error message (see getErrorMessage()) only when it is applied without monitor.
+
+  Filter parameters are edited in the GUI thread, a run in other threads should use a copy of the filter
+  made with clone(). Default implementation needs a Q_INVOKABLE constructor with the parent argument.
+
   */
 
+//******************************************************************************
+/*!
+  \class FilterMonitor
+  \brief Cancellation token and progress sink of a filter run
+
+  Monitor can have a parent monitor : cancellation of the parent cancels the child and the progress
+  of the child in [0, 100] is reported to the parent in the range [progressMin, progressMax].
+  Child monitor with an empty progress range only forwards the cancellation (e.g. a monitor of a tile).
+  Reimplement progressChanged() to receive progress values.
+  Error message of the run is kept by the monitor and is not forwarded to the parent : a monitor is used
+  by a single thread, the owner of the parent collects the errors of its children.
+  */
+
+//******************************************************************************
+
+FilterMonitor::FilterMonitor(const FilterMonitor *parent, int progressMin, int progressMax) :
+    _parent(parent),
+    _progressMin(progressMin),
+    _progressMax(progressMax),
+    _canceled(0)
+{
+}
+
+//******************************************************************************
+/*!
+  Method to report the progress value in [0, 100]
+  \return false if the run is canceled
+*/
+bool FilterMonitor::setProgress(int value) const
+{
+    if (isCanceled())
+        return false;
+    if (_progressMax > _progressMin)
+    {
+        int v = _progressMin + ((_progressMax - _progressMin) * qBound(0, value, 100)) / 100;
+        progressChanged(v);
+        if (_parent)
+            _parent->setProgress(v);
+    }
+    return true;
+}
+
+//******************************************************************************
+/*!
+  Method to report an error of the run, the first error is kept
+*/
+void FilterMonitor::setError(const QString &message) const
+{
+    if (_errorMessage.isEmpty())
+        _errorMessage = message;
+}
+
 //******************************************************************************
 
 AbstractFilter::AbstractFilter(QObject *parent) :
@@ -28,66 +102,202 @@ AbstractFilter::AbstractFilter(QObject *parent) :
 //******************************************************************************
 /*!
   Method to apply a filter on data.
+  \param monitor is an optional monitor to cancel the run and to receive the progress
+  \return filtered data or empty matrix if failed or canceled
+*/
+cv::Mat AbstractFilter::apply(const cv::Mat &src, const FilterMonitor * monitor) const
+{
+    cv::Mat res;
+    applyTo(src, res, monitor);
+    return res;
+}
 
+//******************************************************************************
+/*!
+  Method to apply a filter on data into dst. Memory of dst is reused if the filter writes into
+  a given matrix (see filterWithMaskTo()) and dst has the size and the type of the result.
+  \param dst should not share data with src
+  \return false if failed or canceled, dst is released
 */
-cv::Mat AbstractFilter::apply(const cv::Mat &src) const
+bool AbstractFilter::applyTo(const cv::Mat &src, cv::Mat &dst, const FilterMonitor *monitor) const
 {
+    FilterMonitor defaultMonitor;
+    const FilterMonitor & m = monitor ? *monitor : defaultMonitor;
+    if (m.isCanceled())
+    {
+        dst.release();
+        return false;
+    }
+
     // Catch Opencv exceptions:
     try
     {
-        // Rewrite noDataValue to zero :
-        // Mask is a matrix of nb of channels, depth of src, contains 1.0 values where src data exists
-        // and 0.0 values where src data = noDataValue
-        cv::Mat mask, unmask;
-        mask = Core::computeMask(src, _noDataValue, &unmask);
-
-        cv::Mat srcToProcess = src.mul(mask);
+        // No-data mask is a matrix of nb of channels of src, depth 8U, contains non-zero values where src data = noDataValue
+        // Mask is empty if there are no such values
+        cv::Mat noDataMask = src == _noDataValue;
+        if (cv::countNonZero(noDataMask.reshape(1)) == 0)
+            noDataMask.release();
 
         // Apply filtering:
-        cv::Mat res = filter(srcToProcess);
+        filterWithMaskTo(src, noDataMask, dst, m);
+        if (m.isCanceled())
+        {
+            m.setError(tr("Filter \'%1\' is canceled").arg(getName()));
+            dst.release();
+        }
+    }
+    catch (const cv::Exception & e)
+    {
+        m.setError(tr("OpenCV Error in \'%1\' :\n %2")
+                   .arg(getName())
+                   .arg(e.msg.c_str()));
+        dst.release();
+    }
 
-        if (res.empty())
-            return res;
+    if (dst.empty() && !monitor)
+        _errorMessage = defaultMonitor.getErrorMessage();
+    return !dst.empty();
+}
+
+//******************************************************************************
+/*!
+  Method to apply the filter on data with no-data values.
+  \param noDataMask is the 8-bit mask of no-data values or empty matrix if there are no such values
+  \return filtered data with noDataValue written where noDataMask is non-zero
+*/
+cv::Mat AbstractFilter::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor & monitor) const
+{
+    cv::Mat res = filter(zeroNoData(src, noDataMask), monitor);
+    writeNoData(res, noDataMask);
+    return res;
+}
 
-        // !!! MAYBE IT IS OK
-//        if (res.depth() != src.depth())
-//        {
-//            SD_TRACE("AbstractFilter::apply : result depth is different from the source depth")
-//            return cv::Mat();
-//        }
-//        if (res.channels() != src.channels())
-//        {
-//            SD_TRACE("AbstractFilter::apply : result nb of channels is different from the source nb of channels. Return processed matrix without noDataValues");
-//            return res;
-//        }
-
-        // Check output size with mask size
-        if (res.cols == unmask.cols &&
-                res.rows == unmask.rows &&
-                res.channels() == unmask.channels())
+//******************************************************************************
+/*!
+  Method to apply the filter on data with no-data values into dst. Filters that can write their result
+  into a given matrix reimplement it to reuse the memory of dst (see FilterPipeline).
+  Default implementation assigns the result of filterWithMask() to dst.
+  \param dst is the output matrix, it does not share data with src
+*/
+void AbstractFilter::filterWithMaskTo(const cv::Mat &src, const cv::Mat &noDataMask, cv::Mat &dst, const FilterMonitor &monitor) const
+{
+    dst = filterWithMask(src, noDataMask, monitor);
+}
+
+//******************************************************************************
+/*!
+  Method to apply filterStrip() on strips of rows of src extended with the halo of the filter.
+  Result is the same as filterStrip() applied on src if the filter output depends only on the halo.
+  Progress is reported and cancellation is checked between strips.
+  \return filtered data or empty matrix if failed or canceled
+*/
+cv::Mat AbstractFilter::filterByStrips(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor &monitor) const
+{
+    cv::Mat out;
+    int halo = qMax(0, getHaloSize());
+    // strips are larger than the halo to limit the overlap
+    int nbOfStrips = qMax(1, src.rows / qMax(StripHeight, 8 * halo));
+    int stripHeight = (src.rows + nbOfStrips - 1) / nbOfStrips;
+    for (int y=0; y<src.rows; y+=stripHeight)
+    {
+        if (!monitor.setProgress((100 * y) / src.rows))
+            return cv::Mat();
+
+        int y1 = qMin(src.rows, y + stripHeight);
+        int haloY0 = qMax(0, y - halo);
+        int haloY1 = qMin(src.rows, y1 + halo);
+        cv::Mat res = filterStrip(src.rowRange(haloY0, haloY1),
+                                  noDataMask.empty() ? noDataMask : noDataMask.rowRange(haloY0, haloY1));
+        if (res.rows != haloY1 - haloY0 || res.cols != src.cols)
         {
-            // Write noDataValue:
-            unmask = unmask.mul(_noDataValue);
-            if (res.type() == unmask.type())
-            {
-                res = unmask + res;
-            }
-            else
-            {
-                cv::Mat m;
-                unmask.convertTo(m, res.depth());
-                res = m + res;
-            }
+            monitor.setError(tr("Filter \'%1\' output size is different from the input size").arg(getName()));
+            return cv::Mat();
         }
-        return res;
+        if (nbOfStrips == 1)
+            return res;
+        if (out.empty())
+            out.create(src.rows, src.cols, res.type());
+        res.rowRange(y - haloY0, y1 - haloY0).copyTo(out.rowRange(y, y1));
     }
-    catch (const cv::Exception & e)
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to filter a strip of rows, see filterByStrips(). Default implementation returns an empty matrix
+*/
+cv::Mat AbstractFilter::filterStrip(const cv::Mat &src, const cv::Mat &noDataMask) const
+{
+    Q_UNUSED(src);
+    Q_UNUSED(noDataMask);
+    return cv::Mat();
+}
+
+//******************************************************************************
+/*!
+  Method to get a copy of data with zeros instead of no-data values.
+  Source data is returned without copy if mask is empty
+*/
+cv::Mat AbstractFilter::zeroNoData(const cv::Mat &src, const cv::Mat &noDataMask) const
+{
+    if (noDataMask.empty())
+        return src;
+    cv::Mat out = src.clone();
+    out.reshape(1).setTo(0, noDataMask.reshape(1));
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Method to write noDataValue in data where mask is non-zero.
+  Nothing is done if mask is empty or data has a different size or nb of channels
+*/
+void AbstractFilter::writeNoData(cv::Mat &data, const cv::Mat &noDataMask) const
+{
+    if (noDataMask.empty() ||
+            data.cols != noDataMask.cols ||
+            data.rows != noDataMask.rows ||
+            data.channels() != noDataMask.channels())
+        return;
+    data.reshape(1).setTo(_noDataValue, noDataMask.reshape(1));
+}
+
+//******************************************************************************
+/*!
+  Method to get the neighbourhood radius in pixels needed to compute an output pixel.
+  \return -1 if the filter should be applied on the whole image
+*/
+int AbstractFilter::getHaloSize() const
+{
+    return -1;
+}
+
+//******************************************************************************
+
+/*!
+  Method to create a copy of the filter with the same parameters (writable properties and noDataValue).
+  Copy is not verbose and has no parent.
+  \return new filter or null if the filter class has no invokable constructor
+*/
+AbstractFilter * AbstractFilter::clone() const
+{
+    const QMetaObject * mo = metaObject();
+    AbstractFilter * f = qobject_cast<AbstractFilter*>(mo->newInstance());
+    if (!f)
+    {
+        SD_TRACE("AbstractFilter::clone : filter \'" + getName() + "\' can not be copied");
+        return 0;
+    }
+
+    for (int i=QObject::staticMetaObject.propertyCount(); i<mo->propertyCount(); i++)
     {
-        _errorMessage = tr("OpenCV Error in \'%1\' :\n %2")
-                .arg(getName())
-                .arg(e.msg.c_str());
-        return cv::Mat();
+        QMetaProperty p = mo->property(i);
+        if (p.isWritable())
+            p.write(f, p.read(this));
     }
+    f->_noDataValue = _noDataValue;
+    f->_verbose = false;
+    return f;
 }
 
 //******************************************************************************
@@ -3,6 +3,7 @@
 
 // Qt
 #include <QObject>
+#include <QAtomicInt>
 
 // Opencv
 #include <opencv2/core/core.hpp>
@@ -17,6 +18,38 @@ namespace Filters
 
 //******************************************************************************
 
+class GIV_DLL_EXPORT FilterMonitor
+{
+public:
+    explicit FilterMonitor(const FilterMonitor * parent = 0, int progressMin = 0, int progressMax = 100);
+    virtual ~FilterMonitor() {}
+
+    void cancel()
+    { _canceled.store(1); }
+    void reset()
+    { _canceled.store(0); }
+    bool isCanceled() const
+    { return _canceled.load() != 0 || (_parent && _parent->isCanceled()); }
+
+    bool setProgress(int value) const;
+
+    void setError(const QString & message) const;
+    QString getErrorMessage() const
+    { return _errorMessage; }
+
+protected:
+    virtual void progressChanged(int value) const
+    { Q_UNUSED(value); }
+
+    const FilterMonitor * _parent;
+    int _progressMin;
+    int _progressMax;
+    QAtomicInt _canceled;
+    mutable QString _errorMessage;
+};
+
+//******************************************************************************
+
 class GIV_DLL_EXPORT AbstractFilter : public QObject
 {
     Q_OBJECT
@@ -30,19 +63,27 @@ class GIV_DLL_EXPORT AbstractFilter : public QObject
     Q_PROPERTY_WITH_ACCESSORS(float, maskByValue, getMaskByValue, setMaskByValue)
     Q_CLASSINFO("maskByValue", "label:Mask from data value (default, -12345 and no mask);minValue:-12345;maxValue:100000")
 
-    // This is needed to access '_errorMessage' attribute
-    friend class FilterTask;
+    // This is needed to access 'filterWithMask' method
+    friend class FilterPipeline;
 
 public:
     AbstractFilter(QObject * parent = 0);
     virtual ~AbstractFilter() {}
 
-    cv::Mat apply(const cv::Mat & src) const;
+    cv::Mat apply(const cv::Mat & src, const FilterMonitor * monitor = 0) const;
+    bool applyTo(const cv::Mat & src, cv::Mat & dst, const FilterMonitor * monitor = 0) const;
+
+    virtual int getHaloSize() const;
+
+    virtual AbstractFilter * clone() const;
 
     enum {
         Type = 0,
     };
 
+    //! Height of the strips of rows filtered between cancellation checks (see filterByStrips())
+    static const int StripHeight = 1024;
+
     QString getErrorMessage() const
     { return _errorMessage; }
 
@@ -52,7 +93,16 @@ signals:
     void verboseImage(const QString &, cv::Mat *) const;
 
 protected:
-    virtual cv::Mat filter(const cv::Mat & src) const = 0;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const = 0;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+    virtual void filterWithMaskTo(const cv::Mat & src, const cv::Mat & noDataMask, cv::Mat & dst, const FilterMonitor & monitor) const;
+
+    cv::Mat filterByStrips(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterStrip(const cv::Mat & src, const cv::Mat & noDataMask) const;
+
+    cv::Mat zeroNoData(const cv::Mat & src, const cv::Mat & noDataMask) const;
+    void writeNoData(cv::Mat & data, const cv::Mat & noDataMask) const;
+
     mutable QString _errorMessage;
 
     void verboseDisplayImage(const QString & winname, const cv::Mat & img) const;
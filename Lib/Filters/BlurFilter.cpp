@@ -2,11 +2,9 @@
 // Qt
 #include <qmath.h>
 
-// Opencv
-#include <opencv2/imgproc/imgproc.hpp>
-
 // Project
 #include "BlurFilter.h"
+#include "FastBlur.h"
 
 
 namespace Filters
@@ -17,6 +15,10 @@ namespace Filters
 /*!
   \class BlurFilter
   \brief Blur filter implementation
+
+  Cost per pixel of all blur types does not depend on the window size (see FastBlur.h) :
+  mean uses running sums, large gaussian kernels are approximated with stacked box filters
+  and median uses column histograms. Only valid pixels of the window are used.
 */
 
 //******************************************************************************
@@ -35,24 +37,52 @@ BlurFilter::BlurFilter(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat BlurFilter::filter(const cv::Mat &src) const
+int BlurFilter::getHaloSize() const
+{
+    if (_type=="gaussian")
+        return gaussianHaloSize(cv::Size(_sizeX, _sizeY), _sigmaX, _sigmaY);
+    return qMax(_sizeX, _sizeY)/2;
+}
+
+//******************************************************************************
+
+cv::Mat BlurFilter::filter(const cv::Mat &src, const FilterMonitor & monitor) const
+{
+    return filterWithMask(src, cv::Mat(), monitor);
+}
+
+//******************************************************************************
+/*!
+  No-data values are not used to compute output values of valid pixels.
+  Large data is filtered by strips of rows, the run is stopped between strips if canceled
+*/
+cv::Mat BlurFilter::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor &monitor) const
+{
+    return filterByStrips(src, noDataMask, monitor);
+}
+
+//******************************************************************************
+
+cv::Mat BlurFilter::filterStrip(const cv::Mat &src, const cv::Mat &noDataMask) const
 {
     cv::Mat out;
+    cv::Mat data = zeroNoData(src, noDataMask);
 
     SD_TRACE3("Blur filter : type=%1, size = %2, %3", _type, _sizeX, _sizeY);
     if (_type=="mean")
     {
-        cv::blur(src, out, cv::Size(_sizeX, _sizeY));
+        out = meanFilter(data, cv::Size(_sizeX, _sizeY), noDataMask);
     }
     else if (_type=="median")
     {
-        cv::medianBlur(src,out,qMax(_sizeX, _sizeY));
+        out = medianFilter(data, qMax(_sizeX, _sizeY), noDataMask);
     }
     else if (_type=="gaussian")
     {
         SD_TRACE2("Sigma X/Y : %1, %2", _sigmaX, _sigmaY);
-        cv::GaussianBlur(src, out, cv::Size(_sizeX, _sizeY), _sigmaX, _sigmaY);
+        out = gaussianFilter(data, cv::Size(_sizeX, _sizeY), _sigmaX, _sigmaY, noDataMask);
     }
+    writeNoData(out, noDataMask);
     return out;
 }
 
@@ -22,11 +22,11 @@ class GIV_DLL_EXPORT BlurFilter : public AbstractFilter
 
     Q_PROPERTY(int sizeX READ getSizeX WRITE setSizeX)
     PROPERTY_GETACCESSOR(int, sizeX, getSizeX)
-    Q_CLASSINFO("sizeX","minValue:1;maxValue:100")
+    Q_CLASSINFO("sizeX","minValue:1;maxValue:201")
 
     Q_PROPERTY(int sizeY READ getSizeY WRITE setSizeY)
     PROPERTY_GETACCESSOR(int, sizeY, getSizeY)
-    Q_CLASSINFO("sizeY","minValue:1;maxValue:100")
+    Q_CLASSINFO("sizeY","minValue:1;maxValue:201")
 
     Q_PROPERTY_WITH_ACCESSORS(double, sigmaX, getSigmaX, setSigmaX)
     Q_CLASSINFO("sigmaX","label:Sigma X for gaussian blur;minValue:0.001;maxValue:500.0")
@@ -37,9 +37,11 @@ class GIV_DLL_EXPORT BlurFilter : public AbstractFilter
 
 
 public:
-    BlurFilter(QObject * parent = 0);
+    Q_INVOKABLE BlurFilter(QObject * parent = 0);
     virtual ~BlurFilter() {}
 
+    virtual int getHaloSize() const;
+
     void setSizeX(int v)
     { _sizeX = v; }
 
@@ -57,7 +59,9 @@ protected:
 //        _name = tr("Blur filter : %1").arg(_type);
 //    }
 
-    virtual cv::Mat filter(const cv::Mat & src) const;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterStrip(const cv::Mat & src, const cv::Mat & noDataMask) const;
 
 };
 
@@ -41,7 +41,15 @@ ConvertTo8U::ConvertTo8U(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat ConvertTo8U::filter(const cv::Mat &src) const
+int ConvertTo8U::getHaloSize() const
+{
+    // min/max values are computed on the whole image except for user min/max
+    return (_type=="user min/max") ? 0 : -1;
+}
+
+//******************************************************************************
+
+cv::Mat ConvertTo8U::filter(const cv::Mat &src, const FilterMonitor & monitor) const
 {
     cv::Mat out;
 
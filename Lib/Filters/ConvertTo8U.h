@@ -36,12 +36,14 @@ class GIV_DLL_EXPORT ConvertTo8U : public AbstractFilter
 
 
 public:
-    ConvertTo8U(QObject * parent = 0);
+    Q_INVOKABLE ConvertTo8U(QObject * parent = 0);
     virtual ~ConvertTo8U() {}
 
+    virtual int getHaloSize() const;
+
 protected:
 
-    virtual cv::Mat filter(const cv::Mat & src) const;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
 
 };
 
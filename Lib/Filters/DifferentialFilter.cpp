@@ -32,8 +32,27 @@ DifferentialFilter::DifferentialFilter(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat DifferentialFilter::filter(const cv::Mat &src) const
+int DifferentialFilter::getHaloSize() const
 {
+    // Scharr kernel and Sobel/Laplacian kernels of size 1 are 3x3
+    return (_type=="scharr") ? 1 : qMax(1, _size/2);
+}
+
+//******************************************************************************
+
+/*!
+  Large data is filtered by strips of rows, the run is stopped between strips if canceled
+*/
+cv::Mat DifferentialFilter::filter(const cv::Mat &src, const FilterMonitor & monitor) const
+{
+    return filterByStrips(src, cv::Mat(), monitor);
+}
+
+//******************************************************************************
+
+cv::Mat DifferentialFilter::filterStrip(const cv::Mat &src, const cv::Mat &noDataMask) const
+{
+    Q_UNUSED(noDataMask);
     cv::Mat out;
 
     SD_TRACE1("Differential filter : type=%1", _type);
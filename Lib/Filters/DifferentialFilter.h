@@ -24,12 +24,15 @@ class GIV_DLL_EXPORT DifferentialFilter : public AbstractFilter
 
 
 public:
-    DifferentialFilter(QObject * parent = 0);
+    Q_INVOKABLE DifferentialFilter(QObject * parent = 0);
     virtual ~DifferentialFilter() {}
 
+    virtual int getHaloSize() const;
+
 protected:
 
-    virtual cv::Mat filter(const cv::Mat & src) const;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterStrip(const cv::Mat & src, const cv::Mat & noDataMask) const;
 
 };
 
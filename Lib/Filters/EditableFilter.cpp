@@ -8,6 +8,9 @@
 #include <QSysInfo>
 #include <QLibrary>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QMultiMap>
 
 // Opencv
 #include <opencv2/imgproc/imgproc.hpp>
@@ -18,6 +21,33 @@
 namespace Filters
 {
 
+#if (defined WIN32 || defined _WIN32 || defined WINCE)
+static const QString LibraryFileName("EditableFunction.dll");
+#elif (defined Q_OS_MAC)
+static const QString LibraryFileName("libEditableFunction.dylib");
+#else
+static const QString LibraryFileName("libEditableFunction.so");
+#endif
+
+static const QString BuildCachePath("Resources/Build/Cache");
+static const QString BuildCacheStampName("LastUse.stamp");
+static const int BuildCacheMaxCount = 16;
+
+//! Build configuration written in the build folder after a successful build
+static QString BuildConfigKey(const QString & cmakePath, const QString & cmakeGenerator)
+{
+    return cmakePath + ";" + cmakeGenerator;
+}
+
+//! Method to mark a build cache entry as used : least recently used entries are pruned first
+static void TouchBuildCacheEntry(const QString & entryPath)
+{
+    QFile stamp(QDir(entryPath).absoluteFilePath(BuildCacheStampName));
+    if (stamp.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        stamp.write(QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toUtf8());
+    }
+}
 
 QString StringListToString(const QStringList & list)
 {
@@ -33,6 +63,16 @@ QString StringListToString(const QStringList & list)
 /*!
   \class EditableFilter
   \brief Idea is to compile a code in runtime and execute
+
+  Compiled libraries are cached in 'Resources/Build/Cache' by a hash of the source code, the function
+  header and CMake project files and the build configuration. Applying a code that was already built
+  loads the cached library without running CMake. Otherwise the build folder is kept between builds and
+  CMake is only configured once per build configuration, so the build is incremental.
+
+  Libraries of ABI v2 (see Resources/EditableFunction/EditableFunction.h) are called with an explicit
+  context per call, read input data in place and write the result into the output matrix. Calls are
+  reentrant : if the code defines its halo size (EF_HALO_SIZE), the filter is applied on image tiles in parallel.
+  Libraries of ABI v1 are called on the whole image and calls are serialized.
 */
 //******************************************************************************
 
@@ -47,6 +87,15 @@ EditableFilter::EditableFilter(QObject *parent) :
     _libVerboseStackCount(0),
     _libVerboseStackNextP1(0),
     _libVerboseStackNextP2(0),
+    _libAbiVersion(0),
+    _libHaloSize(0),
+    _libCreateContext(0),
+    _libDestroyContext(0),
+    _libFilterFunc(0),
+    _libTakeResult(0),
+    _libVerboseCount(0),
+    _libVerboseNext(0),
+    _libVerboseTake(0),
     _libraryLoader(new QLibrary(this))
 {
     _name = tr("Editable filter");
@@ -84,6 +133,30 @@ EditableFilter::~EditableFilter()
 
 //******************************************************************************
 
+/*!
+  Method to create a copy of the filter that loads the same compiled library.
+  The copy does not build programs, it is used to apply the last built one (e.g. in background)
+*/
+AbstractFilter * EditableFilter::clone() const
+{
+    EditableFilter * f = new EditableFilter();
+    f->_noDataValue = _noDataValue;
+    f->_verbose = false;
+    f->setMaskByValue(getMaskByValue());
+    f->_cmakePath = _cmakePath;
+    f->_cmakeGenerator = _cmakeGenerator;
+    f->_sourceFilePath = _sourceFilePath;
+    if (!f->setLibraryPath(_libraryPath))
+    {
+        SD_TRACE("EditableFilter::clone : failed to load the library of the copy");
+        delete f;
+        return 0;
+    }
+    return f;
+}
+
+//******************************************************************************
+
 QString EditableFilter::getCMakePath() const
 {
     QString out(_cmakePath);
@@ -100,8 +173,119 @@ void EditableFilter::setCMakePath(const QString &path)
 
 //******************************************************************************
 
-cv::Mat EditableFilter::filter(const cv::Mat &src) const
+int EditableFilter::getHaloSize() const
+{
+    if (_libAbiVersion >= 2 && _libHaloSize)
+    {
+        return _libHaloSize();
+    }
+    return -1;
+}
+
+//******************************************************************************
+
+cv::Mat EditableFilter::filter(const cv::Mat &src, const FilterMonitor & monitor) const
+{
+    if (_libAbiVersion >= 2)
+    {
+        return filterV2(src, monitor);
+    }
+    return filterV1(src, monitor);
+}
+
+//******************************************************************************
+
+cv::Mat EditableFilter::filterV2(const cv::Mat &src, const FilterMonitor & monitor) const
 {
+    if (!_libCreateContext ||
+            !_libDestroyContext ||
+            !_libFilterFunc ||
+            !_libTakeResult ||
+            !_libVerboseCount ||
+            !_libVerboseNext ||
+            !_libVerboseTake)
+    {
+        return cv::Mat();
+    }
+
+    void * context = _libCreateContext(_noDataValue);
+    if (!context)
+    {
+        return cv::Mat();
+    }
+
+    // Output is expected to have the size and the nb of channels of the input
+    cv::Mat out(src.rows, src.cols, CV_32FC(src.channels()));
+    // Big try :
+    try
+    {
+        int rw(0), rh(0), rtype(-1);
+        int r = _libFilterFunc(context,
+                               src.data, src.cols, src.rows, src.type(), src.step,
+                               out.data, out.cols, out.rows, out.type(), out.step,
+                               &rw, &rh, &rtype);
+        if (r == -1 && rw > 0 && rh > 0 && rtype >= 0)
+        {
+            // Result has another size or type : take it from the context
+            out.create(rh, rw, rtype);
+            if (!_libTakeResult(context, out.data, out.step))
+            {
+                r = 0;
+            }
+        }
+        else if (r == 1 && rtype < 0)
+        {
+            SD_TRACE("EditableFilter : Resulting matrix is empty");
+            monitor.setError(tr("Resulting matrix is empty"));
+            out.release();
+        }
+
+        if (r != 1 && r != -1)
+        {
+            SD_TRACE("EditableFilter : filter function is failed");
+            out.release();
+        }
+
+        // Handle verbose images
+        int count = monitor.isCanceled() ? 0 : _libVerboseCount(context);
+        for (int i=0; i<count; i++)
+        {
+            int w(0), h(0), type(0), msgsize(0);
+            if (!_libVerboseNext(context, &w, &h, &type, &msgsize))
+            {
+                break;
+            }
+
+            cv::Mat * vOut = (w > 0 && h > 0 && type >= 0) ? new cv::Mat(h, w, type) : new cv::Mat();
+            std::string msg(msgsize, ' ');
+            if (!_libVerboseTake(context, vOut->data, vOut->step, &msg[0]) || vOut->empty())
+            {
+                delete vOut;
+                continue;
+            }
+            emit verboseImage(QString(msg.c_str()), vOut);
+        }
+    }
+    catch(...)
+    {
+        SD_TRACE("Editable filter has crashed");
+        monitor.setError(tr("Editable filter has crashed"));
+        out.release();
+    }
+
+    _libDestroyContext(context);
+    return out;
+}
+
+//******************************************************************************
+
+cv::Mat EditableFilter::filterV1(const cv::Mat &iSrc, const FilterMonitor & monitor) const
+{
+    QMutexLocker locker(&_libV1Mutex);
+
+    // ABI v1 reads continuous data
+    cv::Mat src = iSrc.isContinuous() ? iSrc : iSrc.clone();
+
     if (!_libFilterFuncP1 ||
             !_libFilterFuncP2 ||
             !_libVerboseStackCount ||
@@ -125,10 +309,12 @@ cv::Mat EditableFilter::filter(const cv::Mat &src) const
             SD_TRACE("EditableFilter : filter function p1 is failed");
             return cv::Mat();
         }
+        if (!monitor.setProgress(90))
+            return cv::Mat();
 
         if (ow != 0 && oh != 0 && otype >= 0)
         {
-            out = cv::Mat(oh, ow, otype); out.setTo(0.0);
+            out = cv::Mat(oh, ow, otype);
             if (!_libFilterFuncP2(out.data))
             {
                 SD_TRACE("EditableFilter : filter function p2 is failed");
@@ -138,7 +324,7 @@ cv::Mat EditableFilter::filter(const cv::Mat &src) const
         else
         {
             SD_TRACE("EditableFilter : Resulting matrix is empty");
-            _errorMessage = tr("Resulting matrix is empty");
+            monitor.setError(tr("Resulting matrix is empty"));
         }
 
         // Handle verbose images
@@ -169,7 +355,7 @@ cv::Mat EditableFilter::filter(const cv::Mat &src) const
     catch(...)
     {
         SD_TRACE("Editable filter has crashed");
-        _errorMessage = tr("Editable filter has crashed");
+        monitor.setError(tr("Editable filter has crashed"));
     }
 
     return out;
@@ -362,11 +548,125 @@ void EditableFilter::apply(const QString &program)
         return;
     }
 
-    _postExecuteFunc = &EditableFilter::loadLibrary;
+    _buildKey = computeBuildKey(program);
+    QString cachedLibraryPath = getCachedLibraryPath(_buildKey);
+    if (QFileInfo(cachedLibraryPath).exists())
+    {
+        SD_TRACE("Load cached library : " + cachedLibraryPath);
+        TouchBuildCacheEntry(QFileInfo(cachedLibraryPath).absolutePath());
+        _libraryPath = cachedLibraryPath;
+        emit workFinished(loadLibrary());
+        return;
+    }
+
+    _postExecuteFunc = &EditableFilter::cacheAndLoadLibrary;
 
     buildSourceFile();
 }
 
+//******************************************************************************
+/*!
+  Method to compute the key of the library built from the program : hash of the program, of the
+  EditableFunction project files and of the build configuration
+*/
+QString EditableFilter::computeBuildKey(const QString &program) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(program.toUtf8());
+
+    QDir d("Resources/EditableFunction");
+    QStringList files;
+    files << "EditableFunction.h" << "CMakeLists.txt";
+    foreach (QString file, files)
+    {
+        QFile f(d.absoluteFilePath(file));
+        if (f.open(QIODevice::ReadOnly))
+        {
+            hash.addData(f.readAll());
+        }
+    }
+
+    hash.addData(_cmakePath.toUtf8());
+    hash.addData(_cmakeGenerator.toUtf8());
+    hash.addData(QByteArray("Release"));
+    hash.addData(QByteArray::number(QSysInfo::WordSize));
+    return QString(hash.result().toHex());
+}
+
+//******************************************************************************
+
+QString EditableFilter::getCachedLibraryPath(const QString &buildKey) const
+{
+    return QDir(BuildCachePath + "/" + buildKey).absoluteFilePath(LibraryFileName);
+}
+
+//******************************************************************************
+/*!
+  Post execute method : copy the built library into the cache and load it
+*/
+bool EditableFilter::cacheAndLoadLibrary()
+{
+    // Configure and build tasks are successful :
+    QFile configStamp("Resources/Build/GIVConfig.stamp");
+    if (configStamp.open(QIODevice::WriteOnly))
+    {
+        configStamp.write(BuildConfigKey(_cmakePath, _cmakeGenerator).toUtf8());
+        configStamp.close();
+    }
+
+    QDir d(BuildCachePath);
+    if (!d.mkpath(_buildKey))
+    {
+        SD_TRACE("Failed to create build cache folder");
+        _libraryPath = QDir(".").absoluteFilePath(LibraryFileName);
+        return loadLibrary();
+    }
+
+    // Built library is installed in the working directory
+    QString cachedLibraryPath = getCachedLibraryPath(_buildKey);
+    QFile::remove(cachedLibraryPath);
+    if (!QFile::copy(QDir(".").absoluteFilePath(LibraryFileName), cachedLibraryPath))
+    {
+        SD_TRACE("Failed to copy the library into the build cache");
+        _libraryPath = QDir(".").absoluteFilePath(LibraryFileName);
+        return loadLibrary();
+    }
+
+    TouchBuildCacheEntry(QFileInfo(cachedLibraryPath).absolutePath());
+    pruneBuildCache(BuildCacheMaxCount);
+    _libraryPath = cachedLibraryPath;
+    return loadLibrary();
+}
+
+//******************************************************************************
+/*!
+  Method to remove the least recently used cached libraries. Last use time of an entry is the time
+  of its stamp file (updated when the library is built or loaded from the cache) or of its folder
+*/
+void EditableFilter::pruneBuildCache(int maxCount)
+{
+    QDir d(BuildCachePath);
+    QFileInfoList entries = d.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    if (entries.size() <= maxCount)
+        return;
+
+    // entries sorted by last use time :
+    QMultiMap<qint64, QString> lastUses;
+    foreach (QFileInfo entry, entries)
+    {
+        QFileInfo stamp(QDir(entry.absoluteFilePath()).absoluteFilePath(BuildCacheStampName));
+        QDateTime lastUse = stamp.exists() ? stamp.lastModified() : entry.lastModified();
+        lastUses.insert(lastUse.toMSecsSinceEpoch(), entry.absoluteFilePath());
+    }
+
+    int count = entries.size() - maxCount;
+    QMultiMap<qint64, QString>::const_iterator it = lastUses.constBegin();
+    for (; it != lastUses.constEnd() && count > 0; ++it, --count)
+    {
+        QDir(it.value()).removeRecursively();
+    }
+}
+
 //******************************************************************************
 
 void EditableFilter::buildSourceFile()
@@ -388,6 +688,15 @@ void EditableFilter::buildSourceFile()
     }
 
     _process->setWorkingDirectory(d.absolutePath());
+
+    // Build folder is kept between builds : configure only once per build configuration
+    QFile configStamp(d.absoluteFilePath("GIVConfig.stamp"));
+    bool configured = false;
+    if (QFileInfo(d.absoluteFilePath("CMakeCache.txt")).exists() && configStamp.open(QIODevice::ReadOnly))
+    {
+        configured = QString(configStamp.readAll()) == BuildConfigKey(_cmakePath, _cmakeGenerator);
+        configStamp.close();
+    }
     d.setPath("Resources/EditableFunction");
 
     // Configure
@@ -400,8 +709,11 @@ void EditableFilter::buildSourceFile()
     task << "-G" + _cmakeGenerator;
 #endif
     task << d.absolutePath();
-    _tasks.append(task);
-    SD_TRACE1("Append task : %1", StringListToString(task));
+    if (!configured)
+    {
+        _tasks.append(task);
+        SD_TRACE1("Append task : %1", StringListToString(task));
+    }
 
 
     // Build
@@ -441,6 +753,9 @@ QString EditableFilter::readSourceFile()
 
 bool EditableFilter::removeBuildCache()
 {
+    // Loaded library can be in the build cache
+    if (!unloadLibrary()) return false;
+
     QDir d("Resources/Build");
     if (!d.exists())
     {
@@ -460,6 +775,11 @@ bool EditableFilter::removeBuildCache()
 
 bool EditableFilter::writeSourceFile(const QString & program)
 {
+    // Keep the file untouched if the program is not changed to avoid its rebuild
+    if (readSourceFile() == program)
+    {
+        return true;
+    }
 
     QFile f(_sourceFilePath);
 
@@ -478,6 +798,17 @@ bool EditableFilter::writeSourceFile(const QString & program)
 
 //******************************************************************************
 
+/*!
+  Method to load an already built filter library, e.g. in a filter worker process (see ProcessFilter)
+*/
+bool EditableFilter::setLibraryPath(const QString &path)
+{
+    _libraryPath = path;
+    return loadLibrary();
+}
+
+//******************************************************************************
+
 bool EditableFilter::loadLibrary()
 {
     SD_TRACE("Load library");
@@ -485,13 +816,12 @@ bool EditableFilter::loadLibrary()
     if (!unloadLibrary()) return false;
 
     QStringList names;
-    names << "EditableFunction";
+    names << (_libraryPath.isEmpty() ? QDir(".").absoluteFilePath("EditableFunction") : _libraryPath);
 
-    QDir d(".");
-    SD_TRACE1("Working path : %1", d.absolutePath());
+    SD_TRACE1("Working path : %1", QDir(".").absolutePath());
     foreach (QString name, names)
     {
-        _libraryLoader->setFileName(d.absolutePath() + "/" + name);
+        _libraryLoader->setFileName(name);
         if (_libraryLoader->load())
         {
             _libFilterFuncP1 = reinterpret_cast<LibFilterFuncP1>(_libraryLoader->resolve("filterFuncP1"));
@@ -524,6 +854,27 @@ bool EditableFilter::loadLibrary()
                 SD_TRACE1("Lib verbose stack next function p2 is null : %1", _libraryLoader->errorString());
             }
 
+            // ABI v2 functions :
+            typedef int (*LibAbiVersion)();
+            LibAbiVersion abiVersion = reinterpret_cast<LibAbiVersion>(_libraryLoader->resolve("abiVersion"));
+            _libAbiVersion = abiVersion ? abiVersion() : 1;
+            SD_TRACE1("Library ABI version : %1", _libAbiVersion);
+            if (_libAbiVersion >= 2)
+            {
+                _libHaloSize = reinterpret_cast<LibHaloSize>(_libraryLoader->resolve("haloSize"));
+                _libCreateContext = reinterpret_cast<LibCreateContext>(_libraryLoader->resolve("createContext"));
+                _libDestroyContext = reinterpret_cast<LibDestroyContext>(_libraryLoader->resolve("destroyContext"));
+                _libFilterFunc = reinterpret_cast<LibFilterFunc>(_libraryLoader->resolve("filterFunc"));
+                _libTakeResult = reinterpret_cast<LibTakeResult>(_libraryLoader->resolve("takeResult"));
+                _libVerboseCount = reinterpret_cast<LibVerboseCount>(_libraryLoader->resolve("verboseCount"));
+                _libVerboseNext = reinterpret_cast<LibVerboseNext>(_libraryLoader->resolve("verboseNext"));
+                _libVerboseTake = reinterpret_cast<LibVerboseTake>(_libraryLoader->resolve("verboseTake"));
+                if (!_libFilterFunc)
+                {
+                    SD_TRACE1("Lib filter function is null : %1", _libraryLoader->errorString());
+                }
+            }
+
         }
         else
         {
@@ -532,7 +883,15 @@ bool EditableFilter::loadLibrary()
         }
     }
 
-    return _libFilterFuncP1 && _libFilterFuncP2 && _libVerboseStackCount && _libVerboseStackNextP1 && _libVerboseStackNextP2;
+    bool v1 = _libFilterFuncP1 && _libFilterFuncP2 && _libVerboseStackCount && _libVerboseStackNextP1 && _libVerboseStackNextP2;
+    bool v2 = _libAbiVersion >= 2 &&
+            _libHaloSize && _libCreateContext && _libDestroyContext && _libFilterFunc &&
+            _libTakeResult && _libVerboseCount && _libVerboseNext && _libVerboseTake;
+    if (!v2)
+    {
+        _libAbiVersion = 1;
+    }
+    return v1 || v2;
 }
 
 //******************************************************************************
@@ -547,6 +906,20 @@ bool EditableFilter::unloadLibrary()
             return false;
         }
     }
+    _libFilterFuncP1 = 0;
+    _libFilterFuncP2 = 0;
+    _libVerboseStackCount = 0;
+    _libVerboseStackNextP1 = 0;
+    _libVerboseStackNextP2 = 0;
+    _libAbiVersion = 0;
+    _libHaloSize = 0;
+    _libCreateContext = 0;
+    _libDestroyContext = 0;
+    _libFilterFunc = 0;
+    _libTakeResult = 0;
+    _libVerboseCount = 0;
+    _libVerboseNext = 0;
+    _libVerboseTake = 0;
     return true;
 }
 
@@ -4,6 +4,7 @@
 // Qt
 #include <QObject>
 #include <QProcess>
+#include <QMutex>
 
 // Project
 #include "Filters/AbstractFilter.h"
@@ -37,6 +38,14 @@ public:
 
     bool removeBuildCache();
 
+    QString getLibraryPath() const
+    { return _libraryPath; }
+    bool setLibraryPath(const QString & path);
+
+    virtual int getHaloSize() const;
+
+    virtual AbstractFilter * clone() const;
+
 signals:
     void badConfiguration();
     void workFinished(bool ok); //!< signal to notify that apply() method is done
@@ -51,7 +60,9 @@ protected slots:
     void onProcessReadyReadStandardOutput();
 
 protected:
-    virtual cv::Mat filter(const cv::Mat & src) const;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    cv::Mat filterV1(const cv::Mat & src, const FilterMonitor & monitor) const;
+    cv::Mat filterV2(const cv::Mat & src, const FilterMonitor & monitor) const;
 
 private:
     void buildSourceFile();
@@ -61,12 +72,20 @@ private:
     bool loadLibrary();
     bool unloadLibrary();
 
+    QString computeBuildKey(const QString & program) const;
+    QString getCachedLibraryPath(const QString & buildKey) const;
+    bool cacheAndLoadLibrary();
+    void pruneBuildCache(int maxCount);
+
     void displayEnv() const;
 
     void processTask();
 
 	QString _cmakePath;
     QString _sourceFilePath;
+    //! Key of the library being built and path of the library to load
+    QString _buildKey;
+    QString _libraryPath;
     QProcess * _process;
     QList<QStringList> _tasks;
     QLibrary * _libraryLoader;
@@ -91,6 +110,39 @@ private:
     typedef bool (*LibVerboseStackNextP2)(uchar * odata, char * msg);
     LibVerboseStackNextP2 _libVerboseStackNextP2;
 
+    //! ABI v1 library functions use global state : calls are serialized
+    mutable QMutex _libV1Mutex;
+
+    // Library functions of ABI v2 : reentrant calls with an explicit context
+    int _libAbiVersion;
+
+    typedef int (*LibHaloSize)();
+    LibHaloSize _libHaloSize;
+
+    typedef void * (*LibCreateContext)(float nodatavalue);
+    LibCreateContext _libCreateContext;
+
+    typedef void (*LibDestroyContext)(void * context);
+    LibDestroyContext _libDestroyContext;
+
+    typedef int (*LibFilterFunc)(void * context,
+                                 const uchar * idata, int iw, int ih, int itype, size_t istep,
+                                 uchar * odata, int ow, int oh, int otype, size_t ostep,
+                                 int * rw, int * rh, int * rtype);
+    LibFilterFunc _libFilterFunc;
+
+    typedef bool (*LibTakeResult)(void * context, uchar * odata, size_t ostep);
+    LibTakeResult _libTakeResult;
+
+    typedef int (*LibVerboseCount)(void * context);
+    LibVerboseCount _libVerboseCount;
+
+    typedef bool (*LibVerboseNext)(void * context, int * ow, int *oh, int *otype, int * msgsize);
+    LibVerboseNext _libVerboseNext;
+
+    typedef bool (*LibVerboseTake)(void * context, uchar * odata, size_t ostep, char * msg);
+    LibVerboseTake _libVerboseTake;
+
 
 };
 
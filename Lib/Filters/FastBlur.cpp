@@ -0,0 +1,502 @@
+
+// Qt
+#include <QtGlobal>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "FastBlur.h"
+
+// STD
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace Filters
+{
+
+//******************************************************************************
+
+namespace
+{
+
+//! Largest gaussian kernel applied directly
+const int SmallKernelSize = 15;
+
+//******************************************************************************
+/*!
+  Weights of pixels (CV_32F) : 1 for valid pixels and 0 for no-data pixels. Empty matrix if mask is empty
+*/
+cv::Mat validWeights(const cv::Mat & noDataMask)
+{
+    cv::Mat w;
+    if (noDataMask.empty())
+        return w;
+    cv::compare(noDataMask, 0, w, cv::CMP_EQ);
+    w.convertTo(w, CV_32F, 1.0/255.0);
+    return w;
+}
+
+//******************************************************************************
+/*!
+  Normalized convolution result : filtered weighted data divided by filtered weights
+*/
+cv::Mat normalizeByWeights(const cv::Mat & sum, const cv::Mat & weights)
+{
+    cv::Mat out;
+    cv::divide(sum, cv::max(weights, FLT_EPSILON), out);
+    return out;
+}
+
+//******************************************************************************
+
+void computeSigmas(cv::Size ksize, double & sigmaX, double & sigmaY)
+{
+    if (sigmaY <= 0)
+        sigmaY = sigmaX;
+    if (sigmaX <= 0)
+        sigmaX = 0.3*((ksize.width - 1)*0.5 - 1) + 0.8;
+    if (sigmaY <= 0)
+        sigmaY = 0.3*((ksize.height - 1)*0.5 - 1) + 0.8;
+}
+
+//******************************************************************************
+/*!
+  Sizes of n stacked box filters with the variance of the gaussian of the given sigma
+  (W. Jarosz, "Fast image convolutions" ; P. Kovesi, "Fast almost-gaussian filtering")
+*/
+std::vector<int> gaussianBoxSizes(double sigma, int n = 3)
+{
+    double wIdeal = std::sqrt(12.0*sigma*sigma/n + 1.0);
+    int wl = (int) std::floor(wIdeal);
+    if (wl % 2 == 0)
+        wl--;
+    wl = qMax(1, wl);
+    int wu = wl + 2;
+    double mIdeal = (12.0*sigma*sigma - n*wl*wl - 4.0*n*wl - 3.0*n)/(-4.0*wl - 4.0);
+    int m = qRound(mIdeal);
+
+    std::vector<int> sizes;
+    for (int i=0; i<n; i++)
+    {
+        sizes.push_back(i < m ? wl : wu);
+    }
+    return sizes;
+}
+
+//******************************************************************************
+
+cv::Mat stackedBoxFilter(const cv::Mat & src, const std::vector<int> & sizesX, const std::vector<int> & sizesY)
+{
+    cv::Mat out = src;
+    for (size_t i=0; i<sizesX.size(); i++)
+    {
+        cv::Mat tmp;
+        cv::boxFilter(out, tmp, CV_32F, cv::Size(sizesX[i], sizesY[i]));
+        out = tmp;
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Index of the histogram bin containing the value of the given rank
+*/
+int histogramRank(const int * hist, int size, int rank)
+{
+    int sum = 0;
+    for (int i=0; i<size; i++)
+    {
+        sum += hist[i];
+        if (sum > rank)
+            return i;
+    }
+    return size - 1;
+}
+
+//******************************************************************************
+
+void updateColumns8U(const cv::Mat & src, const cv::Mat & valid, int y, int d, std::vector<int> & columns, std::vector<int> & counts)
+{
+    const uchar * s = src.ptr<uchar>(y);
+    const uchar * v = valid.empty() ? 0 : valid.ptr<uchar>(y);
+    for (int x=0; x<src.cols; x++)
+    {
+        if (v && !v[x])
+            continue;
+        columns[x*256 + s[x]] += d;
+        counts[x] += d;
+    }
+}
+
+//******************************************************************************
+
+void updateKernel8U(int * kernel, int & count, const std::vector<int> & columns, const std::vector<int> & counts, int x, int d)
+{
+    const int * c = &columns[x*256];
+    for (int i=0; i<256; i++)
+    {
+        kernel[i] += d*c[i];
+    }
+    count += d*counts[x];
+}
+
+//******************************************************************************
+/*!
+  Median of 8-bit data with column histograms (S. Perreault, P. Hebert, "Median filtering in constant time") :
+  column histograms are moved down by one row and the kernel histogram is moved right by one column histogram
+*/
+cv::Mat median8U(const cv::Mat & src, const cv::Mat & valid, int r)
+{
+    const int w = src.cols, h = src.rows;
+    cv::Mat dst(h, w, CV_8U, cv::Scalar(0));
+    std::vector<int> columns(w*256, 0), counts(w, 0);
+    int kernel[256];
+
+    for (int y=0; y<qMin(r, h); y++)
+    {
+        updateColumns8U(src, valid, y, 1, columns, counts);
+    }
+
+    for (int y=0; y<h; y++)
+    {
+        if (y + r < h)
+            updateColumns8U(src, valid, y + r, 1, columns, counts);
+        if (y - r - 1 >= 0)
+            updateColumns8U(src, valid, y - r - 1, -1, columns, counts);
+
+        std::fill(kernel, kernel + 256, 0);
+        int count = 0;
+        for (int x=0; x<=qMin(r, w-1); x++)
+        {
+            updateKernel8U(kernel, count, columns, counts, x, 1);
+        }
+
+        uchar * out = dst.ptr<uchar>(y);
+        for (int x=0; x<w; x++)
+        {
+            if (count > 0)
+                out[x] = (uchar) histogramRank(kernel, 256, (count - 1)/2);
+            if (x + r + 1 < w)
+                updateKernel8U(kernel, count, columns, counts, x + r + 1, 1);
+            if (x - r >= 0)
+                updateKernel8U(kernel, count, columns, counts, x - r, -1);
+        }
+    }
+    return dst;
+}
+
+//******************************************************************************
+
+template <typename T>
+void addHistogram(int * dst, const T * src, int d)
+{
+    for (int i=0; i<256; i++)
+    {
+        dst[i] += d*src[i];
+    }
+}
+
+//******************************************************************************
+/*!
+  Column histograms of 16-bit data for the columns [c0, c1) : a coarse histogram of the high bytes (256 bins)
+  and a fine histogram of the values (65536 bins) per column
+*/
+struct Columns16U
+{
+    Columns16U(int c0, int c1) :
+        c0(c0),
+        coarse((c1 - c0)*256, 0),
+        fine((size_t) (c1 - c0)*65536, 0),
+        counts(c1 - c0, 0)
+    {}
+
+    void update(const cv::Mat & src, const cv::Mat & valid, int y, int d)
+    {
+        const ushort * s = src.ptr<ushort>(y) + c0;
+        const uchar * v = valid.empty() ? 0 : valid.ptr<uchar>(y) + c0;
+        for (int i=0; i<(int) counts.size(); i++)
+        {
+            if (v && !v[i])
+                continue;
+            ushort value = s[i];
+            fine[(size_t) i*65536 + value] += d;
+            coarse[i*256 + (value >> 8)] += d;
+            counts[i] += d;
+        }
+    }
+
+    const ushort * coarseAt(int i) const
+    { return &coarse[i*256]; }
+    const ushort * fineAt(int i, int c) const
+    { return &fine[(size_t) i*65536 + c*256]; }
+
+    int c0;
+    std::vector<ushort> coarse;
+    std::vector<ushort> fine;
+    std::vector<int> counts;
+};
+
+//******************************************************************************
+/*!
+  Median of the strip of output columns [c0 + r, c1 - r) with the column histograms of the columns [c0, c1)
+*/
+void median16UStrip(const cv::Mat & src, const cv::Mat & valid, int r, int c0, int c1, cv::Mat & dst)
+{
+    const int h = src.rows, n = 2*r + 1;
+    Columns16U columns(c0, c1);
+    std::vector<int> coarse(256), fine(65536), refreshed(256);
+
+    for (int y=0; y<n-1; y++)
+    {
+        columns.update(src, valid, y, 1);
+    }
+
+    for (int y=r; y<h-r; y++)
+    {
+        // columns are moved down with one update per pixel
+        columns.update(src, valid, y + r, 1);
+        if (y - r - 1 >= 0)
+            columns.update(src, valid, y - r - 1, -1);
+
+        std::fill(coarse.begin(), coarse.end(), 0);
+        int count = 0;
+        for (int i=0; i<n; i++)
+        {
+            addHistogram(&coarse[0], columns.coarseAt(i), 1);
+            count += columns.counts[i];
+        }
+        // fine bins are refreshed only when the median falls into them
+        std::fill(refreshed.begin(), refreshed.end(), -1);
+
+        ushort * out = dst.ptr<ushort>(y) + c0 + r;
+        for (int i=0; i+n<=c1-c0; i++)
+        {
+            if (i > 0)
+            {
+                addHistogram(&coarse[0], columns.coarseAt(i + n - 1), 1);
+                addHistogram(&coarse[0], columns.coarseAt(i - 1), -1);
+                count += columns.counts[i + n - 1] - columns.counts[i - 1];
+            }
+            if (count == 0)
+                continue;
+
+            int rank = (count - 1)/2;
+            int sum = 0, c = 0;
+            for (; c<255; c++)
+            {
+                if (sum + coarse[c] > rank)
+                    break;
+                sum += coarse[c];
+            }
+
+            // fine bins of c are moved from the column where they have been refreshed last
+            // or are recomputed if it is cheaper
+            int * f = &fine[c*256];
+            int last = refreshed[c];
+            if (last < 0 || 2*(i - last) >= n)
+            {
+                std::fill(f, f + 256, 0);
+                for (int j=i; j<i+n; j++)
+                {
+                    addHistogram(f, columns.fineAt(j, c), 1);
+                }
+            }
+            else
+            {
+                for (int j=last+1; j<=i; j++)
+                {
+                    addHistogram(f, columns.fineAt(j + n - 1, c), 1);
+                    addHistogram(f, columns.fineAt(j - 1, c), -1);
+                }
+            }
+            refreshed[c] = i;
+            out[i] = (ushort) (c*256 + histogramRank(f, 256, rank - sum));
+        }
+    }
+}
+
+//******************************************************************************
+/*!
+  Median of 16-bit data with two-level column histograms (S. Perreault, P. Hebert, "Median filtering in constant time") :
+  columns are moved down with one update per pixel, the coarse kernel histogram is moved right by one column and
+  the fine kernel histogram is refreshed lazily in the coarse bin of the median only.
+  Only pixels at the distance r from the borders are computed : data is padded by the caller.
+  Data is processed by vertical strips wider than the window (memory of the fine column histograms is limited),
+  thus the cost per pixel does not depend on r
+*/
+cv::Mat median16U(const cv::Mat & src, const cv::Mat & valid, int r)
+{
+    const int w = src.cols, h = src.rows;
+    cv::Mat dst(h, w, CV_16U, cv::Scalar(0));
+    if (w < 2*r + 1 || h < 2*r + 1)
+        return dst;
+
+    const int stripWidth = qMax(64, 2*r);
+    for (int x=r; x<w-r; x+=stripWidth)
+    {
+        median16UStrip(src, valid, r, x - r, qMin(w - r, x + stripWidth) + r, dst);
+    }
+    return dst;
+}
+
+//******************************************************************************
+
+//! Median of the data padded by r
+cv::Mat medianSingleChannel(const cv::Mat & src, int r, const cv::Mat & noDataMask)
+{
+    cv::Mat valid;
+    if (!noDataMask.empty())
+        cv::compare(noDataMask, 0, valid, cv::CMP_EQ);
+
+    if (src.depth() == CV_8U)
+        return median8U(src, valid, r);
+    if (src.depth() == CV_16U)
+        return median16U(src, valid, r);
+
+    double minVal = 0.0, maxVal = -1.0;
+    if (valid.empty() || cv::countNonZero(valid) > 0)
+        cv::minMaxLoc(src, &minVal, &maxVal, 0, 0, valid);
+    if (maxVal < minVal)
+        return cv::Mat::zeros(src.size(), src.type());
+
+    // Integer values are filtered without quantization :
+    cv::Mat data, rounded;
+    src.convertTo(data, CV_64F);
+    data.convertTo(rounded, CV_32S);
+    rounded.convertTo(rounded, CV_64F);
+    bool isIntegral = cv::norm(data, rounded, cv::NORM_INF, valid) == 0.0;
+
+    double range = maxVal - minVal;
+    cv::Mat q, out;
+    if (isIntegral && range < 256)
+    {
+        src.convertTo(q, CV_8U, 1.0, -minVal);
+        median8U(q, valid, r).convertTo(out, src.depth(), 1.0, minVal);
+    }
+    else
+    {
+        double scale = (isIntegral && range < 65536) || range == 0.0 ? 1.0 : 65535.0/range;
+        src.convertTo(q, CV_16U, scale, -minVal*scale);
+        median16U(q, valid, r).convertTo(out, src.depth(), 1.0/scale, minVal);
+    }
+    return out;
+}
+
+}
+
+//******************************************************************************
+
+cv::Mat meanFilter(const cv::Mat &src, cv::Size ksize, const cv::Mat &noDataMask)
+{
+    cv::Mat out;
+    if (noDataMask.empty())
+    {
+        cv::blur(src, out, ksize);
+        return out;
+    }
+
+    cv::Mat data, sum, count;
+    src.convertTo(data, CV_32F);
+    cv::Mat w = validWeights(noDataMask);
+    // Box filter uses running sums : the cost does not depend on ksize
+    cv::boxFilter(data.mul(w), sum, CV_32F, ksize, cv::Point(-1,-1), false);
+    cv::boxFilter(w, count, CV_32F, ksize, cv::Point(-1,-1), false);
+    normalizeByWeights(sum, count).convertTo(out, src.depth());
+    return out;
+}
+
+//******************************************************************************
+
+cv::Mat gaussianFilter(const cv::Mat &src, cv::Size ksize, double sigmaX, double sigmaY, const cv::Mat &noDataMask)
+{
+    cv::Mat out;
+    computeSigmas(ksize, sigmaX, sigmaY);
+    bool isSmall = qMax(ksize.width, ksize.height) <= SmallKernelSize;
+    if (isSmall && noDataMask.empty())
+    {
+        cv::GaussianBlur(src, out, ksize, sigmaX, sigmaY);
+        return out;
+    }
+
+    cv::Mat data, sum, weights;
+    src.convertTo(data, CV_32F);
+    cv::Mat w = validWeights(noDataMask);
+    if (!w.empty())
+        data = data.mul(w);
+
+    if (isSmall)
+    {
+        cv::GaussianBlur(data, sum, ksize, sigmaX, sigmaY);
+        cv::GaussianBlur(w, weights, ksize, sigmaX, sigmaY);
+    }
+    else
+    {
+        std::vector<int> sizesX = gaussianBoxSizes(sigmaX);
+        std::vector<int> sizesY = gaussianBoxSizes(sigmaY);
+        sum = stackedBoxFilter(data, sizesX, sizesY);
+        if (!w.empty())
+            weights = stackedBoxFilter(w, sizesX, sizesY);
+    }
+
+    out = w.empty() ? sum : normalizeByWeights(sum, weights);
+    out.convertTo(out, src.depth());
+    return out;
+}
+
+//******************************************************************************
+
+int gaussianHaloSize(cv::Size ksize, double sigmaX, double sigmaY)
+{
+    computeSigmas(ksize, sigmaX, sigmaY);
+    if (qMax(ksize.width, ksize.height) <= SmallKernelSize)
+        return qMax(ksize.width, ksize.height)/2;
+
+    int haloX = 0, haloY = 0;
+    std::vector<int> sizesX = gaussianBoxSizes(sigmaX);
+    std::vector<int> sizesY = gaussianBoxSizes(sigmaY);
+    for (size_t i=0; i<sizesX.size(); i++)
+    {
+        haloX += sizesX[i]/2;
+        haloY += sizesY[i]/2;
+    }
+    return qMax(haloX, haloY);
+}
+
+//******************************************************************************
+
+cv::Mat medianFilter(const cv::Mat &src, int ksize, const cv::Mat &noDataMask)
+{
+    cv::Mat out;
+    ksize = qMax(1, ksize | 1);
+    int depth = src.depth();
+    if (noDataMask.empty() &&
+            (depth == CV_8U || (ksize <= 5 && (depth == CV_16U || depth == CV_32F))))
+    {
+        cv::medianBlur(src, out, ksize);
+        return out;
+    }
+
+    // Borders are replicated as in cv::medianBlur : histograms are computed on padded data
+    int r = ksize/2;
+    cv::Mat data, mask;
+    cv::copyMakeBorder(src, data, r, r, r, r, cv::BORDER_REPLICATE);
+    if (!noDataMask.empty())
+        cv::copyMakeBorder(noDataMask, mask, r, r, r, r, cv::BORDER_REPLICATE);
+
+    std::vector<cv::Mat> channels, masks;
+    cv::split(data, channels);
+    if (!mask.empty())
+        cv::split(mask, masks);
+    for (size_t i=0; i<channels.size(); i++)
+    {
+        channels[i] = medianSingleChannel(channels[i], r, masks.empty() ? cv::Mat() : masks[i]);
+    }
+    cv::merge(channels, out);
+    return out(cv::Rect(r, r, src.cols, src.rows)).clone();
+}
+
+//******************************************************************************
+
+}
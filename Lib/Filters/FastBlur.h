@@ -0,0 +1,50 @@
+#ifndef FASTBLUR_H
+#define FASTBLUR_H
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "Core/LibExport.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+// Blur methods with a cost per pixel independent of the window size.
+// Optional no-data mask is an 8-bit matrix with the channels of src, non-zero where data is not valid :
+// output values are computed only from valid pixels, output values of invalid pixels are not defined.
+//******************************************************************************
+
+/*!
+  \brief meanFilter method computes the mean of valid pixels in the window of size ksize
+*/
+cv::Mat GIV_DLL_EXPORT meanFilter(const cv::Mat & src, cv::Size ksize, const cv::Mat & noDataMask = cv::Mat());
+
+/*!
+  \brief gaussianFilter method computes the gaussian blur of valid pixels.
+  Small kernels (up to 15 pixels) are applied with cv::GaussianBlur, larger kernels are approximated
+  with three stacked box filters of the same variance (the kernel is not truncated to ksize, see gaussianHaloSize())
+  \param sigmaX, sigmaY, if not positive they are computed from ksize as in cv::getGaussianKernel
+*/
+cv::Mat GIV_DLL_EXPORT gaussianFilter(const cv::Mat & src, cv::Size ksize, double sigmaX, double sigmaY, const cv::Mat & noDataMask = cv::Mat());
+
+/*!
+  \brief gaussianHaloSize method returns the neighbourhood radius used by gaussianFilter()
+*/
+int GIV_DLL_EXPORT gaussianHaloSize(cv::Size ksize, double sigmaX, double sigmaY);
+
+/*!
+  \brief medianFilter method computes the (lower) median of valid pixels in the window ksize x ksize.
+  Borders are replicated as in cv::medianBlur, used for small kernels without no-data. ksize should be odd.
+  8-bit data is filtered with column histograms and 16-bit data with two-level (coarse/fine) column histograms,
+  both in constant time per pixel. Other data is filtered as 8-bit or 16-bit data if values are
+  integers in a range of 256 or 65536 values, otherwise values are quantized on 65536 levels of the data range.
+*/
+cv::Mat GIV_DLL_EXPORT medianFilter(const cv::Mat & src, int ksize, const cv::Mat & noDataMask = cv::Mat());
+
+//******************************************************************************
+
+}
+
+#endif // FASTBLUR_H
@@ -0,0 +1,178 @@
+
+// Project
+#include "FilterPipeline.h"
+
+
+namespace Filters
+{
+
+//******************************************************************************
+/*!
+  \class FilterPipeline
+  \brief applies a chain of filters in a single pass
+
+  Filters are applied one after another on the same data, e.g. Blur -> Power -> ConvertTo8U.
+  Applied with TiledFilterEngine, the whole chain runs on each tile and only the final result is
+  stored and used to compute image stats : intermediate results exist only for one tile at a time
+  and are released as soon as the next filter has been applied.
+
+  Intermediate results are written into two buffers of the calling thread used in turn (ping-pong) :
+  processing the next tile in the same thread reuses their memory if filters write into the given
+  matrix (see AbstractFilter::filterWithMaskTo()). The result of the last filter is not a buffer.
+
+  Halo of the pipeline is the sum of the halos of the filters. If one of the filters needs
+  the whole image, the pipeline needs the whole image too : TiledFilterEngine applies the filters
+  before this one on tiles and the remaining filters on the whole intermediate image.
+
+  No-data mask is computed once for the whole chain and passed to each filter.
+  Run is canceled between filters and each filter reports progress in its part of the progress range.
+
+  Filters are not owned by the pipeline.
+*/
+
+//******************************************************************************
+
+FilterPipeline::FilterPipeline(QObject *parent) :
+    AbstractFilter(parent)
+{
+    _name = tr("Filter pipeline");
+    _description = tr("Apply a chain of filters");
+}
+
+//******************************************************************************
+
+void FilterPipeline::append(const AbstractFilter *filter)
+{
+    if (!filter || filter == this)
+        return;
+    _filters << filter;
+
+    QStringList names;
+    foreach (const AbstractFilter * f, _filters)
+    {
+        names << f->getName();
+    }
+    _name = names.join(" + ");
+}
+
+//******************************************************************************
+
+void FilterPipeline::clear()
+{
+    _filters.clear();
+    _name = tr("Filter pipeline");
+}
+
+//******************************************************************************
+
+int FilterPipeline::getHaloSize() const
+{
+    int halo = 0;
+    foreach (const AbstractFilter * f, _filters)
+    {
+        int h = f->getHaloSize();
+        if (h < 0)
+            return -1;
+        halo += h;
+    }
+    return halo;
+}
+
+//******************************************************************************
+
+cv::Mat FilterPipeline::filter(const cv::Mat &src, const FilterMonitor & monitor) const
+{
+    if (_filters.isEmpty())
+    {
+        monitor.setError(tr("Filter pipeline is empty"));
+        return cv::Mat();
+    }
+
+    cv::Mat data = src;
+    int n = _filters.size();
+    for (int i=0; i<n; i++)
+    {
+        const AbstractFilter * f = _filters[i];
+        // Each filter of the chain reports its progress in its part of the pipeline progress range
+        FilterMonitor m(&monitor, (100 * i) / n, (100 * (i + 1)) / n);
+        // Previous intermediate result is released on assignment
+        data = f->apply(data, &m);
+        if (monitor.isCanceled())
+            return cv::Mat();
+        if (data.empty())
+        {
+            monitor.setError(tr("Filter \'%1\' has failed in the pipeline :\n %2")
+                             .arg(f->getName())
+                             .arg(m.getErrorMessage()));
+            return data;
+        }
+    }
+    return data;
+}
+
+//******************************************************************************
+
+cv::Mat FilterPipeline::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor & monitor) const
+{
+    if (_filters.isEmpty())
+    {
+        monitor.setError(tr("Filter pipeline is empty"));
+        return cv::Mat();
+    }
+
+    if (!_buffers.hasLocalData())
+        _buffers.setLocalData(new PipelineBuffers());
+    cv::Mat * buffers = _buffers.localData()->buffers;
+
+    cv::Mat data = src;
+    int n = _filters.size();
+    for (int i=0; i<n; i++)
+    {
+        const AbstractFilter * f = _filters[i];
+        FilterMonitor m(&monitor, (100 * i) / n, (100 * (i + 1)) / n);
+        // Mask is valid while filters keep data size and nb of channels
+        bool maskIsValid = noDataMask.empty() ||
+                (data.cols == noDataMask.cols &&
+                 data.rows == noDataMask.rows &&
+                 data.channels() == noDataMask.channels());
+        if (maskIsValid && i < n - 1)
+        {
+            cv::Mat & buffer = buffers[i % 2];
+            // A filter could have returned its input : buffer can not be the output of the next filter
+            if (buffer.datastart == data.datastart)
+                buffer.release();
+            f->filterWithMaskTo(data, noDataMask, buffer, m);
+            data = buffer;
+        }
+        else
+        {
+            data = maskIsValid ? f->filterWithMask(data, noDataMask, m) : f->apply(data, &m);
+        }
+        if (monitor.isCanceled() || data.empty())
+        {
+            buffers[0].release();
+            buffers[1].release();
+        }
+        if (monitor.isCanceled())
+            return cv::Mat();
+        if (data.empty())
+        {
+            monitor.setError(tr("Filter \'%1\' has failed in the pipeline :\n %2")
+                             .arg(f->getName())
+                             .arg(m.getErrorMessage()));
+            return data;
+        }
+    }
+    // Buffers sharing data with the source or the result are not reused for the next tile
+    for (int i=0; i<2; i++)
+    {
+        if (buffers[i].datastart == src.datastart || buffers[i].datastart == data.datastart)
+            buffers[i].release();
+    }
+    writeNoData(data, noDataMask);
+    return data;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,55 @@
+#ifndef FILTERPIPELINE_H
+#define FILTERPIPELINE_H
+
+// Qt
+#include <QObject>
+#include <QList>
+#include <QThreadStorage>
+
+// Project
+#include "Filters/AbstractFilter.h"
+
+namespace Filters
+{
+
+//! Intermediate results of a pipeline run in a thread
+struct PipelineBuffers
+{
+    cv::Mat buffers[2];
+};
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT FilterPipeline : public AbstractFilter
+{
+    Q_OBJECT
+
+public:
+    FilterPipeline(QObject *parent = 0);
+
+    void append(const AbstractFilter * filter);
+    void clear();
+
+    const QList<const AbstractFilter*> & getFilters() const
+    { return _filters; }
+
+    bool isEmpty() const
+    { return _filters.isEmpty(); }
+
+    virtual int getHaloSize() const;
+
+protected:
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+
+    QList<const AbstractFilter*> _filters;
+    //! Intermediate results of each worker thread
+    mutable QThreadStorage<PipelineBuffers*> _buffers;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // FILTERPIPELINE_H
@@ -0,0 +1,241 @@
+
+// Qt
+#include <qmath.h>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "FilterPreviewDataProvider.h"
+#include "AbstractFilter.h"
+#include "Core/LayerUtils.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+/*!
+  \class FilterPreviewDataProvider
+  \brief provides data of the source provider filtered on demand.
+
+  Nothing is computed in advance : getImageData() reads the requested extent from the source
+  at the requested output size (thus GDAL sources read from the matching overview) with a halo
+  of AbstractFilter::getHaloSize() output pixels, applies the filter and crops the halo.
+  Used with a GeoImageItem, only the tiles visible at the current zoom level are filtered.
+
+  Filter parameters are applied in output pixels, so the preview at reduced resolution
+  is an approximation of the full resolution result. Filters working on the whole image
+  are applied on each tile.
+
+  Tiles are filtered in the loader threads while filter parameters are edited in the GUI thread,
+  thus the provider runs a copy of the filter (see AbstractFilter::clone()). setFilter() replaces
+  the copy with the new parameters, tiles being filtered keep the previous copy until they are done.
+
+  Source provider is not owned by the provider.
+*/
+
+//******************************************************************************
+
+FilterPreviewDataProvider::FilterPreviewDataProvider(QObject *parent) :
+    Core::ImageDataProvider(parent),
+    _source(0)
+{
+}
+
+//******************************************************************************
+/*!
+ * \brief FilterPreviewDataProvider::setup method to setup the provider.
+ * Output data info and stats are computed on a reduced resolution image
+ */
+bool FilterPreviewDataProvider::setup(const AbstractFilter *filter, const Core::ImageDataProvider *source)
+{
+    if (_source)
+        disconnect(_source, SIGNAL(destroyed()), this, SLOT(onSourceDestroyed()));
+
+    _source = source;
+    if (!_source || !setFilter(filter))
+        return false;
+
+    connect(_source, SIGNAL(destroyed()), this, SLOT(onSourceDestroyed()));
+
+    setImageName(tr("Preview of ") + _source->getImageName() + " + " + filter->getName());
+    _location = _source->getLocation();
+    _pixelExtent = _source->getPixelExtent();
+    _width = _inputWidth = _source->getWidth();
+    _height = _inputHeight = _source->getHeight();
+
+    cv::Mat data = getImageData(QRect(), 512);
+    if (data.empty())
+    {
+        SD_TRACE("FilterPreviewDataProvider::setup : failed to filter data");
+        setFilter(0);
+        return false;
+    }
+
+    _nbBands = _inputNbBands = data.channels();
+    _depth = _inputDepth = data.elemSize1();
+    _isComplex = _inputIsComplex = false;
+    _bandNames.clear();
+    for (int i=0; i<_nbBands; i++)
+    {
+        _bandNames << QString("band %1").arg(i+1);
+    }
+
+    cv::Mat mask = Core::ImageDataProvider::computeMask(data);
+    if (!Core::computeNormalizedHistogram(data, mask,
+                                          _minValues,
+                                          _maxValues,
+                                          _bandHistograms,
+                                          1000))
+    {
+        SD_TRACE("FilterPreviewDataProvider::setup : Failed to compute image stats");
+        setFilter(0);
+        return false;
+    }
+    return true;
+}
+
+//******************************************************************************
+
+/*!
+  Method to replace the filter applied on the tiles by a copy of the filter. Filter is reset if null.
+  No-data value of the copy is the value of the providers data, the filter itself is not modified.
+  \return false if the filter can not be copied
+*/
+bool FilterPreviewDataProvider::setFilter(const AbstractFilter *filter)
+{
+    QSharedPointer<const AbstractFilter> copy;
+    if (filter)
+    {
+        AbstractFilter * f = filter->clone();
+        if (!f)
+            return false;
+        f->setNoDataValue(Core::ImageDataProvider::NoDataValue);
+        copy = QSharedPointer<const AbstractFilter>(f);
+    }
+    QMutexLocker locker(&_filterMutex);
+    _filter = copy;
+    return !_filter.isNull();
+}
+
+//******************************************************************************
+
+QSharedPointer<const AbstractFilter> FilterPreviewDataProvider::getFilter() const
+{
+    QMutexLocker locker(&_filterMutex);
+    return _filter;
+}
+
+//******************************************************************************
+
+void FilterPreviewDataProvider::onSourceDestroyed()
+{
+    _source = 0;
+}
+
+//******************************************************************************
+
+cv::Mat FilterPreviewDataProvider::getImageData(const QRect &srcPixelExtent, int dstPixelWidth, int dstPixelHeight) const
+{
+    cv::Mat out;
+    QSharedPointer<const AbstractFilter> filter = getFilter();
+    if (!filter || !_source)
+        return out;
+
+    QRect srcRequestedExtent, srcExtent;
+    // If source pixel extent is not specified -> take the whole image pixel extent
+    if (srcPixelExtent.isEmpty())
+    {
+        srcRequestedExtent = _pixelExtent;
+        srcExtent = _pixelExtent;
+    }
+    else
+    {
+        srcRequestedExtent = _pixelExtent.intersected(srcPixelExtent);
+        srcExtent = srcPixelExtent;
+    }
+
+    if (srcRequestedExtent.isEmpty())
+        return out;
+
+    // If destination pixel extent is not specified -> take extent equals source extent <=> full resolution
+    QSize dstPixelExtent;
+    if (dstPixelWidth == 0 && dstPixelHeight == 0)
+    { // Full resolution
+        dstPixelExtent = srcExtent.size();
+    }
+    else if (dstPixelHeight == 0)
+    { // output keeps aspect ratio
+        int h = dstPixelWidth * srcExtent.height() * 1.0 / srcExtent.width();
+        dstPixelExtent = QSize(dstPixelWidth, h);
+    }
+    else
+    {
+        dstPixelExtent = QSize(dstPixelWidth, dstPixelHeight);
+    }
+
+    double scaleX = dstPixelExtent.width() * 1.0 / srcExtent.width();
+    double scaleY = dstPixelExtent.height() * 1.0 / srcExtent.height();
+
+    // Read source data with the halo at the requested scale :
+    int halo = qMax(0, filter->getHaloSize());
+    int haloX = qCeil(halo / scaleX);
+    int haloY = qCeil(halo / scaleY);
+    QRect haloExtent = srcRequestedExtent.adjusted(-haloX, -haloY, haloX, haloY).intersected(_pixelExtent);
+    int haloW = qMax(1, qRound(scaleX * haloExtent.width()));
+    int haloH = qMax(1, qRound(scaleY * haloExtent.height()));
+
+    cv::Mat data = _source->getImageData(haloExtent, haloW, haloH);
+    if (data.empty())
+        return out;
+
+    // Error message stays in the local monitor, the filter copy is shared by the loader threads
+    FilterMonitor monitor;
+    cv::Mat res = filter->apply(data, &monitor);
+    if (res.empty() || res.rows != data.rows || res.cols != data.cols)
+        return out;
+    if (res.depth() != CV_32F)
+        res.convertTo(res, CV_32F);
+
+    int reqScaledW = qMin(qCeil(scaleX*srcRequestedExtent.width()), dstPixelExtent.width());
+    int reqScaledH = qMin(qCeil(scaleY*srcRequestedExtent.height()), dstPixelExtent.height());
+
+    if (_cutNoDataBRBoundary &&
+            (srcRequestedExtent.x() == srcExtent.x()) &&
+            (srcRequestedExtent.y() == srcExtent.y()))
+    {
+        if (reqScaledW < dstPixelExtent.width())
+            dstPixelExtent.setWidth(reqScaledW);
+        if (reqScaledH < dstPixelExtent.height())
+            dstPixelExtent.setHeight(reqScaledH);
+    }
+
+    // Crop the halo :
+    cv::Rect r(qRound(scaleX*(srcRequestedExtent.x() - haloExtent.x())),
+               qRound(scaleY*(srcRequestedExtent.y() - haloExtent.y())),
+               reqScaledW,
+               reqScaledH);
+    r &= cv::Rect(0, 0, res.cols, res.rows);
+
+    // Write into the output as other providers do :
+    cv::Rect d(qFloor(scaleX*(srcRequestedExtent.x() - srcExtent.x())),
+               qFloor(scaleY*(srcRequestedExtent.y() - srcExtent.y())),
+               reqScaledW,
+               reqScaledH);
+
+    out = cv::Mat(dstPixelExtent.height(),
+                  dstPixelExtent.width(),
+                  CV_32FC(res.channels()));
+    out.setTo(NoDataValue);
+    d &= cv::Rect(0, 0, out.cols, out.rows);
+    if (r.area() == 0 || d.area() == 0)
+        return out;
+
+    cv::Mat dstMat = out(d);
+    cv::resize(res(r), dstMat, dstMat.size());
+    return out;
+}
+
+//******************************************************************************
+
+}
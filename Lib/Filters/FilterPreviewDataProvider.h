@@ -0,0 +1,60 @@
+#ifndef FILTERPREVIEWDATAPROVIDER_H
+#define FILTERPREVIEWDATAPROVIDER_H
+
+// Qt
+#include <QMutex>
+#include <QSharedPointer>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "Core/Global.h"
+#include "Core/LibExport.h"
+#include "Core/ImageDataProvider.h"
+
+namespace Filters
+{
+
+class AbstractFilter;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT FilterPreviewDataProvider : public Core::ImageDataProvider
+{
+    Q_OBJECT
+public:
+    explicit FilterPreviewDataProvider(QObject *parent = 0);
+
+    virtual cv::Mat getImageData(const QRect & srcPixelExtent=QRect(), int dstPixelWidth=0, int dstPixelHeight=0) const;
+    bool setup(const AbstractFilter * filter, const Core::ImageDataProvider * source);
+    bool setFilter(const AbstractFilter * filter);
+
+    virtual QString fetchProjectionRef() const
+    { return _source ? _source->fetchProjectionRef() : Core::ImageDataProvider::fetchProjectionRef(); }
+    virtual QPolygonF fetchGeoExtent(const QVector<QPoint> & points=QVector<QPoint>()) const
+    { return _source ? _source->fetchGeoExtent(points) : Core::ImageDataProvider::fetchGeoExtent(points); }
+    virtual QVector<double> fetchGeoTransform() const
+    { return _source ? _source->fetchGeoTransform() : Core::ImageDataProvider::fetchGeoTransform(); }
+
+    virtual bool isValid() const
+    { return getFilter() && _source; }
+
+protected slots:
+    void onSourceDestroyed();
+
+protected:
+    QSharedPointer<const AbstractFilter> getFilter() const;
+
+    //! Copy of the filter, replaced under the mutex when parameters change
+    QSharedPointer<const AbstractFilter> _filter;
+    mutable QMutex _filterMutex;
+    const Core::ImageDataProvider * _source;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // FILTERPREVIEWDATAPROVIDER_H
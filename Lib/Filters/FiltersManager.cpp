@@ -12,7 +12,10 @@
 #include "PowerFilter.h"
 #include "DifferentialFilter.h"
 #include "ConvertTo8U.h"
+#include "MorphologyFilter.h"
 #include "EditableFilter.h"
+#include "ProcessFilter.h"
+#include "TiledFilterEngine.h"
 #include "Core/Global.h"
 #include "Core/ImageDataProvider.h"
 #include "Core/FloatingDataProvider.h"
@@ -26,42 +29,58 @@ class FilterTask : public QRunnable
 {
 public:
     FilterTask():
-        _canceled(false),
+        _canceled(0),
         _srcProvider(0),
         _dstProvider(0),
         _filter(0)
     {
-        setAutoDelete(true);
+    }
+
+    ~FilterTask()
+    {
+        setFilter(0);
     }
 
     virtual void run();
 
     void setSource(const Core::ImageDataProvider * p)
     {
-        _canceled = true;
         _srcProvider = p;
     }
 
-    void setOutput(Core::FloatingDataProvider * o)
-    { _dstProvider = o; }
-
     Core::ImageDataProvider * getOutput()
     { return _dstProvider; }
 
-    void setFilter(const AbstractFilter * filter)
+    TiledFilterEngine * getEngine()
+    { return &_engine; }
+
+    //! Task takes the ownership of the filter copy. The copy lives in the thread of the manager and is released there
+    void setFilter(AbstractFilter * filter)
     {
-        _canceled = true;
+        if (_filter)
+            _filter->deleteLater();
         _filter = filter;
     }
 
     const AbstractFilter * getFilter() const
     { return _filter; }
 
+    //! Method to cancel the run, it does not wait for the end of the run
+    void cancel()
+    {
+        _canceled.store(1);
+        _engine.cancel();
+    }
+
+    bool isCanceled() const
+    { return _canceled.load() != 0; }
+
 protected:
-    bool _canceled;
-    const AbstractFilter * _filter;
+    QAtomicInt _canceled;
+    AbstractFilter * _filter;
     const Core::ImageDataProvider * _srcProvider;
-    Core::FloatingDataProvider * _dstProvider;
+    Core::ImageDataProvider * _dstProvider;
+    TiledFilterEngine _engine;
 };
 
 
@@ -70,15 +89,21 @@ FiltersManager * FiltersManager::_instance = 0;
 //******************************************************************************
 
 FiltersManager::FiltersManager() :
+    _pool(new QThreadPool(this)),
     _task(0),
     _isWorking(false),
-    _isAsyncTask(true)
+    _isCanceled(false),
+    _isAsyncTask(true),
+    _outOfProcess(false)
 {
+    _pool->setMaxThreadCount(1);
+
     // Insert default filters :
     insertFilter(new BlurFilter());
     insertFilter(new PowerFilter());
     insertFilter(new DifferentialFilter());
     insertFilter(new ConvertTo8U());
+    insertFilter(new MorphologyFilter());
     insertFilter(new EditableFilter());
 }
 
@@ -86,6 +111,13 @@ FiltersManager::FiltersManager() :
 
 FiltersManager::~FiltersManager()
 {
+    {
+        QMutexLocker locker(&_taskMutex);
+        if (_task)
+            _task->cancel();
+        _task = 0;
+    }
+    _pool->waitForDone();
 }
 
 //******************************************************************************
@@ -102,6 +134,7 @@ void FiltersManager::insertFilter(AbstractFilter *filter)
 
 void FiltersManager::loadPlugins(const QString &path)
 {
+    _pluginsPath = path;
     foreach (Core::Plugin pair, Core::PluginLoader::loadAll(path))
     {
         QString fileName = pair.first;
@@ -138,30 +171,48 @@ Core::ImageDataProvider * FiltersManager::applyFilter(AbstractFilter *filter)
 
 //******************************************************************************
 
+/*!
+  Method to apply the filter in background. The filter is copied : the task applies and owns the copy,
+  and the filter can be modified during the run (e.g. by the filtering view).
+  A new task is started for each call : the previous task is canceled without waiting for it and only
+  the result of the last task is delivered with filteringFinished()
+*/
 void FiltersManager::applyFilterInBackground(const AbstractFilter *filter, const Core::ImageDataProvider *provider)
 {
-    // task is automatically deleted on finished
-    _task = new FilterTask();
+    // previous task finishes in the pool and its result is dropped
+    cancel();
 
-    _task->setFilter(filter);
-    _task->setSource(provider);
-    _task->setOutput(new Core::FloatingDataProvider());
+    _errorMessage.clear();
+    _isCanceled = false;
     _isAsyncTask = true;
 
-    connect(filter, &AbstractFilter::progressValue, this, &FiltersManager::filterProgressValueChanged);
-    if (filter->isVerbose())
+    AbstractFilter * copy = filter->clone();
+    if (!copy)
+    {
+        _errorMessage = tr("Filter \'%1\' can not be applied in background").arg(filter->getName());
+        emit filteringFinished(0);
+        return;
+    }
+    copy->setVerbose(filter->isVerbose());
+
+    // task is deleted by the pool at the end of the run
+    FilterTask * task = new FilterTask();
+    task->setFilter(copy);
+    task->setSource(provider);
+    connect(task->getEngine(), &TiledFilterEngine::progressValueChanged, this, &FiltersManager::filterProgressValueChanged);
+
+    connect(copy, &AbstractFilter::progressValue, this, &FiltersManager::filterProgressValueChanged);
+    if (copy->isVerbose())
     {
-        connect(filter, &AbstractFilter::verboseImage, this, &FiltersManager::onVerboseImage);
+        connect(copy, &AbstractFilter::verboseImage, this, &FiltersManager::onVerboseImage);
     }
 
-    QThreadPool * pool = QThreadPool::globalInstance();
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-    pool->clear();
-#endif
-    pool->waitForDone();
-    // Only one thread is possible due to GDAL reader (e.g. TIFF)
-    _isWorking=true;
-    pool->start(_task);
+    {
+        QMutexLocker locker(&_taskMutex);
+        _task = task;
+        _isWorking=true;
+    }
+    _pool->start(task);
 }
 
 //******************************************************************************
@@ -171,17 +222,22 @@ void disconnectFilter(const AbstractFilter * filter, QObject * receiver)
     filter->disconnect(receiver);
 }
 
+/*!
+  Method to cancel the filter applied in background. Method does not wait for the end of the run :
+  running filters stop at their next cancellation check and filteringFinished() is sent with null provider
+*/
 void FiltersManager::cancel()
 {
-    disconnectFilter(_task->getFilter(), this);
-
-    _task->setFilter(0);
-    QThreadPool * pool = QThreadPool::globalInstance();
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
-    pool->clear();
-#endif
-    pool->waitForDone();
-    _isWorking=false;
+    QMutexLocker locker(&_taskMutex);
+    if (!_task || !_isWorking)
+        return;
+
+    if (_task->getFilter())
+        disconnectFilter(_task->getFilter(), this);
+    _task->getEngine()->disconnect(this);
+
+    _isCanceled = true;
+    _task->cancel();
 }
 
 //******************************************************************************
@@ -195,9 +251,24 @@ void FiltersManager::onVerboseImage(const QString &winname, cv::Mat * img)
 
 //******************************************************************************
 
-void FiltersManager::taskFinished(Core::ImageDataProvider * provider)
+void FiltersManager::taskFinished(FilterTask * task, Core::ImageDataProvider * provider, const QString &errorMessage)
 {
-    disconnectFilter(_task->getFilter(), this);
+    // method is called from the task thread at the end of the run
+    if (task->getFilter())
+        disconnectFilter(task->getFilter(), this);
+    task->getEngine()->disconnect(this);
+    task->setFilter(0);
+    task->setSource(0);
+
+    QMutexLocker locker(&_taskMutex);
+    if (task != _task)
+    {
+        // task has been replaced by a new one
+        delete provider;
+        return;
+    }
+    _task = 0;
+    _errorMessage = errorMessage;
     _isWorking=false;
     if (_isAsyncTask)
         emit filteringFinished(provider);
@@ -206,62 +277,52 @@ void FiltersManager::taskFinished(Core::ImageDataProvider * provider)
 //******************************************************************************
 //******************************************************************************
 
-#define ClearData() \
-    if (_dstProvider) { \
-        delete _dstProvider; \
-        _dstProvider = 0;   \
-    }
-
-
-#define Cancel() \
-    if (_canceled) { \
-        ClearData(); \
-        return; \
-    }
-
 void FilterTask::run()
 {
-    _canceled=false;
-    if (!_filter || !_srcProvider)
+    // previous output is owned by the receiver of filteringFinished()
+    _dstProvider = 0;
+    if (isCanceled())
     {
-        ClearData();
-        FiltersManager::get()->taskFinished(0);
+        FiltersManager::get()->taskFinished(this, 0, QObject::tr("Filter is canceled"));
         return;
     }
-
-    if (_srcProvider->getWidth() > 2048 && _srcProvider->getHeight() > 2048)
+    if (!_filter || !_srcProvider)
     {
-        SD_TRACE("FilterTask::run : src is too large");
-        ClearData();
-        _filter->_errorMessage = QObject::tr("Provided image extent is larger than (2048x2048) pixels");
-        FiltersManager::get()->taskFinished(0);
+        FiltersManager::get()->taskFinished(this, 0);
         return;
     }
 
-    Cancel();
-
-    FiltersManager::get()->filterProgressValueChanged(5);
-
-    cv::Mat dstMat;
+    // Filter is applied on overlapping tiles in parallel (or on the whole image if filter needs it)
+    if (FiltersManager::get()->isOutOfProcess())
+    {
+        // Workers are stopped when the process filter is destroyed
+        ProcessFilter processFilter(_filter);
+        if (!FiltersManager::get()->_pluginsPath.isEmpty())
+            processFilter.setPluginsPath(FiltersManager::get()->_pluginsPath);
+        _dstProvider = _engine.apply(&processFilter, _srcProvider);
+    }
+    else
     {
-        cv::Mat srcMat = _srcProvider->getImageData();
-        dstMat = _filter->apply(srcMat);
+        _dstProvider = _engine.apply(_filter, _srcProvider);
     }
 
-    if (dstMat.empty())
+    // run could be canceled before the engine has started
+    if (isCanceled())
     {
-        ClearData();
-        FiltersManager::get()->taskFinished(0);
+        delete _dstProvider;
+        _dstProvider = 0;
+        FiltersManager::get()->taskFinished(this, 0, QObject::tr("Filter is canceled"));
         return;
     }
 
-    FiltersManager::get()->filterProgressValueChanged(60);
-
-    _dstProvider->create(_srcProvider->getImageName() + " + " + _filter->getName(), dstMat);
-    _dstProvider->setupGeoInfo(_srcProvider);
+    if (!_dstProvider)
+    {
+        // error is kept by the manager : filter can be used by other threads (e.g. preview)
+        FiltersManager::get()->taskFinished(this, 0, _engine.getErrorMessage());
+        return;
+    }
 
-    FiltersManager::get()->filterProgressValueChanged(100);
-    FiltersManager::get()->taskFinished(_dstProvider);
+    FiltersManager::get()->taskFinished(this, _dstProvider);
 }
 
 //******************************************************************************
@@ -4,8 +4,11 @@
 // Qt
 #include <QString>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
 
+class QThreadPool;
+
 // Project
 #include "Core/LibExport.h"
 
@@ -65,6 +68,19 @@ public:
     void cancel();
     bool isWorking()
     { return _isWorking; }
+    //! Last filter applied in background has been canceled
+    bool isCanceled() const
+    { return _isCanceled; }
+
+    //! Error message of the last filter applied in background
+    QString getErrorMessage() const
+    { return _errorMessage; }
+
+    //! Filters applied in background are run in worker processes (see ProcessFilter)
+    void setOutOfProcess(bool value)
+    { _outOfProcess = value; }
+    bool isOutOfProcess() const
+    { return _outOfProcess; }
 
 signals:
     void filteringFinished(Core::ImageDataProvider * provider);
@@ -83,10 +99,18 @@ private:
     QHash<QString, AbstractFilter*> _filters;
     QList<AbstractFilter*> _list;
 
+    //! Pool of the background tasks : one thread due to GDAL reader (e.g. TIFF)
+    QThreadPool * _pool;
+    //! Current task, previous canceled tasks finish in the pool without delivering their results
     FilterTask * _task;
-    void taskFinished(Core::ImageDataProvider * provider);
+    QMutex _taskMutex;
+    void taskFinished(FilterTask * task, Core::ImageDataProvider * provider, const QString & errorMessage = QString());
+    QString _errorMessage;
     bool _isAsyncTask;
     bool _isWorking;
+    bool _isCanceled;
+    bool _outOfProcess;
+    QString _pluginsPath;
 
 };
 
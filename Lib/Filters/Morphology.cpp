@@ -0,0 +1,253 @@
+
+// Qt
+#include <QList>
+#include <qmath.h>
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "Morphology.h"
+
+// STD
+#include <cfloat>
+#include <climits>
+
+namespace Filters
+{
+
+//******************************************************************************
+
+namespace
+{
+
+/*!
+  Value ignored by the operation : the lowest value of the depth for the dilation and the highest for the erosion
+*/
+double neutralValue(int depth, bool dilate)
+{
+    switch (depth)
+    {
+    case CV_8U: return dilate ? 0 : UCHAR_MAX;
+    case CV_8S: return dilate ? SCHAR_MIN : SCHAR_MAX;
+    case CV_16U: return dilate ? 0 : USHRT_MAX;
+    case CV_16S: return dilate ? SHRT_MIN : SHRT_MAX;
+    case CV_32S: return dilate ? INT_MIN : INT_MAX;
+    case CV_32F: return dilate ? -FLT_MAX : FLT_MAX;
+    default: return dilate ? -DBL_MAX : DBL_MAX;
+    }
+}
+
+//******************************************************************************
+
+inline void combine(const cv::Mat & a, const cv::Mat & b, cv::Mat & dst, bool dilate)
+{
+    if (dilate)
+        cv::max(a, b, dst);
+    else
+        cv::min(a, b, dst);
+}
+
+//******************************************************************************
+/*!
+  van Herk / Gil-Werman algorithm along columns, window of output row y is [y - k/2, y + k - 1 - k/2].
+  Padded rows are split into blocks of k rows, g is the running extremum from the block start and h from the block end :
+  extremum over the window [a, a + k - 1] is the extremum of h(a) and g(a + k - 1).
+  Rows are combined at once, thus 3 operations per pixel for any k.
+*/
+cv::Mat vhgwColumns(const cv::Mat & src, int k, bool dilate)
+{
+    if (k <= 1 || src.empty())
+        return src.clone();
+
+    int n = src.rows;
+    int r = k/2;
+    int m = ((n + k - 1 + k - 1)/k)*k;
+    cv::Mat padded(m, src.cols, src.type(), cv::Scalar::all(neutralValue(src.depth(), dilate)));
+    cv::Mat inner = padded.rowRange(r, r + n);
+    src.copyTo(inner);
+
+    cv::Mat g(m, src.cols, src.type()), h(m, src.cols, src.type());
+    for (int y=0; y<m; y++)
+    {
+        cv::Mat gy = g.row(y);
+        if (y % k == 0)
+            padded.row(y).copyTo(gy);
+        else
+            combine(g.row(y - 1), padded.row(y), gy, dilate);
+    }
+    for (int y=m-1; y>=0; y--)
+    {
+        cv::Mat hy = h.row(y);
+        if (y % k == k - 1)
+            padded.row(y).copyTo(hy);
+        else
+            combine(h.row(y + 1), padded.row(y), hy, dilate);
+    }
+
+    cv::Mat out(n, src.cols, src.type());
+    for (int y=0; y<n; y++)
+    {
+        cv::Mat oy = out.row(y);
+        combine(h.row(y), g.row(y + k - 1), oy, dilate);
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Shift of the row y in the sheared image : diagonal lines of the image become columns
+*/
+inline int shearOffset(int y, int height, bool antiDiagonal)
+{
+    return antiDiagonal ? y : height - 1 - y;
+}
+
+//******************************************************************************
+
+cv::Mat vhgwDiagonal(const cv::Mat & src, int k, bool dilate, bool antiDiagonal)
+{
+    if (k <= 1 || src.empty())
+        return src.clone();
+
+    int w = src.cols, h = src.rows;
+    cv::Mat sheared(h, w + h - 1, src.type(), cv::Scalar::all(neutralValue(src.depth(), dilate)));
+    for (int y=0; y<h; y++)
+    {
+        cv::Mat row = sheared(cv::Rect(shearOffset(y, h, antiDiagonal), y, w, 1));
+        src.row(y).copyTo(row);
+    }
+
+    sheared = vhgwColumns(sheared, k, dilate);
+
+    cv::Mat out(h, w, src.type());
+    for (int y=0; y<h; y++)
+    {
+        cv::Mat row = out.row(y);
+        sheared(cv::Rect(shearOffset(y, h, antiDiagonal), y, w, 1)).copyTo(row);
+    }
+    return out;
+}
+
+}
+
+//******************************************************************************
+
+cv::Mat morphologyLine(const cv::Mat &src, bool dilate, int length, int direction)
+{
+    cv::Mat out;
+    switch (direction)
+    {
+    case HorizontalLine:
+        out = vhgwColumns(src.t(), length, dilate).t();
+        break;
+    case VerticalLine:
+        out = vhgwColumns(src, length, dilate);
+        break;
+    case DiagonalLine:
+        out = vhgwDiagonal(src, length, dilate, false);
+        break;
+    case AntiDiagonalLine:
+        out = vhgwDiagonal(src, length, dilate, true);
+        break;
+    default:
+        out = src.clone();
+    }
+    return out;
+}
+
+//******************************************************************************
+
+cv::Mat morphologyRect(const cv::Mat &src, bool dilate, cv::Size ksize)
+{
+    cv::Mat out = morphologyLine(src, dilate, ksize.height, VerticalLine);
+    return morphologyLine(out, dilate, ksize.width, HorizontalLine);
+}
+
+//******************************************************************************
+/*!
+  Octagon of radius R is the sum of horizontal and vertical segments of half-length a
+  and diagonal segments of half-length b, with a + 2b = R (horizontal extent)
+  and a + b = R/sqrt(2) (diagonal extent) : b = R (1 - 1/sqrt(2)).
+  Diagonal segments alone give a checkerboard element (a = 0) : small disks (R <= 3) are applied
+  with the ellipse structuring element and a is at least 1 when b > 0.
+*/
+cv::Mat morphologyDisk(const cv::Mat &src, bool dilate, int diameter)
+{
+    int radius = (diameter - 1)/2;
+    if (radius <= 0)
+        return src.clone();
+
+    cv::Mat out;
+    if (radius <= 3)
+    {
+        cv::Mat k = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2*radius + 1, 2*radius + 1));
+        if (dilate)
+            cv::dilate(src, out, k);
+        else
+            cv::erode(src, out, k);
+        return out;
+    }
+
+    int b = qRound(radius*(1.0 - 1.0/qSqrt(2.0)));
+    int a = radius - 2*b;
+    if (b > 0 && a < 1)
+    {
+        b = (radius - 1)/2;
+        a = radius - 2*b;
+    }
+
+    out = morphologyLine(src, dilate, 2*a + 1, HorizontalLine);
+    out = morphologyLine(out, dilate, 2*a + 1, VerticalLine);
+    out = morphologyLine(out, dilate, 2*b + 1, DiagonalLine);
+    return morphologyLine(out, dilate, 2*b + 1, AntiDiagonalLine);
+}
+
+//******************************************************************************
+
+cv::Mat morphology(const cv::Mat &src, int operation, int shape, cv::Size ksize, int iterations, const cv::Mat &noDataMask)
+{
+    // Sequence of elementary operations : true for the dilation
+    QList<bool> steps;
+    switch (operation)
+    {
+    case cv::MORPH_ERODE:
+        steps << false;
+        break;
+    case cv::MORPH_DILATE:
+        steps << true;
+        break;
+    case cv::MORPH_OPEN:
+        steps << false << true;
+        break;
+    case cv::MORPH_CLOSE:
+        steps << true << false;
+        break;
+    default:
+        return cv::Mat();
+    }
+
+    cv::Mat data = src;
+    foreach (bool dilate, steps)
+    {
+        for (int i=0; i<qMax(1, iterations); i++)
+        {
+            if (!noDataMask.empty())
+            {
+                // No-data pixels do not change the result of the operation
+                if (data.data == src.data)
+                    data = data.clone();
+                data.reshape(1).setTo(neutralValue(data.depth(), dilate), noDataMask.reshape(1));
+            }
+            if (shape == DiskShape)
+                data = morphologyDisk(data, dilate, qMax(ksize.width, ksize.height));
+            else
+                data = morphologyRect(data, dilate, ksize);
+        }
+    }
+    return data.data == src.data ? data.clone() : data;
+}
+
+//******************************************************************************
+
+}
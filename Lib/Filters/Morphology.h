@@ -0,0 +1,66 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "Core/LibExport.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+// Morphology methods with a cost per pixel independent of the structuring element size
+// (van Herk / Gil-Werman algorithm on line segments).
+// Pixels outside of the image are ignored, as with the default border of cv::erode/cv::dilate.
+//******************************************************************************
+
+enum MorphologyShape
+{
+    RectangleShape = 0,
+    //! Disk is approximated with an octagon : sum of horizontal, vertical and diagonal segments
+    DiskShape
+};
+
+enum LineDirection
+{
+    HorizontalLine = 0,
+    VerticalLine,
+    //! Line of pixels (x+i, y+i)
+    DiagonalLine,
+    //! Line of pixels (x-i, y+i)
+    AntiDiagonalLine
+};
+
+/*!
+  \brief morphologyLine method to erode or dilate with a line segment of 'length' pixels centered on the pixel
+  (as cv::dilate with a line kernel and the default anchor)
+*/
+cv::Mat GIV_DLL_EXPORT morphologyLine(const cv::Mat & src, bool dilate, int length, int direction);
+
+/*!
+  \brief morphologyRect method to erode or dilate with a rectangle of size ksize
+*/
+cv::Mat GIV_DLL_EXPORT morphologyRect(const cv::Mat & src, bool dilate, cv::Size ksize);
+
+/*!
+  \brief morphologyDisk method to erode or dilate with an octagon approximating the disk of diameter 'diameter'
+*/
+cv::Mat GIV_DLL_EXPORT morphologyDisk(const cv::Mat & src, bool dilate, int diameter);
+
+/*!
+  \brief morphology method to apply a morphological operation as cv::morphologyEx
+  \param operation is one of cv::MORPH_ERODE, cv::MORPH_DILATE, cv::MORPH_OPEN, cv::MORPH_CLOSE
+  \param shape is one of MorphologyShape values, disk diameter is the largest dimension of ksize
+  \param noDataMask is an optional 8-bit matrix with the channels of src, non-zero where data is not valid :
+  no-data pixels are ignored, their output values are not defined
+*/
+cv::Mat GIV_DLL_EXPORT morphology(const cv::Mat & src, int operation, int shape, cv::Size ksize,
+                                  int iterations = 1, const cv::Mat & noDataMask = cv::Mat());
+
+//******************************************************************************
+
+}
+
+#endif // MORPHOLOGY_H
@@ -0,0 +1,82 @@
+
+// Opencv
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Project
+#include "MorphologyFilter.h"
+#include "Morphology.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+
+/*!
+  \class MorphologyFilter
+  \brief Morphological erosion, dilation, opening and closing with rectangle or disk structuring elements.
+  Cost per pixel does not depend on the size of the structuring element (see Morphology.h).
+  No-data pixels are ignored.
+*/
+
+//******************************************************************************
+
+MorphologyFilter::MorphologyFilter(QObject *parent) :
+    AbstractFilter(parent),
+    _operation("close"),
+    _shape("rectangle"),
+    _sizeX(3),
+    _sizeY(3),
+    _iterations(1)
+{
+    _name = tr("Morphology filter");
+    _description = tr("Morphology filter with options : erode, dilate, open, close");
+}
+
+//******************************************************************************
+
+int MorphologyFilter::getHaloSize() const
+{
+    int halo = qMax(_sizeX, _sizeY)/2 * qMax(1, _iterations);
+    return (_operation == "open" || _operation == "close") ? 2*halo : halo;
+}
+
+//******************************************************************************
+
+cv::Mat MorphologyFilter::filter(const cv::Mat &src, const FilterMonitor & monitor) const
+{
+    return filterWithMask(src, cv::Mat(), monitor);
+}
+
+//******************************************************************************
+
+/*!
+  Large data is filtered by strips of rows, the run is stopped between strips if canceled
+*/
+cv::Mat MorphologyFilter::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor &monitor) const
+{
+    return filterByStrips(src, noDataMask, monitor);
+}
+
+//******************************************************************************
+
+cv::Mat MorphologyFilter::filterStrip(const cv::Mat &src, const cv::Mat &noDataMask) const
+{
+    int operation = cv::MORPH_CLOSE;
+    if (_operation == "erode")
+        operation = cv::MORPH_ERODE;
+    else if (_operation == "dilate")
+        operation = cv::MORPH_DILATE;
+    else if (_operation == "open")
+        operation = cv::MORPH_OPEN;
+
+    int shape = _shape == "disk" ? DiskShape : RectangleShape;
+
+    SD_TRACE3("Morphology filter : operation=%1, shape=%2, iterations=%3", _operation, _shape, _iterations);
+    cv::Mat out = morphology(src, operation, shape, cv::Size(_sizeX, _sizeY), _iterations, noDataMask);
+    writeNoData(out, noDataMask);
+    return out;
+}
+
+//******************************************************************************
+
+}
@@ -0,0 +1,50 @@
+#ifndef MORPHOLOGYFILTER_H
+#define MORPHOLOGYFILTER_H
+
+// Qt
+#include <QObject>
+
+// Project
+#include "Filters/AbstractFilter.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT MorphologyFilter : public AbstractFilter
+{
+    Q_OBJECT
+
+    Q_PROPERTY_WITH_ACCESSORS(QString, operation, getOperation, setOperation)
+    Q_CLASSINFO("operation","possibleValues:erode,dilate,open,close")
+
+    Q_PROPERTY_WITH_ACCESSORS(QString, shape, getShape, setShape)
+    Q_CLASSINFO("shape","possibleValues:rectangle,disk")
+
+    Q_PROPERTY_WITH_ACCESSORS(int, sizeX, getSizeX, setSizeX)
+    Q_CLASSINFO("sizeX","label:Size X (disk diameter);minValue:1;maxValue:201")
+
+    Q_PROPERTY_WITH_ACCESSORS(int, sizeY, getSizeY, setSizeY)
+    Q_CLASSINFO("sizeY","minValue:1;maxValue:201")
+
+    Q_PROPERTY_WITH_ACCESSORS(int, iterations, getIterations, setIterations)
+    Q_CLASSINFO("iterations","minValue:1;maxValue:10")
+
+public:
+    Q_INVOKABLE MorphologyFilter(QObject * parent = 0);
+
+    virtual int getHaloSize() const;
+
+protected:
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterStrip(const cv::Mat & src, const cv::Mat & noDataMask) const;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // MORPHOLOGYFILTER_H
@@ -28,14 +28,47 @@ PowerFilter::PowerFilter(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat PowerFilter::filter(const cv::Mat &src) const
+cv::Mat PowerFilter::filter(const cv::Mat &src, const FilterMonitor & monitor) const
 {
     cv::Mat out;
     SD_TRACE(QString("Power filter : power = %1").arg(_power));
-    cv::pow(src, _power, out);
+    filterWithMaskTo(src, cv::Mat(), out, monitor);
     return out;
 }
 
+//******************************************************************************
+/*!
+  Pixel-wise operation : no-data values are not replaced by zeros, they are overwritten in the result
+*/
+cv::Mat PowerFilter::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor & monitor) const
+{
+    cv::Mat out;
+    filterWithMaskTo(src, noDataMask, out, monitor);
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Result is written into dst memory if it has the size and the type of the result.
+  Data is processed by strips of rows, the run is stopped between strips if canceled
+*/
+void PowerFilter::filterWithMaskTo(const cv::Mat &src, const cv::Mat &noDataMask, cv::Mat &dst, const FilterMonitor &monitor) const
+{
+    dst.create(src.rows, src.cols, src.type());
+    for (int y=0; y<src.rows; y+=StripHeight)
+    {
+        if (!monitor.setProgress((100 * y) / src.rows))
+        {
+            dst.release();
+            return;
+        }
+        int y1 = qMin(src.rows, y + StripHeight);
+        cv::Mat strip = dst.rowRange(y, y1);
+        cv::pow(src.rowRange(y, y1), _power, strip);
+    }
+    writeNoData(dst, noDataMask);
+}
+
 //******************************************************************************
 
 }
@@ -20,11 +20,16 @@ class GIV_DLL_EXPORT PowerFilter : public AbstractFilter
 
 
 public:
-    PowerFilter(QObject *parent = 0);
+    Q_INVOKABLE PowerFilter(QObject *parent = 0);
+
+    virtual int getHaloSize() const
+    { return 0; }
 
 
 protected:
-    virtual cv::Mat filter(const cv::Mat & src) const;
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+    virtual void filterWithMaskTo(const cv::Mat & src, const cv::Mat & noDataMask, cv::Mat & dst, const FilterMonitor & monitor) const;
 
 };
 
@@ -0,0 +1,734 @@
+
+// Qt
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMetaProperty>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+#include <QThread>
+#include <QUuid>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+// Project
+#include "ProcessFilter.h"
+#include "EditableFilter.h"
+#include "FiltersManager.h"
+
+// STD
+#if (defined WIN32 || defined _WIN32 || defined WINCE)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#endif
+
+namespace Filters
+{
+
+//******************************************************************************
+/*!
+  \class ProcessFilter
+  \brief runs a filter in worker processes to protect the application from crashes of the filter code
+  (e.g. EditableFilter user code or plugin filters).
+
+  Worker executable (GIVFilterWorker, see runWorker()) loads filter plugins, creates the filter of the same class
+  as the wrapped filter and sets the same property values. Filter configuration is taken at construction,
+  thus wrapped filter changes are not seen by running workers.
+
+  Each worker has its own shared memory segment with a small header (ProcessFilterHeader) and the data area :
+  input tile is written at the beginning of the data area and the filter of the worker writes the output after it
+  (see AbstractFilter::applyTo()), the host copies the output into the result. Host and worker wait for each other
+  with a pair of system semaphores (request and reply), a watchdog thread releases the semaphore of the waiting side
+  if the other process exits or if the run is canceled. Up to maxNbOfWorkers workers run tiles in parallel.
+  Worker that has crashed is restarted and the tile is processed once again, the tile fails if the worker crashes again.
+  Worker is killed when the run is canceled.
+
+  No-data values are handled by the filter in the worker.
+*/
+
+//******************************************************************************
+
+namespace
+{
+
+enum WaitResult
+{
+    WaitCrashed = -1,
+    WaitCanceled = -2,
+    WaitTimeout = -3
+};
+
+//******************************************************************************
+/*!
+  Thread releasing a system semaphore once when the watched process exits, when the run is canceled or when
+  the timeout is over : QSystemSemaphore::acquire() can not be interrupted. Checks are done only when the watchdog
+  is armed, i.e. while the other thread waits on the semaphore.
+*/
+class SemaphoreWatchdog : public QThread
+{
+public:
+    SemaphoreWatchdog(qint64 pid, QSystemSemaphore * semaphore, int interval) :
+        _pid(pid),
+        _semaphore(semaphore),
+        _interval(interval),
+        _monitor(0),
+        _timeout(0),
+        _armed(false),
+        _triggered(false),
+        _stopped(false)
+    {
+    }
+
+    void arm(const FilterMonitor * monitor, int timeout)
+    {
+        QMutexLocker locker(&_mutex);
+        _monitor = monitor;
+        _timeout = timeout;
+        _triggered = false;
+        _armed = true;
+        _timer.start();
+        _condition.wakeOne();
+    }
+
+    //! \return true if the semaphore has been released by the watchdog
+    bool disarm()
+    {
+        QMutexLocker locker(&_mutex);
+        _armed = false;
+        _monitor = 0;
+        return _triggered;
+    }
+
+    void stop()
+    {
+        {
+            QMutexLocker locker(&_mutex);
+            _stopped = true;
+            _condition.wakeOne();
+        }
+        wait();
+    }
+
+protected:
+    virtual void run()
+    {
+        QMutexLocker locker(&_mutex);
+        while (!_stopped)
+        {
+            bool watch = _armed && !_triggered;
+            if (watch && ((_monitor && _monitor->isCanceled()) ||
+                          (_timeout > 0 && _timer.elapsed() > _timeout) ||
+                          !ProcessFilter::isProcessRunning(_pid)))
+            {
+                _triggered = true;
+                _semaphore->release();
+                watch = false;
+            }
+            if (watch)
+                _condition.wait(&_mutex, _interval);
+            else
+                _condition.wait(&_mutex);
+        }
+    }
+
+    qint64 _pid;
+    QSystemSemaphore * _semaphore;
+    int _interval;
+    const FilterMonitor * _monitor;
+    int _timeout;
+    bool _armed;
+    bool _triggered;
+    bool _stopped;
+    QElapsedTimer _timer;
+    QMutex _mutex;
+    QWaitCondition _condition;
+};
+
+//******************************************************************************
+
+void writeMessage(ProcessFilterHeader * header, const QString & message)
+{
+    qstrncpy(header->message, message.toUtf8().constData(), ProcessFilterHeader::MessageSize);
+}
+
+}
+
+//******************************************************************************
+
+class FilterWorker
+{
+public:
+    enum Result
+    {
+        Ok,
+        Failed,
+        Crashed,
+        Canceled,
+        NoSpace
+    };
+
+    FilterWorker() :
+        _pid(0),
+        _memory(0),
+        _request(0),
+        _reply(0),
+        _watchdog(0),
+        _broken(false)
+    {
+    }
+
+    ~FilterWorker()
+    { stop(); }
+
+    bool start(const QString & program, const QStringList & arguments, qint64 dataSize, int timeout, QString & error);
+    void stop(bool kill = false);
+
+    bool isRunning() const
+    { return _pid > 0 && !_broken && ProcessFilter::isProcessRunning(_pid); }
+
+    qint64 getDataSize() const
+    { return _memory ? header()->dataSize : 0; }
+
+    Result process(const cv::Mat & src, cv::Mat & dst, const FilterMonitor & monitor, qint64 & neededSize, QString & error);
+
+    static qint64 getOutputOffset(const cv::Mat & src)
+    { return cv::alignSize(src.total() * src.elemSize(), 64); }
+
+    static qint64 estimateDataSize(const cv::Mat & src)
+    { return getOutputOffset(src) + src.total() * src.channels() * sizeof(float); }
+
+protected:
+    int waitReply(int requestState, const FilterMonitor * monitor, int timeout);
+
+    ProcessFilterHeader * header() const
+    { return static_cast<ProcessFilterHeader*>(_memory->data()); }
+
+    uchar * data() const
+    { return static_cast<uchar*>(_memory->data()) + ProcessFilterHeader::DataOffset; }
+
+    qint64 _pid;
+    QSharedMemory * _memory;
+    QSystemSemaphore * _request;
+    QSystemSemaphore * _reply;
+    SemaphoreWatchdog * _watchdog;
+    //! Reply semaphore has been released by the watchdog, semaphore count is not reliable
+    bool _broken;
+};
+
+//******************************************************************************
+
+bool FilterWorker::start(const QString &program, const QStringList &arguments, qint64 dataSize, int timeout, QString &error)
+{
+    stop(true);
+
+    QString key = QString("GIV_FilterWorker_%1").arg(QUuid::createUuid().toString());
+    _memory = new QSharedMemory(key);
+    if (!_memory->create(ProcessFilterHeader::DataOffset + dataSize))
+    {
+        error = QObject::tr("Failed to create shared memory of the filter worker : %1").arg(_memory->errorString());
+        delete _memory;
+        _memory = 0;
+        return false;
+    }
+    memset(_memory->data(), 0, ProcessFilterHeader::DataOffset);
+    header()->dataSize = dataSize;
+    header()->state = ProcessFilterHeader::Starting;
+
+    _request = new QSystemSemaphore(key + "_request", 0, QSystemSemaphore::Create);
+    _reply = new QSystemSemaphore(key + "_reply", 0, QSystemSemaphore::Create);
+    if (_request->error() != QSystemSemaphore::NoError || _reply->error() != QSystemSemaphore::NoError)
+    {
+        error = QObject::tr("Failed to create semaphores of the filter worker : %1")
+                .arg(_request->error() != QSystemSemaphore::NoError ? _request->errorString() : _reply->errorString());
+        stop();
+        return false;
+    }
+
+    QStringList args(arguments);
+    args << "--memory" << _memory->key()
+         << "--host" << QString::number(QCoreApplication::applicationPid());
+    if (!QProcess::startDetached(program, args, QFileInfo(program).absolutePath(), &_pid))
+    {
+        error = QObject::tr("Failed to start the filter worker \'%1\'").arg(program);
+        _pid = 0;
+        stop();
+        return false;
+    }
+
+    _watchdog = new SemaphoreWatchdog(_pid, _reply, 10);
+    _watchdog->start();
+
+    int state = waitReply(ProcessFilterHeader::Starting, 0, timeout);
+    if (state == ProcessFilterHeader::Idle && !_broken)
+        return true;
+
+    if (state == ProcessFilterHeader::Failed)
+        error = QString::fromUtf8(header()->message);
+    else
+        error = QObject::tr("Filter worker \'%1\' has not started").arg(program);
+    stop(true);
+    return false;
+}
+
+//******************************************************************************
+/*!
+  Method to stop the worker and to release the shared memory.
+  Worker is asked to quit and is killed if it does not quit in time or if 'kill' is true
+*/
+void FilterWorker::stop(bool kill)
+{
+    if (_pid > 0)
+    {
+        if (!kill && !_broken)
+        {
+            header()->state = ProcessFilterHeader::Quit;
+            _request->release();
+            QElapsedTimer timer;
+            timer.start();
+            while (ProcessFilter::isProcessRunning(_pid) && timer.elapsed() < 1000)
+                QThread::msleep(5);
+        }
+        if (ProcessFilter::isProcessRunning(_pid))
+            ProcessFilter::killProcess(_pid);
+        _pid = 0;
+    }
+    if (_watchdog)
+    {
+        _watchdog->stop();
+        delete _watchdog;
+        _watchdog = 0;
+    }
+    delete _request;
+    _request = 0;
+    delete _reply;
+    _reply = 0;
+    if (_memory)
+    {
+        delete _memory;
+        _memory = 0;
+    }
+    _broken = false;
+}
+
+//******************************************************************************
+/*!
+  Method to wait for the reply of the worker to a request written with the header state 'requestState'.
+  Worker is marked as broken if the wait is stopped by the watchdog
+  \return reply state or one of WaitResult values
+*/
+int FilterWorker::waitReply(int requestState, const FilterMonitor *monitor, int timeout)
+{
+    _watchdog->arm(monitor, timeout);
+    _reply->acquire();
+    if (!_watchdog->disarm())
+        return header()->state;
+
+    // Worker could have replied too : the next request would not wait, worker is restarted
+    _broken = true;
+    int state = header()->state;
+    if (state != requestState)
+        return state;
+    if (monitor && monitor->isCanceled())
+        return WaitCanceled;
+    if (!ProcessFilter::isProcessRunning(_pid))
+        return WaitCrashed;
+    return WaitTimeout;
+}
+
+//******************************************************************************
+
+FilterWorker::Result FilterWorker::process(const cv::Mat &src, cv::Mat &dst, const FilterMonitor &monitor, qint64 &neededSize, QString &error)
+{
+    ProcessFilterHeader * h = header();
+    qint64 outputOffset = getOutputOffset(src);
+    if (outputOffset > h->dataSize)
+    {
+        neededSize = estimateDataSize(src);
+        return NoSpace;
+    }
+
+    h->inputWidth = src.cols;
+    h->inputHeight = src.rows;
+    h->inputType = src.type();
+    h->outputOffset = outputOffset;
+    // input is written directly into the data area
+    cv::Mat input(src.rows, src.cols, src.type(), data());
+    src.copyTo(input);
+
+    h->state = ProcessFilterHeader::Request;
+    _request->release();
+    int state = waitReply(ProcessFilterHeader::Request, &monitor, 0);
+    switch (state)
+    {
+    case ProcessFilterHeader::Done:
+        // output is read from the data area into dst memory if it has the same size and type
+        cv::Mat(h->outputHeight, h->outputWidth, h->outputType, data() + outputOffset).copyTo(dst);
+        return Ok;
+    case ProcessFilterHeader::Failed:
+        error = QString::fromUtf8(h->message);
+        return Failed;
+    case ProcessFilterHeader::NoSpace:
+        neededSize = h->neededSize;
+        return NoSpace;
+    case WaitCanceled:
+        return Canceled;
+    default:
+        return Crashed;
+    }
+}
+
+//******************************************************************************
+//******************************************************************************
+
+ProcessFilter::ProcessFilter(const AbstractFilter *filter, QObject *parent) :
+    AbstractFilter(parent),
+    _maxNbOfWorkers(QThread::idealThreadCount()),
+    _startTimeout(30000),
+    _filter(filter)
+{
+    _name = filter->getName();
+    _description = filter->getDescription();
+    _noDataValue = filter->getNoDataValue();
+
+    _workerPath = QCoreApplication::applicationDirPath() + "/GIVFilterWorker";
+    _pluginsPath = QCoreApplication::applicationDirPath() + "/Plugins/Filters";
+
+    // Serialize filter configuration :
+    QVariantMap properties;
+    const QMetaObject * mo = filter->metaObject();
+    for (int i=QObject::staticMetaObject.propertyCount(); i<mo->propertyCount(); i++)
+    {
+        QMetaProperty p = mo->property(i);
+        if (p.isWritable())
+            properties.insert(p.name(), p.read(filter));
+    }
+
+    QVariantMap config;
+    config.insert("className", QString(mo->className()));
+    config.insert("noDataValue", filter->getNoDataValue());
+    config.insert("properties", properties);
+    const EditableFilter * ef = qobject_cast<const EditableFilter*>(filter);
+    if (ef)
+        config.insert("libraryPath", ef->getLibraryPath());
+
+    QByteArray buffer;
+    QDataStream stream(&buffer, QIODevice::WriteOnly);
+    stream << config;
+    _setup = QString::fromLatin1(buffer.toBase64());
+}
+
+//******************************************************************************
+
+ProcessFilter::~ProcessFilter()
+{
+    stopWorkers();
+}
+
+//******************************************************************************
+/*!
+  Method to stop all workers. It should not be called while the filter runs
+*/
+void ProcessFilter::stopWorkers()
+{
+    QMutexLocker locker(&_mutex);
+    foreach (FilterWorker * worker, _workers)
+    {
+        delete worker;
+    }
+    _workers.clear();
+    _freeWorkers.clear();
+}
+
+//******************************************************************************
+
+int ProcessFilter::getHaloSize() const
+{
+    return _filter->getHaloSize();
+}
+
+//******************************************************************************
+
+FilterWorker * ProcessFilter::acquireWorker() const
+{
+    QMutexLocker locker(&_mutex);
+    while (_freeWorkers.isEmpty())
+    {
+        if (_workers.size() < qMax(1, _maxNbOfWorkers))
+        {
+            FilterWorker * worker = new FilterWorker();
+            _workers << worker;
+            return worker;
+        }
+        _workerReleased.wait(&_mutex);
+    }
+    return _freeWorkers.takeLast();
+}
+
+//******************************************************************************
+
+void ProcessFilter::releaseWorker(FilterWorker *worker) const
+{
+    QMutexLocker locker(&_mutex);
+    _freeWorkers << worker;
+    _workerReleased.wakeOne();
+}
+
+//******************************************************************************
+/*!
+  Input data is passed to the worker with no-data values, the filter in the worker handles them
+*/
+cv::Mat ProcessFilter::filterWithMask(const cv::Mat &src, const cv::Mat &noDataMask, const FilterMonitor &monitor) const
+{
+    Q_UNUSED(noDataMask);
+    return filter(src, monitor);
+}
+
+//******************************************************************************
+
+cv::Mat ProcessFilter::filter(const cv::Mat &src, const FilterMonitor &monitor) const
+{
+    cv::Mat out;
+    filterWithMaskTo(src, cv::Mat(), out, monitor);
+    return out;
+}
+
+//******************************************************************************
+/*!
+  Output of the worker is copied into dst memory if it has the size and the type of the output
+*/
+void ProcessFilter::filterWithMaskTo(const cv::Mat &src, const cv::Mat &noDataMask, cv::Mat &dst, const FilterMonitor &monitor) const
+{
+    Q_UNUSED(noDataMask);
+    QStringList arguments;
+    arguments << "--plugins" << _pluginsPath
+              << "--setup" << _setup;
+
+    FilterWorker * worker = acquireWorker();
+    qint64 neededSize = FilterWorker::estimateDataSize(src);
+    int nbOfRestarts = 0;
+    while (true)
+    {
+        QString error;
+        if (!worker->isRunning() || worker->getDataSize() < neededSize)
+        {
+            // Data area is allocated with a margin for next tiles
+            if (!worker->start(_workerPath, arguments, neededSize + neededSize/4, _startTimeout, error))
+            {
+                monitor.setError(error);
+                break;
+            }
+        }
+
+        FilterWorker::Result r = worker->process(src, dst, monitor, neededSize, error);
+        if (r == FilterWorker::NoSpace)
+            continue;
+        if (r == FilterWorker::Crashed && nbOfRestarts++ < 1)
+        {
+            SD_TRACE(QString("Worker process of the filter \'%1\' has crashed, restart it").arg(getName()));
+            continue;
+        }
+
+        if (r == FilterWorker::Crashed)
+            monitor.setError(tr("Worker process of the filter \'%1\' has crashed").arg(getName()));
+        else if (r == FilterWorker::Failed)
+            monitor.setError(error);
+        else if (r == FilterWorker::Canceled)
+            worker->stop(true);
+        break;
+    }
+    releaseWorker(worker);
+    if (!monitor.getErrorMessage().isEmpty() || monitor.isCanceled())
+        dst.release();
+}
+
+//******************************************************************************
+/*!
+  Worker main loop : sets up the filter from the arguments, then processes requests from the shared memory
+  until the host asks to quit or exits.
+  Arguments : --memory <shared memory key> --host <host pid> --plugins <filter plugins path> --setup <filter configuration>
+  \return process exit code
+*/
+int ProcessFilter::runWorker(const QStringList &arguments)
+{
+    QString key, pluginsPath, setup;
+    qint64 hostPid = 0;
+    for (int i=1; i+1<arguments.size(); i+=2)
+    {
+        const QString & name = arguments[i];
+        const QString & value = arguments[i+1];
+        if (name == "--memory")
+            key = value;
+        else if (name == "--host")
+            hostPid = value.toLongLong();
+        else if (name == "--plugins")
+            pluginsPath = value;
+        else if (name == "--setup")
+            setup = value;
+    }
+
+    QSharedMemory memory(key);
+    if (key.isEmpty() || !memory.attach())
+    {
+        SD_TRACE("Filter worker : failed to attach shared memory");
+        return 1;
+    }
+    ProcessFilterHeader * header = static_cast<ProcessFilterHeader*>(memory.data());
+    uchar * data = static_cast<uchar*>(memory.data()) + ProcessFilterHeader::DataOffset;
+
+    QSystemSemaphore request(key + "_request", 0, QSystemSemaphore::Open);
+    QSystemSemaphore reply(key + "_reply", 0, QSystemSemaphore::Open);
+    if (request.error() != QSystemSemaphore::NoError || reply.error() != QSystemSemaphore::NoError)
+    {
+        SD_TRACE("Filter worker : failed to open semaphores");
+        return 1;
+    }
+
+    // Setup the filter :
+    QVariantMap config;
+    QDataStream stream(QByteArray::fromBase64(setup.toLatin1()));
+    stream >> config;
+
+    if (!pluginsPath.isEmpty())
+        FiltersManager::get()->loadPlugins(pluginsPath);
+
+    AbstractFilter * filter = 0;
+    QString className = config.value("className").toString();
+    foreach (AbstractFilter * f, FiltersManager::get()->getFilters())
+    {
+        if (className == f->metaObject()->className())
+        {
+            filter = f;
+            break;
+        }
+    }
+    if (!filter)
+    {
+        writeMessage(header, QObject::tr("Filter worker : filter \'%1\' is not found").arg(className));
+        header->state = ProcessFilterHeader::Failed;
+        reply.release();
+        return 1;
+    }
+
+    QVariantMap properties = config.value("properties").toMap();
+    foreach (QString name, properties.keys())
+    {
+        filter->setProperty(name.toLatin1().constData(), properties[name]);
+    }
+    filter->setNoDataValue(config.value("noDataValue").toFloat());
+    // verbose images can not be displayed by the worker
+    filter->setVerbose(false);
+
+    EditableFilter * ef = qobject_cast<EditableFilter*>(filter);
+    if (ef && !ef->setLibraryPath(config.value("libraryPath").toString()))
+    {
+        writeMessage(header, QObject::tr("Filter worker : failed to load the filter library"));
+        header->state = ProcessFilterHeader::Failed;
+        reply.release();
+        return 1;
+    }
+
+    // Requests are not canceled : host kills the worker
+    SemaphoreWatchdog hostWatchdog(hostPid, &request, 500);
+    hostWatchdog.start();
+    hostWatchdog.arm(0, 0);
+
+    header->state = ProcessFilterHeader::Idle;
+    reply.release();
+
+    // Process requests :
+    while (true)
+    {
+        request.acquire();
+        int state = header->state;
+        if (state == ProcessFilterHeader::Quit || !isProcessRunning(hostPid))
+            break;
+        if (state != ProcessFilterHeader::Request)
+            continue;
+
+        cv::Mat input(header->inputHeight, header->inputWidth, header->inputType, data);
+        // filter writes directly into the data area if the output has the size and the type of the input
+        cv::Mat output;
+        if (header->outputOffset + (qint64) (input.total() * input.elemSize()) <= header->dataSize)
+            output = cv::Mat(input.rows, input.cols, input.type(), data + header->outputOffset);
+        uchar * outputData = output.data;
+
+        if (!filter->applyTo(input, output))
+        {
+            writeMessage(header, filter->getErrorMessage());
+            header->state = ProcessFilterHeader::Failed;
+        }
+        else if (output.data == outputData)
+        {
+            header->outputWidth = output.cols;
+            header->outputHeight = output.rows;
+            header->outputType = output.type();
+            header->state = ProcessFilterHeader::Done;
+        }
+        else
+        {
+            qint64 size = output.total() * output.elemSize();
+            if (header->outputOffset + size > header->dataSize)
+            {
+                header->neededSize = header->outputOffset + size;
+                header->state = ProcessFilterHeader::NoSpace;
+            }
+            else
+            {
+                cv::Mat out(output.rows, output.cols, output.type(), data + header->outputOffset);
+                output.copyTo(out);
+                header->outputWidth = output.cols;
+                header->outputHeight = output.rows;
+                header->outputType = output.type();
+                header->state = ProcessFilterHeader::Done;
+            }
+        }
+        reply.release();
+    }
+
+    hostWatchdog.stop();
+    memory.detach();
+    return 0;
+}
+
+//******************************************************************************
+
+bool ProcessFilter::isProcessRunning(qint64 pid)
+{
+    if (pid <= 0)
+        return false;
+#if (defined WIN32 || defined _WIN32 || defined WINCE)
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD) pid);
+    if (!process)
+        return false;
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+#else
+    return kill((pid_t) pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+//******************************************************************************
+
+void ProcessFilter::killProcess(qint64 pid)
+{
+    if (pid <= 0)
+        return;
+#if (defined WIN32 || defined _WIN32 || defined WINCE)
+    HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, (DWORD) pid);
+    if (!process)
+        return;
+    TerminateProcess(process, 1);
+    CloseHandle(process);
+#else
+    kill((pid_t) pid, SIGKILL);
+#endif
+}
+
+//******************************************************************************
+
+}
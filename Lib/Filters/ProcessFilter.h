@@ -0,0 +1,108 @@
+#ifndef PROCESSFILTER_H
+#define PROCESSFILTER_H
+
+// Qt
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+
+// Project
+#include "Filters/AbstractFilter.h"
+
+namespace Filters
+{
+
+class FilterWorker;
+
+//******************************************************************************
+
+//! Layout of the shared memory segment of a filter worker : header is followed by the data area at DataOffset.
+//! State is written before the release of the request or the reply semaphore
+struct ProcessFilterHeader
+{
+    enum State
+    {
+        Starting = 0,   //!< worker sets up the filter
+        Idle,           //!< worker waits for a request
+        Request,        //!< input data is written by the host
+        Done,           //!< output data is written by the worker
+        Failed,         //!< filter has failed, message contains the error
+        NoSpace,        //!< output does not fit the data area, neededSize contains the size
+        Quit            //!< worker should exit
+    };
+
+    enum
+    {
+        DataOffset = 1024,
+        MessageSize = 512
+    };
+
+    int state;
+    int inputWidth;
+    int inputHeight;
+    int inputType;
+    int outputWidth;
+    int outputHeight;
+    int outputType;
+    qint64 outputOffset;
+    qint64 dataSize;
+    qint64 neededSize;
+    char message[MessageSize];
+};
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT ProcessFilter : public AbstractFilter
+{
+    Q_OBJECT
+
+    //! Path of the worker executable
+    PROPERTY_ACCESSORS(QString, workerPath, getWorkerPath, setWorkerPath)
+    //! Path of filter plugins loaded by workers
+    PROPERTY_ACCESSORS(QString, pluginsPath, getPluginsPath, setPluginsPath)
+    PROPERTY_ACCESSORS(int, maxNbOfWorkers, getMaxNbOfWorkers, setMaxNbOfWorkers)
+    //! Time limit (in ms) to start a worker and to setup its filter
+    PROPERTY_ACCESSORS(int, startTimeout, getStartTimeout, setStartTimeout)
+
+public:
+    explicit ProcessFilter(const AbstractFilter * filter, QObject * parent = 0);
+    virtual ~ProcessFilter();
+
+    virtual int getHaloSize() const;
+
+    const AbstractFilter * getFilter() const
+    { return _filter; }
+
+    void stopWorkers();
+
+    static int runWorker(const QStringList & arguments);
+
+    static bool isProcessRunning(qint64 pid);
+    static void killProcess(qint64 pid);
+
+protected:
+    virtual cv::Mat filter(const cv::Mat & src, const FilterMonitor & monitor) const;
+    virtual cv::Mat filterWithMask(const cv::Mat & src, const cv::Mat & noDataMask, const FilterMonitor & monitor) const;
+
+    virtual void filterWithMaskTo(const cv::Mat & src, const cv::Mat & noDataMask, cv::Mat & dst, const FilterMonitor & monitor) const;
+
+    FilterWorker * acquireWorker() const;
+    void releaseWorker(FilterWorker * worker) const;
+
+    const AbstractFilter * _filter;
+    //! Serialized filter configuration passed to workers
+    QString _setup;
+
+    mutable QMutex _mutex;
+    mutable QWaitCondition _workerReleased;
+    mutable QList<FilterWorker*> _workers;
+    mutable QList<FilterWorker*> _freeWorkers;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // PROCESSFILTER_H
@@ -0,0 +1,556 @@
+
+// Qt
+#include <QDir>
+#include <QUuid>
+#include <QThread>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+// GDAL
+#include <gdal_priv.h>
+
+// Project
+#include "TiledFilterEngine.h"
+#include "AbstractFilter.h"
+#include "FilterPipeline.h"
+#include "Core/ImageDataProvider.h"
+#include "Core/FloatingDataProvider.h"
+#include "Core/LayerUtils.h"
+
+namespace Filters
+{
+
+//******************************************************************************
+/*!
+  \class TiledFilterEngine
+  \brief applies a filter on an image data provider tile by tile.
+
+  The source extent is split into tiles of tileSize pixels. Each tile is read with a halo of
+  AbstractFilter::getHaloSize() pixels, filtered in a thread of the engine's pool, cropped to the
+  tile extent and written into the output. Output is a FloatingDataProvider if its size is smaller
+  than inMemoryLimit, otherwise tiles are streamed into a temporary tiled GeoTiff file opened as a
+  GDALDataProvider (with overviews) which removes the file when destroyed.
+
+  Filters with negative halo size (whole image is needed) are applied on the whole image if its size
+  is smaller than inMemoryLimit. A FilterPipeline containing such a filter is split : the filters before it
+  are applied on tiles and the remaining filters are applied on the whole intermediate result.
+
+  Filters are applied with a FilterMonitor of the engine : cancel() stops the tiles in the queue and the
+  running filters at their next progress report. Progress reported by a filter applied on the whole image
+  is forwarded to progressValueChanged(). Filter errors are reported to the monitor of the tile and the engine
+  keeps the first one, the filter itself is not modified.
+*/
+
+//******************************************************************************
+
+class TileSink
+{
+public:
+    virtual ~TileSink() {}
+    //! Thread-safe method to write a filtered tile
+    virtual bool write(const QPoint & offset, const cv::Mat & tile) = 0;
+    virtual Core::ImageDataProvider * finalize(const QString & name, const Core::ImageDataProvider * src) = 0;
+};
+
+//******************************************************************************
+
+class MemoryTileSink : public TileSink
+{
+public:
+    MemoryTileSink(const QSize & size) :
+        _size(size)
+    {}
+
+    virtual bool write(const QPoint & offset, const cv::Mat & tile)
+    {
+        {
+            QMutexLocker locker(&_mutex);
+            if (_data.empty())
+            {
+                _data = cv::Mat(_size.height(), _size.width(), tile.type());
+            }
+            if (_data.type() != tile.type())
+                return false;
+        }
+        // tiles do not overlap -> copy without lock
+        tile.copyTo(_data(cv::Rect(offset.x(), offset.y(), tile.cols, tile.rows)));
+        return true;
+    }
+
+    virtual Core::ImageDataProvider * finalize(const QString & name, const Core::ImageDataProvider * src)
+    {
+        Core::FloatingDataProvider * out = Core::FloatingDataProvider::createDataProvider(name, _data);
+        _data.release();
+        if (out)
+            out->setupGeoInfo(src);
+        return out;
+    }
+
+protected:
+    QSize _size;
+    cv::Mat _data;
+    QMutex _mutex;
+};
+
+//******************************************************************************
+
+class FileTileSink : public TileSink
+{
+public:
+    FileTileSink(const QString & path, const QSize & size, int blockSize) :
+        _path(path),
+        _size(size),
+        _blockSize(blockSize),
+        _dataset(0),
+        _type(-1)
+    {}
+
+    virtual ~FileTileSink()
+    {
+        if (_dataset)
+        {
+            GDALDriver * driver = _dataset->GetDriver();
+            GDALClose(_dataset);
+            driver->Delete(_path.toStdString().c_str());
+        }
+    }
+
+    virtual bool write(const QPoint & offset, const cv::Mat & tile)
+    {
+        QMutexLocker locker(&_mutex);
+        if (!_dataset && !create(tile))
+            return false;
+        if (tile.type() != _type)
+            return false;
+
+        GDALDataType type = Core::convertDataTypeOpenCVToGDAL(tile.depth(), 1);
+        CPLErr err = _dataset->RasterIO(GF_Write,
+                                        offset.x(), offset.y(), tile.cols, tile.rows,
+                                        tile.data, tile.cols, tile.rows,
+                                        type, tile.channels(), 0,
+                                        tile.elemSize(), tile.step, tile.elemSize1());
+        return err == CE_None;
+    }
+
+    virtual Core::ImageDataProvider * finalize(const QString & name, const Core::ImageDataProvider * src)
+    {
+        if (!_dataset)
+            return 0;
+
+        QVector<double> geoTransform = src->fetchGeoTransform();
+        if (geoTransform.size() == 6)
+            _dataset->SetGeoTransform(geoTransform.data());
+        QString projection = src->fetchProjectionRef();
+        if (projection != "Unknown")
+            _dataset->SetProjection(projection.toStdString().c_str());
+
+        if (!Core::createOverviews(_dataset))
+        {
+            SD_TRACE("FileTileSink : failed to create overviews");
+        }
+        GDALClose(_dataset);
+        _dataset = 0;
+
+        Core::GDALDataProvider * out = new Core::GDALDataProvider();
+        // file is removed with the provider
+        out->setTemporary(true);
+        if (!out->setup(_path))
+        {
+            delete out;
+            return 0;
+        }
+        out->setImageName(name);
+
+        // compute data stats on a reduced resolution image :
+        cv::Mat data = out->getImageData(QRect(), 1024);
+        cv::Mat mask = Core::ImageDataProvider::computeMask(data);
+        QVector<double> minValues, maxValues;
+        QVector<QVector<double> > bandHistograms;
+        int histSize = out->getInputDepthInBytes() > 1 ? 1000 : 256;
+        if (data.empty() ||
+                !Core::computeNormalizedHistogram(data, mask, minValues, maxValues, bandHistograms, histSize))
+        {
+            SD_TRACE("FileTileSink : Failed to compute image stats");
+            delete out;
+            return 0;
+        }
+        out->setMinValues(minValues);
+        out->setMaxValues(maxValues);
+        out->setBandHistograms(bandHistograms);
+        return out;
+    }
+
+protected:
+
+    bool create(const cv::Mat & tile)
+    {
+        GDALDriver * driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+        if (!driver)
+            return false;
+
+        QByteArray blockSize = QByteArray::number(_blockSize);
+        char **options = 0;
+        options = CSLSetNameValue(options, "TILED", "YES");
+        options = CSLSetNameValue(options, "BLOCKXSIZE", blockSize.data());
+        options = CSLSetNameValue(options, "BLOCKYSIZE", blockSize.data());
+        options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+        _dataset = driver->Create(_path.toStdString().c_str(),
+                                  _size.width(), _size.height(), tile.channels(),
+                                  Core::convertDataTypeOpenCVToGDAL(tile.depth(), 1),
+                                  options);
+        CSLDestroy(options);
+        if (!_dataset)
+        {
+            SD_TRACE("FileTileSink : failed to create the file " + _path);
+            return false;
+        }
+        _type = tile.type();
+        if (tile.depth() == CV_32F)
+        {
+            for (int i=0; i<tile.channels(); i++)
+            {
+                _dataset->GetRasterBand(i+1)->SetNoDataValue(Core::ImageDataProvider::NoDataValue);
+            }
+        }
+        return true;
+    }
+
+    QString _path;
+    QSize _size;
+    int _blockSize;
+    GDALDataset * _dataset;
+    int _type;
+    QMutex _mutex;
+};
+
+//******************************************************************************
+
+class EngineMonitor : public FilterMonitor
+{
+public:
+    EngineMonitor(TiledFilterEngine * engine) :
+        FilterMonitor(),
+        _engine(engine)
+    {
+    }
+
+protected:
+    virtual void progressChanged(int value) const
+    {
+        emit _engine->progressValueChanged(value);
+    }
+
+    TiledFilterEngine * _engine;
+};
+
+//******************************************************************************
+
+class TileFilterTask : public QRunnable
+{
+public:
+    TileFilterTask(TiledFilterEngine * engine, const QRect & tile) :
+        _engine(engine),
+        _tile(tile)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        _engine->processTile(_tile);
+    }
+
+protected:
+    TiledFilterEngine * _engine;
+    QRect _tile;
+};
+
+//******************************************************************************
+
+TiledFilterEngine::TiledFilterEngine(QObject *parent) :
+    QObject(parent),
+    _tileSize(1024),
+    _maxNbOfThreads(QThread::idealThreadCount()),
+    _inMemoryLimit(512.0 * 1024.0 * 1024.0),
+    _tempPath(QDir::tempPath()),
+    _filter(0),
+    _src(0),
+    _sink(0),
+    _halo(0),
+    _progressStart(5),
+    _progressEnd(95),
+    _monitor(0),
+    _nbOfTiles(0),
+    _nbOfProcessedTiles(0)
+{
+    _monitor = new EngineMonitor(this);
+}
+
+//******************************************************************************
+
+TiledFilterEngine::~TiledFilterEngine()
+{
+    delete _monitor;
+}
+
+//******************************************************************************
+
+QList<QRect> TiledFilterEngine::computeTiles(const QRect &extent, int tileSize)
+{
+    QList<QRect> out;
+    if (tileSize < 1)
+        return out;
+    for (int y=extent.y(); y<extent.y() + extent.height(); y+=tileSize)
+    {
+        for (int x=extent.x(); x<extent.x() + extent.width(); x+=tileSize)
+        {
+            out << QRect(x, y, tileSize, tileSize).intersected(extent);
+        }
+    }
+    return out;
+}
+
+//******************************************************************************
+/*!
+ * \brief TiledFilterEngine::apply method to apply the filter on the source data provider.
+ * Method is blocking and should be called from a worker thread.
+ * \return output data provider or null if failed or canceled, error message is available with getErrorMessage()
+ */
+Core::ImageDataProvider * TiledFilterEngine::apply(const AbstractFilter *filter, const Core::ImageDataProvider *src, const QString & iName)
+{
+    _errorMessage.clear();
+    _monitor->reset();
+    if (!filter || !src)
+    {
+        _errorMessage = tr("Filter or source image is not defined");
+        return 0;
+    }
+    _filter = filter;
+    _src = src;
+    _halo = filter->getHaloSize();
+    QString name = iName.isEmpty() ? src->getImageName() + " + " + filter->getName() : iName;
+
+    emit progressValueChanged(5);
+
+    _progressStart = 5;
+    _progressEnd = 95;
+    Core::ImageDataProvider * out = 0;
+    if (_halo >= 0)
+    {
+        out = applyTiled(name);
+    }
+    else
+    {
+        const FilterPipeline * pipeline = qobject_cast<const FilterPipeline*>(filter);
+        out = pipeline ? applyPipeline(pipeline, name) : applyOnWholeImage(name);
+    }
+
+    if (out)
+        emit progressValueChanged(100);
+    return out;
+}
+
+//******************************************************************************
+/*!
+ * \brief TiledFilterEngine::applyTiled method to apply the filter with non-negative halo tile by tile
+ */
+Core::ImageDataProvider * TiledFilterEngine::applyTiled(const QString & name)
+{
+    const Core::ImageDataProvider * src = _src;
+    double size = 1.0 * src->getWidth() * src->getHeight() * src->getNbBands() * src->getDepthInBytes();
+    if (size > _inMemoryLimit)
+    {
+        QString path = QDir(_tempPath).absoluteFilePath("GIV_" + QUuid::createUuid().toString().mid(1, 36) + ".tif");
+        _sink = new FileTileSink(path, src->getPixelExtent().size(), 512);
+    }
+    else
+    {
+        _sink = new MemoryTileSink(src->getPixelExtent().size());
+    }
+
+    QList<QRect> tiles = computeTiles(src->getPixelExtent(), _tileSize);
+    _nbOfTiles = tiles.size();
+    _nbOfProcessedTiles = 0;
+
+    // Own pool : global pool is used by the task calling this method
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, _maxNbOfThreads));
+    foreach (QRect tile, tiles)
+    {
+        pool.start(new TileFilterTask(this, tile));
+    }
+    pool.waitForDone();
+
+    Core::ImageDataProvider * out = 0;
+    if (!isCanceled())
+    {
+        out = _sink->finalize(name, src);
+        if (!out && _errorMessage.isEmpty())
+            _errorMessage = tr("Failed to create the output image");
+    }
+    delete _sink;
+    _sink = 0;
+    return out;
+}
+
+//******************************************************************************
+
+Core::ImageDataProvider * TiledFilterEngine::applyOnWholeImage(const QString & name)
+{
+    double size = 1.0 * _src->getWidth() * _src->getHeight() * _src->getNbBands() * _src->getDepthInBytes();
+    if (size > _inMemoryLimit)
+    {
+        _errorMessage = tr("Filter \'%1\' is applied on the whole image and the image is too large (%2 Mb)")
+                .arg(_filter->getName())
+                .arg(size / (1024.0 * 1024.0), 0, 'f', 1);
+        return 0;
+    }
+
+    cv::Mat dstMat;
+    {
+        cv::Mat srcMat = _src->getImageData();
+        // Filter progress is mapped on the engine progress range of the stage
+        FilterMonitor monitor(_monitor, _progressStart, _progressEnd);
+        dstMat = _filter->apply(srcMat, &monitor);
+        if (dstMat.empty() || isCanceled())
+        {
+            setError(monitor.getErrorMessage());
+            return 0;
+        }
+    }
+
+    Core::FloatingDataProvider * out = new Core::FloatingDataProvider();
+    if (!out->create(name, dstMat))
+    {
+        delete out;
+        _errorMessage = tr("Failed to create the output image");
+        return 0;
+    }
+    out->setupGeoInfo(_src);
+    return out;
+}
+
+//******************************************************************************
+/*!
+ * \brief TiledFilterEngine::applyPipeline method to apply a pipeline containing a filter that needs the whole image.
+ * Filters before the first such filter are applied on tiles in a single pass, the remaining filters are
+ * applied on the whole intermediate result, e.g. Blur -> Power are applied on tiles and ConvertTo8U
+ * on the whole blurred image.
+ */
+Core::ImageDataProvider * TiledFilterEngine::applyPipeline(const FilterPipeline * pipeline, const QString & name)
+{
+    FilterPipeline head, tail;
+    head.setNoDataValue(pipeline->getNoDataValue());
+    tail.setNoDataValue(pipeline->getNoDataValue());
+    foreach (const AbstractFilter * f, pipeline->getFilters())
+    {
+        if (tail.isEmpty() && f->getHaloSize() >= 0)
+            head.append(f);
+        else
+            tail.append(f);
+    }
+    if (head.isEmpty())
+        return applyOnWholeImage(name);
+
+    const Core::ImageDataProvider * src = _src;
+    _filter = &head;
+    _halo = head.getHaloSize();
+    _progressEnd = 50;
+    Core::ImageDataProvider * intermediate = applyTiled(name);
+
+    Core::ImageDataProvider * out = 0;
+    if (intermediate)
+    {
+        _filter = &tail;
+        _src = intermediate;
+        _progressStart = 50;
+        _progressEnd = 95;
+        out = applyOnWholeImage(name);
+        if (out)
+            static_cast<Core::FloatingDataProvider*>(out)->setupGeoInfo(src);
+        delete intermediate;
+    }
+
+    // Engine state is restored
+    _filter = pipeline;
+    _src = src;
+    _halo = -1;
+    return out;
+}
+
+//******************************************************************************
+
+void TiledFilterEngine::processTile(const QRect &tile)
+{
+    if (isCanceled())
+        return;
+
+    QRect haloTile = tile.adjusted(-_halo, -_halo, _halo, _halo).intersected(_src->getPixelExtent());
+    cv::Mat data = _src->getImageData(haloTile);
+    if (data.empty())
+    {
+        setError(tr("Failed to read source data"));
+        return;
+    }
+
+    // Tile monitor only forwards the cancellation, progress is computed from the nb of processed tiles
+    FilterMonitor monitor(_monitor, 0, 0);
+    cv::Mat res = _filter->apply(data, &monitor);
+    if (isCanceled())
+        return;
+    if (res.empty())
+    {
+        setError(monitor.getErrorMessage());
+        return;
+    }
+    if (res.cols != data.cols || res.rows != data.rows)
+    {
+        setError(tr("Filter \'%1\' output size is different from the input size").arg(_filter->getName()));
+        return;
+    }
+
+    cv::Rect r(tile.x() - haloTile.x(), tile.y() - haloTile.y(), tile.width(), tile.height());
+    if (!_sink->write(tile.topLeft(), res(r)))
+    {
+        setError(tr("Failed to write filtered data"));
+        return;
+    }
+
+    int progress;
+    {
+        QMutexLocker locker(&_mutex);
+        _nbOfProcessedTiles++;
+        progress = _progressStart + ((_progressEnd - _progressStart) * _nbOfProcessedTiles) / _nbOfTiles;
+    }
+    emit progressValueChanged(progress);
+}
+
+//******************************************************************************
+
+void TiledFilterEngine::setError(const QString &message)
+{
+    QMutexLocker locker(&_mutex);
+    if (_errorMessage.isEmpty())
+        _errorMessage = !message.isEmpty() ? message : tr("Filter \'%1\' has failed").arg(_filter->getName());
+    // stop other tiles
+    _monitor->cancel();
+}
+
+//******************************************************************************
+
+void TiledFilterEngine::cancel()
+{
+    _monitor->cancel();
+}
+
+//******************************************************************************
+
+bool TiledFilterEngine::isCanceled() const
+{
+    return _monitor->isCanceled();
+}
+
+//******************************************************************************
+
+}
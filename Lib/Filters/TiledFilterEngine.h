@@ -0,0 +1,86 @@
+#ifndef TILEDFILTERENGINE_H
+#define TILEDFILTERENGINE_H
+
+// Qt
+#include <QObject>
+#include <QRect>
+#include <QMutex>
+
+// Opencv
+#include <opencv2/core/core.hpp>
+
+// Project
+#include "Core/LibExport.h"
+#include "Core/Global.h"
+
+namespace Core
+{
+class ImageDataProvider;
+}
+
+namespace Filters
+{
+
+class AbstractFilter;
+class FilterMonitor;
+class FilterPipeline;
+class TileSink;
+class TileFilterTask;
+
+//******************************************************************************
+
+class GIV_DLL_EXPORT TiledFilterEngine : public QObject
+{
+    Q_OBJECT
+    friend class TileFilterTask;
+
+    PROPERTY_ACCESSORS(int, tileSize, getTileSize, setTileSize)
+    PROPERTY_ACCESSORS(int, maxNbOfThreads, getMaxNbOfThreads, setMaxNbOfThreads)
+    //! Result size limit (in bytes) to keep the result in memory, larger results are written in a temporary file
+    PROPERTY_ACCESSORS(double, inMemoryLimit, getInMemoryLimit, setInMemoryLimit)
+    PROPERTY_ACCESSORS(QString, tempPath, getTempPath, setTempPath)
+
+public:
+    explicit TiledFilterEngine(QObject * parent = 0);
+    virtual ~TiledFilterEngine();
+
+    Core::ImageDataProvider * apply(const AbstractFilter * filter, const Core::ImageDataProvider * src, const QString & name=QString());
+    void cancel();
+    bool isCanceled() const;
+
+    QString getErrorMessage() const
+    { return _errorMessage; }
+
+    static QList<QRect> computeTiles(const QRect & extent, int tileSize);
+
+signals:
+    void progressValueChanged(int);
+
+protected:
+    Core::ImageDataProvider * applyTiled(const QString & name);
+    Core::ImageDataProvider * applyOnWholeImage(const QString & name);
+    Core::ImageDataProvider * applyPipeline(const FilterPipeline * pipeline, const QString & name);
+    void processTile(const QRect & tile);
+    void setError(const QString & message);
+
+    const AbstractFilter * _filter;
+    const Core::ImageDataProvider * _src;
+    TileSink * _sink;
+    int _halo;
+    //! Engine progress range of the current stage
+    int _progressStart;
+    int _progressEnd;
+
+    FilterMonitor * _monitor;
+    QMutex _mutex;
+    QString _errorMessage;
+    int _nbOfTiles;
+    int _nbOfProcessedTiles;
+
+};
+
+//******************************************************************************
+
+}
+
+#endif // TILEDFILTERENGINE_H
@@ -2,6 +2,7 @@
 // Qt
 #include <QVBoxLayout>
 #include <QPushButton>
+#include <QCheckBox>
 
 // Project
 #include "DefaultFilterDialog.h"
@@ -29,6 +30,12 @@ DefaultFilterDialog::DefaultFilterDialog(const QString &title, QWidget *parent)
     layout()->addWidget(_editor);
 
     _editor->setPropertyUnfilter(QStringList() << "objectName");
+    connect(_editor, &PropertyEditor::propertyValueChanged, this, &DefaultFilterDialog::filterParametersChanged);
+
+    QCheckBox * preview = new QCheckBox(tr("Preview in the viewport"));
+    preview->setToolTip(tr("Filter only the visible part of the image at the current zoom level"));
+    layout()->addWidget(preview);
+    connect(preview, &QCheckBox::toggled, this, &DefaultFilterDialog::previewFilter);
 
     QPushButton * apply = new QPushButton(tr("Apply"));
     layout()->addWidget(apply);
@@ -37,6 +37,8 @@ public:
 
 signals:
     void applyFilter();
+    void previewFilter(bool);
+    void filterParametersChanged();
 
 };
 
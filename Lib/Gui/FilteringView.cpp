@@ -8,6 +8,7 @@
 #include "FilteringView.h"
 #include "Filters/AbstractFilter.h"
 #include "Filters/EditableFilter.h"
+#include "Filters/FilterPreviewDataProvider.h"
 #include "Core/GeoImageLayer.h"
 #include "Core/GeoImageItem.h"
 #include "Core/ImageDataProvider.h"
@@ -20,6 +21,11 @@ namespace Gui
 * \class FilteringView
 *
 * \brief This is a view controller for layer filtering system
+*
+* When the preview is enabled in the filter dialog, the filter is applied lazily on the visible
+* part of the source layer (see Filters::FilterPreviewDataProvider) and the preview is refreshed
+* after parameters changes. Apply computes the full resolution result. When the preview is disabled,
+* the destination layer showing the preview is removed.
 */
 //******************************************************************************
 
@@ -29,8 +35,14 @@ FilteringView::FilteringView(QProgressDialog *progress, QObject *parent) :
     _srcLayer(0),
     _dstLayer(0),
     _filter(0),
-    _progressDialog(progress)
+    _progressDialog(progress),
+    _preview(false),
+    _previewDisplayed(false)
 {
+    _previewTimer.setSingleShot(true);
+    _previewTimer.setInterval(300);
+    connect(&_previewTimer, &QTimer::timeout, this, &FilteringView::onUpdatePreview);
+
     //    connect(Filters::FiltersManager::get(),
     //            &Filters::FiltersManager::filteringFinished,
     //            this,
@@ -75,7 +87,9 @@ void FilteringView::setup(Filters::AbstractFilter * f)
     _filterDialog->setLayerName(_srcLayer->getImageName());
     _filterDialog->installEventFilter(this);
 
-    connect(_filterDialog, &DefaultFilterDialog::applyFilter, this, &FilteringView::onApplyFilter);
+    connect(_filterDialog, &BaseFilterDialog::applyFilter, this, &FilteringView::onApplyFilter);
+    connect(_filterDialog, &BaseFilterDialog::previewFilter, this, &FilteringView::onPreviewFilter);
+    connect(_filterDialog, &BaseFilterDialog::filterParametersChanged, this, &FilteringView::onFilterParametersChanged);
 
     _filter = f;
     _filterDialog->show();
@@ -87,6 +101,10 @@ void FilteringView::setup(Filters::AbstractFilter * f)
 void FilteringView::reset()
 {
     SD_TRACE("FilteringView : RESET");
+    _previewTimer.stop();
+    _preview = false;
+    _previewDisplayed = false;
+    _previewProvider = 0;
     _srcLayer = 0;
     _dstLayer = 0;
     _filter = 0;
@@ -131,11 +149,79 @@ void FilteringView::onApplyFilter()
     _progressDialog->setValue(0);
     _progressDialog->show();
 
+    // Applied result replaces the preview
+    _previewDisplayed = false;
     Filters::FiltersManager::get()->applyFilterInBackground(_filter, provider);
 }
 
 //******************************************************************************
 
+void FilteringView::onPreviewFilter(bool enabled)
+{
+    _preview = enabled;
+    if (_preview)
+    {
+        onUpdatePreview();
+    }
+    else
+    {
+        _previewTimer.stop();
+        if (_previewDisplayed)
+        {
+            _previewDisplayed = false;
+            emit previewRemoved();
+        }
+    }
+}
+
+//******************************************************************************
+
+void FilteringView::onFilterParametersChanged()
+{
+    if (_preview)
+        _previewTimer.start();
+}
+
+//******************************************************************************
+
+void FilteringView::onUpdatePreview()
+{
+    if (!_preview || !_filter || !_srcLayer)
+        return;
+
+    const Core::GeoImageItem * item = qgraphicsitem_cast<const Core::GeoImageItem*>(_srcLayer->getConstItem());
+    if (!item)
+    {
+        SD_TRACE("onUpdatePreview : item is null");
+        return;
+    }
+
+    // Displayed preview runs a copy of the filter : the copy is replaced and the tiles are reloaded
+    if (_previewDisplayed && _previewProvider)
+    {
+        if (!_previewProvider->setFilter(_filter))
+        {
+            SD_TRACE("onUpdatePreview : failed to update preview filter");
+            return;
+        }
+        emit previewUpdated();
+        return;
+    }
+
+    Filters::FilterPreviewDataProvider * provider = new Filters::FilterPreviewDataProvider();
+    if (!provider->setup(_filter, item->getConstDataProvider()))
+    {
+        SD_TRACE("onUpdatePreview : failed to setup preview data provider");
+        delete provider;
+        return;
+    }
+    _previewDisplayed = true;
+    _previewProvider = provider;
+    emit previewReady(provider);
+}
+
+//******************************************************************************
+
 bool FilteringView::eventFilter(QObject * object, QEvent * event)
 {
     if (object == _filterDialog)
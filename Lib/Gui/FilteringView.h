@@ -3,6 +3,8 @@
 
 // Qt
 #include <QObject>
+#include <QPointer>
+#include <QTimer>
 
 
 // Project
@@ -12,10 +14,12 @@ class QProgressDialog;
 
 namespace Filters {
 class AbstractFilter;
+class FilterPreviewDataProvider;
 }
 
 namespace Core {
 class GeoImageLayer;
+class ImageDataProvider;
 }
 
 namespace Gui
@@ -39,9 +43,18 @@ public:
     void reset();
     void setSrcLayer(Core::GeoImageLayer * layer);
 
+signals:
+    void previewReady(Core::ImageDataProvider *);
+    //! Signal to reload the tiles of the destination layer when the preview filter is updated
+    void previewUpdated();
+    //! Signal to remove the destination layer when it shows the preview
+    void previewRemoved();
 
 protected slots:
     void onApplyFilter();
+    void onPreviewFilter(bool enabled);
+    void onFilterParametersChanged();
+    void onUpdatePreview();
 
 protected:
 
@@ -50,6 +63,13 @@ protected:
     BaseFilterDialog * _filterDialog;
     QProgressDialog * _progressDialog;
 
+    bool _preview;
+    //! Destination layer shows the preview and not the applied filter result
+    bool _previewDisplayed;
+    //! Provider of the displayed preview, owned by the destination layer item
+    QPointer<Filters::FilterPreviewDataProvider> _previewProvider;
+    QTimer _previewTimer;
+
 };
 
 //******************************************************************************
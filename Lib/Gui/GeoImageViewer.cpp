@@ -84,6 +84,12 @@ GeoImageViewer::GeoImageViewer(QWidget *parent) :
             this, SLOT(onFilteringFinished(Core::ImageDataProvider*)));
     connect(Filters::FiltersManager::get(), SIGNAL(filterProgressValueChanged(int)),
             this, SLOT(onProgressValueChanged(int)));
+    connect(_filteringView, SIGNAL(previewReady(Core::ImageDataProvider*)),
+            this, SLOT(onFilterPreviewReady(Core::ImageDataProvider*)));
+    connect(_filteringView, SIGNAL(previewRemoved()),
+            this, SLOT(onFilterPreviewRemoved()));
+    connect(_filteringView, SIGNAL(previewUpdated()),
+            this, SLOT(onFilterPreviewUpdated()));
 
 }
 
@@ -225,6 +231,11 @@ void GeoImageViewer::onProgressCanceled()
         {
             _imageWriter->cancel();
         }
+        else if (Filters::FiltersManager::get()->isWorking())
+        {
+            // filtering finishes in background, null result is sent to onFilteringFinished()
+            Filters::FiltersManager::get()->cancel();
+        }
     _processedLayer = 0;
 
     // ??? What to do with _filteringView ???
@@ -367,18 +378,90 @@ void GeoImageViewer::writeGeoImageLayer(Core::GeoImageLayer* layer)
     //        return;
     //    }
 
+    // Cloud optimized GeoTiffs and map tiles are proposed only for image data.
+    // JPEG GeoTiff is possible only for 8 bits RGB images
+    QStringList formats;
+    QList<ExportFormat> exportFormats;
+    formats << tr("GeoTiff (*.tif)");
+    exportFormats << GeoTiff;
+    if (item->type() == Core::GeoImageItem::Type)
+    {
+        const Core::ImageDataProvider * provider = qgraphicsitem_cast<const Core::GeoImageItem*>(item)->getConstDataProvider();
+        formats << tr("Cloud optimized GeoTiff, DEFLATE (*.tif)")
+                << tr("Cloud optimized GeoTiff, ZSTD (*.tif)")
+                << tr("Cloud optimized GeoTiff, LZW (*.tif)");
+        exportFormats << CloudOptimizedDeflate << CloudOptimizedZstd << CloudOptimizedLzw;
+        if (provider->getNbBands() == 3 && provider->getInputDepthInBytes() == 1 && !provider->inputIsComplex())
+        {
+            formats << tr("Cloud optimized GeoTiff, JPEG (*.tif)");
+            exportFormats << CloudOptimizedJpeg;
+        }
+        // XYZ tiles rows are numbered from the top and TMS tiles rows from the bottom
+        formats << tr("Map tiles XYZ, PNG (*.png)")
+                << tr("Map tiles XYZ, JPEG (*.jpg)")
+                << tr("Map tiles TMS, PNG (*.png)")
+                << tr("Map tiles TMS, JPEG (*.jpg)");
+        exportFormats << MapTilesPng << MapTilesJpeg << TmsTilesPng << TmsTilesJpeg;
+    }
+    QString format;
     QString filename = QFileDialog::getSaveFileName(this,
                                                     tr("Save into a file"),
                                                     QString(),
-                                                    tr("Images (*.tif)"));
+                                                    formats.join(";;"),
+                                                    &format);
     if (filename.isEmpty())
         return;
 
+    ExportFormat exportFormat = exportFormats.value(formats.indexOf(format), GeoTiff);
+    // data is written as float with the floating point predictor, except for JPEG
+    Core::GeoTiffOptions options;
+    switch (exportFormat)
+    {
+    case CloudOptimizedDeflate:
+        options.Compression = "DEFLATE";
+        options.Predictor = 3;
+        options.CloudOptimized = true;
+        break;
+    case CloudOptimizedZstd:
+        options.Compression = "ZSTD";
+        options.Predictor = 3;
+        options.CloudOptimized = true;
+        break;
+    case CloudOptimizedLzw:
+        options.Compression = "LZW";
+        options.Predictor = 3;
+        options.CloudOptimized = true;
+        break;
+    case CloudOptimizedJpeg:
+        options.Compression = "JPEG";
+        options.CloudOptimized = true;
+        break;
+    default:
+        break;
+    }
+    _imageWriter->setGeoTiffOptions(options);
+
     _progressDialog->setLabelText("Save image ...");
     _progressDialog->setValue(0);
     _progressDialog->show();
 
-    if (item->type() == Core::GeoImageItem::Type)
+    if (exportFormat == MapTilesPng || exportFormat == MapTilesJpeg ||
+            exportFormat == TmsTilesPng || exportFormat == TmsTilesJpeg)
+    {
+        // tiles are rendered with the current configuration into the directory 'filename' without extension
+        const Core::GeoImageItem * giItem = qgraphicsitem_cast<const Core::GeoImageItem*>(item);
+        QFileInfo fi(filename);
+        QString outputPath = fi.absolutePath() + "/" + fi.completeBaseName();
+        bool isPng = exportFormat == MapTilesPng || exportFormat == TmsTilesPng;
+        bool isTms = exportFormat == TmsTilesPng || exportFormat == TmsTilesJpeg;
+        if (!_imageWriter->writeTilesInBackground(outputPath, giItem->getConstDataProvider(),
+                                                  giItem->getRenderer(), giItem->getRendererConfiguration(),
+                                                  isPng ? "png" : "jpg", isTms))
+        {
+            _progressDialog->close();
+        }
+    }
+    else if (item->type() == Core::GeoImageItem::Type)
     {
         const Core::GeoImageItem * giItem = qgraphicsitem_cast<const Core::GeoImageItem*>(item);
         const Core::ImageDataProvider * provider = giItem->getConstDataProvider();
@@ -389,10 +472,18 @@ void GeoImageViewer::writeGeoImageLayer(Core::GeoImageLayer* layer)
     }
     else if (item->type() == Core::DrawingsItem::Type)
     {
+        // only the painted part of the canvas is written, not the whole canvas
         const Core::DrawingsItem * dItem = qgraphicsitem_cast<const Core::DrawingsItem*>(item);
-        const QImage & image = dItem->getImage();
+        QRect rect = dItem->getPaintedRect().intersected(QRect(QPoint(0, 0), dItem->getSize()));
+        if (rect.isEmpty())
+        {
+            _progressDialog->close();
+            SD_ERR(tr("Drawings layer is empty, nothing to write"));
+            return;
+        }
+        QImage image = dItem->getImage(rect);
 
-        if (!_imageWriter->writeInBackground(filename, &image, _processedLayer))
+        if (!_imageWriter->writeInBackground(filename, &image, _processedLayer, rect.topLeft()))
         {
             _progressDialog->close();
         }
@@ -501,20 +592,77 @@ void GeoImageViewer::onFilteringFinished(Core::ImageDataProvider * provider)
     if (!provider)
     {
         //        SD_TRACE("GeoImageViewer::onFilteringFinished : provider is null");
+        if (Filters::FiltersManager::get()->isCanceled())
+        {
+            _progressDialog->close();
+            return;
+        }
         SD_ERR(tr("Filtering  with \'%1\' has failed.\n\nError message: %2")
                .arg(filter->getName())
-               .arg(filter->getErrorMessage()));
+               .arg(Filters::FiltersManager::get()->getErrorMessage()));
         _progressDialog->close();
         return;
     }
 
+    displayFilteringResult(provider);
+}
+
+//******************************************************************************
+
+void GeoImageViewer::onFilterPreviewReady(Core::ImageDataProvider * provider)
+{
+    if (!_filteringView->getSrcLayer())
+    {
+        delete provider;
+        return;
+    }
+    displayFilteringResult(provider);
+}
+
+//******************************************************************************
+/*!
+ * \brief GeoImageViewer::onFilterPreviewRemoved method to remove the destination layer showing the preview.
+ * Filtering view destination layer is reset in onBaseLayerDestroyed()
+ */
+void GeoImageViewer::onFilterPreviewRemoved()
+{
+    Core::GeoImageLayer * dstLayer = _filteringView->getDstLayer();
+    if (dstLayer)
+        removeLayer(dstLayer);
+}
+
+//******************************************************************************
+/*!
+ * \brief GeoImageViewer::onFilterPreviewUpdated method to reload the tiles of the destination layer
+ * when the filter of the displayed preview provider is updated. Layer and item are kept
+ */
+void GeoImageViewer::onFilterPreviewUpdated()
+{
+    Core::GeoImageLayer * dstLayer = _filteringView->getDstLayer();
+    if (!dstLayer)
+        return;
+    Core::GeoImageItem * item = qgraphicsitem_cast<Core::GeoImageItem*>(dstLayer->getItem());
+    if (!item)
+        return;
+    item->clearCache();
+    item->updateItem(_zoomLevel, getVisibleSceneRect());
+}
+
+//******************************************************************************
+/*!
+ * \brief GeoImageViewer::displayFilteringResult method to display filtered data in the destination layer of the filtering view.
+ * Destination layer is created if does not exist. Provider is deleted if it can not be displayed
+ */
+bool GeoImageViewer::displayFilteringResult(Core::ImageDataProvider * provider)
+{
+    Filters::AbstractFilter * filter = _filteringView->getFilter();
     const Core::GeoImageItem * item = qgraphicsitem_cast<const Core::GeoImageItem*>(_filteringView->getSrcLayer()->getConstItem());
 
     if (!item)
     {
-        SD_TRACE("GeoImageViewer::onFilteringFinished : item is null . something wrong");
+        SD_TRACE("GeoImageViewer::displayFilteringResult : item is null . something wrong");
         delete provider;
-        return;
+        return false;
     }
 
     QPointF pos = item->pos();
@@ -523,7 +671,7 @@ void GeoImageViewer::onFilteringFinished(Core::ImageDataProvider * provider)
     {
         delete provider;
         SD_ERR("Application failed to create new image layer");
-        return;
+        return false;
     }
 
     if (!_filteringView->getDstLayer())
@@ -540,6 +688,7 @@ void GeoImageViewer::onFilteringFinished(Core::ImageDataProvider * provider)
 
     // display item in Scene:
     nItem->updateItem(_zoomLevel, getVisibleSceneRect());
+    return true;
 }
 
 //******************************************************************************
@@ -652,6 +801,8 @@ void GeoImageViewer::initFilterTools()
                         this, SLOT(onDrawingFinalized(QString,Core::DrawingsItem*)));
                 connect(ftool, SIGNAL(itemCreated(QGraphicsItem*)),
                         this, SLOT(onItemCreated(QGraphicsItem*)));
+                connect(this, SIGNAL(viewportChanged(int,QRectF)),
+                        ftool, SLOT(onViewportChanged(int,QRectF)));
             }
         }
     }
@@ -68,11 +68,28 @@ protected slots:
 
     virtual void onFilterTriggered();
     virtual void onFilteringFinished(Core::ImageDataProvider *);
+    virtual void onFilterPreviewReady(Core::ImageDataProvider *);
+    virtual void onFilterPreviewRemoved();
+    virtual void onFilterPreviewUpdated();
 
     void onDrawingFinalized(const QString&, Core::DrawingsItem*);
 
 protected:
 
+    //! Formats proposed to save image layers
+    enum ExportFormat
+    {
+        GeoTiff,
+        CloudOptimizedDeflate,
+        CloudOptimizedZstd,
+        CloudOptimizedLzw,
+        CloudOptimizedJpeg,
+        MapTilesPng,
+        MapTilesJpeg,
+        TmsTilesPng,
+        TmsTilesJpeg
+    };
+
     void writeGeoImageLayer(Core::GeoImageLayer *layer);
     void writeGeoShapeLayer(Core::GeoShapeLayer *layer);
 
@@ -86,6 +103,7 @@ protected:
     bool configureTool(Tools::AbstractTool * tool, Core::BaseLayer * layer);
 
     void initFilterTools();
+    bool displayFilteringResult(Core::ImageDataProvider * provider);
 
     virtual bool onSceneDragAndDrop(const QList<QUrl> & urls);
     void enableOptions(bool v);
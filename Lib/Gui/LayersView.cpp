@@ -80,6 +80,15 @@ void LayersView::onRemoveLayer()
 {
     QListWidgetItem * item = ui->_layers->currentItem();
     Core::BaseLayer * layer = _itemLayerMap.value(item, 0);
+    if (layer)
+        removeLayer(layer);
+}
+
+//******************************************************************************
+
+void LayersView::removeLayer(Core::BaseLayer *layer)
+{
+    QListWidgetItem * item = _itemLayerMap.key(layer, 0);
 
     // reset editor info if removed layer is current
     if (ui->_editor->getObject() == layer)
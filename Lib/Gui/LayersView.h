@@ -39,6 +39,7 @@ public:
     ~LayersView();
 
     void addLayer(Core::BaseLayer * layer);
+    void removeLayer(Core::BaseLayer * layer);
     void setLayers(const QList<Core::BaseLayer*> & layers);
 
     Core::BaseLayer * getCurrentLayer();
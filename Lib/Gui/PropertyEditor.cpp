@@ -389,6 +389,10 @@ QWidget * PropertyEditor::readableWidget(const QVariant &value)
     if (!property.write(_object, newValue)) \
     { \
         SD_TRACE(QString("onPropertyChanged : failed to write new property value !")); \
+    } \
+    else \
+    { \
+        emit propertyValueChanged(property.name()); \
     }
 
 //******************************************************************************
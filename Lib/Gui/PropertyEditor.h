@@ -44,6 +44,8 @@ public:
     QObject * getObject()
     { return _object; }
 
+signals:
+    void propertyValueChanged(const QString & name);
 
 protected:
 
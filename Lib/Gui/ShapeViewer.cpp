@@ -60,6 +60,9 @@ ShapeViewer::ShapeViewer(const QString &initialText, QWidget *parent) :
 
 ShapeViewer::~ShapeViewer()
 {
+    // tool is deactivated before it is destroyed
+    if (_currentTool)
+        _currentTool->clear();
     _currentTool = 0;
     Tools::ToolsManager::destroy();
 
@@ -377,6 +380,21 @@ void ShapeViewer::addLayer(Core::BaseLayer * layer)
 
 //******************************************************************************
 
+void ShapeViewer::removeLayer(Core::BaseLayer * layer)
+{
+    // layer is removed from the list in onBaseLayerDestroyed()
+    if (_layersView)
+    {
+        _layersView->removeLayer(layer);
+    }
+    else
+    {
+        delete layer;
+    }
+}
+
+//******************************************************************************
+
 void ShapeViewer::setToolsView(AbstractToolsView *toolsView)
 {
 
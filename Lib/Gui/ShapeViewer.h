@@ -58,6 +58,7 @@ protected:
 
     void changeTool(Tools::AbstractTool * newTool);
     void addLayer(Core::BaseLayer*);
+    void removeLayer(Core::BaseLayer*);
 
     virtual QPointF computePointOnItem(const QPointF &scenePos);
 
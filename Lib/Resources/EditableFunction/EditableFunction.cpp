@@ -6,6 +6,10 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+// Neighbourhood radius in pixels needed to compute an output pixel. Uncomment if the filter function
+// does not use global image statistics to allow filtering of image tiles in parallel
+// #define EF_HALO_SIZE 5
+
 // Do not remove this include
 #include "EditableFunction.h"
 
@@ -14,6 +18,7 @@
 
 // Built-in functions :
 //
+// float noDataValue() : no-data value of the filtered data (same as _noDataValue)
 // verboseDisplayImage(const std::string & name, const cv::Mat & img)
 //
 
@@ -186,7 +191,7 @@ cv::Mat filter(const cv::Mat & data)
     cv::Mat m = out == 0;
     cv::Mat mask;
     m.convertTo(mask, CV_32F, 1.0/255.0);
-    mask = mask.mul(_noDataValue);
+    mask = mask.mul(noDataValue());
     cv::Mat o;
     out.convertTo(o, CV_32F, 1.0/255.0);
     out = o + mask;
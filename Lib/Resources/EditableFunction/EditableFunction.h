@@ -9,9 +9,24 @@
 #  define EF_EXPORT
 #endif
 
+#if (defined _MSC_VER)
+#  define EF_THREAD_LOCAL __declspec(thread)
+#else
+#  define EF_THREAD_LOCAL __thread
+#endif
+
+// Neighbourhood radius in pixels needed by the filter function to compute an output pixel.
+// Define it before including this header to allow the application to call the filter function
+// on image tiles in parallel, e.g. #define EF_HALO_SIZE 5
+// Default value -1 means that the filter function needs the whole image.
+#ifndef EF_HALO_SIZE
+#  define EF_HALO_SIZE -1
+#endif
+
 // Std
 #include <iostream>
 #include <queue>
+#include <cstring>
 
 // Opencv
 #include <opencv2/core/core.hpp>
@@ -22,17 +37,38 @@
 
 cv::Mat filter(const cv::Mat & inputImg);
 
-static float _noDataValue;
+typedef std::pair<std::string, cv::Mat> Message;
+
+// State of a filter function call
+struct EFContext
+{
+    float noDataValue;
+    std::queue<Message> queue;
+    cv::Mat result;
+};
 
+// ABI v1 uses a single global context, ABI v2 sets the context of the current call
+static EFContext _v1Context;
+static EF_THREAD_LOCAL EFContext * _currentContext = 0;
 
-typedef std::pair<std::string, cv::Mat> Message;
-static std::queue<Message> _queue;
-static cv::Mat _result;
+inline EFContext * currentContext()
+{
+    return _currentContext ? _currentContext : &_v1Context;
+}
+
+// No-data value of the current call
+inline float noDataValue()
+{
+    return currentContext()->noDataValue;
+}
+
+// Predefined variable of the first versions, kept for the existing programs
+#define _noDataValue (currentContext()->noDataValue)
 
 void verboseDisplayImage(const std::string & name, const cv::Mat & img)
 {
     cv::Mat copy = img.clone();
-    _queue.push(Message(name, copy));
+    currentContext()->queue.push(Message(name, copy));
 }
 
 //******************************************************************************
@@ -41,14 +77,17 @@ void verboseDisplayImage(const std::string & name, const cv::Mat & img)
 
 extern "C" double EF_EXPORT foo(double value);
 
+//******************************************************************************
+// ABI v1 : two-phase calls on the global context, not reentrant
 //******************************************************************************
 
 extern "C" bool EF_EXPORT filterFuncP1(uchar * inputData, int inputWidth, int inputHeight, int inputCvType,
                                        float noDataValue,
                                        int * outputWidth, int * outputHeight, int * outputCvType)
 {
-    _queue.swap( std::queue<Message>() );
-    _noDataValue = noDataValue;
+    _currentContext = 0;
+    std::queue<Message>().swap(_v1Context.queue);
+    _v1Context.noDataValue = noDataValue;
 
     if (!inputData ||
             !outputWidth ||
@@ -63,7 +102,7 @@ extern "C" bool EF_EXPORT filterFuncP1(uchar * inputData, int inputWidth, int in
 
     try
     {
-        _result = filter(inputImg);
+        _v1Context.result = filter(inputImg);
     }
     catch (const cv::Exception & e)
     {
@@ -72,11 +111,11 @@ extern "C" bool EF_EXPORT filterFuncP1(uchar * inputData, int inputWidth, int in
     }
 
 
-    if (!_result.empty())
+    if (!_v1Context.result.empty())
     {
-        *outputHeight = _result.rows;
-        *outputWidth = _result.cols;
-        *outputCvType = _result.type();
+        *outputHeight = _v1Context.result.rows;
+        *outputWidth = _v1Context.result.cols;
+        *outputCvType = _v1Context.result.type();
     }
     else
     {
@@ -97,8 +136,10 @@ extern "C" bool EF_EXPORT filterFuncP2(uchar * outputData)
         return false;
     }
     // copy data:
-    memcpy(outputData, _result.data, _result.rows * _result.cols * _result.elemSize());
-    _result.release();
+    cv::Mat & result = _v1Context.result;
+    cv::Mat output(result.rows, result.cols, result.type(), (void*) outputData);
+    result.copyTo(output);
+    result.release();
     return true;
 }
 
@@ -106,7 +147,7 @@ extern "C" bool EF_EXPORT filterFuncP2(uchar * outputData)
 
 extern "C" int EF_EXPORT verboseStackCount()
 {
-    return _queue.size();
+    return _v1Context.queue.size();
 }
 
 //******************************************************************************
@@ -122,7 +163,7 @@ extern "C" bool EF_EXPORT verboseStackNextP1(int * outputWidth, int *outputHeigh
         return false;
     }
 
-    Message & msg = _queue.front();
+    Message & msg = _v1Context.queue.front();
     *msgsize = msg.first.size();
     cv::Mat res = msg.second;
     if (!res.empty())
@@ -151,12 +192,183 @@ extern "C" bool EF_EXPORT verboseStackNextP2(uchar * outputData, char * msgdata)
         return false;
     }
 
-    Message & msg = _queue.front();
-    strcpy(msgdata, msg.first.c_str());
+    Message & msg = _v1Context.queue.front();
+    memcpy(msgdata, msg.first.c_str(), msg.first.size());
 
     cv::Mat res = msg.second;
     memcpy(outputData, res.data, res.rows * res.cols * res.elemSize());
-    _queue.pop();
+    _v1Context.queue.pop();
+    return true;
+}
+
+//******************************************************************************
+// ABI v2 : calls on an explicit context, reentrant.
+// Input and output data are caller's buffers with row steps (e.g. image tiles),
+// result is written directly into the output buffer when its size and type are expected by the caller.
+//******************************************************************************
+
+extern "C" int EF_EXPORT abiVersion()
+{
+    return 2;
+}
+
+//******************************************************************************
+
+extern "C" int EF_EXPORT haloSize()
+{
+    return EF_HALO_SIZE;
+}
+
+//******************************************************************************
+
+extern "C" void * EF_EXPORT createContext(float noDataValue)
+{
+    EFContext * context = new EFContext();
+    context->noDataValue = noDataValue;
+    return context;
+}
+
+//******************************************************************************
+
+extern "C" void EF_EXPORT destroyContext(void * context)
+{
+    delete static_cast<EFContext*>(context);
+}
+
+//******************************************************************************
+
+/*
+    Apply the filter function on input data and write the result in output data.
+    Returns 1 if the result is written, 0 if failed
+    and -1 if the result size or type are different from the output ones : result size and type are written into
+    resultWidth, resultHeight, resultCvType and the result is kept in the context until takeResult() call.
+*/
+extern "C" int EF_EXPORT filterFunc(void * ctx,
+                                    const uchar * inputData, int inputWidth, int inputHeight, int inputCvType, size_t inputStep,
+                                    uchar * outputData, int outputWidth, int outputHeight, int outputCvType, size_t outputStep,
+                                    int * resultWidth, int * resultHeight, int * resultCvType)
+{
+    EFContext * context = static_cast<EFContext*>(ctx);
+    if (!context ||
+            !inputData ||
+            !resultWidth ||
+            !resultHeight ||
+            !resultCvType)
+    {
+        std::cerr << "Some of attribute pointers is null" << std::endl;
+        return 0;
+    }
+
+    cv::Mat inputImg(inputHeight, inputWidth, inputCvType, (void*) inputData, inputStep);
+
+    EFContext * previousContext = _currentContext;
+    _currentContext = context;
+    cv::Mat result;
+    try
+    {
+        result = filter(inputImg);
+    }
+    catch (const cv::Exception & e)
+    {
+        std::cerr << "OpenCV Exception : " << e.msg << std::endl;
+        _currentContext = previousContext;
+        return 0;
+    }
+    _currentContext = previousContext;
+
+    *resultWidth = result.cols;
+    *resultHeight = result.rows;
+    *resultCvType = result.empty() ? -1 : result.type();
+
+    if (result.empty())
+        return 1;
+
+    if (outputData &&
+            result.cols == outputWidth &&
+            result.rows == outputHeight &&
+            result.type() == outputCvType)
+    {
+        cv::Mat outputImg(outputHeight, outputWidth, outputCvType, (void*) outputData, outputStep);
+        if (result.data != outputImg.data)
+            result.copyTo(outputImg);
+        return 1;
+    }
+
+    context->result = result;
+    return -1;
+}
+
+//******************************************************************************
+
+extern "C" bool EF_EXPORT takeResult(void * ctx, uchar * outputData, size_t outputStep)
+{
+    EFContext * context = static_cast<EFContext*>(ctx);
+    if (!context || !outputData || context->result.empty())
+    {
+        std::cerr << "Some of attribute pointers is null" << std::endl;
+        return false;
+    }
+    cv::Mat & result = context->result;
+    cv::Mat outputImg(result.rows, result.cols, result.type(), (void*) outputData, outputStep);
+    result.copyTo(outputImg);
+    result.release();
+    return true;
+}
+
+//******************************************************************************
+
+extern "C" int EF_EXPORT verboseCount(void * ctx)
+{
+    EFContext * context = static_cast<EFContext*>(ctx);
+    return context ? context->queue.size() : 0;
+}
+
+//******************************************************************************
+
+extern "C" bool EF_EXPORT verboseNext(void * ctx, int * outputWidth, int *outputHeight, int *outputCvType, int * msgsize)
+{
+    EFContext * context = static_cast<EFContext*>(ctx);
+    if (!context ||
+            context->queue.empty() ||
+            !outputWidth ||
+            !outputHeight ||
+            !outputCvType ||
+            !msgsize)
+    {
+        std::cerr << "Some of attribute pointers is null" << std::endl;
+        return false;
+    }
+
+    Message & msg = context->queue.front();
+    *msgsize = msg.first.size();
+    const cv::Mat & res = msg.second;
+    *outputHeight = res.rows;
+    *outputWidth = res.cols;
+    *outputCvType = res.empty() ? -1 : res.type();
+    return true;
+}
+
+//******************************************************************************
+
+extern "C" bool EF_EXPORT verboseTake(void * ctx, uchar * outputData, size_t outputStep, char * msgdata)
+{
+    EFContext * context = static_cast<EFContext*>(ctx);
+    if (!context || context->queue.empty() || !msgdata)
+    {
+        std::cerr << "Some of attribute pointers is null" << std::endl;
+        return false;
+    }
+
+    Message & msg = context->queue.front();
+    memcpy(msgdata, msg.first.c_str(), msg.first.size());
+
+    const cv::Mat & res = msg.second;
+    if (outputData && !res.empty())
+    {
+        cv::Mat outputImg(res.rows, res.cols, res.type(), (void*) outputData, outputStep);
+        res.copyTo(outputImg);
+    }
+    context->queue.pop();
     return true;
 }
 
@@ -1,6 +1,8 @@
 // Qt
 #include <QGraphicsScene>
 #include <QPainter>
+#include <QAction>
+#include <QKeyEvent>
 
 // Project
 #include "AbstractTool.h"
@@ -21,6 +23,7 @@ namespace Tools
 
   \class ImageCreationTool from CreationTool,
   \brief Inherits from CreationTool, abstract class represents a tool to create a Core::DrawingsItem. Created Core::DrawingsItem is not owned by this class
+  Strokes on the Core::DrawingsItem can be undone with Undo/Redo actions or key sequences (see Core::DrawingsItem::beginEdit())
 
 */
 
@@ -52,6 +55,16 @@ ImageCreationTool::ImageCreationTool(QObject * parent) :
 {
     _toolType = Type;
     _cursor = QCursor(Qt::BlankCursor);
+
+    _undo = new QAction(tr("Undo"), this);
+    _undo->setShortcut(QKeySequence::Undo);
+    connect(_undo, SIGNAL(triggered()), this, SLOT(undo()));
+    _actions.append(_undo);
+
+    _redo = new QAction(tr("Redo"), this);
+    _redo->setShortcut(QKeySequence::Redo);
+    connect(_redo, SIGNAL(triggered()), this, SLOT(redo()));
+    _actions.append(_redo);
 }
 
 //******************************************************************************
@@ -74,4 +87,43 @@ void ImageCreationTool::setIsMerging(bool value)
 
 //******************************************************************************
 
+void ImageCreationTool::undo()
+{
+    if (_drawingsItem && !_pressed)
+        _drawingsItem->undo();
+}
+
+//******************************************************************************
+
+void ImageCreationTool::redo()
+{
+    if (_drawingsItem && !_pressed)
+        _drawingsItem->redo();
+}
+
+//******************************************************************************
+/*!
+  Method to undo/redo on key sequences. Actions shortcuts are not active in the context menu
+*/
+bool ImageCreationTool::undoRedoOnKeys(QEvent *e)
+{
+    if (e->type() != QEvent::KeyPress || !_drawingsItem)
+        return false;
+
+    QKeyEvent * event = static_cast<QKeyEvent*>(e);
+    if (event->matches(QKeySequence::Undo))
+    {
+        undo();
+        return true;
+    }
+    else if (event->matches(QKeySequence::Redo))
+    {
+        redo();
+        return true;
+    }
+    return false;
+}
+
+//******************************************************************************
+
 }
@@ -116,8 +116,16 @@ public:
     virtual void setErase(bool erase);
     virtual void setIsMerging(bool value);
 
+public slots:
+    void undo();
+    void redo();
+
 protected:
+    bool undoRedoOnKeys(QEvent * e);
+
     int _mode;
+    QAction * _undo;
+    QAction * _redo;
 };
 
 //******************************************************************************
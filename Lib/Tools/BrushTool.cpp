@@ -7,6 +7,8 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QWheelEvent>
 #include <QPoint>
+#include <QLineF>
+#include <QMap>
 #include <qmath.h>
 
 // Project
@@ -22,6 +24,8 @@ namespace Tools
   \class BrushTool
   \brief Class inherits from ImageCreationTool class and represent a tool to draw circles on Core::DrawingsItem.
   User can specify the color and the size.
+  Circles are stamped along the mouse path every quarter of the brush size, stamps of a mouse event are
+  painted at once and the painted area is repainted at most once per frame.
 */
 
 //******************************************************************************
@@ -39,6 +43,11 @@ BrushTool::BrushTool(QGraphicsScene* scene, QGraphicsView * view, QObject *paren
     _name=tr("Brush");
     _description=tr("Tool to draw on a layer");
     _icon = QIcon(":/icons/brush");
+
+    // ~60 repaints per second
+    _updateTimer.setSingleShot(true);
+    _updateTimer.setInterval(16);
+    connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(onUpdateTimeout()));
 }
 
 //******************************************************************************
@@ -46,13 +55,19 @@ BrushTool::BrushTool(QGraphicsScene* scene, QGraphicsView * view, QObject *paren
 bool BrushTool::dispatch(QEvent *e, QGraphicsScene *scene)
 {
 
-    if (e->type() == QEvent::GraphicsSceneMousePress)
+    if (undoRedoOnKeys(e))
+    {
+        return true;
+    }
+    else if (e->type() == QEvent::GraphicsSceneMousePress)
     {
         QGraphicsSceneMouseEvent * event = static_cast<QGraphicsSceneMouseEvent*>(e);
         if (event->button() == Qt::LeftButton && !_pressed && _drawingsItem)
         {
             _pressed = true;
             _anchor = event->scenePos();
+            // a stroke is undone at once
+            _drawingsItem->beginEdit();
             drawAtPoint(_anchor);
             return true;
         }
@@ -65,7 +80,7 @@ bool BrushTool::dispatch(QEvent *e, QGraphicsScene *scene)
 
         if (_pressed && (event->buttons() & Qt::LeftButton) && _drawingsItem)
         {
-            drawAtPoint(event->scenePos());
+            drawStroke(event->scenePos());
         }
         // Allow to process other options on mouse move. Otherwise should return true
         return false;
@@ -77,6 +92,10 @@ bool BrushTool::dispatch(QEvent *e, QGraphicsScene *scene)
         {
             _pressed=false;
             _anchor = QPointF();
+            if (_drawingsItem)
+                _drawingsItem->endEdit();
+            _updateTimer.stop();
+            onUpdateTimeout();
 
             return true;
         }
@@ -186,29 +205,92 @@ void BrushTool::createCursor()
 
 void BrushTool::drawAtPoint(const QPointF &pos)
 {
-    // check if the rectangle to paint is in the drawingItem zone:
-    QRectF r = _drawingsItem->boundingRect();
-    r.moveTo(_drawingsItem->pos());
+    drawStamps(QVector<QPointF>() << pos);
+}
+
+//******************************************************************************
+/*!
+  Method to draw stamps on the segment from the last stamp (_anchor) to the point
+*/
+void BrushTool::drawStroke(const QPointF &pos)
+{
     double size = _size / qMin(_view->matrix().m11(), _view->matrix().m22());
-    QRectF r2 = QRectF(pos.x()-size*0.5, pos.y()-size*0.5, size, size);
-    if (r.intersects(QRectF(pos.x()-_size*0.5, pos.y()-_size*0.5, _size, _size)))
+    double spacing = qMax(0.25*size, 0.5);
+    QLineF line(_anchor, pos);
+    double length = line.length();
+
+    QVector<QPointF> points;
+    for (double t=spacing; t<=length; t+=spacing)
     {
-        r2.translate(-_drawingsItem->scenePos());
-        drawCircle(r2);
-        r2=r2.adjusted(-size*0.25, -size*0.25, size*0.25, size*0.25);
-        _drawingsItem->update(r2);
+        points << line.pointAt(t/length);
     }
+    if (points.isEmpty())
+        return;
+
+    _anchor = points.last();
+    drawStamps(points);
+}
+
+//******************************************************************************
+
+void BrushTool::drawStamps(const QVector<QPointF> &points)
+{
+    // check if the rectangles to paint are in the drawingItem zone:
+    QRectF canvas = _drawingsItem->boundingRect();
+    double size = _size / qMin(_view->matrix().m11(), _view->matrix().m22());
+    QRect canvasRect = canvas.toAlignedRect();
+    const int tileSize = Core::DrawingsItem::TileSize;
+
+    // Stamps are grouped by canvas tiles : only the touched tiles are saved for undo and written back
+    QMap<quint64, QRect> tileRects;
+    QMap<quint64, QVector<QRectF> > tileStamps;
+    QRectF bounds;
+    foreach (QPointF pos, points)
+    {
+        QRectF r = QRectF(pos.x()-size*0.5, pos.y()-size*0.5, size, size);
+        r.translate(-_drawingsItem->scenePos());
+        QRect ar = r.adjusted(-1.0, -1.0, 1.0, 1.0).toAlignedRect().intersected(canvasRect);
+        if (ar.isEmpty())
+            continue;
+        bounds = bounds.united(ar);
+        for (int ty=ar.top()/tileSize; ty<=ar.bottom()/tileSize; ty++)
+        {
+            for (int tx=ar.left()/tileSize; tx<=ar.right()/tileSize; tx++)
+            {
+                quint64 key = ((quint64) ty << 32) | (quint64) tx;
+                QRect tr = QRect(tx*tileSize, ty*tileSize, tileSize, tileSize).intersected(ar);
+                tileRects[key] = tileRects.value(key).united(tr);
+                tileStamps[key] << r;
+            }
+        }
+    }
+    if (tileRects.isEmpty())
+        return;
+
+    foreach (quint64 key, tileRects.keys())
+    {
+        Core::DrawingsPainter p(_drawingsItem, tileRects[key], false);
+        p.setCompositionMode((QPainter::CompositionMode)_mode);
+        p.setPen(QPen(_ucolor, 0.0));
+        p.setBrush(_ucolor);
+        foreach (QRectF r, tileStamps[key])
+        {
+            p.drawEllipse(r);
+        }
+    }
+
+    _dirtyRect = _dirtyRect.united(bounds.translated(_drawingsItem->scenePos()));
+    if (!_updateTimer.isActive())
+        _updateTimer.start();
 }
 
 //******************************************************************************
 
-void BrushTool::drawCircle(const QRectF & r)
+void BrushTool::onUpdateTimeout()
 {
-    QPainter p(&_drawingsItem->getImage());
-    p.setCompositionMode((QPainter::CompositionMode)_mode);
-    p.setPen(QPen(_ucolor, 0.0));
-    p.setBrush(_ucolor);
-    p.drawEllipse(r);
+    if (!_dirtyRect.isEmpty())
+        _scene->update(_dirtyRect);
+    _dirtyRect = QRectF();
 }
 
 //******************************************************************************
@@ -1,7 +1,9 @@
 #ifndef BRUSHTOOL_H
 #define BRUSHTOOL_H
 
-
+// Qt
+#include <QTimer>
+#include <QVector>
 
 // Project
 #include "Core/Global.h"
@@ -40,18 +42,26 @@ public slots:
 signals:
     void sizeChanged(double);
 
+protected slots:
+    void onUpdateTimeout();
+
 protected:
 
     void createCursor();
     void destroyCursor();
-    void drawCircle(const QRectF &r);
     void drawAtPoint(const QPointF & pt);
+    void drawStroke(const QPointF & pt);
+    void drawStamps(const QVector<QPointF> & points);
 
     QAbstractGraphicsShapeItem * _cursorShape;
     QGraphicsScene * _scene;
     QGraphicsView * _view;
     QColor _ucolor;
 
+    //! Scene rect painted since the last repaint
+    QRectF _dirtyRect;
+    QTimer _updateTimer;
+
 };
 
 //******************************************************************************
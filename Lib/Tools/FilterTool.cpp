@@ -9,6 +9,9 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QWheelEvent>
 #include <QPoint>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QMetaProperty>
 #include <qmath.h>
 
 // Opencv
@@ -17,6 +20,7 @@
 // Project
 #include "FilterTool.h"
 #include "Core/LayerUtils.h"
+#include "Core/ImageDataProvider.h"
 
 namespace Tools
 {
@@ -31,6 +35,20 @@ namespace Tools
   Virtual method onFinalize() should be subclassed to finish the processing and send the result.
   The result of the filtering can be a QGraphicsItem or Core::DrawingsItem which is not owned by the class.
 
+  Preview under the mouse is computed in a worker thread : mouse moves only update the requested rect and
+  the worker processes the last requested rect when it is ready, intermediate requests are dropped.
+  While the mouse is pressed, every requested rect is processed and painted in order, and the edit of
+  the drawings item is ended when the last result is painted.
+  Source data is read by tiles kept in a cache, thus the image is not read again while the mouse moves.
+  The result is drawn into the drawings item at the position it has been computed for.
+  Tool parameters edited in the GUI thread are copied with the request (see getParameters()), processData()
+  uses the copy. Workers are stopped when the cursor is destroyed, when the tool is cleared (deactivated)
+  and when the tool is deleted : subclasses stop them in their destructor, because workers call processData().
+
+  Overlay mode ('Show overlay' action) applies processData() to the whole viewport at the zoom level of the view.
+  Data tiles of each zoom level are kept in the same cache, thus when filter parameters are changed
+  (see updateOverlay()) the overlay is recomputed without reading the image again.
+
 
 */
 
@@ -48,10 +66,23 @@ FilterTool::FilterTool(QGraphicsScene *scene, QGraphicsView *view, QObject *pare
     _size(100),
     _isValid(false),
     _opacity(0.5),
-    _color(Qt::green)
+    _color(Qt::green),
+    _previewRunning(false),
+    _paintSession(0),
+    _nbOfPaintsToDraw(0),
+    _endEditPending(false),
+    _overlay(0),
+    _overlayZoomLevel(0),
+    _pendingOverlayLevel(0),
+    _overlayRunning(false)
 {
     _toolType = Type;
 
+    // one thread for the preview and one for the overlay : each task has its own copy of the parameters
+    // and processData() is const
+    _previewPool.setMaxThreadCount(2);
+    _previewTiles.setMaxCost(64*1024);
+
     _finalize = new QAction(tr("Finalize"), this);
     _finalize->setEnabled(false);
     connect(_finalize, SIGNAL(triggered()), this, SLOT(onFinalize()));
@@ -62,6 +93,12 @@ FilterTool::FilterTool(QGraphicsScene *scene, QGraphicsView *view, QObject *pare
     connect(_hideShowResult, SIGNAL(triggered()), this, SLOT(onHideShowResult()));
     _actions.append(_hideShowResult);
 
+    _showOverlay = new QAction(tr("Show overlay"), this);
+    _showOverlay->setCheckable(true);
+    _showOverlay->setEnabled(false);
+    connect(_showOverlay, SIGNAL(toggled(bool)), this, SLOT(onShowOverlay(bool)));
+    _actions.append(_showOverlay);
+
     QAction * separator = new QAction(this);
     separator->setSeparator(true);
     _actions.append(separator);
@@ -77,12 +114,54 @@ FilterTool::FilterTool(QGraphicsScene *scene, QGraphicsView *view, QObject *pare
 
 //******************************************************************************
 
+FilterTool::~FilterTool()
+{
+    stopPreview();
+}
+
+//******************************************************************************
+
+void FilterTool::setDataProvider(const Core::ImageDataProvider *provider)
+{
+    if (provider == _dataProvider)
+        return;
+
+    stopPreview();
+    _showOverlay->setChecked(false);
+    if (_dataProvider)
+        disconnect(_dataProvider, SIGNAL(destroyed()), this, SLOT(onDataProviderDestroyed()));
+    _dataProvider = provider;
+    if (_dataProvider)
+        connect(_dataProvider, SIGNAL(destroyed()), this, SLOT(onDataProviderDestroyed()));
+
+    _previewTiles.clear();
+    _previewRect = QRect();
+    _showOverlay->setEnabled(_dataProvider != 0);
+}
+
+//******************************************************************************
+
+void FilterTool::onDataProviderDestroyed()
+{
+    stopPreview();
+    _dataProvider = 0;
+    _previewTiles.clear();
+    _showOverlay->setChecked(false);
+    _showOverlay->setEnabled(false);
+}
+
+//******************************************************************************
+
 bool FilterTool::dispatch(QEvent *e, QGraphicsScene *scene)
 {
     if (!_isValid)
         return false;
 
-    if (e->type() == QEvent::GraphicsSceneMousePress)
+    if (undoRedoOnKeys(e))
+    {
+        return true;
+    }
+    else if (e->type() == QEvent::GraphicsSceneMousePress)
     {
 
         QGraphicsSceneMouseEvent * event = static_cast<QGraphicsSceneMouseEvent*>(e);
@@ -93,37 +172,23 @@ bool FilterTool::dispatch(QEvent *e, QGraphicsScene *scene)
             // check if _drawingsItem exists
             if (!_drawingsItem)
             {
-                // create drawings item for the current visible extent
-                QRect wr = _view->viewport()->rect();
-                QRectF r = _view->mapToScene(wr).boundingRect();
-                if (r.width() < 2000 && r.height() < 2000)
-                {
-                    _drawingsItem = new Core::DrawingsItem(r.width(), r.height(), QColor(Qt::transparent));
-                    _drawingsItem->setPos(r.x(), r.y());
-                    _drawingsItem->setZValue(_cursorShapeZValue-10);
-                    _drawingsItem->setOpacity(_opacity);
-                    // visible canvas
-                    QGraphicsRectItem * canvas = new QGraphicsRectItem(QRectF(0.0,0.0,r.width(), r.height()), _drawingsItem);
-                    canvas->setPen(QPen(Qt::white, 0));
-                    canvas->setBrush(QBrush(QColor(127,127,127,50)));
-                    canvas->setFlag(QGraphicsItem::ItemStacksBehindParent);
-                    scene->addItem(_drawingsItem);
-                    _finalize->setEnabled(true);
-                    _clear->setEnabled(true);
-                    _hideShowResult->setEnabled(true);
-                }
-                else
-                {
-                    SD_WARN("Visible zone is too large. Zoom to define smaller zone");
-                }
+                createDrawingsItem(scene);
             }
 
             if (_drawingsItem && _cursorShape)
             {
                 _pressed = true;
                 _anchor = event->scenePos();
+                // results of the previous stroke are not painted yet : the stroke continues the same edit
+                if (_endEditPending)
+                    _endEditPending = false;
+                else
+                    _drawingsItem->beginEdit();
 
-                drawAtPoint(event->scenePos());
+                if (_dataProvider && !_erase)
+                    requestPreview(getPreviewRect(event->scenePos()), true);
+                else
+                    drawAtPoint(event->scenePos());
                 return true;
             }
         }
@@ -139,38 +204,15 @@ bool FilterTool::dispatch(QEvent *e, QGraphicsScene *scene)
 
             if (_dataProvider && !_erase)
             {
-                size *= _cursorShape->scale();
-                pos -= QPointF(0.5*size, 0.5*size);
-
-                //                SD_TRACE(QString("rect : %1, %2, %3, %4")
-                //                         .arg(pos.x())
-                //                         .arg(pos.y())
-                //                         .arg(size)
-                //                         .arg(size));
-                QRect r(pos.x(), pos.y(), size, size);
-                cv::Mat data = _dataProvider->getImageData(r);
-                if (!data.empty())
-                {
-                    cv::Mat out = processData(data);
-                    //                    SD_TRACE(QString("out : %1, %2, %3, %4")
-                    //                             .arg(out.rows)
-                    //                             .arg(out.cols)
-                    //                             .arg(out.channels())
-                    //                             .arg(out.elemSize1()));
-
-                    QPixmap p = QPixmap::fromImage(QImage(out.data,
-                                                          out.cols,
-                                                          out.rows,
-                                                          QImage::Format_ARGB32).copy());
-                    p = p.scaled(QSize(_size,_size));
-                    _cursorShape->setPixmap(p);
-                }
+                // result is drawn when the preview is ready
+                requestPreview(getPreviewRect(pos), _pressed && _drawingsItem);
             }
 
         }
 
         if (_pressed && (event->buttons() & Qt::LeftButton)
-                && _drawingsItem && _cursorShape)
+                && _drawingsItem && _cursorShape
+                && (!_dataProvider || _erase))
         {
             drawAtPoint(event->scenePos());
         }
@@ -185,6 +227,11 @@ bool FilterTool::dispatch(QEvent *e, QGraphicsScene *scene)
         {
             _pressed=false;
             _anchor = QPointF();
+            // edit is ended when the requested results are painted (see onPreviewReady())
+            if (_nbOfPaintsToDraw > 0)
+                _endEditPending = true;
+            else if (_drawingsItem)
+                _drawingsItem->endEdit();
 
             return true;
         }
@@ -193,6 +240,29 @@ bool FilterTool::dispatch(QEvent *e, QGraphicsScene *scene)
     return false;
 }
 
+//******************************************************************************
+/*!
+  Method to create the drawings item for the whole image extent. Canvas is sparse, thus only
+  painted tiles are allocated
+*/
+void FilterTool::createDrawingsItem(QGraphicsScene *scene)
+{
+    QRect r = _dataProvider ? _dataProvider->getPixelExtent() : scene->sceneRect().toAlignedRect();
+    _drawingsItem = new Core::DrawingsItem(r.width(), r.height(), QColor(Qt::transparent));
+    _drawingsItem->setPos(r.x(), r.y());
+    _drawingsItem->setZValue(_cursorShapeZValue-10);
+    _drawingsItem->setOpacity(_opacity);
+    // visible canvas
+    QGraphicsRectItem * canvas = new QGraphicsRectItem(QRectF(0.0,0.0,r.width(), r.height()), _drawingsItem);
+    canvas->setPen(QPen(Qt::white, 0));
+    canvas->setBrush(QBrush(QColor(127,127,127,50)));
+    canvas->setFlag(QGraphicsItem::ItemStacksBehindParent);
+    scene->addItem(_drawingsItem);
+    _finalize->setEnabled(true);
+    _clear->setEnabled(true);
+    _hideShowResult->setEnabled(true);
+}
+
 //******************************************************************************
 
 bool FilterTool::dispatch(QEvent *e, QWidget *viewport)
@@ -295,6 +365,8 @@ void FilterTool::createCursor()
 
 void FilterTool::destroyCursor()
 {
+    // workers use the subclass, they are stopped before the tool is deactivated
+    stopPreview();
     _cursorShapeScale = _cursorShape->scale();
     QGraphicsScene * scene = _cursorShape->scene();
     if (scene)
@@ -335,6 +407,7 @@ void FilterTool::onFinalize()
 
 void FilterTool::clear()
 {
+    stopPreview();
     if (_cursorShape)
     {
         destroyCursor();
@@ -355,6 +428,382 @@ void FilterTool::setErase(bool erase)
     ImageCreationTool::setErase(erase);
 }
 
+//******************************************************************************
+/*!
+  Method to get a copy of the tool parameters passed to processData() : values of the properties
+  declared by subclasses. It is called in the GUI thread when a preview or an overlay is requested
+*/
+QVariantMap FilterTool::getParameters() const
+{
+    QVariantMap parameters;
+    const QMetaObject * mo = metaObject();
+    for (int i=FilterTool::staticMetaObject.propertyCount(); i<mo->propertyCount(); i++)
+    {
+        QMetaProperty p = mo->property(i);
+        parameters.insert(p.name(), p.read(this));
+    }
+    return parameters;
+}
+
+//******************************************************************************
+/*!
+  Method to compute the source rect of the preview centered on the scene position
+*/
+QRect FilterTool::getPreviewRect(const QPointF &pos) const
+{
+    double size = _size * _cursorShape->scale() / qMin(_view->matrix().m11(), _view->matrix().m22());
+    QPointF topLeft = pos - QPointF(0.5*size, 0.5*size);
+    return QRect(topLeft.x(), topLeft.y(), size, size);
+}
+
+//******************************************************************************
+
+class FilterToolPreviewTask : public QRunnable
+{
+public:
+    FilterToolPreviewTask(FilterTool * tool, bool overlay = false) :
+        _tool(tool),
+        _overlay(overlay)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        if (_overlay)
+            _tool->runOverlay();
+        else
+            _tool->runPreview();
+    }
+
+protected:
+    FilterTool * _tool;
+    bool _overlay;
+};
+
+//******************************************************************************
+/*!
+  Method to request the preview of the rect. Only the last request is processed if the worker is busy,
+  except for the requests to paint the result which are all processed
+*/
+void FilterTool::requestPreview(const QRect &rect, bool paint)
+{
+    QVariantMap parameters = getParameters();
+    QMutexLocker locker(&_previewMutex);
+    if (paint)
+    {
+        _pendingPaints << qMakePair(rect, parameters);
+        _nbOfPaintsToDraw++;
+    }
+    else
+    {
+        _pendingPreviewRect = rect;
+        _pendingPreviewParameters = parameters;
+    }
+    if (!_previewRunning)
+    {
+        _previewRunning = true;
+        _previewPool.start(new FilterToolPreviewTask(this));
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to process the requested rects in the worker thread until there are no more requests
+*/
+void FilterTool::runPreview()
+{
+    forever
+    {
+        QRect rect;
+        QVariantMap parameters;
+        bool paint = false;
+        int session;
+        {
+            QMutexLocker locker(&_previewMutex);
+            session = _paintSession;
+            if (!_pendingPaints.isEmpty())
+            {
+                QPair<QRect, QVariantMap> request = _pendingPaints.takeFirst();
+                rect = request.first;
+                parameters = request.second;
+                paint = true;
+            }
+            else
+            {
+                rect = _pendingPreviewRect;
+                parameters = _pendingPreviewParameters;
+                _pendingPreviewRect = QRect();
+                if (rect.isEmpty())
+                {
+                    _previewRunning = false;
+                    return;
+                }
+            }
+        }
+
+        // result of a paint request is always sent, the GUI thread counts them
+        QImage image;
+        cv::Mat data = getTilesData(rect);
+        cv::Mat out = data.empty() ? cv::Mat() : processData(data, parameters);
+        if (!out.empty())
+            image = QImage(out.data, out.cols, out.rows, QImage::Format_ARGB32).copy();
+        else if (!paint)
+            continue;
+
+        QMetaObject::invokeMethod(this, "onPreviewReady", Qt::QueuedConnection,
+                                  Q_ARG(QImage, image), Q_ARG(QRect, rect),
+                                  Q_ARG(bool, paint), Q_ARG(int, session));
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to get source data of the rect from the cached tiles. Method is called in the worker threads.
+  Level defines the resolution : rect and output matrix are in pixels of the image downsampled by 2^level,
+  level 0 is the full resolution. Output matrix is a new matrix, it can be modified by processData()
+*/
+cv::Mat FilterTool::getTilesData(const QRect &rect, int level)
+{
+    const int tileSize = 256;
+    const int scale = 1 << level;
+    QRect extent = _dataProvider ? _dataProvider->getPixelExtent() : QRect();
+    QRect levelExtent = QRect(extent.x() / scale, extent.y() / scale,
+                              qCeil(extent.width() * 1.0 / scale), qCeil(extent.height() * 1.0 / scale));
+    QRect r = rect.intersected(levelExtent);
+    if (r.isEmpty())
+        return cv::Mat();
+
+    cv::Mat out;
+    int tx0 = (r.left() - levelExtent.left()) / tileSize;
+    int tx1 = (r.right() - levelExtent.left()) / tileSize;
+    int ty0 = (r.top() - levelExtent.top()) / tileSize;
+    int ty1 = (r.bottom() - levelExtent.top()) / tileSize;
+    for (int ty=ty0; ty<=ty1; ty++)
+    {
+        for (int tx=tx0; tx<=tx1; tx++)
+        {
+            QRect tileRect = QRect(levelExtent.x() + tx*tileSize, levelExtent.y() + ty*tileSize, tileSize, tileSize).intersected(levelExtent);
+            quint64 key = ((quint64) level << 56) | ((quint64) ty << 28) | (quint64) tx;
+            cv::Mat tile;
+            {
+                QMutexLocker locker(&_previewMutex);
+                cv::Mat * cached = _previewTiles.object(key);
+                if (cached)
+                    tile = *cached;
+            }
+            if (tile.empty())
+            {
+                QRect srcRect = QRect(extent.x() + tx*tileSize*scale, extent.y() + ty*tileSize*scale,
+                                      tileSize*scale, tileSize*scale).intersected(extent);
+                tile = _dataProvider->getImageData(srcRect, tileRect.width(), tileRect.height());
+                if (tile.empty())
+                    return cv::Mat();
+                QMutexLocker locker(&_previewMutex);
+                _previewTiles.insert(key, new cv::Mat(tile), qMax(1, (int) (tile.total()*tile.elemSize() / 1024)));
+            }
+
+            if (out.empty())
+            {
+                // Data outside of the image is no-data as in ImageDataProvider::getImageData
+                out = cv::Mat(rect.height(), rect.width(), tile.type());
+                out.setTo(Core::ImageDataProvider::NoDataValue);
+            }
+            // provider can return a smaller matrix at the image boundary
+            QRect common = QRect(tileRect.topLeft(), QSize(tile.cols, tile.rows)).intersected(r);
+            if (common.isEmpty())
+                continue;
+            tile(cv::Rect(common.x() - tileRect.x(), common.y() - tileRect.y(), common.width(), common.height()))
+                    .copyTo(out(cv::Rect(common.x() - rect.x(), common.y() - rect.y(), common.width(), common.height())));
+        }
+    }
+    return out;
+}
+
+//******************************************************************************
+
+/*!
+  Method to stop the workers. Requested paints are dropped, the current edit of the drawings item
+  is ended by the next edit or by undo
+*/
+void FilterTool::stopPreview()
+{
+    {
+        QMutexLocker locker(&_previewMutex);
+        _pendingPreviewRect = QRect();
+        _pendingOverlayRect = QRect();
+        _pendingPaints.clear();
+        _paintSession++;
+    }
+    _previewPool.waitForDone();
+    _nbOfPaintsToDraw = 0;
+    _endEditPending = false;
+}
+
+//******************************************************************************
+
+void FilterTool::onPreviewReady(const QImage &image, const QRect &rect, bool paint, int paintSession)
+{
+    if (paint)
+    {
+        // results requested before the workers have been stopped are not painted
+        if (paintSession != _paintSession)
+            return;
+        _nbOfPaintsToDraw--;
+        if (_drawingsItem && !image.isNull())
+            drawImage(image, rect);
+        if (_nbOfPaintsToDraw == 0 && _endEditPending)
+        {
+            _endEditPending = false;
+            if (_drawingsItem)
+                _drawingsItem->endEdit();
+        }
+    }
+
+    if (!_cursorShape || image.isNull())
+        return;
+
+    _cursorShape->setPixmap(QPixmap::fromImage(image).scaled(QSize(_size, _size)));
+    _previewRect = rect;
+}
+
+//******************************************************************************
+
+void FilterTool::onViewportChanged(int zoomLevel, const QRectF &visibleSceneRect)
+{
+    _overlayZoomLevel = zoomLevel;
+    _overlaySceneRect = visibleSceneRect;
+    updateOverlay();
+}
+
+//******************************************************************************
+
+void FilterTool::onShowOverlay(bool show)
+{
+    if (!show)
+    {
+        destroyOverlay();
+        return;
+    }
+
+    if (_overlaySceneRect.isEmpty() && _view)
+    {
+        // viewport has not been changed since the tool is created
+        _overlaySceneRect = _view->mapToScene(_view->viewport()->rect()).boundingRect();
+        double scale = qMin(_view->matrix().m11(), _view->matrix().m22());
+        _overlayZoomLevel = qRound(qLn(scale)/qLn(2.0));
+    }
+    updateOverlay();
+}
+
+//******************************************************************************
+/*!
+  Method to request the overlay of the visible scene rect. It should be called by subclasses when
+  parameters of processData() are changed. Only the last request is processed if the worker is busy
+*/
+void FilterTool::updateOverlay()
+{
+    if (!_showOverlay->isChecked() || !_dataProvider || _overlaySceneRect.isEmpty())
+        return;
+
+    // Data is not read at a higher resolution than the screen one
+    int level = qMax(0, -_overlayZoomLevel);
+    int scale = 1 << level;
+    QRect extent = _dataProvider->getPixelExtent();
+    QRect levelExtent = QRect(extent.x() / scale, extent.y() / scale,
+                              qCeil(extent.width() * 1.0 / scale), qCeil(extent.height() * 1.0 / scale));
+    QRect rect = QRectF(_overlaySceneRect.x() / scale, _overlaySceneRect.y() / scale,
+                        _overlaySceneRect.width() / scale, _overlaySceneRect.height() / scale)
+            .toAlignedRect().intersected(levelExtent);
+    if (rect.isEmpty())
+        return;
+
+    QVariantMap parameters = getParameters();
+    QMutexLocker locker(&_previewMutex);
+    _pendingOverlayRect = rect;
+    _pendingOverlayLevel = level;
+    _pendingOverlayParameters = parameters;
+    if (!_overlayRunning)
+    {
+        _overlayRunning = true;
+        _previewPool.start(new FilterToolPreviewTask(this, true));
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to process the requested overlay rects in the worker thread until there are no more requests
+*/
+void FilterTool::runOverlay()
+{
+    forever
+    {
+        QRect rect;
+        int level;
+        QVariantMap parameters;
+        {
+            QMutexLocker locker(&_previewMutex);
+            rect = _pendingOverlayRect;
+            level = _pendingOverlayLevel;
+            parameters = _pendingOverlayParameters;
+            _pendingOverlayRect = QRect();
+            if (rect.isEmpty())
+            {
+                _overlayRunning = false;
+                return;
+            }
+        }
+
+        cv::Mat data = getTilesData(rect, level);
+        if (data.empty())
+            continue;
+        cv::Mat out = processData(data, parameters);
+        if (out.empty())
+            continue;
+
+        QImage image = QImage(out.data, out.cols, out.rows, QImage::Format_ARGB32).copy();
+        int scale = 1 << level;
+        QRectF sceneRect = QRectF(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
+        QMetaObject::invokeMethod(this, "onOverlayReady", Qt::QueuedConnection,
+                                  Q_ARG(QImage, image), Q_ARG(QRectF, sceneRect));
+    }
+}
+
+//******************************************************************************
+
+void FilterTool::onOverlayReady(const QImage &image, const QRectF &rect)
+{
+    // overlay could be hidden when the result is computed
+    if (!_showOverlay->isChecked() || !_scene || image.isNull())
+        return;
+
+    if (!_overlay)
+    {
+        _overlay = new QGraphicsPixmapItem();
+        _overlay->setZValue(_cursorShapeZValue-20);
+        _scene->addItem(_overlay);
+    }
+    _overlay->setOpacity(_opacity);
+    _overlay->setPixmap(QPixmap::fromImage(image));
+    _overlay->setPos(rect.topLeft());
+    _overlay->setScale(rect.width() / image.width());
+}
+
+//******************************************************************************
+
+void FilterTool::destroyOverlay()
+{
+    if (!_overlay)
+        return;
+    // overlay is already destroyed if the scene has been cleared
+    if (_scene && _scene->items().contains(_overlay))
+    {
+        _scene->removeItem(_overlay);
+        delete _overlay;
+    }
+    _overlay = 0;
+}
+
 //******************************************************************************
 
 void FilterTool::drawAtPoint(const QPointF &pos)
@@ -369,16 +818,27 @@ void FilterTool::drawAtPoint(const QPointF &pos)
     {
         r2.translate(-_drawingsItem->scenePos());
 
-        QPainter p(&_drawingsItem->getImage());
+        Core::DrawingsPainter p(_drawingsItem, r2.toAlignedRect());
         p.setCompositionMode((QPainter::CompositionMode)_mode);
         QPixmap px = _cursorShape->pixmap();
         p.drawPixmap(r2, px, QRectF(0.0,0.0,px.width(),px.height()));
-
-        r2=r2.adjusted(-size*0.25, -size*0.25, size*0.25, size*0.25);
-        _drawingsItem->update(r2);
     }
 }
 
+//******************************************************************************
+/*!
+  Method to draw the processed image at the scene rect it has been computed for
+*/
+void FilterTool::drawImage(const QImage &image, const QRect &rect)
+{
+    QRectF r = QRectF(rect).translated(-_drawingsItem->scenePos());
+    if (!_drawingsItem->boundingRect().intersects(r))
+        return;
+    Core::DrawingsPainter p(_drawingsItem, r.toAlignedRect());
+    p.setCompositionMode((QPainter::CompositionMode)_mode);
+    p.drawImage(r, image);
+}
+
 //******************************************************************************
 
 }
@@ -3,6 +3,16 @@
 
 // Qt
 #include <QObject>
+#include <QRect>
+#include <QRectF>
+#include <QImage>
+#include <QMutex>
+#include <QCache>
+#include <QThreadPool>
+#include <QVariantMap>
+
+// Opencv
+#include <opencv2/core/core.hpp>
 
 // Project
 #include "Core/LibExport.h"
@@ -19,10 +29,16 @@ namespace Tools
 
 //******************************************************************************
 
+class FilterToolPreviewTask;
+
+//******************************************************************************
+
 class GIV_DLL_EXPORT FilterTool : public ImageCreationTool
 {
     Q_OBJECT
-    PTR_PROPERTY_ACCESSORS(const Core::ImageDataProvider, dataProvider, getDataProvider, setDataProvider)
+    friend class FilterToolPreviewTask;
+
+    PTR_PROPERTY_GETACCESSOR(const Core::ImageDataProvider, dataProvider, getDataProvider)
 
     PROPERTY_ACCESSORS(double, size, getSize, setSize)
 
@@ -38,6 +54,9 @@ class GIV_DLL_EXPORT FilterTool : public ImageCreationTool
 public:
 
     FilterTool(QGraphicsScene* scene, QGraphicsView * view, QObject * parent = 0);
+    virtual ~FilterTool();
+
+    void setDataProvider(const Core::ImageDataProvider * provider);
 
     void setGraphicsSceneAndView(QGraphicsScene* scene, QGraphicsView * view)
     {
@@ -55,6 +74,9 @@ public:
 
     virtual void setErase(bool erase);
 
+public slots:
+    void onViewportChanged(int zoomLevel, const QRectF & visibleSceneRect);
+
 signals:
     void drawingsFinalized(const QString&, Core::DrawingsItem * item);
     void itemCreated(QGraphicsItem * item);
@@ -63,13 +85,33 @@ protected slots:
     virtual void onFinalize();
     virtual void clear();
     void onHideShowResult();
+    void onPreviewReady(const QImage & image, const QRect & rect, bool paint, int paintSession);
+    virtual void onDataProviderDestroyed();
+    void onShowOverlay(bool show);
+    void onOverlayReady(const QImage & image, const QRectF & rect);
 
 protected:
     virtual void createCursor();
     virtual void destroyCursor();
+    void createDrawingsItem(QGraphicsScene * scene);
 
     void drawAtPoint(const QPointF & pt);
-    virtual cv::Mat processData(const cv::Mat & data) = 0; //!< Abstract method to process data. Returns RGBA (4-channels, 8U) matrix
+    void drawImage(const QImage & image, const QRect & rect);
+    //! Abstract method to process data with the parameters copied when the task is queued (see getParameters()).
+    //! Returns RGBA (4-channels, 8U) matrix. Method is called from the worker threads : preview and overlay
+    //! can run in parallel, thus it uses only the parameters and local data
+    virtual cv::Mat processData(const cv::Mat & data, const QVariantMap & parameters) const = 0;
+    virtual QVariantMap getParameters() const;
+
+    QRect getPreviewRect(const QPointF & pos) const;
+    void requestPreview(const QRect & rect, bool paint = false);
+    void runPreview();
+    cv::Mat getTilesData(const QRect & rect, int level = 0);
+    void stopPreview();
+
+    void updateOverlay();
+    void runOverlay();
+    void destroyOverlay();
 
 
     QGraphicsPixmapItem * _cursorShape;
@@ -81,9 +123,37 @@ protected:
     QAction * _finalize;
     QAction * _clear;
     QAction * _hideShowResult;
+    QAction * _showOverlay;
 
     bool _isValid;
 
+    // Preview is computed in a worker thread, only the last requested rect is processed
+    QThreadPool _previewPool;
+    QMutex _previewMutex;
+    QRect _pendingPreviewRect;
+    QVariantMap _pendingPreviewParameters;
+    bool _previewRunning;
+    // Rects requested while the mouse is pressed are all processed and painted in order.
+    // Results of the previous session are dropped when workers are stopped
+    QList< QPair<QRect, QVariantMap> > _pendingPaints;
+    int _paintSession;
+    //! Number of requested paints not received yet (GUI thread), the edit is ended when all are painted
+    int _nbOfPaintsToDraw;
+    bool _endEditPending;
+    //! Source rect of the cursor pixmap
+    QRect _previewRect;
+    //! Provider data tiles of all levels, cost is in kilobytes
+    QCache<quint64, cv::Mat> _previewTiles;
+
+    // Overlay of the processed data over the viewport, computed at the zoom level of the view
+    QGraphicsPixmapItem * _overlay;
+    int _overlayZoomLevel;
+    QRectF _overlaySceneRect;
+    QRect _pendingOverlayRect;
+    int _pendingOverlayLevel;
+    QVariantMap _pendingOverlayParameters;
+    bool _overlayRunning;
+
 
 };
 
@@ -12,6 +12,7 @@
 // Project
 #include "ThresholdFilterTool.h"
 #include "Core/LayerUtils.h"
+#include "Core/TiledVectorizer.h"
 
 namespace Tools
 {
@@ -33,7 +34,37 @@ ThresholdFilterTool::ThresholdFilterTool(QGraphicsScene *scene, QGraphicsView *v
 
 //******************************************************************************
 
-cv::Mat ThresholdFilterTool::processData(const cv::Mat &data)
+ThresholdFilterTool::~ThresholdFilterTool()
+{
+    // workers call processData() which is not available in the base destructor
+    stopPreview();
+}
+
+//******************************************************************************
+/*!
+  Threshold overlay (see FilterTool) follows the threshold value, tiles are not read again
+*/
+void ThresholdFilterTool::setThreshold(int threshold)
+{
+    if (_threshold == threshold)
+        return;
+    _threshold = threshold;
+    updateOverlay();
+}
+
+//******************************************************************************
+
+void ThresholdFilterTool::setInverse(bool inverse)
+{
+    if (_inverse == inverse)
+        return;
+    _inverse = inverse;
+    updateOverlay();
+}
+
+//******************************************************************************
+
+cv::Mat ThresholdFilterTool::processData(const cv::Mat &data, const QVariantMap &parameters) const
 {
     ///
     /// Process only the first band
@@ -52,8 +83,8 @@ cv::Mat ThresholdFilterTool::processData(const cv::Mat &data)
     }
 
     cv::Mat processedData;
-    int type = _inverse ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY;
-    cv::threshold(in, processedData, _threshold, 255, type);
+    int type = parameters.value("inverse").toBool() ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY;
+    cv::threshold(in, processedData, parameters.value("threshold").toInt(), 255, type);
     cv::morphologyEx(processedData, processedData, cv::MORPH_CLOSE, cv::Mat(3,3,CV_8U,cv::Scalar(1)));
 
     cv::Mat out, processedData8U;
@@ -77,14 +108,14 @@ cv::Mat ThresholdFilterTool::processData(const cv::Mat &data)
 void ThresholdFilterTool::onFinalize()
 {
     //  Do something with data
-    QImage im = _drawingsItem->getImage();
+    // Only the painted part of the canvas is vectorized, tiles outside of it are not allocated
+    QRect paintedRect = _drawingsItem->getPaintedRect();
+    QImage im = _drawingsItem->getImage(paintedRect);
     cv::Mat image(im.height(), im.width(), CV_8UC4, im.bits());
 
-    cv::dilate(image, image, cv::Mat());
-
-    std::vector<cv::Mat> iChannels(image.channels());
-    cv::split(image, &iChannels[0]);
-    QVector<QPolygonF> contours = Core::vectorizeAsPolygons(iChannels[0], true);
+    // Polygons follow the pixel boundaries of the first channel, tile by tile
+    Core::TiledVectorizer vectorizer;
+    QVector<QPolygonF> contours = vectorizer.vectorize(image, 0);
 
     if (contours.isEmpty())
     {
@@ -111,7 +142,7 @@ void ThresholdFilterTool::onFinalize()
         }
 
         _scene->addItem(group);
-        group->setPos(_drawingsItem->scenePos());
+        group->setPos(_drawingsItem->scenePos() + paintedRect.topLeft());
         emit itemCreated(group);
 
     }
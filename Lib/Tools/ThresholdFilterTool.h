@@ -22,19 +22,25 @@ namespace Tools
 class GIV_DLL_EXPORT ThresholdFilterTool : public FilterTool
 {
     Q_OBJECT
-    Q_PROPERTY_WITH_ACCESSORS(int, threshold, getThreshold, setThreshold)
+    Q_PROPERTY(int threshold READ getThreshold WRITE setThreshold)
+    PROPERTY_GETACCESSOR(int, threshold, getThreshold)
     Q_CLASSINFO("threshold","minValue:0;maxValue:10000")
 
-    Q_PROPERTY_WITH_ACCESSORS(bool, inverse, inverse, setInverse)
+    Q_PROPERTY(bool inverse READ inverse WRITE setInverse)
+    PROPERTY_GETACCESSOR(bool, inverse, inverse)
 
 public:
     explicit ThresholdFilterTool(QGraphicsScene* scene, QGraphicsView * view, QObject *parent = 0);
+    virtual ~ThresholdFilterTool();
+
+    void setThreshold(int threshold);
+    void setInverse(bool inverse);
 
 protected slots:
     virtual void onFinalize();
 
 protected:
-    virtual cv::Mat processData(const cv::Mat & data);
+    virtual cv::Mat processData(const cv::Mat & data, const QVariantMap & parameters) const;
 
 };
 
@@ -36,7 +36,7 @@ DarkPixelFilterPlugin::DarkPixelFilterPlugin(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
+cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data, const Filters::FilterMonitor & monitor) const
 {
     cv::Mat out;
     if (data.channels() > 1)
@@ -68,7 +68,7 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
     cv::divide(1.0,out,out,CV_32F);
 
     if (_verbose) { verboseDisplayImage("Image -> 1/Image", out); }
-    emit progressValue(15);
+    if (!monitor.setProgress(15)) return cv::Mat();
 
 
     // 2) Convert to 8U
@@ -77,7 +77,7 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
     cv::Mat out8U;
     out.convertTo(out8U, CV_8U, 255.0/(maxVal-minVal), -255.0*minVal/(maxVal-minVal));
     out = out8U;
-    emit progressValue(30);
+    if (!monitor.setProgress(30)) return cv::Mat();
 
     // 3) Adaptive thresholding
     int winsize = 131;
@@ -87,7 +87,7 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
     cv::adaptiveThreshold(out, out, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, winsize, c);
 
     if (_verbose) { verboseDisplayImage("Adaptive thresholding", out); }
-    emit progressValue(40);
+    if (!monitor.setProgress(40)) return cv::Mat();
 
     // 4) Morpho close + open
     cv::Mat k1=cv::Mat::ones(5,5,CV_8U);
@@ -95,12 +95,12 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
     cv::morphologyEx(out, out, cv::MORPH_CLOSE, k1);
 
     if (_verbose) { verboseDisplayImage("Morpho close", out); }
-    emit progressValue(50);
+    if (!monitor.setProgress(50)) return cv::Mat();
 
     cv::morphologyEx(out, out, cv::MORPH_OPEN, k2);
 
     if (_verbose) { verboseDisplayImage("Morpho open", out); }
-    emit progressValue(55);
+    if (!monitor.setProgress(55)) return cv::Mat();
 
     // 5) Find contours
     std::vector<std::vector<cv::Point> > contours;
@@ -108,7 +108,7 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
 
     cv::Mat res(out.size(), CV_32F);
     res.setTo(_noDataValue);
-    emit progressValue(80);
+    if (!monitor.setProgress(80)) return cv::Mat();
 
     if (contours.size() > 0)
     {
@@ -134,7 +134,7 @@ cv::Mat DarkPixelFilterPlugin::filter(const cv::Mat &data) const
     }
     else
     {
-        _errorMessage = tr("No dark pixel zones found of size larger than %1").arg(_minSize);
+        monitor.setError(tr("No dark pixel zones found of size larger than %1").arg(_minSize));
         return cv::Mat();
     }
 
@@ -23,10 +23,10 @@ class GIV_PLUGIN_EXPORT DarkPixelFilterPlugin : public Filters::AbstractFilter
 
 
 public:
-    DarkPixelFilterPlugin(QObject* parent = 0);
+    Q_INVOKABLE DarkPixelFilterPlugin(QObject* parent = 0);
 
 protected:
-    virtual cv::Mat filter(const cv::Mat &src) const;
+    virtual cv::Mat filter(const cv::Mat &src, const Filters::FilterMonitor & monitor) const;
 
 };
 
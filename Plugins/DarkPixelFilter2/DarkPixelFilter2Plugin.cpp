@@ -6,6 +6,8 @@
 
 // Project
 #include "DarkPixelFilter2Plugin.h"
+#include "Core/IntegralImage.h"
+#include "Filters/Morphology.h"
 
 
 namespace Plugins
@@ -18,8 +20,7 @@ cv::Mat blurThreshClose(const cv::Mat & data, int blurSize=3, int threshold=200,
 
     cv::threshold(out, out, threshold, 255, cv::THRESH_BINARY);
 
-    cv::Mat k1=cv::Mat::ones(closeSize, closeSize,CV_8U);
-    cv::morphologyEx(out, out, cv::MORPH_CLOSE, k1, cv::Point(-1,-1), n);
+    out = Filters::morphology(out, cv::MORPH_CLOSE, Filters::RectangleShape, cv::Size(closeSize, closeSize), n);
 
     return out;
 }
@@ -61,7 +62,7 @@ DarkPixelFilter2Plugin::DarkPixelFilter2Plugin(QObject *parent) :
 
 //******************************************************************************
 
-cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
+cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data, const Filters::FilterMonitor & monitor) const
 {
     cv::Mat out;
     if (data.channels() > 1)
@@ -101,7 +102,7 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
     cv::divide(1.0,out,out,CV_32F);
 
     if (_verbose) { verboseDisplayImage("Image -> 1/Image", out); }
-    emit progressValue(15);
+    if (!monitor.setProgress(15)) return cv::Mat();
 
 
     // -) Gaussian blur
@@ -126,7 +127,7 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
         cv::resize(datamask, datamask, cv::Size(0, 0), rf, rf, cv::INTER_NEAREST);
     }
 
-    emit progressValue(25);
+    if (!monitor.setProgress(25)) return cv::Mat();
 
     // -) Convert to 8U
     {
@@ -141,7 +142,7 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
         cv::Mat out8U;
         out.convertTo(out8U, CV_8U, 255.0/(maxVal-minVal), -255.0*minVal/(maxVal-minVal));
         out = out8U;
-        emit progressValue(30);
+        if (!monitor.setProgress(30)) return cv::Mat();
     }
 
     // -) Median blur
@@ -163,28 +164,39 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
     // Y = (Ymin - Ymax) * (X - Xmin)/(Xmax - Xmin) + Ymax
     // transform sensivity [0.0 -> 1.0] into coeff [1.0 -> 0.3]
     double v = 1.0 - (0.7)*_sensivity;
-    cv::Scalar mean = cv::mean(out, datamask);
-    double c = -v*mean[0];
-    cv::adaptiveThreshold(out, out, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, _atWinSize, c);
+    if (datamask.empty())
+    {
+        cv::Scalar mean = cv::mean(out);
+        double c = -v*mean[0];
+        cv::adaptiveThreshold(out, out, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, _atWinSize, c);
+    }
+    else
+    {
+        // Local means are computed from valid pixels only (window is clipped at the image border)
+        Core::IntegralImage integral(out, datamask == 0);
+        double mean = 0.0, std = 0.0;
+        integral.meanStdDev(cv::Rect(0, 0, out.cols, out.rows), mean, std);
+        double c = -v*mean;
+        out = integral.adaptiveThreshold(out, 255, _atWinSize, c);
+    }
 
     if (_verbose) { verboseDisplayImage("Adaptive thresholding", out); }
-    emit progressValue(40);
+    if (!monitor.setProgress(40)) return cv::Mat();
 
     // -) Morpho close
     out = blurThreshClose(out, 3, 100, _mcWinSize, 2);
     if (_verbose) { verboseDisplayImage("Blur + Theshold + Morpho", out); }
-    emit progressValue(50);
+    if (!monitor.setProgress(50)) return cv::Mat();
 
     // -) Resize to initial
     cv::resize(out, out, cv::Size(initW, initH), 0, 0, cv::INTER_LINEAR);
-    emit progressValue(60);
+    if (!monitor.setProgress(60)) return cv::Mat();
 
     // -) Make contours smoother
     {
         int s = 7;
         cv::blur(out, out, cv::Size(s, s));
-        cv::Mat k1 = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(s, s));
-        cv::morphologyEx(out, out, cv::MORPH_ERODE, k1);
+        out = Filters::morphologyDisk(out, false, s);
     }
 
     // -) Find contours
@@ -193,7 +205,7 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
 
     cv::Mat res(out.size(), CV_32F);
     res.setTo(_noDataValue);
-    emit progressValue(80);
+    if (!monitor.setProgress(80)) return cv::Mat();
 
     if (contours.size() > 0)
     {
@@ -214,7 +226,7 @@ cv::Mat DarkPixelFilter2Plugin::filter(const cv::Mat &data) const
     }
     else
     {
-        _errorMessage = tr("No dark pixel zones found of size larger than %1").arg(_minSize);
+        monitor.setError(tr("No dark pixel zones found of size larger than %1").arg(_minSize));
         return cv::Mat();
     }
 
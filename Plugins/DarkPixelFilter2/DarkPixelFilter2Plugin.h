@@ -35,10 +35,10 @@ class GIV_PLUGIN_EXPORT DarkPixelFilter2Plugin : public Filters::AbstractFilter
 
 
 public:
-    DarkPixelFilter2Plugin(QObject* parent = 0);
+    Q_INVOKABLE DarkPixelFilter2Plugin(QObject* parent = 0);
 
 protected:
-    virtual cv::Mat filter(const cv::Mat &src) const;
+    virtual cv::Mat filter(const cv::Mat &src, const Filters::FilterMonitor & monitor) const;
 
 };
 
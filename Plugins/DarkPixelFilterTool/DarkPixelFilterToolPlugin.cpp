@@ -13,6 +13,7 @@
 #include "DarkPixelFilterToolPlugin.h"
 #include "Core/Global.h"
 #include "Core/LayerUtils.h"
+#include "Core/TiledVectorizer.h"
 
 
 namespace Plugins
@@ -42,7 +43,14 @@ DarkPixelFilterToolPlugin::DarkPixelFilterToolPlugin(QObject * parent) :
 
 //******************************************************************************
 
-cv::Mat DarkPixelFilterToolPlugin::processData(const cv::Mat &data)
+DarkPixelFilterToolPlugin::~DarkPixelFilterToolPlugin()
+{
+    stopPreview();
+}
+
+//******************************************************************************
+
+cv::Mat DarkPixelFilterToolPlugin::processData(const cv::Mat &data, const QVariantMap &parameters) const
 {
     cv::Mat out;
     if (data.channels() > 1)
@@ -97,7 +105,8 @@ cv::Mat DarkPixelFilterToolPlugin::processData(const cv::Mat &data)
     cv::findContours(outCopy, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
     if (contours.size() > 0)
     {
-        double minArea = _minSize*_minSize;
+        int minSize = parameters.value("minSize").toInt();
+        double minArea = minSize*minSize;
         for (int i=0;i<contours.size();i++)
         {
             std::vector<cv::Point> contour = contours[i];
@@ -133,14 +142,12 @@ void DarkPixelFilterToolPlugin::onFinalize()
 {
     //  Do something with data
 
-    QImage im = _drawingsItem->getImage();
+    QRect paintedRect = _drawingsItem->getPaintedRect();
+    QImage im = _drawingsItem->getImage(paintedRect);
     cv::Mat image(im.height(), im.width(), CV_8UC4, im.bits());
 
-    cv::dilate(image, image, cv::Mat());
-
-    std::vector<cv::Mat> iChannels(image.channels());
-    cv::split(image, &iChannels[0]);
-    QVector<QPolygonF> contours = Core::vectorizeAsPolygons(iChannels[0]);
+    Core::TiledVectorizer vectorizer;
+    QVector<QPolygonF> contours = vectorizer.vectorize(image, 0);
 
     if (contours.isEmpty())
     {
@@ -167,7 +174,7 @@ void DarkPixelFilterToolPlugin::onFinalize()
         }
 
         _scene->addItem(group);
-        group->setPos(_drawingsItem->scenePos());
+        group->setPos(_drawingsItem->scenePos() + paintedRect.topLeft());
         emit itemCreated(group);
     }
 
@@ -28,12 +28,13 @@ class GIV_PLUGIN_EXPORT DarkPixelFilterToolPlugin : public Tools::FilterTool
 
 public:
     DarkPixelFilterToolPlugin(QObject * parent = 0);
+    virtual ~DarkPixelFilterToolPlugin();
 
 protected slots:
     virtual void onFinalize();
 
 protected:
-    virtual cv::Mat processData(const cv::Mat & data);
+    virtual cv::Mat processData(const cv::Mat & data, const QVariantMap & parameters) const;
 };
 
 //******************************************************************************
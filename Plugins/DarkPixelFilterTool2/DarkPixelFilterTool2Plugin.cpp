@@ -13,6 +13,8 @@
 #include "DarkPixelFilterTool2Plugin.h"
 #include "Core/Global.h"
 #include "Core/LayerUtils.h"
+#include "Core/TiledVectorizer.h"
+#include "Filters/Morphology.h"
 
 
 namespace Plugins
@@ -40,7 +42,14 @@ DarkPixelFilterTool2Plugin::DarkPixelFilterTool2Plugin(QObject * parent) :
 
 //******************************************************************************
 
-cv::Mat DarkPixelFilterTool2Plugin::processData(const cv::Mat &data)
+DarkPixelFilterTool2Plugin::~DarkPixelFilterTool2Plugin()
+{
+    stopPreview();
+}
+
+//******************************************************************************
+
+cv::Mat DarkPixelFilterTool2Plugin::processData(const cv::Mat &data, const QVariantMap &parameters) const
 {
     cv::Mat out;
     if (data.channels() > 1)
@@ -70,22 +79,22 @@ cv::Mat DarkPixelFilterTool2Plugin::processData(const cv::Mat &data)
 
 
     // 1) Gaussian blur
-    if (_minSize > 1)
+    int minSize = parameters.value("minSize").toInt();
+    if (minSize > 1)
     {
-        _minSize = (_minSize % 2 == 0) ? _minSize+1: _minSize;
-        cv::GaussianBlur(out, out, cv::Size(_minSize, _minSize), 0);
+        minSize = (minSize % 2 == 0) ? minSize+1: minSize;
+        cv::GaussianBlur(out, out, cv::Size(minSize, minSize), 0);
     }
 
     // 2) Threshold inverse
     // Compute threshold value as mean*0.5
     cv::Scalar mn = cv::mean(out);
-    double thresholdValue = 0.75*mn[0] + _param;
+    double thresholdValue = 0.75*mn[0] + parameters.value("param").toDouble();
 //    SD_TRACE1("Threshold value = %1", thresholdValue);
     cv::threshold(out, out, thresholdValue, 255, CV_THRESH_BINARY_INV);
 
     // 4) Morpho close
-    cv::Mat k1 = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(_minSize/2, _minSize/2));
-    cv::morphologyEx(out, out, cv::MORPH_CLOSE, k1);
+    out = Filters::morphology(out, cv::MORPH_CLOSE, Filters::DiskShape, cv::Size(minSize/2, minSize/2));
 
     // Render to RGBA :
     cv::Mat t1,t2;
@@ -103,13 +112,15 @@ void DarkPixelFilterTool2Plugin::onFinalize()
 {
     //  Do something with data
 
-    QImage im = _drawingsItem->getImage();
+    QRect paintedRect = _drawingsItem->getPaintedRect();
+    QImage im = _drawingsItem->getImage(paintedRect);
     cv::Mat image(im.height(), im.width(), CV_8UC4, im.bits());
 
-    cv::dilate(image, image, cv::Mat());
     cv::Mat gray;
-    cv::cvtColor(image, gray, CV_BGRA2GRAY);
-    QVector<QPolygonF> contours = Core::vectorizeAsPolygons(gray);
+    if (!image.empty())
+        cv::cvtColor(image, gray, CV_BGRA2GRAY);
+    Core::TiledVectorizer vectorizer;
+    QVector<QPolygonF> contours = vectorizer.vectorize(gray);
 
     if (contours.isEmpty())
     {
@@ -136,7 +147,7 @@ void DarkPixelFilterTool2Plugin::onFinalize()
         }
 
         _scene->addItem(group);
-        group->setPos(_drawingsItem->scenePos());
+        group->setPos(_drawingsItem->scenePos() + paintedRect.topLeft());
         emit itemCreated(group);
     }
 
@@ -31,12 +31,13 @@ class GIV_PLUGIN_EXPORT DarkPixelFilterTool2Plugin : public Tools::FilterTool
 
 public:
     DarkPixelFilterTool2Plugin(QObject * parent = 0);
+    virtual ~DarkPixelFilterTool2Plugin();
 
 protected slots:
     virtual void onFinalize();
 
 protected:
-    virtual cv::Mat processData(const cv::Mat & data);
+    virtual cv::Mat processData(const cv::Mat & data, const QVariantMap & parameters) const;
 
 };
 
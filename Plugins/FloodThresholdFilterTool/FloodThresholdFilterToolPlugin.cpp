@@ -4,6 +4,11 @@
 #include <QGraphicsItemGroup>
 #include <QGraphicsPolygonItem>
 #include <QGraphicsScene>
+#include <QGraphicsSceneMouseEvent>
+#include <QApplication>
+#include <QAction>
+#include <QRunnable>
+#include <qmath.h>
 
 
 // Opencv
@@ -13,6 +18,11 @@
 #include "FloodThresholdFilterToolPlugin.h"
 #include "Core/Global.h"
 #include "Core/LayerUtils.h"
+#include "Core/TiledVectorizer.h"
+#include "Core/RegionGrowing.h"
+#include "Core/SparseMask.h"
+#include "Core/DrawingsItem.h"
+#include "Core/ImageDataProvider.h"
 
 
 namespace Plugins
@@ -22,24 +32,89 @@ namespace Plugins
 /*!
  * \class FloodThresholdFilterToolPlugin
  * \brief is a plugin of filtering tools that segments image data using flood fill
+ * Cursor shows the flood fill in the cursor window, a click paints it as other filter tools.
+ *
+ * In 'Grow region' mode a click segments the whole region connected to the clicked pixel with
+ * Core::RegionGrowing in a worker thread. The region is painted into the drawings item (undo and
+ * 'Finalize' work as for the painted results). Region size is limited in pixels and in loaded
+ * data tiles, larger regions are not painted. Growing is canceled by a new click, when the tool is
+ * cleared and when the data provider is destroyed. The worker reads a copy of the data provider
+ * (see ImageDataProvider::clone()) : it does not depend on the layer provider lifetime.
  *
  */
 //******************************************************************************
 
+// Limits of the region growing : 32 Mpixels and 512 tiles of 256x256 floats (128 Mb)
+static const qint64 MaxRegionPixels = 32*1024*1024;
+static const int MaxRegionTiles = 512;
+
+//******************************************************************************
+
+class RegionGrowingTask : public QRunnable
+{
+public:
+    RegionGrowingTask(QObject * tool, Core::RegionGrowing * region, const QPoint & seed,
+                      double loDiff, double upDiff, int id) :
+        _tool(tool),
+        _region(region),
+        _seed(seed),
+        _loDiff(loDiff),
+        _upDiff(upDiff),
+        _id(id)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run()
+    {
+        bool grown = _region->grow(_seed, _loDiff, _upDiff);
+        QMetaObject::invokeMethod(_tool, "onRegionReady", Qt::QueuedConnection,
+                                  Q_ARG(int, _id), Q_ARG(bool, grown));
+    }
+
+protected:
+    QObject * _tool;
+    Core::RegionGrowing * _region;
+    QPoint _seed;
+    double _loDiff;
+    double _upDiff;
+    int _id;
+};
+
+//******************************************************************************
+
 FloodThresholdFilterToolPlugin::FloodThresholdFilterToolPlugin(QObject * parent) :
     Tools::FilterTool(0, 0, parent),
     _loDiff(50),
-    _upDiff(50)
+    _upDiff(50),
+    _region(0),
+    _regionData(0),
+    _regionProvider(0),
+    _regionId(0)
 {
     setObjectName("floodtool");
     _name=tr("Flood Threshold");
     _description=tr("Filter to segment image using floodfill and thresholding");
     _icon = QIcon(":/icons/wand");
+
+    _regionPool.setMaxThreadCount(1);
+
+    _growRegion = new QAction(tr("Grow region"), this);
+    _growRegion->setCheckable(true);
+    _actions.insert(_actions.indexOf(_showOverlay) + 1, _growRegion);
+}
+
+//******************************************************************************
+
+FloodThresholdFilterToolPlugin::~FloodThresholdFilterToolPlugin()
+{
+    stopRegionGrowing();
+    stopPreview();
 }
 
 //******************************************************************************
 
-cv::Mat FloodThresholdFilterToolPlugin::processData(const cv::Mat &data)
+cv::Mat FloodThresholdFilterToolPlugin::processData(const cv::Mat &data, const QVariantMap &parameters) const
 {
     ///
     /// Process only the first band
@@ -64,7 +139,7 @@ cv::Mat FloodThresholdFilterToolPlugin::processData(const cv::Mat &data)
     cv::Mat processedData(in.rows+2,in.cols+2,CV_8U,cv::Scalar(0));
     cv::Point p(in.cols/2, in.rows/2);
     int flag = 8 | (255 << 8) | cv::FLOODFILL_FIXED_RANGE | cv::FLOODFILL_MASK_ONLY;
-    cv::floodFill(in, processedData, p, cv::Scalar(0), 0, cv::Scalar::all(_loDiff), cv::Scalar::all(_upDiff), flag);
+    cv::floodFill(in, processedData, p, cv::Scalar(0), 0, cv::Scalar::all(parameters.value("loDiff").toInt()), cv::Scalar::all(parameters.value("upDiff").toInt()), flag);
 
     // morpho close:
     cv::morphologyEx(processedData, processedData, cv::MORPH_CLOSE, cv::Mat(3,3,CV_8U,cv::Scalar(1)));
@@ -95,49 +170,200 @@ void FloodThresholdFilterToolPlugin::onFinalize()
 {
     //  Do something with data
 
-    QImage im = _drawingsItem->getImage();
+    QRect paintedRect = _drawingsItem->getPaintedRect();
+    QImage im = _drawingsItem->getImage(paintedRect);
     cv::Mat image(im.height(), im.width(), CV_8UC4, im.bits());
 
-    cv::dilate(image, image, cv::Mat());
+    Core::TiledVectorizer vectorizer;
+    QVector<QPolygonF> contours = vectorizer.vectorize(image, 0);
+    createContoursItem(contours, _drawingsItem->scenePos() + paintedRect.topLeft());
+
+    _scene->removeItem(_drawingsItem);
+    delete _drawingsItem;
 
-    std::vector<cv::Mat> iChannels(image.channels());
-    cv::split(image, &iChannels[0]);
-    QVector<QPolygonF> contours = Core::vectorizeAsPolygons(iChannels[0]);
+    //release _drawingsItem pointer
+    FilterTool::onFinalize();
+}
+
+//******************************************************************************
+
+void FloodThresholdFilterToolPlugin::clear()
+{
+    stopRegionGrowing();
+    FilterTool::clear();
+}
+
+//******************************************************************************
+
+bool FloodThresholdFilterToolPlugin::dispatch(QEvent *e, QGraphicsScene *scene)
+{
+    if (_isValid && _dataProvider && !_erase && _growRegion->isChecked() &&
+            e->type() == QEvent::GraphicsSceneMousePress)
+    {
+        QGraphicsSceneMouseEvent * event = static_cast<QGraphicsSceneMouseEvent*>(e);
+        if (event->button() == Qt::LeftButton && !_pressed &&
+                !(event->modifiers() & Qt::ControlModifier))
+        {
+            growRegion(event->scenePos());
+            return true;
+        }
+    }
+    return FilterTool::dispatch(e, scene);
+}
+
+//******************************************************************************
+/*!
+  Method to start the segmentation of the region connected to the clicked pixel on the whole image.
+  Fill is not limited to the cursor window : the first band is read by tiles at full resolution
+  where the region grows. Previous region growing is canceled
+*/
+void FloodThresholdFilterToolPlugin::growRegion(const QPointF &pos)
+{
+    stopRegionGrowing();
+
+    _regionData = _dataProvider->clone();
+    if (!_regionData)
+    {
+        SD_WARN(tr("Region growing is not available for the data of this layer"));
+        return;
+    }
+    _region = new Core::RegionGrowing(_regionData);
+    _region->setMaxNbOfPixels(MaxRegionPixels);
+    _region->setMaxNbOfTiles(MaxRegionTiles);
+    _regionProvider = _dataProvider;
+    _regionId++;
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    _regionPool.start(new RegionGrowingTask(this, _region, QPoint(qFloor(pos.x()), qFloor(pos.y())),
+                                            _loDiff, _upDiff, _regionId));
+}
 
+//******************************************************************************
+/*!
+  Method to cancel the region growing and wait for the worker
+*/
+void FloodThresholdFilterToolPlugin::stopRegionGrowing()
+{
+    if (!_region)
+        return;
+    _region->cancel();
+    _regionPool.waitForDone();
+    releaseRegion();
+}
+
+//******************************************************************************
+
+void FloodThresholdFilterToolPlugin::releaseRegion()
+{
+    delete _region;
+    _region = 0;
+    delete _regionData;
+    _regionData = 0;
+    _regionProvider = 0;
+    QApplication::restoreOverrideCursor();
+}
+
+//******************************************************************************
+
+void FloodThresholdFilterToolPlugin::onDataProviderDestroyed()
+{
+    // region of the destroyed provider is not painted
+    stopRegionGrowing();
+    FilterTool::onDataProviderDestroyed();
+}
+
+//******************************************************************************
+/*!
+  Slot called in the GUI thread when the worker has finished. Results of canceled tasks are dropped
+*/
+void FloodThresholdFilterToolPlugin::onRegionReady(int id, bool grown)
+{
+    if (!_region || id != _regionId)
+        return;
+    _regionPool.waitForDone();
+
+    bool limitReached = _region->isLimitReached();
+    if (!limitReached && grown && _regionProvider == _dataProvider && _scene)
+    {
+        SD_TRACE(QString("Region : %1 pixels, %2 loaded tiles")
+                 .arg(_region->getNbOfPixels())
+                 .arg(_region->getNbOfLoadedTiles()));
+        paintRegion(_region->getMask());
+    }
+    releaseRegion();
+
+    if (limitReached)
+    {
+        QString msg = tr("Region is too large : more than %1 pixels or %2 data tiles. Reduce the differences")
+                .arg(MaxRegionPixels)
+                .arg(MaxRegionTiles);
+        SD_WARN(msg);
+    }
+}
+
+//******************************************************************************
+/*!
+  Method to paint the region into the drawings item as a single edit. Mask is copied by tiles,
+  its coordinates are pixels of the provider extent
+*/
+void FloodThresholdFilterToolPlugin::paintRegion(const Core::SparseMask &mask)
+{
+    if (mask.isEmpty())
+        return;
+
+    if (!_drawingsItem)
+        createDrawingsItem(_scene);
+
+    QPoint offset = _drawingsItem->pos().toPoint();
+    QRect extent = mask.getExtent();
+    int tileSize = mask.getTileSize();
+    _drawingsItem->beginEdit();
+    foreach (QPoint t, mask.getTiles())
+    {
+        QRect r = QRect(extent.x() + t.x()*tileSize, extent.y() + t.y()*tileSize, tileSize, tileSize).intersected(extent);
+        cv::Mat m = mask.getData(r);
+        // white opaque region, transparent elsewhere
+        std::vector<cv::Mat> channels(4, m);
+        cv::Mat rgba;
+        cv::merge(channels, rgba);
+        r.translate(-offset);
+        Core::DrawingsPainter p(_drawingsItem, r, false);
+        p.drawImage(r.topLeft(), Core::fromMat(rgba));
+    }
+    _drawingsItem->endEdit();
+    _drawingsItem->update();
+}
+
+//******************************************************************************
+
+void FloodThresholdFilterToolPlugin::createContoursItem(const QVector<QPolygonF> &contours, const QPointF &pos)
+{
     if (contours.isEmpty())
     {
         SD_TRACE("Contours are not found");
+        return;
     }
-    else
+
+//    SD_TRACE(QString("Number of contours : %1").arg(contours.size()));
+    QGraphicsItemGroup * group = new QGraphicsItemGroup();
+    foreach (QPolygonF contour, contours)
     {
-//        SD_TRACE(QString("Number of contours : %1").arg(contours.size()));
-        QGraphicsItemGroup * group = new QGraphicsItemGroup();
-        foreach (QPolygonF contour, contours)
+        if (contour.last() == contour.first())
         {
-            if (contour.last() == contour.first())
-            {
-                contour.takeLast();
-            }
-//            SD_TRACE(QString("Number of points : %1").arg(contour.size()));
-            if (contour.size() > 2)
-            {
-                QGraphicsPolygonItem * p = new QGraphicsPolygonItem(contour);
-                p->setPen(QPen(QColor(255,0,0,127), 0));
-                p->setBrush(QColor(255,0,0,127));
-                group->addToGroup(p);
-            }
+            contour.takeLast();
+        }
+//        SD_TRACE(QString("Number of points : %1").arg(contour.size()));
+        if (contour.size() > 2)
+        {
+            QGraphicsPolygonItem * p = new QGraphicsPolygonItem(contour);
+            p->setPen(QPen(QColor(255,0,0,127), 0));
+            p->setBrush(QColor(255,0,0,127));
+            group->addToGroup(p);
         }
-
-        _scene->addItem(group);
-        group->setPos(_drawingsItem->scenePos());
-        emit itemCreated(group);
     }
 
-    _scene->removeItem(_drawingsItem);
-    delete _drawingsItem;
-
-    //release _drawingsItem pointer
-    FilterTool::onFinalize();
+    _scene->addItem(group);
+    group->setPos(pos);
+    emit itemCreated(group);
 }
 
 //******************************************************************************
@@ -3,6 +3,9 @@
 
 // Qt
 #include <QObject>
+#include <QVector>
+#include <QPolygonF>
+#include <QThreadPool>
 
 // Opencv
 #include <opencv2/core/core.hpp>
@@ -12,6 +15,15 @@
 #include "Tools/FilterTool.h"
 
 class QGraphicsItem;
+class QGraphicsScene;
+class QAction;
+
+namespace Core
+{
+class RegionGrowing;
+class SparseMask;
+class ImageDataProvider;
+}
 
 namespace Plugins
 {
@@ -39,12 +51,35 @@ class GIV_PLUGIN_EXPORT FloodThresholdFilterToolPlugin : public Tools::FilterToo
 public:
 
     FloodThresholdFilterToolPlugin(QObject * parent = 0);
+    virtual ~FloodThresholdFilterToolPlugin();
+
+    using Tools::FilterTool::dispatch;
+    virtual bool dispatch(QEvent * e, QGraphicsScene * scene);
 
 protected slots:
     virtual void onFinalize();
+    virtual void clear();
+    void onRegionReady(int id, bool grown);
+    virtual void onDataProviderDestroyed();
 
 protected:
-    virtual cv::Mat processData(const cv::Mat & data);
+    virtual cv::Mat processData(const cv::Mat & data, const QVariantMap & parameters) const;
+
+    void growRegion(const QPointF & pos);
+    void stopRegionGrowing();
+    void releaseRegion();
+    void paintRegion(const Core::SparseMask & mask);
+    void createContoursItem(const QVector<QPolygonF> & contours, const QPointF & pos);
+
+    QAction * _growRegion;
+    //! Region growing runs in a worker thread, only one region at a time
+    QThreadPool _regionPool;
+    Core::RegionGrowing * _region;
+    //! Copy of the data provider read by the worker, owned by the tool
+    Core::ImageDataProvider * _regionData;
+    //! Data provider of the region, only compared with the current provider
+    const Core::ImageDataProvider * _regionProvider;
+    int _regionId;
 
 };
 
@@ -30,7 +30,7 @@ namespace Plugins
  *
  *
  */
-cv::Mat HistogramThresholdFilterPlugin::filter(const cv::Mat & inputMat) const
+cv::Mat HistogramThresholdFilterPlugin::filter(const cv::Mat & inputMat, const Filters::FilterMonitor & monitor) const
 {
 
 
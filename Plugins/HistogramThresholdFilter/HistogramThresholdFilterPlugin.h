@@ -21,7 +21,7 @@ class GIV_PLUGIN_EXPORT HistogramThresholdFilterPlugin : public Filters::Abstrac
 
 public:
 
-    HistogramThresholdFilterPlugin(QObject * parent = 0) :
+    Q_INVOKABLE HistogramThresholdFilterPlugin(QObject * parent = 0) :
         Filters::AbstractFilter(parent)
     {
         _name=tr("Histogram Threshold");
@@ -30,7 +30,7 @@ public:
 
 protected:
 
-    virtual cv::Mat filter(const cv::Mat & ) const;
+    virtual cv::Mat filter(const cv::Mat & , const Filters::FilterMonitor & ) const;
 
 };
 
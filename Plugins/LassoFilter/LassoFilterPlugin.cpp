@@ -11,7 +11,7 @@ namespace Plugins
 
 //******************************************************************************
 
-cv::Mat LassoFilterPlugin::filter(const cv::Mat &) const
+cv::Mat LassoFilterPlugin::filter(const cv::Mat &, const Filters::FilterMonitor &) const
 {
 
 
@@ -20,7 +20,7 @@ class GIV_PLUGIN_EXPORT LassoFilterPlugin : public Filters::AbstractFilter
 
 public:
 
-    LassoFilterPlugin(QObject * parent = 0) :
+    Q_INVOKABLE LassoFilterPlugin(QObject * parent = 0) :
         Filters::AbstractFilter(parent)
     {
         _name=tr("Lasso Filter");
@@ -29,7 +29,7 @@ public:
 
 protected:
 
-    virtual cv::Mat filter(const cv::Mat & ) const;
+    virtual cv::Mat filter(const cv::Mat & , const Filters::FilterMonitor & ) const;
 
 };
 
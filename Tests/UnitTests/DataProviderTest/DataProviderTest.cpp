@@ -12,6 +12,7 @@
 #include "../../Common.h"
 #include "DataProviderTest.h"
 #include "Core/LayerUtils.h"
+#include "Core/IntegralImage.h"
 
 namespace Tests
 {
@@ -236,6 +237,15 @@ void DataProviderTest::test_GDALDataProvider()
     m2(cv::Rect(0,0,100,50)).copyTo(m3(cv::Rect(100,100,100,50)));
     QVERIFY(Core::isEqual(m3,m));
 
+    // copy has its own dataset :
+    Core::ImageDataProvider * copy = _provider->clone();
+    QVERIFY(copy);
+    QVERIFY(copy->getPixelExtent() == _provider->getPixelExtent());
+    QVERIFY(Core::isEqual(copy->getImageData(), _provider->getImageData()));
+    QVERIFY( compareVectors(copy->fetchGeoTransform(), _geoTransform) );
+    delete copy;
+    QVERIFY(_provider->isValid());
+
 }
 
 //*************************************************************************
@@ -311,7 +321,13 @@ void DataProviderTest::test_FloatingDataProvider()
     QVERIFY( compareVectors(_provider->fetchGeoTransform(), provider->fetchGeoTransform()) );
     QVERIFY( _provider->getPixelExtent() == provider->getPixelExtent() );
 
+    // copy shares the data and remains valid when the source is deleted :
+    Core::ImageDataProvider * copy = provider->clone();
+    QVERIFY(copy);
     delete provider;
+    QVERIFY(Core::isEqual(mSrc, copy->getImageData()));
+    QVERIFY( compareVectors(_provider->fetchGeoTransform(), copy->fetchGeoTransform()) );
+    delete copy;
 }
 
 //*************************************************************************
@@ -397,6 +413,143 @@ void DataProviderTest::test_FloatingDataProvider3()
 
 //*************************************************************************
 
+/*!
+ * \brief DataProviderTest::test_VirtualDataProvider
+ * Check virtual data provider computed from gdal and floating data providers
+ * a) compilation errors
+ * b) data and nodata mask
+ * c) reduced resolution request
+ */
+void DataProviderTest::test_VirtualDataProvider()
+{
+    QVERIFY(_provider);
+    if (!_provider->isValid())
+    {
+        QString path = _testFiles[1];
+        QVERIFY(_provider->setup(path));
+    }
+
+    Core::FloatingDataProvider * provider2 =
+            Core::FloatingDataProvider::createDataProvider("provider2", _testMatrices[0]);
+    QVERIFY(provider2);
+
+    QList<const Core::ImageDataProvider*> inputs;
+    inputs << _provider << provider2;
+
+    QVector<Core::BandMathProgram> programs;
+    QVERIFY(!Core::VirtualDataProvider::compile("b1 +", inputs, programs));
+    QVERIFY(!Core::VirtualDataProvider::compile("b9", inputs, programs));
+    QVERIFY(!Core::VirtualDataProvider::compile("i3b1", inputs, programs));
+    QVERIFY(!Core::VirtualDataProvider::compile("min(b1)", inputs, programs));
+    QVERIFY(!Core::VirtualDataProvider::compile("(b1 + b2", inputs, programs));
+    QVERIFY(Core::VirtualDataProvider::compile("-b1^2 + max(i2b1, 3.5e1); sqrt(abs(b2))", inputs, programs));
+    QVERIFY(programs.size() == 2);
+
+    Core::VirtualDataProvider * provider =
+            Core::VirtualDataProvider::createDataProvider("virtual", inputs, "(b4 - b3)/(b4 + b3); i1b1 - i2b2");
+    QVERIFY(provider);
+    QVERIFY(provider->getNbBands() == 2);
+    QVERIFY(provider->getPixelExtent() == _provider->getPixelExtent());
+
+    cv::Mat m1 = _provider->getImageData();
+    cv::Mat m2 = provider2->getImageData();
+    std::vector<cv::Mat> c1(m1.channels()), c2(m2.channels()), trueChannels(2);
+    cv::split(m1, &c1[0]);
+    cv::split(m2, &c2[0]);
+
+    cv::Mat num, den;
+    cv::subtract(c1[3], c1[2], num);
+    cv::add(c1[3], c1[2], den);
+    cv::divide(num, den, trueChannels[0]);
+    cv::subtract(c1[0], c2[1], trueChannels[1]);
+
+    cv::Mat mask = Core::ImageDataProvider::computeMask(m1);
+    trueChannels[0].setTo(Core::ImageDataProvider::NoDataValue, mask == 0);
+    trueChannels[1].setTo(Core::ImageDataProvider::NoDataValue, mask == 0);
+    cv::Mat trueData;
+    cv::merge(trueChannels, trueData);
+
+    cv::Mat data = provider->getImageData();
+    QVERIFY(Core::isEqual(data, trueData));
+
+    // Reduced resolution request has the same size as the inputs request
+    QRect r(100, 200, 1024, 512);
+    cv::Mat m = provider->getImageData(r, 256);
+    cv::Mat mIn = _provider->getImageData(r, 256);
+    QVERIFY(m.rows == mIn.rows && m.cols == mIn.cols);
+
+    delete provider;
+    delete provider2;
+}
+
+//*************************************************************************
+/*!
+ * \brief DataProviderTest::test_WindowStatistics
+ * Check statistics of valid pixels over rectangles computed from integral images of tiles
+ */
+void DataProviderTest::test_WindowStatistics()
+{
+    cv::Mat m(300, 260, CV_32F);
+    cv::randu(m, 0.0, 100.0);
+    m(cv::Rect(50, 60, 40, 30)).setTo(Core::ImageDataProvider::NoDataValue);
+    cv::Mat valid = m != Core::ImageDataProvider::NoDataValue;
+
+    // Integral image :
+    Core::IntegralImage integral(m, valid == 0);
+    QVERIFY(integral.getWidth() == m.cols && integral.getHeight() == m.rows);
+    cv::Rect r(30, 40, 150, 120);
+    cv::Scalar trueMean, trueStd;
+    cv::meanStdDev(m(r), trueMean, trueStd, valid(r));
+    double mean, std;
+    QVERIFY(integral.meanStdDev(r, mean, std));
+    QVERIFY(qAbs(mean - trueMean[0]) < 1e-6);
+    QVERIFY(qAbs(std - trueStd[0]) < 1e-6);
+    QVERIFY(integral.count(r) == cv::countNonZero(valid(r)));
+    QVERIFY(!integral.meanStdDev(cv::Rect(55, 65, 10, 10), mean, std));
+
+    cv::Mat localMean = integral.localMean(cv::Size(31, 31));
+    cv::Rect w(100 - 15, 120 - 15, 31, 31);
+    QVERIFY(qAbs(localMean.at<float>(120, 100) - cv::mean(m(w), valid(w))[0]) < 1e-3);
+    // window is clipped at the border
+    cv::Rect c(0, 0, 16, 16);
+    QVERIFY(qAbs(localMean.at<float>(0, 0) - cv::mean(m(c), valid(c))[0]) < 1e-3);
+
+    // Without no-data, threshold is the one of cv::adaptiveThreshold except at the border :
+    cv::Mat m8U, trueThreshold;
+    m(cv::Rect(100, 100, 160, 200)).convertTo(m8U, CV_8U, 2.0);
+    cv::adaptiveThreshold(m8U, trueThreshold, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, 15, -3.0);
+    cv::Mat threshold = Core::IntegralImage(m8U).adaptiveThreshold(m8U, 255, 15, -3.0);
+    cv::Rect inner(7, 7, m8U.cols - 14, m8U.rows - 14);
+    QVERIFY(cv::countNonZero(threshold(inner) != trueThreshold(inner)) < inner.area()/100);
+
+    // Service on provider tiles :
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("stats", m);
+    QVERIFY(provider);
+
+    Core::WindowStatistics stats(provider, 64);
+    QVector<double> means, stds, counts;
+    QRect qr(r.x, r.y, r.width, r.height);
+    QVERIFY(stats.meanStdDev(qr, 0, means, stds, &counts));
+    QVERIFY(means.size() == 1);
+    QVERIFY(qAbs(means[0] - trueMean[0]) < 1e-6);
+    QVERIFY(qAbs(stds[0] - trueStd[0]) < 1e-6);
+    QVERIFY(counts[0] == cv::countNonZero(valid(r)));
+
+    // Overview level : same statistics approximately
+    QVERIFY(stats.meanStdDev(qr, 1, means, stds));
+    QVERIFY(qAbs(means[0] - trueMean[0]) < 2.0);
+
+    // Cached tiles are reused : same statistics
+    QVector<double> means2, stds2;
+    QVERIFY(stats.meanStdDev(qr, 0, means2, stds2));
+    QVERIFY(qAbs(means2[0] - trueMean[0]) < 1e-6);
+    QVERIFY(qAbs(stds2[0] - trueStd[0]) < 1e-6);
+    delete provider;
+}
+
+//*************************************************************************
+
 void DataProviderTest::cleanupTestCase()
 {
     if (_provider) delete _provider;
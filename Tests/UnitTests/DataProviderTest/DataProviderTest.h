@@ -11,6 +11,7 @@
 // Project
 #include "Core/ImageDataProvider.h"
 #include "Core/FloatingDataProvider.h"
+#include "Core/VirtualDataProvider.h"
 
 namespace Tests
 {
@@ -28,6 +29,8 @@ private slots:
     void test_FloatingDataProvider();
     void test_FloatingDataProvider2();
     void test_FloatingDataProvider3();
+    void test_VirtualDataProvider();
+    void test_WindowStatistics();
     void cleanupTestCase();
 
 private:
@@ -1,16 +1,40 @@
 
 // Qt
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QThreadPool>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QSignalSpy>
+#include <QTextStream>
 
 // OpenCV
 #include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// GDAL
+#include <gdal_priv.h>
 
 // Tests
 #include "FiltersTest.h"
 #include "Core/LayerUtils.h"
+#include "Core/FloatingDataProvider.h"
 #include "Filters/BlurFilter.h"
+#include "Filters/ConvertTo8U.h"
+#include "Filters/PowerFilter.h"
+#include "Filters/FilterPipeline.h"
+#include "Filters/TiledFilterEngine.h"
+#include "Filters/FilterPreviewDataProvider.h"
+#include "Filters/ProcessFilter.h"
+#include "Filters/FastBlur.h"
+#include "Filters/Morphology.h"
+#include "Filters/EditableFilter.h"
+
+// STD
+#include <algorithm>
+#include <cfloat>
+#include <vector>
 
 namespace Tests
 {
@@ -24,6 +48,9 @@ cv::Mat TEST_MATRIX;
 
 void FiltersTest::initTestCase()
 {
+    // Register GDAL drivers
+    GDALAllRegister();
+
     // create synthetic image:
     TEST_MATRIX = cv::Mat(WIDTH, HEIGHT, DEPTH, cv::Scalar(0));
     for (int i=0; i<TEST_MATRIX.rows;i++)
@@ -55,6 +82,20 @@ void FiltersTest::initTestCase()
 
 //*************************************************************************
 
+class FailingFilter : public Filters::AbstractFilter
+{
+public:
+    virtual int getHaloSize() const
+    { return 0; }
+protected:
+    virtual cv::Mat filter(const cv::Mat & src, const Filters::FilterMonitor & monitor) const
+    {
+        Q_UNUSED(monitor);
+        CV_Error(CV_StsBadArg, "Failing filter");
+        return src;
+    }
+};
+
 void FiltersTest::test_exception()
 {
     // test opencv exception handling
@@ -66,6 +107,704 @@ void FiltersTest::test_exception()
     cv::Mat r = bf.apply(TEST_MATRIX);
 
     QVERIFY(r.empty());
+
+    // Filter without monitor keeps the error message
+    FailingFilter ff;
+    QVERIFY(ff.apply(TEST_MATRIX).empty());
+    QVERIFY(!ff.getErrorMessage().isEmpty());
+
+    // Error of a monitored run is reported to the monitor and tile errors are collected by the engine
+    FailingFilter ff2;
+    Filters::FilterMonitor monitor;
+    QVERIFY(ff2.apply(TEST_MATRIX, &monitor).empty());
+    QVERIFY(!monitor.getErrorMessage().isEmpty());
+
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("provider", TEST_MATRIX(cv::Rect(0, 0, 500, 500)));
+    QVERIFY(provider);
+    Filters::TiledFilterEngine engine;
+    engine.setTileSize(200);
+    QVERIFY(!engine.apply(&ff2, provider));
+    QVERIFY(!engine.getErrorMessage().isEmpty());
+    QVERIFY(ff2.getErrorMessage().isEmpty());
+    delete provider;
+}
+
+//*************************************************************************
+
+/*!
+ * \brief FiltersTest::test_noDataMask
+ * Check that no-data values are kept in the result and are not used by neighbourhood filters :
+ * mean of the blur filter is computed from valid pixels only
+ */
+void FiltersTest::test_noDataMask()
+{
+    float noDataValue = Core::ImageDataProvider::NoDataValue;
+    cv::Mat data;
+    TEST_MATRIX(cv::Rect(0, 0, 100, 100)).convertTo(data, CV_32F);
+    cv::Rect noDataRect(20, 30, 10, 10);
+    data(noDataRect).setTo(noDataValue);
+
+    Filters::PowerFilter pf;
+    pf.setPower(0.5);
+    pf.setNoDataValue(noDataValue);
+    cv::Mat res = pf.apply(data);
+    QVERIFY(!res.empty());
+    QVERIFY(cv::countNonZero(res(noDataRect).reshape(1) != noDataValue) == 0);
+    cv::Mat trueRes;
+    cv::pow(data(cv::Rect(50, 50, 50, 50)), 0.5, trueRes);
+    QVERIFY(cv::norm(res(cv::Rect(50, 50, 50, 50)), trueRes, cv::NORM_INF) < 1e-5);
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(3);
+    bf.setSizeY(3);
+    bf.setNoDataValue(noDataValue);
+    res = bf.apply(data);
+    QVERIFY(!res.empty());
+    QVERIFY(cv::countNonZero(res(noDataRect).reshape(1) != noDataValue) == 0);
+    cv::Mat zeroData = data.clone();
+    zeroData(noDataRect).setTo(0);
+    cv::Mat valid(data.size(), CV_32F, cv::Scalar(1.0)), count;
+    valid(noDataRect).setTo(0);
+    cv::boxFilter(zeroData, trueRes, CV_32F, cv::Size(3, 3), cv::Point(-1,-1), false);
+    cv::boxFilter(valid, count, CV_32F, cv::Size(3, 3), cv::Point(-1,-1), false);
+    trueRes /= count;
+    // column next to no-data pixels : mean of 6 valid pixels
+    cv::Rect r(noDataRect.x - 1, noDataRect.y + 1, 1, noDataRect.height - 2);
+    QVERIFY(cv::norm(res(r), trueRes(r), cv::NORM_INF) < 1e-3);
+}
+
+//*************************************************************************
+
+class StagedFilter : public Filters::AbstractFilter
+{
+protected:
+    virtual cv::Mat filter(const cv::Mat & src, const Filters::FilterMonitor & monitor) const
+    {
+        for (int i=1; i<=4; i++)
+        {
+            if (!monitor.setProgress(25*i))
+                return cv::Mat();
+        }
+        return src.clone();
+    }
+};
+
+class ProgressRecorder : public Filters::FilterMonitor
+{
+public:
+    mutable QList<int> values;
+protected:
+    virtual void progressChanged(int value) const
+    { values << value; }
+};
+
+//! Monitor canceled at the first progress report
+class CancelingMonitor : public Filters::FilterMonitor
+{
+protected:
+    virtual void progressChanged(int value) const
+    {
+        Q_UNUSED(value);
+        const_cast<CancelingMonitor*>(this)->cancel();
+    }
+};
+
+/*!
+ * \brief FiltersTest::test_FilterMonitor
+ * Check progress reporting and cancellation of a filter run
+ */
+void FiltersTest::test_FilterMonitor()
+{
+    cv::Mat data(10, 10, CV_32F, cv::Scalar(1.0));
+    StagedFilter f;
+
+    ProgressRecorder recorder;
+    QVERIFY(!f.apply(data, &recorder).empty());
+    QVERIFY(recorder.values == QList<int>() << 25 << 50 << 75 << 100);
+
+    // Child monitor maps the progress into its range
+    recorder.values.clear();
+    Filters::FilterMonitor child(&recorder, 50, 100);
+    QVERIFY(!f.apply(data, &child).empty());
+    QVERIFY(recorder.values == QList<int>() << 62 << 75 << 87 << 100);
+
+    // Canceled parent cancels the child run
+    recorder.values.clear();
+    recorder.cancel();
+    QVERIFY(child.isCanceled());
+    QVERIFY(f.apply(data, &child).empty());
+    QVERIFY(recorder.values.isEmpty());
+
+    // Large data is filtered by strips : same result as the whole data and the run stops between strips
+    cv::Mat large(3 * Filters::AbstractFilter::StripHeight + 10, 40, CV_32F);
+    cv::randu(large, 1.0, 100.0);
+    cv::Mat trueRes;
+    cv::blur(large, trueRes, cv::Size(7, 7));
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(7);
+    bf.setSizeY(7);
+    recorder.reset();
+    recorder.values.clear();
+    cv::Mat res = bf.apply(large, &recorder);
+    QVERIFY(cv::norm(res, trueRes, cv::NORM_INF) < 1e-3);
+    QVERIFY(recorder.values.size() == 3);
+
+    CancelingMonitor canceling;
+    QVERIFY(bf.apply(large, &canceling).empty());
+    QVERIFY(canceling.isCanceled());
+}
+
+//*************************************************************************
+
+/*!
+ * \brief FiltersTest::test_TiledFilterEngine
+ * Check that filter applied on tiles with halo gives the same result as the filter applied on the whole image
+ * a) in memory output
+ * b) temporary file output
+ */
+void FiltersTest::test_TiledFilterEngine()
+{
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("provider", TEST_MATRIX);
+    QVERIFY(provider);
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(7);
+    bf.setSizeY(5);
+    bf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+    QVERIFY(bf.getHaloSize() == 3);
+
+    cv::Mat trueData = bf.apply(provider->getImageData());
+    QVERIFY(!trueData.empty());
+
+    QList<QRect> tiles = Filters::TiledFilterEngine::computeTiles(QRect(0,0,1000,700), 300);
+    QVERIFY(tiles.size() == 12);
+    QVERIFY(tiles.last() == QRect(900,600,100,100));
+
+    Filters::TiledFilterEngine engine;
+    engine.setTileSize(300);
+    Core::ImageDataProvider * output = engine.apply(&bf, provider);
+    QVERIFY(output);
+    QVERIFY(output->getPixelExtent() == provider->getPixelExtent());
+    QVERIFY(cv::norm(output->getImageData(), trueData, cv::NORM_INF) < 1e-2);
+    delete output;
+
+    // Force output into a temporary file :
+    engine.setInMemoryLimit(0.0);
+    output = engine.apply(&bf, provider);
+    QVERIFY(output);
+    QVERIFY(cv::norm(output->getImageData(), trueData, cv::NORM_INF) < 1e-2);
+    delete output;
+
+    delete provider;
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_FilterPreviewDataProvider
+ * Check that preview at full resolution gives the same result as the filter applied on the whole image
+ * and that reduced resolution requests have the requested size
+ */
+void FiltersTest::test_FilterPreviewDataProvider()
+{
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("provider", TEST_MATRIX);
+    QVERIFY(provider);
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(7);
+    bf.setSizeY(5);
+    bf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+
+    cv::Mat trueData = bf.apply(provider->getImageData());
+    QVERIFY(!trueData.empty());
+
+    Filters::FilterPreviewDataProvider preview;
+    QVERIFY(preview.setup(&bf, provider));
+    QVERIFY(preview.getPixelExtent() == provider->getPixelExtent());
+    QVERIFY(preview.getNbBands() == provider->getNbBands());
+
+    QRect r(100, 50, 300, 200);
+    cv::Mat data = preview.getImageData(r);
+    QVERIFY(data.cols == r.width() && data.rows == r.height());
+    cv::Mat trueRoi = trueData(cv::Rect(r.x(), r.y(), r.width(), r.height()));
+    QVERIFY(cv::norm(data, trueRoi, cv::NORM_INF) < 1e-2);
+
+    // Preview runs a copy of the filter : parameters changes are taken with setFilter()
+    bf.setSizeX(15);
+    data = preview.getImageData(r);
+    QVERIFY(cv::norm(data, trueRoi, cv::NORM_INF) < 1e-2);
+    QVERIFY(preview.setFilter(&bf));
+    data = preview.getImageData(r);
+    QVERIFY(cv::norm(data, trueRoi, cv::NORM_INF) > 1e-2);
+
+    data = preview.getImageData(QRect(0, 0, 1000, 1000), 250, 250);
+    QVERIFY(data.cols == 250 && data.rows == 250);
+
+    // Source is destroyed -> preview becomes invalid
+    delete provider;
+    QVERIFY(!preview.isValid());
+    QVERIFY(preview.getImageData().empty());
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_FilterPipeline
+ * Check that the chain of filters applied on tiles gives the same result as filters applied
+ * one after another on the whole image
+ */
+void FiltersTest::test_FilterPipeline()
+{
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("provider", TEST_MATRIX);
+    QVERIFY(provider);
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(5);
+    bf.setSizeY(5);
+    bf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+
+    Filters::PowerFilter pf;
+    pf.setPower(0.5);
+    pf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+
+    cv::Mat trueData = pf.apply(bf.apply(provider->getImageData()));
+    QVERIFY(!trueData.empty());
+
+    Filters::FilterPipeline pipeline;
+    QVERIFY(pipeline.apply(provider->getImageData()).empty());
+    pipeline.append(&bf);
+    pipeline.append(&pf);
+    pipeline.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+    QVERIFY(pipeline.getFilters().size() == 2);
+    QVERIFY(pipeline.getHaloSize() == bf.getHaloSize() + pf.getHaloSize());
+
+    Filters::TiledFilterEngine engine;
+    engine.setTileSize(300);
+    Core::ImageDataProvider * output = engine.apply(&pipeline, provider);
+    QVERIFY(output);
+    QVERIFY(cv::norm(output->getImageData(), trueData, cv::NORM_INF) < 1e-2);
+    delete output;
+
+    // Filter working on the whole image ends the tiled part of the pipeline
+    Filters::ConvertTo8U cf;
+    cf.setType("real min/max");
+    cf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+    QVERIFY(cf.getHaloSize() < 0);
+    cv::Mat true8U = cf.apply(trueData);
+    QVERIFY(!true8U.empty());
+    true8U.convertTo(true8U, CV_32F);
+
+    pipeline.append(&cf);
+    QVERIFY(pipeline.getHaloSize() < 0);
+    output = engine.apply(&pipeline, provider);
+    QVERIFY(output);
+    QVERIFY(output->getPixelExtent() == provider->getPixelExtent());
+    QVERIFY(cv::norm(output->getImageData(), true8U, cv::NORM_INF) <= 1.0);
+    delete output;
+
+    delete provider;
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_ProcessFilter
+ * Check that the process filter reports an error without a worker executable
+ */
+void FiltersTest::test_ProcessFilter()
+{
+    QVERIFY(Filters::ProcessFilter::isProcessRunning(QCoreApplication::applicationPid()));
+    QVERIFY(!Filters::ProcessFilter::isProcessRunning(0));
+
+    Filters::BlurFilter bf;
+    bf.setSizeX(5);
+    bf.setSizeY(5);
+
+    Filters::ProcessFilter pf(&bf);
+    QVERIFY(pf.getName() == bf.getName());
+    QVERIFY(pf.getHaloSize() == bf.getHaloSize());
+
+    pf.setWorkerPath(QDir::temp().absoluteFilePath("GIVFilterWorker_not_found"));
+    pf.setMaxNbOfWorkers(2);
+    cv::Mat data(100, 100, CV_32F, cv::Scalar(1.0));
+    QVERIFY(pf.apply(data).empty());
+    QVERIFY(!pf.getErrorMessage().isEmpty());
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_ProcessFilterWorker
+ * Check that the filter applied in the worker process gives the same result as the filter applied in-process :
+ * a) with no-data values
+ * b) on a larger tile that restarts the worker with a larger shared memory
+ * c) with the tiled filter engine
+ */
+void FiltersTest::test_ProcessFilterWorker()
+{
+#ifndef GIV_FILTER_WORKER_PATH
+    QSKIP("Filter worker path is not defined");
+#else
+    QString workerPath(GIV_FILTER_WORKER_PATH);
+    if (!QFileInfo(workerPath).exists())
+        QSKIP("Filter worker executable is not found");
+
+    Filters::BlurFilter bf;
+    bf.setType("mean");
+    bf.setSizeX(7);
+    bf.setSizeY(5);
+    bf.setNoDataValue(Core::ImageDataProvider::NoDataValue);
+
+    Filters::ProcessFilter pf(&bf);
+    pf.setWorkerPath(workerPath);
+    pf.setPluginsPath("");
+    pf.setMaxNbOfWorkers(2);
+
+    // a)
+    cv::Mat data;
+    TEST_MATRIX(cv::Rect(0, 0, 200, 150)).convertTo(data, CV_32F);
+    data(cv::Rect(50, 40, 30, 20)).setTo(Core::ImageDataProvider::NoDataValue);
+    cv::Mat trueData = bf.apply(data);
+    QVERIFY(!trueData.empty());
+    cv::Mat res = pf.apply(data);
+    QVERIFY2(!res.empty(), pf.getErrorMessage().toLatin1().constData());
+    QVERIFY(res.size() == trueData.size() && res.type() == trueData.type());
+    QVERIFY(cv::norm(res, trueData, cv::NORM_INF) < 1e-5);
+
+    // b)
+    TEST_MATRIX(cv::Rect(0, 0, 600, 500)).convertTo(data, CV_32F);
+    trueData = bf.apply(data);
+    res = pf.apply(data);
+    QVERIFY2(!res.empty(), pf.getErrorMessage().toLatin1().constData());
+    QVERIFY(cv::norm(res, trueData, cv::NORM_INF) < 1e-5);
+
+    // c)
+    Core::FloatingDataProvider * provider =
+            Core::FloatingDataProvider::createDataProvider("provider", TEST_MATRIX);
+    QVERIFY(provider);
+    trueData = bf.apply(provider->getImageData());
+    Filters::TiledFilterEngine engine;
+    engine.setTileSize(300);
+    Core::ImageDataProvider * output = engine.apply(&pf, provider);
+    QVERIFY(output);
+    QVERIFY(cv::norm(output->getImageData(), trueData, cv::NORM_INF) < 1e-2);
+    delete output;
+    delete provider;
+#endif
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_FastBlur
+ * Check median and mean of valid pixels over a large window against direct computation
+ * and large gaussian approximation against cv::GaussianBlur
+ */
+void FiltersTest::test_FastBlur()
+{
+    const int ksize = 31;
+    const int r = ksize/2;
+
+    // Integer values in a range of 256 (8-bit histograms) and of 1000 (16-bit histograms) :
+    int ranges[] = {200, 1000};
+    for (int i=0; i<2; i++)
+    {
+        cv::Mat data(60, 70, CV_32F);
+        cv::randu(data, 0, ranges[i]);
+        data.convertTo(data, CV_32S);
+        data.convertTo(data, CV_32F);
+        cv::Mat noDataMask(data.size(), CV_8U, cv::Scalar(0));
+        noDataMask(cv::Rect(10, 10, 20, 15)).setTo(255);
+        data.setTo(0, noDataMask);
+
+        cv::Mat median = Filters::medianFilter(data, ksize, noDataMask);
+        cv::Mat mean = Filters::meanFilter(data, cv::Size(ksize, ksize), noDataMask);
+        QVERIFY(median.size() == data.size() && median.type() == data.type());
+        QVERIFY(mean.size() == data.size() && mean.type() == data.type());
+
+        for (int y=0; y<data.rows; y+=7)
+        {
+            for (int x=0; x<data.cols; x+=5)
+            {
+                if (noDataMask.at<uchar>(y, x))
+                    continue;
+                std::vector<float> values;
+                double sum = 0.0;
+                // borders are replicated
+                for (int dy=-r; dy<=r; dy++)
+                {
+                    for (int dx=-r; dx<=r; dx++)
+                    {
+                        int yy = qBound(0, y+dy, data.rows-1);
+                        int xx = qBound(0, x+dx, data.cols-1);
+                        if (noDataMask.at<uchar>(yy, xx))
+                            continue;
+                        values.push_back(data.at<float>(yy, xx));
+                        sum += values.back();
+                    }
+                }
+                std::sort(values.begin(), values.end());
+                QVERIFY(median.at<float>(y, x) == values[(values.size() - 1)/2]);
+
+                // mean at borders uses reflected pixels
+                if (y >= r && y < data.rows - r && x >= r && x < data.cols - r)
+                {
+                    QVERIFY(qAbs(mean.at<float>(y, x) - sum/values.size()) < 1e-2);
+                }
+            }
+        }
+    }
+
+    // Masked path has the border of cv::medianBlur :
+    cv::Mat data8U(60, 70, CV_8U);
+    cv::randu(data8U, 0, 256);
+    cv::Mat trueMedian;
+    cv::medianBlur(data8U, trueMedian, 7);
+    cv::Mat noMask(data8U.size(), CV_8U, cv::Scalar(0));
+    QVERIFY(cv::norm(Filters::medianFilter(data8U, 7, noMask), trueMedian, cv::NORM_INF) == 0.0);
+
+    // Cost of the 16-bit median does not depend on the window size : best time of 3 runs
+    cv::Mat data16U(300, 300, CV_16U);
+    cv::randu(data16U, 0, 65536);
+    qint64 times[2];
+    int ksizes[] = {15, 201};
+    for (int k=0; k<2; k++)
+    {
+        times[k] = -1;
+        for (int run=0; run<3; run++)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            Filters::medianFilter(data16U, ksizes[k]);
+            qint64 t = timer.nsecsElapsed();
+            times[k] = times[k] < 0 ? t : qMin(times[k], t);
+        }
+    }
+    // window is 13 times larger
+    QVERIFY(times[1] < 3*times[0]);
+
+    // Large gaussian kernel :
+    cv::Mat data(200, 200, CV_32F);
+    cv::randu(data, 0, 1000);
+    cv::Mat trueData;
+    cv::GaussianBlur(data, trueData, cv::Size(49, 49), 8.0, 8.0);
+    cv::Mat res = Filters::gaussianFilter(data, cv::Size(49, 49), 8.0, 8.0);
+    QVERIFY(res.size() == data.size());
+    cv::Rect inner(30, 30, 140, 140);
+    QVERIFY(cv::norm(res(inner), trueData(inner), cv::NORM_INF) < 20.0);
+    QVERIFY(Filters::gaussianHaloSize(cv::Size(49, 49), 8.0, 8.0) >= 2*8);
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_Morphology
+ * Check van Herk/Gil-Werman line and rectangle morphology against cv::dilate/cv::erode,
+ * disk approximation and no-data handling
+ */
+void FiltersTest::test_Morphology()
+{
+    cv::Mat data(57, 63, CV_32F);
+    cv::randu(data, -100, 100);
+
+    // Lines of odd sizes and rectangles of odd and even sizes :
+    int sizes[] = {1, 5, 9, 25, 71};
+    for (int i=0; i<5; i++)
+    {
+        int k = sizes[i];
+        cv::Mat eye = cv::Mat::eye(k, k, CV_8U);
+        cv::Mat antiEye;
+        cv::flip(eye, antiEye, 1);
+        cv::Mat kernels[] = {cv::Mat::ones(1, k, CV_8U), cv::Mat::ones(k, 1, CV_8U), eye, antiEye};
+        int directions[] = {Filters::HorizontalLine, Filters::VerticalLine, Filters::DiagonalLine, Filters::AntiDiagonalLine};
+        for (int j=0; j<4; j++)
+        {
+            cv::Mat trueData;
+            cv::dilate(data, trueData, kernels[j]);
+            QVERIFY(cv::norm(Filters::morphologyLine(data, true, k, directions[j]), trueData, cv::NORM_INF) == 0.0);
+            cv::erode(data, trueData, kernels[j]);
+            QVERIFY(cv::norm(Filters::morphologyLine(data, false, k, directions[j]), trueData, cv::NORM_INF) == 0.0);
+        }
+
+        cv::Size ksize(k, sizes[4 - i] + 1);
+        cv::Mat trueData;
+        cv::dilate(data, trueData, cv::Mat::ones(ksize, CV_8U));
+        QVERIFY(cv::norm(Filters::morphologyRect(data, true, ksize), trueData, cv::NORM_INF) == 0.0);
+        cv::morphologyEx(data, trueData, cv::MORPH_CLOSE, cv::Mat::ones(ksize, CV_8U), cv::Point(-1,-1), 2);
+        QVERIFY(cv::norm(Filters::morphology(data, cv::MORPH_CLOSE, Filters::RectangleShape, ksize, 2), trueData, cv::NORM_INF) == 0.0);
+    }
+
+    // 8-bit open :
+    cv::Mat data8U;
+    data.convertTo(data8U, CV_8U, 1.0, 100.0);
+    cv::Mat trueData;
+    cv::morphologyEx(data8U, trueData, cv::MORPH_OPEN, cv::Mat::ones(7, 7, CV_8U));
+    cv::Mat res = Filters::morphology(data8U, cv::MORPH_OPEN, Filters::RectangleShape, cv::Size(7, 7));
+    QVERIFY(res.type() == CV_8U);
+    QVERIFY(cv::norm(res, trueData, cv::NORM_INF) == 0.0);
+
+    // Disk is close to the ellipse structuring element :
+    cv::Mat point(101, 101, CV_8U, cv::Scalar(0));
+    point.at<uchar>(50, 50) = 255;
+    cv::Mat disk = Filters::morphologyDisk(point, true, 41);
+    cv::Mat ellipse = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(41, 41));
+    int diskArea = cv::countNonZero(disk);
+    int ellipseArea = cv::countNonZero(ellipse);
+    QVERIFY(qAbs(diskArea - ellipseArea) < 0.1*ellipseArea);
+    std::vector<cv::Point> diskPoints;
+    cv::findNonZero(disk, diskPoints);
+    QVERIFY(cv::boundingRect(diskPoints) == cv::Rect(30, 30, 41, 41));
+
+    // Small disks are the ellipse, larger disks have no holes :
+    for (int d=3; d<=15; d+=2)
+    {
+        disk = Filters::morphologyDisk(point, true, d);
+        if (d <= 7)
+        {
+            cv::Mat trueDisk;
+            cv::dilate(point, trueDisk, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(d, d)));
+            QVERIFY(cv::countNonZero(disk != trueDisk) == 0);
+        }
+        cv::Mat outside = disk.clone();
+        cv::floodFill(outside, cv::Point(0, 0), cv::Scalar(128));
+        QVERIFY(cv::countNonZero(outside == 0) == 0);
+    }
+
+    // No-data pixels are ignored :
+    cv::Mat noDataMask(data.size(), CV_8U, cv::Scalar(0));
+    noDataMask.at<uchar>(20, 20) = 255;
+    cv::Mat input = data.clone();
+    input.at<float>(20, 20) = 1000.0f;
+    res = Filters::morphology(input, cv::MORPH_DILATE, Filters::RectangleShape, cv::Size(5, 5), 1, noDataMask);
+    cv::Mat trueMasked = data.clone();
+    trueMasked.at<float>(20, 20) = -FLT_MAX;
+    cv::dilate(trueMasked, trueData, cv::Mat::ones(5, 5, CV_8U));
+    QVERIFY(cv::norm(res, trueData, cv::NORM_INF) == 0.0);
+    QVERIFY(input.at<float>(20, 20) == 1000.0f);
+}
+
+//*************************************************************************
+
+//! Class to restore the EditableFunction source file and the working directory changed by EditableFilter
+class EditableFunctionGuard
+{
+public:
+    EditableFunctionGuard() :
+        _currentPath(QDir::currentPath())
+    {}
+
+    ~EditableFunctionGuard()
+    {
+        QFile f(_sourcePath);
+        if (!_source.isNull() && f.open(QIODevice::WriteOnly))
+        {
+            QTextStream ts(&f);
+            ts << _source;
+        }
+        QDir::setCurrent(_currentPath);
+    }
+
+    //! Method to keep the source file, returns false if the EditableFunction project or CMake is not found
+    bool keepSource(const Filters::EditableFilter & filter)
+    {
+        _sourcePath = QDir::current().absoluteFilePath("Resources/EditableFunction/EditableFunction.cpp");
+        if (!QFileInfo(_sourcePath).exists() ||
+                QProcess::execute(filter.getCMakePath(), QStringList() << "--version") != 0)
+            return false;
+        QFile f(_sourcePath);
+        if (!f.open(QIODevice::ReadOnly))
+            return false;
+        _source = QTextStream(&f).readAll();
+        return true;
+    }
+
+protected:
+    QString _currentPath;
+    QString _sourcePath;
+    QString _source;
+};
+
+//! Method to apply the program and to wait for its build. Cached is true if the library is loaded
+//! without a build
+bool applyEditableProgram(Filters::EditableFilter & filter, const QString & program, bool * cached = 0)
+{
+    QSignalSpy spy(&filter, SIGNAL(workFinished(bool)));
+    filter.apply(program);
+    if (cached)
+        *cached = !spy.isEmpty();
+    if (spy.isEmpty() && !spy.wait(10*60*1000))
+        return false;
+    return spy.first().first().toBool();
+}
+
+/*!
+ * \brief FiltersTest::test_EditableFilter
+ * Check that programs using the predefined variable _noDataValue are compiled and read the no-data value
+ */
+void FiltersTest::test_EditableFilter()
+{
+    EditableFunctionGuard guard;
+    Filters::EditableFilter filter;
+    if (!guard.keepSource(filter))
+        QSKIP("EditableFunction project or CMake is not found");
+
+    QString program = "#include \"EditableFunction.h\"\n"
+            "cv::Mat filter(const cv::Mat & data)\n"
+            "{\n"
+            "    return cv::Mat(data.size(), CV_32F, cv::Scalar(_noDataValue));\n"
+            "}\n";
+    QVERIFY(applyEditableProgram(filter, program));
+
+    filter.setNoDataValue(-5.0f);
+    cv::Mat out = filter.apply(cv::Mat(10, 12, CV_32F, cv::Scalar(1.0)));
+    QVERIFY(out.size() == cv::Size(12, 10) && out.type() == CV_32F);
+    QVERIFY(cv::countNonZero(out != -5.0f) == 0);
+}
+
+//*************************************************************************
+/*!
+ * \brief FiltersTest::test_EditableFilterCache
+ * Check that a program applied again is loaded from the build cache and that a changed program is built.
+ * Changed program has a unique comment, thus it is not in the cache of a previous run
+ */
+void FiltersTest::test_EditableFilterCache()
+{
+    EditableFunctionGuard guard;
+    Filters::EditableFilter filter;
+    if (!guard.keepSource(filter))
+        QSKIP("EditableFunction project or CMake is not found");
+
+    QString program = "#include \"EditableFunction.h\"\n"
+            "cv::Mat filter(const cv::Mat & data)\n"
+            "{\n"
+            "    return data + 1.0;\n"
+            "}\n";
+    cv::Mat data(10, 12, CV_32F, cv::Scalar(1.0));
+
+    bool cached = false;
+    QVERIFY(applyEditableProgram(filter, program, &cached));
+    QString libraryPath = filter.getLibraryPath();
+    QVERIFY(!libraryPath.isEmpty());
+
+    // Same program : cached library is loaded without a build
+    QVERIFY(applyEditableProgram(filter, program, &cached));
+    QVERIFY(cached);
+    QVERIFY(filter.getLibraryPath() == libraryPath);
+    cv::Mat out = filter.apply(data);
+    QVERIFY(!out.empty() && cv::countNonZero(out != 2.0f) == 0);
+
+    // Changed program : library is built again
+    QString program2 = QString("// %1\n").arg(QDateTime::currentMSecsSinceEpoch()) + program;
+    program2.replace("data + 1.0", "data + 2.0");
+    QVERIFY(applyEditableProgram(filter, program2, &cached));
+    QVERIFY(!cached);
+    QVERIFY(filter.getLibraryPath() != libraryPath);
+    out = filter.apply(data);
+    QVERIFY(!out.empty() && cv::countNonZero(out != 3.0f) == 0);
 }
 
 //*************************************************************************
@@ -86,7 +825,8 @@ void FiltersTest::test3()
 
 void FiltersTest::cleanupTestCase()
 {
-    QVERIFY(true);
+    // gdal
+    GDALDestroyDriverManager();
 }
 
 //*************************************************************************
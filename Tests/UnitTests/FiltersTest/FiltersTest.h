@@ -18,6 +18,17 @@ class FiltersTest : public QObject
 private slots:
     void initTestCase();
     void test_exception();
+    void test_noDataMask();
+    void test_FilterMonitor();
+    void test_TiledFilterEngine();
+    void test_FilterPreviewDataProvider();
+    void test_FilterPipeline();
+    void test_ProcessFilter();
+    void test_ProcessFilterWorker();
+    void test_FastBlur();
+    void test_Morphology();
+    void test_EditableFilter();
+    void test_EditableFilterCache();
     void test2();
     void test3();
     void cleanupTestCase();
@@ -13,6 +13,12 @@
 #include "LayerUtilsTest.h"
 #include "Core/LayerUtils.h"
 #include "Core/ImageDataProvider.h"
+#include "Core/TiledVectorizer.h"
+#include "Core/DrawingsItem.h"
+#include "Core/RegionGrowing.h"
+#include "Core/FloatingDataProvider.h"
+#include "Core/ImageRenderer.h"
+#include "Core/TilePyramidWriter.h"
 
 namespace Tests
 {
@@ -220,6 +226,69 @@ void LayerUtilsTest::test_FileReadWriteMethods()
     QVERIFY( comparePolygons(provider->fetchGeoExtent(), GEO_EXTENT) );
     QVERIFY( compareVectors(provider->fetchGeoTransform(), GEO_TRANSFORM) );
     QVERIFY( provider->getPixelExtent() == QRect(0,0,WIDTH,HEIGHT));
+
+    // Write a subset of the provider by windows into a tiled file :
+    QString out2 = QFileInfo("Input:").absoluteFilePath() + "/test_image1.tif";
+    QRect subset(130, 70, 900, 1250);
+    Core::GeoTiffOptions options;
+    options.BlockSize = 128;
+    res = Core::writeToFile(out2, provider, subset,
+                            provider->fetchProjectionRef(), provider->fetchGeoTransform(),
+                            Core::ImageDataProvider::NoDataValue, METADATA, options);
+    QVERIFY(res);
+
+    Core::GDALDataProvider * provider2 = new Core::GDALDataProvider();
+    QVERIFY(provider2->setup(out2));
+    QVERIFY( provider2->getPixelExtent() == QRect(0,0,subset.width(),subset.height()));
+    int blockXSize = 0, blockYSize = 0;
+    provider2->getDataset()->GetRasterBand(1)->GetBlockSize(&blockXSize, &blockYSize);
+    QVERIFY(blockXSize == 128 && blockYSize == 128);
+    cv::Mat s = provider2->getImageData();
+    cv::Mat s2 = m(cv::Rect(subset.x(), subset.y(), subset.width(), subset.height()));
+    QVERIFY(Core::isEqual(s, s2));
+    QVector<double> gt = provider2->fetchGeoTransform();
+    QVERIFY(qAbs(gt[0] - (GEO_TRANSFORM[0] + subset.x()*GEO_TRANSFORM[1] + subset.y()*GEO_TRANSFORM[2])) < 1e-8);
+    QVERIFY(qAbs(gt[3] - (GEO_TRANSFORM[3] + subset.x()*GEO_TRANSFORM[4] + subset.y()*GEO_TRANSFORM[5])) < 1e-8);
+    delete provider2;
+    QVERIFY(QFile(out2).remove());
+
+    // Write a cloud optimized file with internal overviews :
+    options.Compression = "DEFLATE";
+    options.Predictor = 3;
+    options.Level = 6;
+    options.CloudOptimized = true;
+    res = Core::writeToFile(out2, provider, QRect(),
+                            provider->fetchProjectionRef(), provider->fetchGeoTransform(),
+                            Core::ImageDataProvider::NoDataValue, METADATA, options);
+    QVERIFY(res);
+    QVERIFY(!QFile(out2 + ".tmp.tif").exists());
+
+    provider2 = new Core::GDALDataProvider();
+    QVERIFY(provider2->setup(out2));
+    GDALRasterBand * band = provider2->getDataset()->GetRasterBand(1);
+    // overviews down to a block : 1000, 500, 250, 125
+    QVERIFY(band->GetOverviewCount() == 4);
+    QVERIFY(Core::isEqual(provider2->getImageData(), m));
+    GDALRasterBand * overview = band->GetOverview(1);
+    QVERIFY(overview->GetXSize() == WIDTH/4 && overview->GetYSize() == HEIGHT/4);
+    cv::Mat o(overview->GetYSize(), overview->GetXSize(), CV_32F);
+    QVERIFY(overview->RasterIO(GF_Read, 0, 0, o.cols, o.rows, o.data, o.cols, o.rows, GDT_Float32, 0, 0) == CE_None);
+    // nearest neighbour samples the block centre
+    QVERIFY(o.at<float>(17, 33) == m.at<float>(17*4 + 2, 33*4 + 2));
+    QVERIFY(o.at<float>(o.rows-1, o.cols-1) == m.at<float>((o.rows-1)*4 + 2, (o.cols-1)*4 + 2));
+    delete provider2;
+    QVERIFY(QFile(out2).remove());
+
+    // Canceled write stops before the first window and removes the output files :
+    Core::ProgressReporter reporter;
+    reporter.cancel();
+    res = Core::writeToFile(out2, provider, QRect(),
+                            provider->fetchProjectionRef(), provider->fetchGeoTransform(),
+                            Core::ImageDataProvider::NoDataValue, METADATA, options, &reporter);
+    QVERIFY(!res);
+    QVERIFY(!QFile(out2).exists());
+    QVERIFY(!QFile(out2 + ".tmp.tif").exists());
+
     delete provider;
 
     QVERIFY(QFile(out).remove());
@@ -471,6 +540,302 @@ void LayerUtilsTest::test_joinContours()
 
     }
 
+    // Test many contours : rows of separated squares joined by bars
+    {
+        QVector< QPolygon > contours;
+        for (int y=0; y<50; y++)
+        {
+            for (int x=0; x<200; x++)
+            {
+                contours << QPolygon(QRect(x*10, y*10, 5, 5), true);
+            }
+        }
+        QVERIFY(Core::joinOvrlContours(contours) == 0);
+        QVERIFY(contours.size() == 10000);
+
+        for (int y=0; y<50; y++)
+        {
+            contours << QPolygon(QRect(0, y*10 + 2, 2000, 2), true);
+        }
+        int count = Core::joinOvrlContours(contours);
+        QVERIFY(count == 10000);
+        QVERIFY(contours.size() == 50);
+        foreach (QPolygon c, contours)
+        {
+            QVERIFY(c.boundingRect().width() == 2000);
+        }
+    }
+
+}
+
+//*************************************************************************
+
+void LayerUtilsTest::test_TiledVectorizer()
+{
+    cv::Mat m(100, 120, CV_8U, cv::Scalar(0));
+    // box
+    m(cv::Rect(10, 10, 10, 10)).setTo(255);
+    // rectangle
+    m(cv::Rect(50, 5, 35, 15)).setTo(255);
+    // cross
+    m(cv::Rect(25, 40, 7, 20)).setTo(255);
+    m(cv::Rect(20, 45, 20, 7)).setTo(255);
+    // frame with a hole
+    m(cv::Rect(60, 60, 50, 30)).setTo(255);
+    m(cv::Rect(70, 70, 20, 10)).setTo(0);
+    // diagonal pixels are connected
+    m.at<uchar>(95, 5) = 255;
+    m.at<uchar>(96, 6) = 255;
+
+    // Tile borders cross the shapes, results do not depend on the tile size
+    int tileSizes[] = {16, 37, 1000};
+    for (int i=0; i<3; i++)
+    {
+        Core::TiledVectorizer vectorizer;
+        vectorizer.setTileSize(tileSizes[i]);
+        QVector<QPolygonF> external = vectorizer.vectorize(m);
+        QVERIFY(external.size() == 5);
+
+        bool found = false;
+        foreach (QPolygonF p, external)
+        {
+            if (p.boundingRect() == QRectF(10, 10, 10, 10))
+            {
+                found = true;
+                QVERIFY(p.size() == 5);
+            }
+        }
+        QVERIFY(found);
+
+        vectorizer.setExternalOnly(false);
+        QVector<QPolygonF> all = vectorizer.vectorize(m);
+        QVERIFY(all.size() == 6);
+
+        // sum of signed areas is the number of pixels
+        double area = 0.0;
+        foreach (QPolygonF p, all)
+        {
+            QVERIFY(p.first() == p.last());
+            for (int j=0; j<p.size()-1; j++)
+            {
+                area += p[j].x()*p[j+1].y() - p[j+1].x()*p[j].y();
+            }
+        }
+        QVERIFY(qAbs(0.5*area - cv::countNonZero(m)) < 1e-10);
+    }
+}
+
+//*************************************************************************
+
+void LayerUtilsTest::test_DrawingsItem()
+{
+    // Large canvas does not allocate memory until something is painted
+    QColor bg(127, 127, 127, 50);
+    // Tiles are premultiplied
+    QRgb bgValue = qUnpremultiply(qPremultiply(bg.rgba()));
+    Core::DrawingsItem item(40000, 30000, bg);
+    QVERIFY(item.boundingRect() == QRectF(0, 0, 40000, 30000));
+    QVERIFY(item.getNbTiles() == 0);
+    QVERIFY(item.getPaintedRect().isEmpty());
+
+    // Rect across 4 tiles
+    int ts = Core::DrawingsItem::TileSize;
+    QRect r(ts - 10, 2*ts - 5, 20, 10);
+    {
+        Core::DrawingsPainter p(&item, r.adjusted(-5, -5, 5, 5));
+        p.fillRect(r, Qt::red);
+    }
+    QVERIFY(item.getNbTiles() == 4);
+    QVERIFY(item.getPaintedRect() == QRect(0, ts, 2*ts, 2*ts));
+
+    QImage im = item.getImage(QRect(ts - 20, 2*ts - 20, 40, 40));
+    QVERIFY(im.size() == QSize(40, 40));
+    QVERIFY(im.pixel(10, 15) == QColor(Qt::red).rgba());
+    QVERIFY(im.pixel(29, 24) == QColor(Qt::red).rgba());
+    QVERIFY(im.pixel(9, 15) == bgValue);
+    QVERIFY(im.pixel(30, 24) == bgValue);
+
+    // Painting the background does not allocate tiles
+    {
+        Core::DrawingsPainter p(&item, QRect(10*ts, 10*ts, ts, ts));
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.fillRect(QRect(10*ts, 10*ts, ts, ts), bg);
+    }
+    QVERIFY(item.getNbTiles() == 4);
+
+    // Painting outside of the canvas is clipped
+    {
+        Core::DrawingsPainter p(&item, QRect(-100, -100, 50, 50));
+        p.fillRect(QRect(-100, -100, 50, 50), Qt::blue);
+    }
+    QVERIFY(item.getNbTiles() == 4);
+
+    // Image outside of the canvas is the background
+    im = item.getImage(QRect(39990, 29990, 20, 20));
+    QVERIFY(im.pixel(19, 19) == bgValue);
+    QVERIFY(item.getImage(QRect()).isNull());
+
+    // setImage writes pixels
+    QImage red(5, 5, QImage::Format_RGBA8888);
+    red.fill(Qt::red);
+    item.setImage(red, QPoint(39998, 29998));
+    QVERIFY(item.getNbTiles() == 5);
+    im = item.getImage(QRect(39995, 29995, 5, 5));
+    QVERIFY(im.pixel(4, 4) == QColor(Qt::red).rgba());
+    QVERIFY(im.pixel(2, 2) == bgValue);
+
+    // Undo/redo of a stroke : only modified tiles are kept in the history
+    QVERIFY(!item.canUndo());
+    item.beginEdit();
+    {
+        Core::DrawingsPainter p(&item, QRect(0, ts, 10, 10));
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.fillRect(QRect(0, ts, 10, 10), Qt::green);
+    }
+    {
+        Core::DrawingsPainter p(&item, QRect(5*ts, 5*ts, 10, 10));
+        p.fillRect(QRect(5*ts, 5*ts, 10, 10), Qt::green);
+    }
+    item.endEdit();
+    QVERIFY(item.canUndo());
+    QVERIFY(item.getNbTiles() == 6);
+    // one allocated tile is saved, the other was not allocated
+    QVERIFY(item.getUndoMemorySize() == ts*ts*4);
+    QVERIFY(item.getImage(QRect(0, ts, 1, 1)).pixel(0, 0) == QColor(Qt::green).rgba());
+
+    QVERIFY(item.undo());
+    QVERIFY(!item.canUndo() && item.canRedo());
+    QVERIFY(item.getNbTiles() == 5);
+    QVERIFY(item.getImage(QRect(0, ts, 1, 1)).pixel(0, 0) == bgValue);
+    QVERIFY(item.getImage(QRect(ts - 10, 2*ts - 5, 1, 1)).pixel(0, 0) == QColor(Qt::red).rgba());
+
+    QVERIFY(item.redo());
+    QVERIFY(item.getNbTiles() == 6);
+    QVERIFY(item.getImage(QRect(0, ts, 1, 1)).pixel(0, 0) == QColor(Qt::green).rgba());
+    QVERIFY(item.getImage(QRect(5*ts, 5*ts, 1, 1)).pixel(0, 0) == QColor(Qt::green).rgba());
+    QVERIFY(!item.redo());
+
+    // History is limited by the memory
+    item.setUndoMemoryLimit(0);
+    QVERIFY(!item.canUndo() && !item.canRedo());
+    QVERIFY(item.getUndoMemorySize() == 0);
+}
+
+//*************************************************************************
+
+void LayerUtilsTest::test_RegionGrowing()
+{
+    // L-shaped region crossing tiles and a separated region with the same values
+    cv::Mat m(600, 700, CV_32F, cv::Scalar(100.0));
+    m(cv::Rect(50, 40, 500, 60)).setTo(10.0);
+    m(cv::Rect(490, 40, 60, 500)).setTo(12.0);
+    m(cv::Rect(50, 300, 100, 100)).setTo(10.0);
+    m.at<float>(580, 680) = Core::ImageDataProvider::NoDataValue;
+
+    Core::FloatingDataProvider * provider = Core::FloatingDataProvider::createDataProvider("test", m);
+    QVERIFY(provider);
+
+    Core::RegionGrowing region(provider, 0, 64);
+    QVERIFY(region.grow(QPoint(60, 50), 5.0, 5.0));
+    int expected = 500*60 + 60*500 - 60*60;
+    QVERIFY(region.getNbOfPixels() == expected);
+    QVERIFY(region.getMask().at(520, 500));
+    QVERIFY(!region.getMask().at(60, 310));
+    QVERIFY(!region.getMask().at(40, 50));
+    // Tiles far from the region are not read
+    QVERIFY(region.getNbOfLoadedTiles() < 11*10);
+
+    // Sparse mask is vectorized on its tiles only
+    Core::TiledVectorizer vectorizer;
+    QVector<QPolygonF> contours = vectorizer.vectorize(region.getMask());
+    QVERIFY(contours.size() == 1);
+    double area = 0.0;
+    QPolygonF p = contours[0];
+    for (int j=0; j<p.size()-1; j++)
+    {
+        area += p[j].x()*p[j+1].y() - p[j+1].x()*p[j].y();
+    }
+    QVERIFY(qAbs(0.5*area - expected) < 1e-10);
+
+    // Smaller range
+    QVERIFY(region.grow(QPoint(60, 50), 1.0, 1.0));
+    QVERIFY(region.getNbOfPixels() == 440*60);
+
+    // No-data seed
+    QVERIFY(!region.grow(QPoint(680, 580), 1000.0, 1000.0));
+
+    // Limits stop the fill with a partial mask
+    region.setMaxNbOfPixels(1000);
+    QVERIFY(!region.grow(QPoint(60, 50), 5.0, 5.0));
+    QVERIFY(region.isLimitReached());
+    QVERIFY(region.getNbOfPixels() <= 1000 + 700);
+    region.setMaxNbOfPixels(0);
+    Core::RegionGrowing limited(provider, 0, 64);
+    limited.setMaxNbOfTiles(4);
+    QVERIFY(!limited.grow(QPoint(60, 50), 5.0, 5.0));
+    QVERIFY(limited.isLimitReached());
+    QVERIFY(limited.getNbOfLoadedTiles() <= 4);
+    QVERIFY(region.grow(QPoint(60, 50), 5.0, 5.0));
+    QVERIFY(!region.isLimitReached());
+
+    delete provider;
+}
+
+//*************************************************************************
+
+void LayerUtilsTest::test_TilePyramidWriter()
+{
+    // Image with a no-data tile at the top-left corner
+    cv::Mat m(300, 600, CV_32F, cv::Scalar(100.0));
+    m(cv::Rect(0, 0, 256, 256)).setTo(Core::ImageDataProvider::NoDataValue);
+
+    Core::FloatingDataProvider * provider = Core::FloatingDataProvider::createDataProvider("test", m);
+    QVERIFY(provider);
+
+    Core::ImageRenderer renderer;
+    Core::ImageRendererConfiguration conf;
+    conf.minValues << 0.0;
+    conf.maxValues << 200.0;
+    conf.toRGBMapping << 0 << 0 << 0;
+
+    QString out = QFileInfo("Input:").absoluteFilePath() + "/tiles";
+    Core::TilePyramidWriter writer;
+    QVERIFY(writer.getMaxZoom(provider->getPixelExtent().size()) == 2);
+    QVERIFY(writer.write(out, provider, &renderer, &conf));
+    // 6 + 2 + 1 tiles, the no-data tile is skipped
+    QVERIFY(writer.getNbOfWrittenTiles() == 8);
+    QVERIFY(writer.getNbOfSkippedTiles() == 1);
+    QVERIFY(!QFile(out + "/2/0/0.png").exists());
+
+    QImage tile(out + "/2/1/0.png");
+    QVERIFY(tile.size() == QSize(256, 256));
+    QVERIFY(qAbs(qGray(tile.pixel(10, 10)) - 128) <= 1 && qAlpha(tile.pixel(10, 10)) == 255);
+
+    // Tiles at the boundary are transparent outside of the image
+    tile = QImage(out + "/2/2/1.png");
+    QVERIFY(tile.size() == QSize(256, 256));
+    QVERIFY(qAlpha(tile.pixel(10, 10)) == 255);
+    QVERIFY(qAlpha(tile.pixel(100, 100)) == 0);
+
+    // Zoom 0 contains the whole image at 1/4 resolution
+    tile = QImage(out + "/0/0/0.png");
+    QVERIFY(tile.size() == QSize(256, 256));
+    QVERIFY(qAlpha(tile.pixel(10, 10)) == 0);
+    QVERIFY(qAlpha(tile.pixel(140, 70)) == 255);
+    QVERIFY(qAlpha(tile.pixel(160, 10)) == 0);
+
+    // TMS rows are numbered from the bottom of the 4 rows of zoom 2
+    QString out2 = QFileInfo("Input:").absoluteFilePath() + "/tiles_tms";
+    writer.setTms(true);
+    writer.setFormat("jpg");
+    QVERIFY(writer.write(out2, provider, &renderer, &conf));
+    QVERIFY(QFile(out2 + "/2/1/3.jpg").exists());
+    QVERIFY(!QFile(out2 + "/2/0/3.jpg").exists());
+    QVERIFY(QFile(out2 + "/2/0/2.jpg").exists());
+
+    QVERIFY(QDir(out).removeRecursively());
+    QVERIFY(QDir(out2).removeRecursively());
+    delete provider;
 }
 
 //*************************************************************************
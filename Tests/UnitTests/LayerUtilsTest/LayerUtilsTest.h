@@ -24,6 +24,10 @@ private slots:
 
     void test_computeMask();
     void test_joinContours();
+    void test_TiledVectorizer();
+    void test_DrawingsItem();
+    void test_RegionGrowing();
+    void test_TilePyramidWriter();
 
 
     void cleanupTestCase();